@@ -0,0 +1,174 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef PROV_DECODER_H
+#define PROV_DECODER_H
+
+/*
+ * OMA client provisioning (WBXML) decoder, the same one which is used
+ * by the provisioning service. Picks the internet and MMS settings out
+ * of the document exactly the way the device does.
+ *
+ * Thread safety: a ProvDecoder may be used by any number of threads at
+ * the same time once it's been configured, i.e. prov_decoder_set_limit()
+ * must not be called after it's been shared. ProvSettings are immutable
+ * and may be passed between threads. Reference counting is atomic.
+ */
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define PROV_DECODER_VERSION_MAJOR   1
+#define PROV_DECODER_VERSION_MINOR   0
+#define PROV_DECODER_VERSION_RELEASE 0
+
+#define PROV_DECODER_VERSION_(v1,v2,v3) \
+	((((v1) & 0x7f) << 24) | \
+	 (((v2) & 0xfff) << 12) | \
+	  ((v3) & 0xfff))
+
+#define PROV_DECODER_VERSION PROV_DECODER_VERSION_( \
+	PROV_DECODER_VERSION_MAJOR, \
+	PROV_DECODER_VERSION_MINOR, \
+	PROV_DECODER_VERSION_RELEASE)
+
+typedef struct prov_decoder ProvDecoder;
+typedef struct prov_settings ProvSettings;
+
+typedef enum prov_decoder_limit {
+	PROV_DECODER_LIMIT_BYTES,           /* Document size */
+	PROV_DECODER_LIMIT_DEPTH,           /* Element nesting */
+	PROV_DECODER_LIMIT_STRTBL,          /* WBXML string table size */
+	PROV_DECODER_LIMIT_CHARACTERISTICS, /* Number of <characteristic> */
+	PROV_DECODER_LIMIT_PARMS            /* Number of <parm> */
+} ProvDecoderLimit;
+
+typedef enum prov_decoder_error {
+	PROV_DECODER_ERROR_REJECTED,        /* Malformed or exceeds limits */
+	PROV_DECODER_ERROR_PARSE            /* Rejected by the WBXML parser */
+} ProvDecoderError;
+
+#define PROV_DECODER_ERROR (prov_decoder_error_quark())
+
+typedef enum prov_settings_context {
+	PROV_SETTINGS_INTERNET,
+	PROV_SETTINGS_MMS
+} ProvSettingsContext;
+
+typedef enum prov_settings_key {
+	PROV_SETTINGS_NAME,
+	PROV_SETTINGS_APN,
+	PROV_SETTINGS_USERNAME,
+	PROV_SETTINGS_PASSWORD,
+	PROV_SETTINGS_MESSAGE_PROXY,        /* MMS only */
+	PROV_SETTINGS_MESSAGE_CENTER,       /* MMS only */
+	PROV_SETTINGS_PORT                  /* MMS only */
+} ProvSettingsKey;
+
+typedef enum prov_settings_auth {
+	PROV_SETTINGS_AUTH_UNKNOWN,
+	PROV_SETTINGS_AUTH_PAP,
+	PROV_SETTINGS_AUTH_CHAP
+} ProvSettingsAuth;
+
+/* Run time version, PROV_DECODER_VERSION of the library */
+guint
+prov_decoder_version(
+	void);
+
+GQuark
+prov_decoder_error_quark(
+	void);
+
+/* Created with the same default limits as the service has */
+ProvDecoder *
+prov_decoder_new(
+	void);
+
+ProvDecoder *
+prov_decoder_ref(
+	ProvDecoder *decoder);
+
+void
+prov_decoder_unref(
+	ProvDecoder *decoder);
+
+/* Zero means no limit. FALSE if the limit is unknown */
+gboolean
+prov_decoder_set_limit(
+	ProvDecoder *decoder,
+	ProvDecoderLimit limit,
+	gsize value);
+
+gsize
+prov_decoder_get_limit(
+	ProvDecoder *decoder,
+	ProvDecoderLimit limit);
+
+/*
+ * Returns NULL and sets the error if the document can't be decoded.
+ * A document which decodes fine may still have no usable settings.
+ */
+ProvSettings *
+prov_decoder_decode(
+	ProvDecoder *decoder,
+	const void *data,
+	gsize size,
+	GError **error);
+
+ProvSettings *
+prov_settings_ref(
+	ProvSettings *settings);
+
+void
+prov_settings_unref(
+	ProvSettings *settings);
+
+gboolean
+prov_settings_has_context(
+	const ProvSettings *settings,
+	ProvSettingsContext context);
+
+/* NULL if the value (or the whole context) is missing */
+const char *
+prov_settings_get_string(
+	const ProvSettings *settings,
+	ProvSettingsContext context,
+	ProvSettingsKey key);
+
+ProvSettingsAuth
+prov_settings_get_auth(
+	const ProvSettings *settings,
+	ProvSettingsContext context);
+
+/*
+ * Floating a{sv} in the format returned by the service's
+ * DecodeProvisioningMessage method.
+ */
+GVariant *
+prov_settings_to_variant(
+	const ProvSettings *settings);
+
+G_END_DECLS
+
+#endif /* PROV_DECODER_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -5,30 +5,74 @@ Release:    1
 License:    GPLv2
 URL:        https://github.com/sailfishos/provisioning-service
 Source0:    %{name}-%{version}.tar.bz2
-BuildRequires:  pkgconfig(glib-2.0)
+BuildRequires:  pkgconfig(glib-2.0) >= 2.66
 BuildRequires:  pkgconfig(libwbxml2) >= 0.11.6
 BuildRequires:  pkgconfig(libgofono) >= 2.0.5
 BuildRequires:  pkgconfig(libglibutil)
 BuildRequires:  pkgconfig(systemd)
+BuildRequires:  pkgconfig(libsystemd)
+BuildRequires:  systemtap-sdt-devel
 Requires:  libgofono >= 2.0.5
+Requires:  libprovisioning-decoder = %{version}-%{release}
 Requires:  ofono
 Requires:  sailfish-setup
 
 %description
 A service for handling over-the-air (OTA) provisioning messages
 
+%package -n libprovisioning-decoder
+Summary:    OMA client provisioning decoder library
+
+%description -n libprovisioning-decoder
+The WBXML provisioning decoder used by the provisioning service
+
+%package -n libprovisioning-decoder-devel
+Summary:    Development files for libprovisioning-decoder
+Requires:   libprovisioning-decoder = %{version}-%{release}
+Requires:   pkgconfig(glib-2.0)
+
+%description -n libprovisioning-decoder-devel
+Headers and pkg-config file for libprovisioning-decoder
+
 %prep
 %setup -q -n %{name}-%{version}
 
 %build
 make generate
-make %{?_smp_mflags} KEEP_SYMBOLS=1 release
+make %{?_smp_mflags} LIBDIR=%{_libdir} KEEP_SYMBOLS=1 release
 
 %check
 make -C test test
 
 %install
-%make_install
+%make_install LIBDIR=%{_libdir}
+
+# Provider database index, see --providers
+%triggerin -- mobile-broadband-provider-info
+# A stale or missing index isn't worth failing the transaction for
+%{_libexecdir}/provisioning-service --compile-providers \
+  %{_datadir}/mobile-broadband-provider-info/serviceproviders.xml || \
+  echo "Failed to compile the provider database" >&2
+
+%triggerun -- mobile-broadband-provider-info
+if [ $2 -eq 0 ] ; then
+  rm -f %{_sharedstatedir}/provisioning-service/providers || :
+fi
+
+# Pick up the updated unit, a service kept running with --watch included
+%post
+systemctl daemon-reload || :
+systemctl try-restart dbus-org.nemomobile.provisioning.service || :
+
+%postun
+if [ $1 -eq 0 ] ; then
+  rm -f %{_sharedstatedir}/provisioning-service/providers || :
+fi
+systemctl daemon-reload || :
+
+%post -n libprovisioning-decoder -p /sbin/ldconfig
+
+%postun -n libprovisioning-decoder -p /sbin/ldconfig
 
 %files
 %defattr(-,root,root,-)
@@ -38,3 +82,14 @@ make -C test test
 %{_sysconfdir}/dbus-1/system.d/provisioning.conf
 %{_datadir}/dbus-1/system-services/org.nemomobile.provisioning.service
 %{_sysconfdir}/ofono/push_forwarder.d/ofono-provisioning.conf
+
+%files -n libprovisioning-decoder
+%defattr(-,root,root,-)
+%license COPYING
+%{_libdir}/libprovisioning-decoder.so.*
+
+%files -n libprovisioning-decoder-devel
+%defattr(-,root,root,-)
+%{_libdir}/libprovisioning-decoder.so
+%{_libdir}/pkgconfig/libprovisioning-decoder.pc
+%{_includedir}/provisioning-decoder/*.h
@@ -9,8 +9,10 @@
  */
 
 #include "log.h"
+#include "provisioning-recorder.h"
 #include <gofono_types.h>
 #include <stdlib.h>
+#include <string.h>
 
 GLOG_MODULE_DEFINE("provisioning");
 
@@ -48,15 +50,48 @@ void initlog(int target)
 	}
 }
 
-/* Implementation of logging function */
+/*
+ * Changes the log level at runtime. The module is "provisioning",
+ * "gofono" or "default", the level is one of GLOG_LEVEL_* values.
+ */
+gboolean prov_log_set_level(const char *module, int level)
+{
+	GLogModule *log = NULL;
+	if (!g_strcmp0(module, GLOG_MODULE_NAME.name)) {
+		log = &GLOG_MODULE_NAME;
+	} else if (!g_strcmp0(module, gofono_log.name)) {
+		log = &gofono_log;
+	} else if (!g_strcmp0(module, "default")) {
+		log = &gutil_log_default;
+	}
+	if (log && level >= GLOG_LEVEL_INHERIT && level <= log->max_level) {
+		log->level = level;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * Implementation of logging function. Everything goes to the flight
+ * recorder, formatting is only done if debug log is actually enabled.
+ */
 void prov_debug(const char *format, ...)
 {
 	va_list args;
 	va_start(args, format);
-	gutil_logv(GLOG_MODULE_CURRENT, GLOG_LEVEL_DEBUG, format, args);
+	prov_debugv(format, args);
 	va_end(args);
 }
 
+void prov_debugv(const char *format, va_list args)
+{
+	va_list copy;
+	va_copy(copy, args);
+	provisioning_recorder_addv(format, copy);
+	va_end(copy);
+	gutil_logv(GLOG_MODULE_CURRENT, GLOG_LEVEL_DEBUG, format, args);
+}
+
 /*
  * Local Variables:
  * mode: C
@@ -31,8 +31,12 @@
 
 extern void initlog(int target);
 
+/* Changes the level of the named module, FALSE if it's unknown */
+extern gboolean prov_log_set_level(const char *module, int level);
+
 /* Prototype for log implementation function */
 extern void prov_debug(const char *format, ...) G_GNUC_PRINTF(1,2);
+extern void prov_debugv(const char *format, va_list args);
 
 #define LOG(fmt, args...) { \
 		prov_debug(fmt, ## args); \
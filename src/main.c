@@ -16,11 +16,24 @@
  *
  */
 
+#include "provisioning-batch.h"
 #include "provisioning-decoder.h"
 #include "provisioning-ofono.h"
+#include "provisioning-prescan.h"
+#include "provisioning-providers.h"
+#include "provisioning-throttle.h"
+#include "provisioning-stats.h"
+#include "provisioning-store.h"
+#include "provisioning-trace.h"
+#include "provisioning-recorder.h"
+#include "provisioning-router.h"
+#include "provisioning-variant.h"
 #include "log.h"
 
 #include <errno.h>
+#include <string.h>
+
+#include <systemd/sd-daemon.h>
 
 /* Generated code */
 #include "org.nemomobile.provisioning.h"
@@ -29,19 +42,152 @@
 #define PROVISIONING_SERVICE_INTERFACE "org.nemomobile.provisioning.interface"
 #define PROVISIONING_SERVICE_PATH "/"
 #define PROVISIONING_CONTENT_TYPE "application/vnd.wap.connectivity-wbxml"
-#define PROVISIONING_BUS G_BUS_TYPE_SYSTEM
+#define PROVISIONING_BUS_SYSTEM "system"
+#define PROVISIONING_BUS_SESSION "session"
+#define PROVISIONING_ERROR_BUSY PROVISIONING_SERVICE ".Error.Busy"
+
+/* Last applied settings, see --store */
+#ifndef PROV_STORE_FILE
+#  define PROV_STORE_FILE "/var/lib/provisioning-service/settings"
+#endif
+
+/* Compiled mobile-broadband-provider-info, see --providers */
+#ifndef PROV_PROVIDERS_FILE
+#  define PROV_PROVIDERS_FILE "/var/lib/provisioning-service/providers"
+#endif
 
 #ifndef PROV_MAX_SAVE_FILES
 #  define PROV_MAX_SAVE_FILES (1000)
 #endif
 
+/* Default limit for transactions started by a shared message */
+#ifndef PROV_MAX_PARALLEL
+#  define PROV_MAX_PARALLEL (8)
+#endif
+
+/*
+ * Idle time before exiting. It doubles (up to the maximum) when work
+ * arrives in the first half of it, and halves when it doesn't, so the
+ * service stays resident while pushes keep coming in bursts.
+ */
+#ifndef PROV_IDLE_EXIT_MIN
+#  define PROV_IDLE_EXIT_MIN (2) /* sec */
+#endif
+
+#ifndef PROV_IDLE_EXIT_MAX
+#  define PROV_IDLE_EXIT_MAX (60) /* sec */
+#endif
+
+/*
+ * Push messages per minute, per originator (the from argument) and per
+ * IMSI. Batches, shared messages and the rest come from the trusted
+ * clients allowed by provisioning.conf and aren't rate limited.
+ */
+#ifndef PROV_SENDER_RATE
+#  define PROV_SENDER_RATE (20)
+#endif
+
+#ifndef PROV_IMSI_RATE
+#  define PROV_IMSI_RATE (10)
+#endif
+
+/* How many of those may arrive at once */
+#ifndef PROV_RATE_BURST
+#  define PROV_RATE_BURST (5)
+#endif
+
+/*
+ * Transactions being decoded, applied or queued. Beyond that, calls
+ * which would start more of them are told to retry.
+ */
+#ifndef PROV_MAX_IN_FLIGHT
+#  define PROV_MAX_IN_FLIGHT (32)
+#endif
+
+/* Number of queued messages handled per main loop iteration */
+#ifndef PROV_QUEUE_CHUNK
+#  define PROV_QUEUE_CHUNK (16)
+#endif
+
 static guint exit_timeout_id;
+static guint idle_exit = PROV_IDLE_EXIT_MIN;
+static int max_idle = PROV_IDLE_EXIT_MAX;
+static gint64 idle_since;
 static char *save_dir;
 static GMainLoop *loop;
 static GDBusConnection *dbus_connection;
 static OrgNemomobileProvisioningInterface *provisioning_proxy;
 static int pending_count;
 static gulong handle_message_id;
+static gulong submit_message_id;
+static gulong retry_failed_id;
+static gulong submit_retry_id;
+static gulong get_statistics_id;
+static gulong dump_log_id;
+static gulong set_log_level_id;
+static gulong handle_messages_id;
+static gulong decode_message_id;
+static gulong provision_settings_id;
+static gulong handle_shared_id;
+static gulong get_settings_id;
+static GQueue message_queue;
+static guint message_queue_id;
+static guint last_txid;
+static struct provisioning_batch_queue *batch_queue;
+static GQueue decode_queue;
+static GMutex save_mutex;
+static int max_parallel = PROV_MAX_PARALLEL;
+static struct provisioning_store *store;
+static char *store_file;
+static struct provisioning_providers *providers;
+static char *providers_file;
+static char *providers_xml;
+static gboolean watch;
+static GHashTable *reapply_table;
+static struct provisioning_prescan_limits prescan_limits;
+static struct provisioning_throttle *throttle;
+static int max_in_flight = PROV_MAX_IN_FLIGHT;
+static struct provisioning_router *router;
+static guint name_id;
+static char *bus_name;
+static int workers;
+static char *worker_address;
+static int shard = -1;
+static int first_tx;
+static guint txid_step = 1;
+static guint txid_slot;
+
+/* Provisioning data being applied */
+struct provisioning_transaction {
+	guint txid;
+	char *sender;
+	char *imsi;
+	gboolean reapply;
+	struct provisioning_data *data;
+	struct provisioning_batch *batch;
+	guint32 remote_time;
+	guint32 local_time;
+};
+
+/* Batch entry waiting to be decoded, (ssay) */
+struct provisioning_message {
+	guint txid;
+	char *sender;
+	GVariant *entry;
+	gint64 queued;
+	struct provisioning_prescan_info info;
+};
+
+static
+void
+provisioning_message_free(
+	gpointer data)
+{
+	struct provisioning_message *msg = data;
+	g_variant_unref(msg->entry);
+	g_free(msg->sender);
+	g_free(msg);
+}
 
 static
 gboolean
@@ -64,13 +210,43 @@ cancel_exit(void)
 	}
 }
 
+/* Called when work arrives, adjusts the idle timeout */
+static
+void
+provisioning_busy(void)
+{
+	cancel_exit();
+	if (idle_since) {
+		const gint64 idle = g_get_monotonic_time() - idle_since;
+		const guint max = MAX(max_idle, PROV_IDLE_EXIT_MIN);
+		const guint prev = idle_exit;
+
+		if (idle < idle_exit * G_USEC_PER_SEC / 2) {
+			idle_exit = MIN(idle_exit * 2, max);
+		} else {
+			idle_exit = MAX(idle_exit / 2, PROV_IDLE_EXIT_MIN);
+		}
+		if (idle_exit != prev) {
+			LOG("Idle timeout %u sec", idle_exit);
+		}
+		idle_since = 0;
+	}
+}
+
 static
 void
 schedule_exit(void)
 {
 	cancel_exit();
-	if (!pending_count) {
-		exit_timeout_id = g_timeout_add_seconds(2, handle_exit, NULL);
+	/* When watching SIMs, keep running. Workers exit with the front end */
+	if (!watch && !worker_address && !pending_count &&
+		g_queue_is_empty(&message_queue) &&
+		!provisioning_batch_queue_waiting(batch_queue) &&
+		g_queue_is_empty(&decode_queue) && !provisioning_router_busy(router)) {
+		if (!idle_since) {
+			idle_since = g_get_monotonic_time();
+		}
+		exit_timeout_id = g_timeout_add_seconds(idle_exit, handle_exit, NULL);
 	}
 }
 
@@ -80,6 +256,17 @@ provisioning_proxy_destroy(void)
 {
 	if (provisioning_proxy) {
         g_signal_handler_disconnect(provisioning_proxy, handle_message_id);
+        g_signal_handler_disconnect(provisioning_proxy, submit_message_id);
+        g_signal_handler_disconnect(provisioning_proxy, retry_failed_id);
+        g_signal_handler_disconnect(provisioning_proxy, submit_retry_id);
+        g_signal_handler_disconnect(provisioning_proxy, get_statistics_id);
+        g_signal_handler_disconnect(provisioning_proxy, dump_log_id);
+        g_signal_handler_disconnect(provisioning_proxy, set_log_level_id);
+        g_signal_handler_disconnect(provisioning_proxy, handle_messages_id);
+        g_signal_handler_disconnect(provisioning_proxy, decode_message_id);
+        g_signal_handler_disconnect(provisioning_proxy, provision_settings_id);
+        g_signal_handler_disconnect(provisioning_proxy, handle_shared_id);
+        g_signal_handler_disconnect(provisioning_proxy, get_settings_id);
         g_dbus_interface_skeleton_unexport(
             G_DBUS_INTERFACE_SKELETON(provisioning_proxy));
 		g_object_unref(provisioning_proxy);
@@ -87,17 +274,47 @@ provisioning_proxy_destroy(void)
 	}
 }
 
+static
+void
+provisioning_dump_log_line(
+	const char *line,
+	void *user_data)
+{
+	GINFO("%s", line);
+}
+
+/* Writes what's happened since the last dump to the log */
+static
+void
+provisioning_dump_log(
+	const char *imsi)
+{
+	GWARN("Provisioning %s failed", imsi);
+	provisioning_recorder_dump(FALSE, provisioning_dump_log_line, NULL);
+}
+
+/*
+ * Broadcasts the result and, if we know who submitted the transaction,
+ * also sends it to the submitter along with the transaction ID.
+ */
 static
 void
 send_signal(
+	guint txid,
+	const char *sender,
 	const char *imsi,
 	const char *path,
-	enum prov_result result)
+	const struct provisioning_ofono_report *report)
 {
-	LOG("send_signal %s %d", imsi, result);
+	const enum prov_result result = report->result;
+	LOG("send_signal %s %d txid %u", imsi, result, txid);
+	PROV_TRACE3(signal__emit, imsi, path, result);
 	if (provisioning_proxy) {
 		if (!imsi) imsi = "";
 		if (!path) path = "";
+		org_nemomobile_provisioning_interface_emit_apn_provisioning_result(
+			provisioning_proxy, imsi, path, result, report->internet_failed,
+			report->mms_failed, report->retries);
 		switch (result) {
 		case PROV_SUCCESS:
 			org_nemomobile_provisioning_interface_emit_apn_provisioning_succeeded(
@@ -113,6 +330,14 @@ send_signal(
 			break;
 		}
 	}
+	/* Workers don't know the submitters, the front end passes it on */
+	if ((sender || worker_address) && dbus_connection) {
+		g_dbus_connection_emit_signal(dbus_connection, sender,
+			PROVISIONING_SERVICE_PATH, PROVISIONING_SERVICE_INTERFACE,
+			"ProvisioningResult", g_variant_new("(ussuuuu)", txid, imsi,
+			path, result, report->internet_failed, report->mms_failed,
+			report->retries), NULL);
+	}
 }
 
 static
@@ -120,27 +345,271 @@ void
 provisioning_done(
 	const char *imsi,
 	const char *path,
-	enum prov_result result,
+	const struct provisioning_ofono_report *report,
 	void *param)
 {
-	LOG("Provisioning result %d imsi %s path %s", result, imsi, path);
-	send_signal(imsi, path, result);
+	struct provisioning_transaction *tx = param;
+	struct provisioning_batch *batch = tx->batch;
+	LOG("Provisioning result %d imsi %s path %s txid %u", report->result,
+		imsi, path, tx->txid);
+	switch (report->result) {
+	case PROV_SUCCESS:
+		provisioning_stats_count(PROV_STATS_RESULT_SUCCESS, 1);
+		break;
+	case PROV_PARTIAL_SUCCESS:
+		provisioning_stats_count(PROV_STATS_RESULT_PARTIAL_SUCCESS, 1);
+		break;
+	default:
+		provisioning_stats_count(PROV_STATS_RESULT_FAILURE, 1);
+		provisioning_dump_log(imsi);
+		break;
+	}
+	/* These are seconds since 1970 */
+	if (tx->local_time) {
+		provisioning_stats_record(PROV_STATS_PUSH_TO_APPLY,
+			g_get_real_time() - tx->local_time * (gint64)G_USEC_PER_SEC);
+	}
+	if (tx->remote_time) {
+		provisioning_stats_record(PROV_STATS_SENT_TO_APPLY,
+			g_get_real_time() - tx->remote_time * (gint64)G_USEC_PER_SEC);
+	}
+	if (report->retries) {
+		GINFO("%s: %u property write(s) retried", imsi, report->retries);
+	}
+	if (report->downtime_ms) {
+		GINFO("%s: data context was down for %u ms", imsi,
+			report->downtime_ms);
+	}
+	if (tx->reapply) {
+		/* Nobody asked for it, nothing to report */
+		g_hash_table_remove(reapply_table, tx->imsi);
+	} else if (report->internet_failed || report->mms_failed) {
+		/* Stored, so that RetryFailed works after a restart too */
+		LOG("Failed properties 0x%02x 0x%02x", report->internet_failed,
+			report->mms_failed);
+		provisioning_store_put_failed(store, tx->imsi, tx->data,
+			report->internet_failed, report->mms_failed);
+	} else {
+		provisioning_store_remove_failed(store, tx->imsi);
+		if (report->result == PROV_SUCCESS) {
+			provisioning_store_put(store, tx->imsi, tx->data);
+		}
+	}
+	if (!tx->reapply) {
+		send_signal(tx->txid, tx->sender, imsi, path, report);
+	}
+	provisioning_data_unref(tx->data);
+	g_free(tx->sender);
+	g_free(tx->imsi);
+	g_free(tx);
 	pending_count--;
+	provisioning_stats_set_in_flight(pending_count);
+	if (batch) {
+		provisioning_batch_done(batch, report->result);
+	}
 	schedule_exit();
 }
 
 static
-gboolean
-handle_message(
+guint
+provisioning_next_txid(void)
+{
+	guint txid;
+
+	/*
+	 * Zero is never used. With --workers, the front end and each worker
+	 * take every (N+1)th ID, so IDs are unique across the processes.
+	 */
+	do {
+		txid = (last_txid++) * txid_step + txid_slot + 1;
+	} while (!txid);
+	return txid;
+}
+
+/* Takes ownership of the data reference */
+static
+struct provisioning_transaction *
+provisioning_transaction_new(
+	guint txid,
+	const char *sender,
 	const char *imsi,
-	const guint8 *msg,
-	int len)
+	struct provisioning_data *data)
+{
+	struct provisioning_transaction *tx =
+		g_new0(struct provisioning_transaction, 1);
+	tx->txid = txid;
+	tx->sender = g_strdup(sender);
+	tx->imsi = g_strdup(imsi);
+	tx->data = data;
+	provisioning_busy();
+	pending_count++;
+	provisioning_stats_set_in_flight(pending_count);
+	return tx;
+}
+
+/* Takes ownership of the data reference */
+static
+void
+provisioning_transaction_start(
+	guint txid,
+	const char *sender,
+	const char *imsi,
+	struct provisioning_data *data,
+	struct provisioning_batch *batch,
+	guint internet_props,
+	guint mms_props,
+	guint32 remote_time,
+	guint32 local_time)
+{
+	struct provisioning_transaction *tx;
+	/* Whatever has been left out, if the provider database knows it */
+	struct provisioning_data *completed =
+		provisioning_providers_complete(providers, imsi, data);
+
+	provisioning_data_unref(data);
+	data = completed;
+	tx = provisioning_transaction_new(txid, sender, imsi, data);
+	tx->batch = batch;
+	tx->remote_time = remote_time;
+	tx->local_time = local_time;
+	provisioning_ofono_props(imsi, data, internet_props, mms_props,
+		provisioning_done, tx);
+}
+
+/* Quietly restores the stored settings, unless they are already there */
+static
+void
+provisioning_sim_appeared(
+	const char *imsi,
+	void *param)
+{
+	if (!g_hash_table_contains(reapply_table, imsi)) {
+		struct provisioning_data *data = provisioning_store_get(store, imsi);
+		if (data) {
+			struct provisioning_transaction *tx =
+				provisioning_transaction_new(provisioning_next_txid(),
+					NULL, imsi, data);
+			LOG("Re-applying %s txid %u", imsi, tx->txid);
+			tx->reapply = TRUE;
+			g_hash_table_add(reapply_table, g_strdup(imsi));
+			provisioning_ofono_update(imsi, data, provisioning_done, tx);
+		}
+	}
+}
+
+/* Shared messages */
+
+static
+guint
+provisioning_batch_txid(
+	void *param)
+{
+	return provisioning_next_txid();
+}
+
+static
+void
+provisioning_batch_start(
+	struct provisioning_batch *batch,
+	guint txid,
+	const char *imsi,
+	void *param)
+{
+	provisioning_transaction_start(txid, batch->sender, imsi,
+		provisioning_data_ref(batch->data), batch,
+		PROV_PROPERTIES_INTERNET, PROV_PROPERTIES_MMS, 0, 0);
+}
+
+static
+void
+provisioning_batch_finished(
+	struct provisioning_batch *batch,
+	void *param)
+{
+	LOG("Batch %u done %u/%u/%u", batch->id,
+		batch->results[PROV_SUCCESS],
+		batch->results[PROV_PARTIAL_SUCCESS],
+		batch->results[PROV_FAILURE]);
+	if (dbus_connection) {
+		g_dbus_connection_emit_signal(dbus_connection, batch->sender,
+			PROVISIONING_SERVICE_PATH, PROVISIONING_SERVICE_INTERFACE,
+			"ProvisioningBatchResult", g_variant_new("(uuuu)", batch->id,
+			batch->results[PROV_SUCCESS],
+			batch->results[PROV_PARTIAL_SUCCESS],
+			batch->results[PROV_FAILURE]), NULL);
+	}
+}
+
+static const struct provisioning_batch_callbacks provisioning_batch_cb = {
+	provisioning_batch_txid,
+	provisioning_batch_start,
+	provisioning_batch_finished
+};
+
+/*
+ * Message being saved and decoded in a worker thread. Jobs complete in
+ * the order they have been submitted, so that two pushes to the same
+ * SIM get applied in the order they have arrived.
+ */
+struct provisioning_decode_job {
+	GVariant *bytes;
+	struct provisioning_prescan_info info; /* From the main thread */
+	gboolean save;
+	gboolean done;
+	gint64 queued;
+	gint64 decode_usec;
+	struct provisioning_data *data;
+	void (*decoded)(struct provisioning_decode_job *job);
+	/* What's needed depends on who's waiting for the result */
+	guint txid;
+	char *sender;
+	char *imsi;
+	char **imsis;
+	guint32 remote_time;
+	guint32 local_time;
+	GDBusMethodInvocation *call;
+};
+
+static
+struct provisioning_decode_job *
+provisioning_decode_job_new(
+	GVariant *bytes,
+	const struct provisioning_prescan_info *info,
+	void (*decoded)(struct provisioning_decode_job *job))
 {
-	struct provisioning_data *prov_data;
+	struct provisioning_decode_job *job =
+		g_new0(struct provisioning_decode_job, 1);
+	job->bytes = g_variant_ref(bytes);
+	job->info = *info;
+	job->decoded = decoded;
+	return job;
+}
 
-	LOG("handle_message %s %d bytes", imsi, len);
+static
+void
+provisioning_decode_job_free(
+	struct provisioning_decode_job *job)
+{
+	if (job->data) {
+		provisioning_data_unref(job->data);
+	}
+	g_variant_unref(job->bytes);
+	g_strfreev(job->imsis);
+	g_free(job->imsi);
+	g_free(job->sender);
+	g_free(job);
+}
 
-	if (save_dir && g_file_test(save_dir, G_FILE_TEST_IS_DIR)) {
+/* Runs in a worker thread */
+static
+void
+provisioning_save_message(
+	const guint8 *msg,
+	gsize len)
+{
+	/* Workers would pick the same file name */
+	g_mutex_lock(&save_mutex);
+	if (g_file_test(save_dir, G_FILE_TEST_IS_DIR)) {
 		int i;
 		GString *path = g_string_new(NULL);
 		for (i=0; i<=PROV_MAX_SAVE_FILES; i++) {
@@ -158,15 +627,254 @@ handle_message(
 		}
 		g_string_free(path, TRUE);
 	}
+	g_mutex_unlock(&save_mutex);
+}
 
-	prov_data = decode_provisioning_wbxml(msg, len);
-	if (prov_data) {
-		cancel_exit();
-		pending_count++;
-		provisioning_ofono(imsi, prov_data, provisioning_done, NULL);
-		return TRUE;
+/* Runs in a worker thread */
+static
+void
+provisioning_decode_thread(
+	GTask *task,
+	gpointer object,
+	gpointer task_data,
+	GCancellable *cancellable)
+{
+	struct provisioning_decode_job *job = task_data;
+	gsize len = 0;
+	const guint8 *bytes = g_variant_get_fixed_array(job->bytes, &len, 1);
+	gint64 decode_start;
+
+	if (job->save) {
+		provisioning_save_message(bytes, len);
+	}
+	decode_start = g_get_monotonic_time();
+	PROV_TRACE1(decode__start, len);
+	/* Pre-scanned when the message was accepted */
+	job->data = decode_provisioning_wbxml_parse(bytes, len, &job->info,
+		NULL);
+	job->decode_usec = g_get_monotonic_time() - decode_start;
+	PROV_TRACE2(decode__done, len, job->data != NULL);
+	g_task_return_boolean(task, TRUE);
+}
+
+/* Back on the main thread */
+static
+void
+provisioning_decode_done(
+	GObject *object,
+	GAsyncResult *result,
+	gpointer user_data)
+{
+	struct provisioning_decode_job *job = user_data;
+
+	job->done = TRUE;
+	while ((job = g_queue_peek_head(&decode_queue)) != NULL && job->done) {
+		g_queue_pop_head(&decode_queue);
+		provisioning_stats_record(PROV_STATS_DECODE, job->decode_usec);
+		if (job->queued) {
+			provisioning_stats_record_since(PROV_STATS_QUEUE_WAIT,
+				job->queued);
+		}
+		if (!job->data) {
+			provisioning_stats_count(PROV_STATS_DECODE_ERRORS, 1);
+		}
+		job->decoded(job);
+		provisioning_decode_job_free(job);
+	}
+	schedule_exit();
+}
+
+/* Decoding is done off the main loop, the callback is invoked on it */
+static
+void
+provisioning_decode_start(
+	struct provisioning_decode_job *job)
+{
+	GTask *task = g_task_new(NULL, NULL, provisioning_decode_done, job);
+	g_task_set_task_data(task, job, NULL);
+	g_queue_push_tail(&decode_queue, job);
+	provisioning_busy();
+	g_task_run_in_thread(task, provisioning_decode_thread);
+	g_object_unref(task);
+}
+
+/*
+ * Malformed and oversized documents are rejected right here, without
+ * copying the data or waiting for a decoding thread. What the pre-scan
+ * finds out goes to the decoder.
+ */
+static
+const char *
+provisioning_check_content(
+	const char *type,
+	GVariant *data,
+	struct provisioning_prescan_info *info)
+{
+	gsize len = 0;
+	const guint8 *bytes = g_variant_get_fixed_array(data, &len, 1);
+	const char *error;
+
+	if (!len) {
+		return "Missing provisioning data";
+	} else if (!type || !type[0]) {
+		return "Missing content type";
+	} else if (g_ascii_strcasecmp(type, PROVISIONING_CONTENT_TYPE)) {
+		return "Unexpected content type";
+	} else if ((error = provisioning_prescan(bytes, len, &prescan_limits,
+		info)) != NULL) {
+		provisioning_stats_count(PROV_STATS_REJECTED, 1);
+		return error;
+	} else {
+		return NULL;
+	}
+}
+
+/* Returns NULL if the message is acceptable, otherwise the reason why not */
+static
+const char *
+provisioning_check_message(
+	const char *imsi,
+	const char *type,
+	GVariant *data,
+	struct provisioning_prescan_info *info)
+{
+	return (!imsi || !imsi[0]) ? "Missing IMSI" :
+		provisioning_check_content(type, data, info);
+}
+
+static
+void
+provisioning_message_decoded(
+	struct provisioning_decode_job *job)
+{
+	if (job->data) {
+		/* The transaction takes over the data */
+		provisioning_transaction_start(job->txid, job->sender, job->imsi,
+			job->data, NULL, PROV_PROPERTIES_INTERNET, PROV_PROPERTIES_MMS,
+			job->remote_time, job->local_time);
+		job->data = NULL;
 	} else {
-		return FALSE;
+		struct provisioning_ofono_report report;
+		provisioning_dump_log(job->imsi);
+		memset(&report, 0, sizeof(report));
+		report.result = PROV_FAILURE;
+		send_signal(job->txid, job->sender, job->imsi, NULL, &report);
+	}
+}
+
+static
+void
+provisioning_process_message(
+	guint txid,
+	const char *sender,
+	const char *imsi,
+	GVariant *data,
+	const struct provisioning_prescan_info *info,
+	guint32 remote_time,
+	guint32 local_time,
+	gint64 queued)
+{
+	struct provisioning_decode_job *job = provisioning_decode_job_new(data,
+		info, provisioning_message_decoded);
+	const gsize len = g_variant_n_children(data);
+
+	LOG("handle_message %s %u bytes txid %u", imsi, (guint)len, txid);
+	PROV_TRACE2(message__received, imsi, len);
+	job->save = (save_dir != NULL);
+	job->txid = txid;
+	job->sender = g_strdup(sender);
+	job->imsi = g_strdup(imsi);
+	job->remote_time = remote_time;
+	job->local_time = local_time;
+	job->queued = queued;
+	provisioning_decode_start(job);
+}
+
+/* Transactions running or waiting in one of the queues */
+static
+guint
+provisioning_in_flight(void)
+{
+	guint n = pending_count + g_queue_get_length(&message_queue);
+	GList *l;
+
+	for (l = decode_queue.head; l; l = l->next) {
+		const struct provisioning_decode_job *job = l->data;
+
+		n += job->imsis ? g_strv_length(job->imsis) : 1;
+	}
+	return n + provisioning_batch_queue_waiting(batch_queue);
+}
+
+/* Zero if the call may go ahead, otherwise milliseconds to wait */
+static
+guint
+provisioning_admit(void)
+{
+	return provisioning_throttle_call(throttle, provisioning_in_flight());
+}
+
+static
+void
+provisioning_return_busy(
+	GDBusMethodInvocation *call,
+	const char *what,
+	guint delay)
+{
+	char *msg = g_strdup_printf("Busy, retry after %u ms", delay);
+	GWARN("%s: %s", what, msg);
+	g_dbus_method_invocation_return_dbus_error(call,
+		PROVISIONING_ERROR_BUSY, msg);
+	g_free(msg);
+	schedule_exit();
+}
+
+/* HandleProvisioningMessage and SubmitProvisioningMessage */
+static
+void
+provisioning_push_message(
+	OrgNemomobileProvisioningInterface *proxy,
+	GDBusMethodInvocation *call,
+	const char *imsi,
+	const char *from,
+	guint32 remote_time,
+	guint32 local_time,
+	const char *type,
+	GVariant *data,
+	gboolean submit)
+{
+	/* Invalid messages don't use up anyone's budget */
+	struct provisioning_prescan_info info;
+	const char *error = provisioning_check_message(imsi, type, data, &info);
+	const guint delay = error ? 0 : provisioning_throttle_push(throttle,
+		from, imsi, provisioning_in_flight(), g_get_monotonic_time());
+	if (error) {
+		GERR("%s", error);
+		g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+			G_DBUS_ERROR_FAILED, "%s", error);
+	} else if (delay) {
+		char *msg = g_strdup_printf("Busy, retry after %u ms", delay);
+		GWARN("Message from %s for %s: %s", from, imsi, msg);
+		g_dbus_method_invocation_return_dbus_error(call,
+			PROVISIONING_ERROR_BUSY, msg);
+		g_free(msg);
+	} else {
+		const guint txid = provisioning_next_txid();
+		/*
+		 * Reply first, so that the caller learns the transaction ID
+		 * before the result arrives. Completing the call drops our
+		 * reference to it, keep it alive for the sender name.
+		 */
+		g_object_ref(call);
+		if (submit) {
+			org_nemomobile_provisioning_interface_complete_submit_provisioning_message(proxy, call, txid);
+		} else {
+			org_nemomobile_provisioning_interface_complete_handle_provisioning_message(proxy, call);
+		}
+		provisioning_process_message(txid,
+			g_dbus_method_invocation_get_sender(call), imsi, data, &info,
+			remote_time, local_time, 0);
+		g_object_unref(call);
 	}
 }
 
@@ -185,32 +893,406 @@ provisioning_handle_push_message(
 	GVariant *data,
 	void *user_data)
 {
-	gsize len = 0;
-	const guint8* bytes = g_variant_get_fixed_array(data, &len, 1);
-	if (!imsi || !imsi[0]) {
-		GERR("Missing IMSI");
+	provisioning_push_message(proxy, call, imsi, from, remote_time,
+		local_time, type, data, FALSE);
+	return TRUE;
+}
+
+static
+gboolean
+provisioning_handle_submit_message(
+	OrgNemomobileProvisioningInterface *proxy,
+	GDBusMethodInvocation *call,
+	const char *imsi,
+	const char *from,
+	guint32 remote_time,
+	guint32 local_time,
+	int dst_port,
+	int src_port,
+	const char *type,
+	GVariant *data,
+	void *user_data)
+{
+	provisioning_push_message(proxy, call, imsi, from, remote_time,
+		local_time, type, data, TRUE);
+	return TRUE;
+}
+
+static
+gboolean
+provisioning_process_queue(
+	gpointer user_data)
+{
+	int i;
+	for (i = 0; i < PROV_QUEUE_CHUNK &&
+		!g_queue_is_empty(&message_queue); i++) {
+		struct provisioning_message *msg = g_queue_pop_head(&message_queue);
+		const char *imsi = NULL;
+		GVariant *data = NULL;
+
+		g_variant_get(msg->entry, "(&s&s@ay)", &imsi, NULL, &data);
+		provisioning_process_message(msg->txid, msg->sender, imsi, data,
+			&msg->info, 0, 0, msg->queued);
+		g_variant_unref(data);
+		provisioning_message_free(msg);
+	}
+	if (g_queue_is_empty(&message_queue)) {
+		message_queue_id = 0;
+		schedule_exit();
+		return G_SOURCE_REMOVE;
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+static
+gboolean
+provisioning_handle_push_messages(
+	OrgNemomobileProvisioningInterface *proxy,
+	GDBusMethodInvocation *call,
+	GVariant *entries,
+	void *user_data)
+{
+	GVariantBuilder results;
+	GVariantIter it;
+	GVariant *entry;
+	const gint64 now = g_get_monotonic_time();
+	const char *sender = g_dbus_method_invocation_get_sender(call);
+	const guint delay = provisioning_admit();
+	guint accepted = 0, rejected = 0;
+
+	if (delay) {
+		provisioning_return_busy(call, "Batch", delay);
+		return TRUE;
+	}
+
+	g_variant_builder_init(&results, G_VARIANT_TYPE("a(bus)"));
+	g_variant_iter_init(&it, entries);
+	while ((entry = g_variant_iter_next_value(&it)) != NULL) {
+		const char *imsi = NULL, *type = NULL;
+		struct provisioning_prescan_info info;
+		GVariant *data = NULL;
+		const char *error;
+
+		g_variant_get(entry, "(&s&s@ay)", &imsi, &type, &data);
+		error = provisioning_check_message(imsi, type, data, &info);
+		if (error) {
+			rejected++;
+			g_variant_builder_add(&results, "(bus)", FALSE, 0, error);
+			g_variant_unref(entry);
+		} else {
+			/* The entry keeps the message data alive, no copying */
+			struct provisioning_message *msg =
+				g_new(struct provisioning_message, 1);
+			msg->txid = provisioning_next_txid();
+			msg->sender = g_strdup(sender);
+			msg->entry = entry;
+			msg->queued = now;
+			msg->info = info;
+			g_queue_push_tail(&message_queue, msg);
+			accepted++;
+			g_variant_builder_add(&results, "(bus)", TRUE, msg->txid, "");
+		}
+		g_variant_unref(data);
+	}
+
+	LOG("Queued %u message(s), rejected %u", accepted, rejected);
+	if (rejected) {
+		GERR("Rejected %u message(s)", rejected);
+	}
+	if (!g_queue_is_empty(&message_queue)) {
+		provisioning_busy();
+		if (!message_queue_id) {
+			message_queue_id = g_idle_add(provisioning_process_queue, NULL);
+		}
+	}
+	org_nemomobile_provisioning_interface_complete_handle_provisioning_messages(
+		proxy, call, g_variant_builder_end(&results));
+	return TRUE;
+}
+
+static
+void
+provisioning_shared_message_decoded(
+	struct provisioning_decode_job *job)
+{
+	const guint n = g_strv_length(job->imsis);
+	guint *txids = g_new(guint, n);
+	struct provisioning_batch *batch = provisioning_batch_queue_add(
+		batch_queue, g_dbus_method_invocation_get_sender(job->call),
+		job->data, (const char *const *)job->imsis, n, txids);
+
+	if (batch) {
+		/* Reply first, the transactions are started from an idle callback */
+		org_nemomobile_provisioning_interface_complete_handle_shared_provisioning_message(provisioning_proxy, job->call, batch->id,
+			g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32, txids,
+			n, sizeof(guint)));
+		provisioning_busy();
+	} else {
+		GERR("Undecodable provisioning data");
+		g_dbus_method_invocation_return_error(job->call, G_DBUS_ERROR,
+			G_DBUS_ERROR_INVALID_ARGS, "Undecodable provisioning data");
+	}
+	g_free(txids);
+}
+
+static
+gboolean
+provisioning_handle_shared_message(
+	OrgNemomobileProvisioningInterface *proxy,
+	GDBusMethodInvocation *call,
+	const char *const *imsis,
+	const char *type,
+	GVariant *data,
+	void *user_data)
+{
+	const gsize len = g_variant_n_children(data);
+	const char *error = provisioning_batch_check_imsis(imsis);
+	struct provisioning_prescan_info info;
+	guint delay = 0;
+
+	if (!error) {
+		error = provisioning_check_content(type, data, &info);
+	}
+	if (!error && (delay = provisioning_admit()) > 0) {
+		provisioning_return_busy(call, "Shared message", delay);
+	} else if (!error) {
+		/* The reply waits until the message is decoded */
+		struct provisioning_decode_job *job = provisioning_decode_job_new(
+			data, &info, provisioning_shared_message_decoded);
+		LOG("Shared message %u bytes %u IMSI(s)", (guint)len,
+			g_strv_length((char**)imsis));
+		job->imsis = g_strdupv((char**)imsis);
+		job->call = call;
+		provisioning_decode_start(job);
+	} else {
+		GERR("%s", error);
 		g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
-			G_DBUS_ERROR_FAILED, "Missing IMSI");
-	} else if (!bytes || !len) {
-		GERR("Missing provisioning data");
+			G_DBUS_ERROR_INVALID_ARGS, "%s", error);
+		schedule_exit();
+	}
+	return TRUE;
+}
+
+static
+void
+provisioning_dry_run_decoded(
+	struct provisioning_decode_job *job)
+{
+	if (job->data) {
+		org_nemomobile_provisioning_interface_complete_decode_provisioning_message(provisioning_proxy, job->call,
+			provisioning_data_variant(job->data));
+	} else {
+		g_dbus_method_invocation_return_error(job->call, G_DBUS_ERROR,
+			G_DBUS_ERROR_INVALID_ARGS, "Undecodable provisioning data");
+	}
+}
+
+static
+gboolean
+provisioning_handle_decode_message(
+	OrgNemomobileProvisioningInterface *proxy,
+	GDBusMethodInvocation *call,
+	const char *type,
+	GVariant *data,
+	void *user_data)
+{
+	const gsize len = g_variant_n_children(data);
+	struct provisioning_prescan_info info;
+	const char *error = provisioning_check_content(type, data, &info);
+	if (error) {
+		GERR("%s", error);
 		g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
-			G_DBUS_ERROR_FAILED, "Missing provisioning data");
-    } else if (!type || !type[0]) {
-        GERR("Missing content type");
+			G_DBUS_ERROR_INVALID_ARGS, "%s", error);
+		schedule_exit();
+	} else {
+		/* Dry run, nothing gets started and nothing gets saved */
+		struct provisioning_decode_job *job = provisioning_decode_job_new(
+			data, &info, provisioning_dry_run_decoded);
+		LOG("Decoding %u bytes", (guint)len);
+		job->call = call;
+		provisioning_decode_start(job);
+	}
+	return TRUE;
+}
+
+static
+gboolean
+provisioning_handle_provision_settings(
+	OrgNemomobileProvisioningInterface *proxy,
+	GDBusMethodInvocation *call,
+	const char *imsi,
+	GVariant *internet,
+	GVariant *mms,
+	void *user_data)
+{
+	const char *error = NULL;
+	struct provisioning_data *data = (imsi && imsi[0]) ?
+		provisioning_data_from_variant(internet, mms, &error) : NULL;
+	const guint delay = data ? provisioning_admit() : 0;
+	if (delay) {
+		provisioning_data_unref(data);
+		provisioning_return_busy(call, imsi, delay);
+	} else if (data) {
+		const guint txid = provisioning_next_txid();
+		LOG("Provisioning %s txid %u", imsi, txid);
+		/* Same as for the push message, reply first */
+		g_object_ref(call);
+		org_nemomobile_provisioning_interface_complete_provision_settings(
+			proxy, call, txid);
+		provisioning_transaction_start(txid,
+			g_dbus_method_invocation_get_sender(call), imsi, data, NULL,
+			PROV_PROPERTIES_INTERNET, PROV_PROPERTIES_MMS, 0, 0);
+		g_object_unref(call);
+	} else {
+		if (!error) error = "Missing IMSI";
+		GERR("%s", error);
 		g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
-			G_DBUS_ERROR_FAILED, "Missing content type");
-    } else if (g_ascii_strcasecmp(type, PROVISIONING_CONTENT_TYPE)) {
-        GERR("Unexpected content type %s", type);
+			G_DBUS_ERROR_INVALID_ARGS, "%s", error);
+		schedule_exit();
+	}
+	return TRUE;
+}
+
+static
+gboolean
+provisioning_handle_get_settings(
+	OrgNemomobileProvisioningInterface *proxy,
+	GDBusMethodInvocation *call,
+	const char *imsi,
+	void *user_data)
+{
+	GVariant *settings = provisioning_store_lookup(store, imsi);
+	if (!settings) {
+		settings = g_variant_ref_sink(g_variant_new_array(
+			G_VARIANT_TYPE("{sv}"), NULL, 0));
+	}
+	org_nemomobile_provisioning_interface_complete_get_provisioned_settings(
+		proxy, call, settings);
+	g_variant_unref(settings);
+	schedule_exit();
+	return TRUE;
+}
+
+/* RetryFailed and SubmitRetryFailed */
+static
+void
+provisioning_retry_failed(
+	OrgNemomobileProvisioningInterface *proxy,
+	GDBusMethodInvocation *call,
+	const char *imsi,
+	gboolean submit)
+{
+	guint internet = 0, mms = 0;
+	struct provisioning_data *data = provisioning_store_get_failed(store,
+		imsi, &internet, &mms);
+	/* The record stays until the retry goes ahead */
+	const guint delay = data ? provisioning_admit() : 0;
+	if (delay) {
+		provisioning_data_unref(data);
+		provisioning_return_busy(call, imsi, delay);
+	} else if (data) {
+		const guint txid = provisioning_next_txid();
+		LOG("Retrying %s 0x%02x 0x%02x", imsi, internet, mms);
+		provisioning_store_remove_failed(store, imsi);
+		/* The transaction may finish right away, reply first */
+		g_object_ref(call);
+		if (submit) {
+			org_nemomobile_provisioning_interface_complete_submit_retry_failed(
+				proxy, call, txid);
+		} else {
+			org_nemomobile_provisioning_interface_complete_retry_failed(proxy,
+				call);
+		}
+		provisioning_transaction_start(txid,
+			g_dbus_method_invocation_get_sender(call), imsi, data, NULL,
+			internet, mms, 0, 0);
+		g_object_unref(call);
+	} else {
+		GERR("Nothing to retry for %s", imsi);
 		g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
-			G_DBUS_ERROR_FAILED, "Unexpected content type");
+			G_DBUS_ERROR_FAILED, "Nothing to retry");
+	}
+}
+
+static
+gboolean
+provisioning_handle_retry_failed(
+	OrgNemomobileProvisioningInterface *proxy,
+	GDBusMethodInvocation *call,
+	const char *imsi,
+	void *user_data)
+{
+	provisioning_retry_failed(proxy, call, imsi, FALSE);
+	return TRUE;
+}
+
+static
+gboolean
+provisioning_handle_submit_retry(
+	OrgNemomobileProvisioningInterface *proxy,
+	GDBusMethodInvocation *call,
+	const char *imsi,
+	void *user_data)
+{
+	provisioning_retry_failed(proxy, call, imsi, TRUE);
+	return TRUE;
+}
+
+static
+gboolean
+provisioning_handle_get_statistics(
+	OrgNemomobileProvisioningInterface *proxy,
+	GDBusMethodInvocation *call,
+	void *user_data)
+{
+	org_nemomobile_provisioning_interface_complete_get_statistics(proxy, call,
+		provisioning_stats_variant());
+	return TRUE;
+}
+
+static
+void
+provisioning_collect_log_line(
+	const char *line,
+	void *user_data)
+{
+	g_ptr_array_add(user_data, g_strdup(line));
+}
+
+static
+gboolean
+provisioning_handle_dump_log(
+	OrgNemomobileProvisioningInterface *proxy,
+	GDBusMethodInvocation *call,
+	void *user_data)
+{
+	GPtrArray *lines = g_ptr_array_new_with_free_func(g_free);
+	provisioning_recorder_dump(TRUE, provisioning_collect_log_line, lines);
+	g_ptr_array_add(lines, NULL);
+	org_nemomobile_provisioning_interface_complete_dump_log(proxy, call,
+		(const gchar *const *)lines->pdata);
+	g_ptr_array_free(lines, TRUE);
+	return TRUE;
+}
+
+static
+gboolean
+provisioning_handle_set_log_level(
+	OrgNemomobileProvisioningInterface *proxy,
+	GDBusMethodInvocation *call,
+	const char *module,
+	int level,
+	void *user_data)
+{
+	if (prov_log_set_level(module, level)) {
+		GINFO("Log level of %s set to %d", module, level);
+		org_nemomobile_provisioning_interface_complete_set_log_level(proxy,
+			call);
 	} else {
-		if (!handle_message(imsi, bytes, len)) {
-			send_signal(imsi, NULL, PROV_FAILURE);
-			schedule_exit();
-		}
-		org_nemomobile_provisioning_interface_complete_handle_provisioning_message(proxy, call);
+		g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+			G_DBUS_ERROR_INVALID_ARGS, "Invalid module or level");
 	}
-    return TRUE;
+	return TRUE;
 }
 
 static
@@ -225,6 +1307,16 @@ provisioning_dbus_ready(
 	GASSERT(!provisioning_proxy);
 	GASSERT(!dbus_connection);
 	g_object_ref(dbus_connection = bus);
+	if (router) {
+		/* The workers do the actual work */
+		if (!provisioning_router_export(router, bus,
+			PROVISIONING_SERVICE_PATH,
+			org_nemomobile_provisioning_interface_interface_info(), &error)) {
+			GERR("Could not start: %s", GERRMSG(error));
+			g_error_free(error);
+		}
+		return;
+	}
 	provisioning_proxy = org_nemomobile_provisioning_interface_skeleton_new();
 	if (g_dbus_interface_skeleton_export(
 	    G_DBUS_INTERFACE_SKELETON(provisioning_proxy), bus,
@@ -232,6 +1324,39 @@ provisioning_dbus_ready(
 		handle_message_id = g_signal_connect(provisioning_proxy,
 			"handle-handle-provisioning-message",
 			G_CALLBACK(provisioning_handle_push_message), NULL);
+		submit_message_id = g_signal_connect(provisioning_proxy,
+			"handle-submit-provisioning-message",
+			G_CALLBACK(provisioning_handle_submit_message), NULL);
+		retry_failed_id = g_signal_connect(provisioning_proxy,
+			"handle-retry-failed",
+			G_CALLBACK(provisioning_handle_retry_failed), NULL);
+		submit_retry_id = g_signal_connect(provisioning_proxy,
+			"handle-submit-retry-failed",
+			G_CALLBACK(provisioning_handle_submit_retry), NULL);
+		get_statistics_id = g_signal_connect(provisioning_proxy,
+			"handle-get-statistics",
+			G_CALLBACK(provisioning_handle_get_statistics), NULL);
+		dump_log_id = g_signal_connect(provisioning_proxy,
+			"handle-dump-log",
+			G_CALLBACK(provisioning_handle_dump_log), NULL);
+		set_log_level_id = g_signal_connect(provisioning_proxy,
+			"handle-set-log-level",
+			G_CALLBACK(provisioning_handle_set_log_level), NULL);
+		handle_messages_id = g_signal_connect(provisioning_proxy,
+			"handle-handle-provisioning-messages",
+			G_CALLBACK(provisioning_handle_push_messages), NULL);
+		decode_message_id = g_signal_connect(provisioning_proxy,
+			"handle-decode-provisioning-message",
+			G_CALLBACK(provisioning_handle_decode_message), NULL);
+		provision_settings_id = g_signal_connect(provisioning_proxy,
+			"handle-provision-settings",
+			G_CALLBACK(provisioning_handle_provision_settings), NULL);
+		handle_shared_id = g_signal_connect(provisioning_proxy,
+			"handle-handle-shared-provisioning-message",
+			G_CALLBACK(provisioning_handle_shared_message), NULL);
+		get_settings_id = g_signal_connect(provisioning_proxy,
+			"handle-get-provisioned-settings",
+			G_CALLBACK(provisioning_handle_get_settings), NULL);
 	} else {
 		GERR("Could not start: %s", GERRMSG(error));
 		g_error_free(error);
@@ -248,6 +1373,7 @@ provisioning_dbus_name_acquired(
 	gpointer arg)
 {
 	LOG("Acquired service name '%s'", name);
+	sd_notify(0, "READY=1");
 }
 
 static
@@ -261,8 +1387,128 @@ provisioning_dbus_name_lost(
 	g_main_loop_quit(loop);
 }
 
+/*
+ * Acquires the service name on the system or session bus, or on the
+ * message bus at the given address. Returns zero on failure.
+ */
+static
+guint
+provisioning_own_name(
+	const char *bus_name,
+	GError **error)
+{
+	GBusType type;
+
+	if (!bus_name || !strcmp(bus_name, PROVISIONING_BUS_SYSTEM)) {
+		type = G_BUS_TYPE_SYSTEM;
+	} else if (!strcmp(bus_name, PROVISIONING_BUS_SESSION)) {
+		type = G_BUS_TYPE_SESSION;
+	} else {
+		guint id = 0;
+		GDBusConnection *bus = g_dbus_connection_new_for_address_sync(
+			bus_name, G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+			G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION, NULL, NULL,
+			error);
+		if (bus) {
+			provisioning_dbus_ready(bus, bus_name, NULL);
+			id = g_bus_own_name_on_connection(bus, PROVISIONING_SERVICE,
+				G_BUS_NAME_OWNER_FLAGS_REPLACE,
+				provisioning_dbus_name_acquired,
+				provisioning_dbus_name_lost, NULL, NULL);
+			g_object_unref(bus);
+		}
+		return id;
+	}
+
+	/* Acquire name, don't allow replacement */
+	return g_bus_own_name(type, PROVISIONING_SERVICE,
+		G_BUS_NAME_OWNER_FLAGS_REPLACE, provisioning_dbus_ready,
+		provisioning_dbus_name_acquired, provisioning_dbus_name_lost,
+		NULL, NULL);
+}
+
+static
+void
+provisioning_worker_closed(
+	GDBusConnection *conn,
+	gboolean remote_peer_vanished,
+	GError *error,
+	gpointer user_data)
+{
+	GINFO("Front end has gone");
+	g_main_loop_quit(loop);
+}
+
+/* Worker connecting back to the front end, see --workers */
+static
+gboolean
+provisioning_worker_connect(
+	const char *address,
+	GError **error)
+{
+	GDBusConnection *conn = g_dbus_connection_new_for_address_sync(address,
+		G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT, NULL, NULL, error);
+
+	if (conn) {
+		LOG("Worker %d connected to %s", shard, address);
+		provisioning_dbus_ready(conn, NULL, NULL);
+		g_signal_connect(conn, "closed",
+			G_CALLBACK(provisioning_worker_closed), NULL);
+		g_object_unref(conn);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/* A worker is up, the front end can take the name */
+static
+void
+provisioning_router_ready(
+	void *param)
+{
+	GError *error = NULL;
+
+	name_id = provisioning_own_name(bus_name, &error);
+	if (!name_id) {
+		GERR("%s: %s", bus_name, GERRMSG(error));
+		g_error_free(error);
+		g_main_loop_quit(loop);
+	}
+}
+
+static
+void
+provisioning_router_busy_cb(
+	void *param)
+{
+	provisioning_busy();
+}
+
+static
+void
+provisioning_router_idle_cb(
+	void *param)
+{
+	schedule_exit();
+}
+
+static const struct provisioning_router_callbacks provisioning_router_cb = {
+	provisioning_router_ready,
+	provisioning_router_busy_cb,
+	provisioning_router_idle_cb
+};
+
 static gint log_target = 0;
 static gboolean debug = 0;
+static gboolean reactivate = 0;
+static gboolean prewarm = TRUE;
+static int max_size = PROV_PRESCAN_MAX_BYTES;
+static int max_depth = PROV_PRESCAN_MAX_DEPTH;
+static int max_characteristics = PROV_PRESCAN_MAX_CHARACTERISTICS;
+static int max_parms = PROV_PRESCAN_MAX_PARMS;
+static int sender_rate = PROV_SENDER_RATE;
+static int imsi_rate = PROV_IMSI_RATE;
+static int rate_burst = PROV_RATE_BURST;
 
 static GOptionEntry entries[] = {
 	{ "log", 'l', 0,G_OPTION_ARG_INT, &log_target,
@@ -273,18 +1519,88 @@ static GOptionEntry entries[] = {
 	  "Disable start timeout for debugging", NULL },
 	{ "save-dir", 's', 0, G_OPTION_ARG_STRING, &save_dir,
 	  "Save received messages to DIR", "DIR" },
+	{ "reactivate", 'r', 0, G_OPTION_ARG_NONE, &reactivate,
+	  "Re-activate contexts after provisioning", NULL },
+	{ "bus", 'b', 0, G_OPTION_ARG_STRING, &bus_name,
+	  "Bus to register on: system (default), session or ADDRESS", "BUS" },
+	{ "max-parallel", 'p', 0, G_OPTION_ARG_INT, &max_parallel,
+	  "Transactions per shared message at a time, 0 for no limit "
+	  "(default " G_STRINGIFY(PROV_MAX_PARALLEL) ")", "N" },
+	{ "max-idle", 'i', 0, G_OPTION_ARG_INT, &max_idle,
+	  "Stay up to SEC after the last transaction when busy (default "
+	  G_STRINGIFY(PROV_IDLE_EXIT_MAX) ")", "SEC" },
+	{ "no-prewarm", 0, G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &prewarm,
+	  "Don't connect to ofono until there's something to provision", NULL },
+	{ "store", 0, 0, G_OPTION_ARG_STRING, &store_file,
+	  "Keep applied settings in FILE (default " PROV_STORE_FILE ")",
+	  "FILE" },
+	{ "providers", 0, 0, G_OPTION_ARG_STRING, &providers_file,
+	  "Fill in missing settings from the provider index FILE (default "
+	  PROV_PROVIDERS_FILE ")", "FILE" },
+	{ "compile-providers", 0, 0, G_OPTION_ARG_FILENAME, &providers_xml,
+	  "Compile serviceproviders.xml into the provider index and exit",
+	  "XML" },
+	{ "watch", 'w', 0, G_OPTION_ARG_NONE, &watch,
+	  "Keep running and re-apply stored settings to inserted SIMs", NULL },
+	{ "max-size", 0, 0, G_OPTION_ARG_INT, &max_size,
+	  "Reject WBXML documents larger than BYTES, 0 for no limit "
+	  "(default " G_STRINGIFY(PROV_PRESCAN_MAX_BYTES) ")", "BYTES" },
+	{ "max-depth", 0, 0, G_OPTION_ARG_INT, &max_depth,
+	  "Reject WBXML documents nested deeper than N, 0 for no limit "
+	  "(default " G_STRINGIFY(PROV_PRESCAN_MAX_DEPTH) ")", "N" },
+	{ "max-characteristics", 0, 0, G_OPTION_ARG_INT, &max_characteristics,
+	  "Reject WBXML documents with more than N characteristics, "
+	  "0 for no limit (default "
+	  G_STRINGIFY(PROV_PRESCAN_MAX_CHARACTERISTICS) ")", "N" },
+	{ "max-parms", 0, 0, G_OPTION_ARG_INT, &max_parms,
+	  "Reject WBXML documents with more than N parms, 0 for no limit "
+	  "(default " G_STRINGIFY(PROV_PRESCAN_MAX_PARMS) ")", "N" },
+	{ "sender-rate", 0, 0, G_OPTION_ARG_INT, &sender_rate,
+	  "Accept up to N push messages per minute from one originator, "
+	  "0 for no limit (default " G_STRINGIFY(PROV_SENDER_RATE) ")", "N" },
+	{ "imsi-rate", 0, 0, G_OPTION_ARG_INT, &imsi_rate,
+	  "Accept up to N push messages per minute for one IMSI, "
+	  "0 for no limit (default " G_STRINGIFY(PROV_IMSI_RATE) ")", "N" },
+	{ "rate-burst", 0, 0, G_OPTION_ARG_INT, &rate_burst,
+	  "Let N push messages per originator or IMSI through at once "
+	  "(default " G_STRINGIFY(PROV_RATE_BURST) ")", "N" },
+	{ "max-in-flight", 0, 0, G_OPTION_ARG_INT, &max_in_flight,
+	  "Turn away calls which would start more transactions while N are "
+	  "being handled or queued, 0 for no limit (default "
+	  G_STRINGIFY(PROV_MAX_IN_FLIGHT) ")", "N" },
+	{ "workers", 0, 0, G_OPTION_ARG_INT, &workers,
+	  "Split the SIMs between N worker processes, 0 to do without "
+	  "(default). Each worker applies --sender-rate and --max-in-flight "
+	  "on its own, so one originator gets up to N times its rate",
+	  "N" },
+	{ "worker", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_STRING, &worker_address,
+	  "Run as a worker of the front end at ADDRESS", "ADDRESS" },
+	{ "shard", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT, &shard,
+	  "Index of this worker", "N" },
+	{ "first-tx", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT, &first_tx,
+	  "Sequence number of the first transaction", "SEQ" },
 	{ NULL },
 };
 
 int main(int argc, char **argv)
 {
-	guint name_id;
+	struct provisioning_ofono_watch *ofono_watch = NULL;
 	GError *error = NULL;
 	GOptionContext *context = g_option_context_new(NULL);
+	char **worker_argv = g_strdupv(argv);
+	char *exe = g_file_read_link("/proc/self/exe", NULL);
+	gboolean front_end, ok;
+
+	/* Workers run the same executable with the same options */
+	if (exe) {
+		g_free(worker_argv[0]);
+		worker_argv[0] = exe;
+	}
 
 	gutil_log_timestamp = FALSE;
 	g_option_context_add_main_entries(context, entries, NULL);
 	if (g_option_context_parse(context, &argc, &argv, &error) == FALSE) {
+		g_strfreev(worker_argv);
 		if (error != NULL) {
 			g_printerr("%s\n", error->message);
 			g_error_free(error);
@@ -296,12 +1612,69 @@ int main(int argc, char **argv)
 	}
 
 	g_option_context_free(context);
+	if (workers < 0 || (worker_address && (shard < 0 || shard >= workers))) {
+		g_printerr("Invalid number of workers or shard\n");
+		g_strfreev(worker_argv);
+		return 1;
+	}
+	front_end = workers > 0 && !worker_address;
+
+	/* Run by the package scripts when the provider database changes */
+	if (providers_xml) {
+		const char *file = providers_file ? providers_file :
+			PROV_PROVIDERS_FILE;
+		ok = provisioning_providers_compile_file(providers_xml, file,
+			&error);
+		if (!ok) {
+			g_printerr("%s\n", error->message);
+			g_error_free(error);
+		}
+		g_strfreev(worker_argv);
+		g_free(providers_xml);
+		g_free(providers_file);
+		return ok ? 0 : 1;
+	}
 
 	/* Turn logging on if debugging is enabled */
 	if (debug && !log_target) log_target = LOGSTDOUT;
 	initlog(log_target);
 	LOG("Starting");
 
+	if (worker_address) {
+		/* Each worker has its own IDs, stored settings and saved files */
+		char *file = g_strdup_printf("%s.%d", store_file ? store_file :
+			PROV_STORE_FILE, shard);
+		g_free(store_file);
+		store_file = file;
+		if (save_dir) {
+			char *dir = g_strdup_printf("%s/%d", save_dir, shard);
+			g_free(save_dir);
+			save_dir = dir;
+		}
+		txid_step = workers + 1;
+		txid_slot = shard + 1;
+		last_txid = MAX(first_tx, 0);
+	}
+
+	provisioning_ofono_set_reactivate(reactivate);
+	batch_queue = provisioning_batch_queue_new(max_parallel,
+		&provisioning_batch_cb, NULL);
+
+	/* The same limits apply to the decoding threads */
+	prescan_limits = provisioning_prescan_defaults;
+	prescan_limits.max_bytes = MAX(max_size, 0);
+	prescan_limits.max_depth = MAX(max_depth, 0);
+	prescan_limits.max_characteristics = MAX(max_characteristics, 0);
+	prescan_limits.max_parms = MAX(max_parms, 0);
+	decode_provisioning_set_limits(&prescan_limits);
+
+	/* Back-pressure for everything that starts a transaction */
+	throttle = provisioning_throttle_new(MAX(rate_burst, 1),
+		MAX(sender_rate, 0), MAX(imsi_rate, 0), MAX(max_in_flight, 0));
+
+	/* Decoder lives in the shared library, route its output through us */
+	decode_provisioning_set_log_func(prov_debugv);
+
 	/* Create file storage directory */
 	if (save_dir) {
 		if (g_mkdir_with_parents(save_dir, 0755) < 0) {
@@ -309,16 +1682,55 @@ int main(int argc, char **argv)
 		}
 	}
 
-	/* Acquire name, don't allow replacement */
-	name_id = g_bus_own_name(PROVISIONING_BUS, PROVISIONING_SERVICE,
-		G_BUS_NAME_OWNER_FLAGS_REPLACE, provisioning_dbus_ready,
-		provisioning_dbus_name_acquired, provisioning_dbus_name_lost,
-		NULL, NULL);
+	reapply_table = g_hash_table_new_full(g_str_hash, g_str_equal,
+		g_free, NULL);
+	if (!front_end) {
+		store = provisioning_store_new(store_file ? store_file :
+			PROV_STORE_FILE);
+		providers = provisioning_providers_new(providers_file ?
+			providers_file : PROV_PROVIDERS_FILE);
+	}
+
+	/*
+	 * Start talking to ofono right away, in parallel with acquiring the
+	 * bus name, so that the message which has caused the activation
+	 * doesn't have to wait for the SIM and connection managers.
+	 */
+	if (!front_end && (watch || prewarm)) {
+		ofono_watch = provisioning_ofono_watch_new(watch ?
+			provisioning_sim_appeared : NULL, NULL);
+	}
+
+	/* The front end takes the name once the first worker is there */
+	if (front_end) {
+		router = provisioning_router_new((const char *const *)worker_argv,
+			workers, PROVISIONING_ERROR_BUSY, &provisioning_router_cb, NULL,
+			&error);
+		ok = (router != NULL);
+	} else if (worker_address) {
+		ok = provisioning_worker_connect(worker_address, &error);
+	} else {
+		name_id = provisioning_own_name(bus_name, &error);
+		ok = (name_id != 0);
+	}
+	g_strfreev(worker_argv);
+	if (!ok) {
+		GERR("%s: %s", worker_address ? worker_address : bus_name,
+			GERRMSG(error));
+		g_error_free(error);
+		g_hash_table_destroy(reapply_table);
+		provisioning_ofono_watch_free(ofono_watch);
+		provisioning_store_free(store);
+		provisioning_providers_free(providers);
+		provisioning_throttle_free(throttle);
+		provisioning_batch_queue_free(batch_queue);
+		return 1;
+	}
 
 	loop = g_main_loop_new(NULL, FALSE);
 
 	/* Exit in 30 seconds if nothing is happening */
-	if (!debug) {
+	if (!watch && !debug && !worker_address) {
 		exit_timeout_id = g_timeout_add_seconds(30, handle_exit, 0);
 	}
 
@@ -327,8 +1739,26 @@ int main(int argc, char **argv)
 	g_main_loop_unref(loop);
 
 	/* Cleanup */
+	if (message_queue_id) {
+		g_source_remove(message_queue_id);
+	}
+	while (!g_queue_is_empty(&message_queue)) {
+		provisioning_message_free(g_queue_pop_head(&message_queue));
+	}
+	provisioning_batch_queue_free(batch_queue);
+	provisioning_ofono_watch_free(ofono_watch);
+	provisioning_router_free(router);
 	provisioning_proxy_destroy();
-	g_bus_unown_name(name_id);
+	g_hash_table_destroy(reapply_table);
+	provisioning_store_free(store);
+	provisioning_providers_free(providers);
+	provisioning_throttle_free(throttle);
+	g_free(store_file);
+	g_free(providers_file);
+	g_free(bus_name);
+	if (name_id) {
+		g_bus_unown_name(name_id);
+	}
 	if (dbus_connection) {
 		g_dbus_connection_flush_sync(dbus_connection, NULL, NULL);
 		g_object_unref(dbus_connection);
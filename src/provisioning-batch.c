@@ -0,0 +1,236 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "provisioning-batch.h"
+#include "provisioning-decoder.h"
+
+struct provisioning_batch_queue {
+	GQueue batches;             /* Those with transactions to start */
+	GSList *all;                /* Including those being finished */
+	int max_parallel;
+	int running;
+	guint pump_id;
+	const struct provisioning_batch_callbacks *cb;
+	void *param;
+};
+
+/* The public part comes first */
+struct provisioning_batch_priv {
+	struct provisioning_batch pub;
+	struct provisioning_batch_queue *queue;
+	char **imsis;
+	guint *txids;
+};
+
+static
+void
+provisioning_batch_free(
+	struct provisioning_batch_priv *priv)
+{
+	provisioning_data_unref(priv->pub.data);
+	g_strfreev(priv->imsis);
+	g_free(priv->txids);
+	g_free(priv->pub.sender);
+	g_free(priv);
+}
+
+/* Starts as many queued transactions as the limit allows */
+static
+gboolean
+provisioning_batch_pump(
+	gpointer data)
+{
+	struct provisioning_batch_queue *queue = data;
+	struct provisioning_batch_priv *priv;
+
+	queue->pump_id = 0;
+	while ((queue->max_parallel <= 0 ||
+		queue->running < queue->max_parallel) &&
+		(priv = g_queue_peek_head(&queue->batches)) != NULL) {
+		/* The transaction may finish (and free the batch) right away */
+		struct provisioning_batch *batch = &priv->pub;
+		const guint i = batch->started++;
+		if (batch->started == batch->count) {
+			g_queue_pop_head(&queue->batches);
+		}
+		queue->running++;
+		queue->cb->start(batch, priv->txids[i], priv->imsis[i],
+			queue->param);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+static
+void
+provisioning_batch_schedule(
+	struct provisioning_batch_queue *queue)
+{
+	if (!queue->pump_id && !g_queue_is_empty(&queue->batches)) {
+		queue->pump_id = g_idle_add(provisioning_batch_pump, queue);
+	}
+}
+
+struct provisioning_batch_queue *
+provisioning_batch_queue_new(
+	int max_parallel,
+	const struct provisioning_batch_callbacks *cb,
+	void *param)
+{
+	struct provisioning_batch_queue *queue =
+		g_new0(struct provisioning_batch_queue, 1);
+
+	g_queue_init(&queue->batches);
+	queue->max_parallel = max_parallel;
+	queue->cb = cb;
+	queue->param = param;
+	return queue;
+}
+
+void
+provisioning_batch_queue_free(
+	struct provisioning_batch_queue *queue)
+{
+	if (queue) {
+		GSList *l;
+
+		if (queue->pump_id) {
+			g_source_remove(queue->pump_id);
+		}
+		g_queue_clear(&queue->batches);
+		for (l = queue->all; l; l = l->next) {
+			struct provisioning_batch_priv *priv = l->data;
+
+			if (priv->pub.started == priv->pub.finished) {
+				provisioning_batch_free(priv);
+			} else {
+				/* Nothing else gets started, wait for the rest */
+				priv->pub.count = priv->pub.started;
+				priv->queue = NULL;
+			}
+		}
+		g_slist_free(queue->all);
+		g_free(queue);
+	}
+}
+
+guint
+provisioning_batch_queue_waiting(
+	struct provisioning_batch_queue *queue)
+{
+	guint n = 0;
+
+	if (queue) {
+		GList *l;
+
+		for (l = queue->batches.head; l; l = l->next) {
+			const struct provisioning_batch *batch = l->data;
+			n += batch->count - batch->started;
+		}
+	}
+	return n;
+}
+
+const char *
+provisioning_batch_check_imsis(
+	const char *const *imsis)
+{
+	const char *error = NULL;
+
+	if (!imsis || !imsis[0]) {
+		error = "Missing IMSI";
+	} else {
+		GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+		guint i;
+
+		/* Two transactions for the same SIM would fight over it */
+		for (i = 0; imsis[i] && !error; i++) {
+			if (!imsis[i][0]) {
+				error = "Missing IMSI";
+			} else if (!g_hash_table_add(seen, (gpointer)imsis[i])) {
+				error = "Duplicate IMSI";
+			}
+		}
+		g_hash_table_destroy(seen);
+	}
+	return error;
+}
+
+struct provisioning_batch *
+provisioning_batch_queue_add(
+	struct provisioning_batch_queue *queue,
+	const char *sender,
+	struct provisioning_data *data,
+	const char *const *imsis,
+	guint count,
+	guint *txids)
+{
+	struct provisioning_batch_priv *priv;
+	struct provisioning_batch *batch;
+	guint i;
+
+	if (!data || !count) {
+		return NULL;
+	}
+
+	priv = g_new0(struct provisioning_batch_priv, 1);
+	batch = &priv->pub;
+	priv->queue = queue;
+	priv->imsis = g_new(char*, count + 1);
+	priv->txids = g_new(guint, count);
+	batch->id = queue->cb->txid(queue->param);
+	batch->sender = g_strdup(sender);
+	batch->data = provisioning_data_ref(data);
+	batch->count = count;
+	for (i = 0; i < count; i++) {
+		priv->imsis[i] = g_strdup(imsis[i]);
+		txids[i] = priv->txids[i] = queue->cb->txid(queue->param);
+	}
+	priv->imsis[count] = NULL;
+	g_queue_push_tail(&queue->batches, priv);
+	queue->all = g_slist_prepend(queue->all, priv);
+	provisioning_batch_schedule(queue);
+	return batch;
+}
+
+void
+provisioning_batch_done(
+	struct provisioning_batch *batch,
+	enum prov_result result)
+{
+	struct provisioning_batch_priv *priv = (struct provisioning_batch_priv *)
+		batch;
+	struct provisioning_batch_queue *queue = priv->queue;
+
+	batch->results[MIN(result, PROV_FAILURE)]++;
+	batch->finished++;
+	if (queue) {
+		queue->running--;
+		if (batch->finished == batch->count) {
+			queue->all = g_slist_remove(queue->all, priv);
+			queue->cb->finished(batch, queue->param);
+		}
+		provisioning_batch_schedule(queue);
+	}
+	if (batch->finished == batch->count) {
+		provisioning_batch_free(priv);
+	}
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,101 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef __PROVBATCH_H
+#define __PROVBATCH_H
+
+#include "provisioning-ofono.h"
+
+#include <glib.h>
+
+/*
+ * Shared messages (HandleSharedProvisioningMessage) being applied to
+ * several SIMs. The transactions of all batches are started in the
+ * order the batches have been queued, at most max_parallel of them at
+ * a time (zero means no limit). They are started from an idle callback,
+ * so a transaction which completes right away doesn't start the next
+ * one from within itself.
+ */
+struct provisioning_batch_queue;
+
+struct provisioning_batch {
+	guint id;
+	char *sender;
+	struct provisioning_data *data;
+	guint count;
+	guint started;
+	guint finished;
+	guint results[PROV_FAILURE + 1];
+};
+
+struct provisioning_batch_callbacks {
+	/* Allocates the batch ID and the transaction IDs */
+	guint (*txid)(void *param);
+	/* Starts a transaction, provisioning_batch_done() has to follow */
+	void (*start)(struct provisioning_batch *batch, guint txid,
+		const char *imsi, void *param);
+	/* All transactions are done, the batch is freed afterwards */
+	void (*finished)(struct provisioning_batch *batch, void *param);
+};
+
+struct provisioning_batch_queue *
+provisioning_batch_queue_new(
+	int max_parallel,
+	const struct provisioning_batch_callbacks *cb,
+	void *param);
+
+/* Batches with running transactions are left to those */
+void
+provisioning_batch_queue_free(
+	struct provisioning_batch_queue *queue);
+
+/* Number of transactions which haven't been started yet */
+guint
+provisioning_batch_queue_waiting(
+	struct provisioning_batch_queue *queue);
+
+/* NULL if the list is fine, otherwise what's wrong with it */
+const char *
+provisioning_batch_check_imsis(
+	const char *const *imsis);
+
+/*
+ * Queues the transactions, count IMSIs from the array. Returns NULL if
+ * the message couldn't be decoded (data is NULL), nothing is queued
+ * then. The transaction IDs are stored to txids, which must have room
+ * for count of them.
+ */
+struct provisioning_batch *
+provisioning_batch_queue_add(
+	struct provisioning_batch_queue *queue,
+	const char *sender,
+	struct provisioning_data *data,
+	const char *const *imsis,
+	guint count,
+	guint *txids);
+
+void
+provisioning_batch_done(
+	struct provisioning_batch *batch,
+	enum prov_result result);
+
+#endif /* __PROVBATCH_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
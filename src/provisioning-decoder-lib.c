@@ -0,0 +1,312 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/* Public API of libprovisioning-decoder, see include/prov_decoder.h */
+
+#include "prov_decoder.h"
+#include "provisioning-decoder.h"
+#include "provisioning-prescan.h"
+#include "provisioning-variant.h"
+
+/* ProvSettings is provisioning_data in disguise */
+#define prov_settings_data(settings) \
+	((const struct provisioning_data*)(settings))
+
+struct prov_decoder {
+	struct provisioning_prescan_limits limits;
+	gint refcount;
+};
+
+guint
+prov_decoder_version(
+	void)
+{
+	return PROV_DECODER_VERSION;
+}
+
+GQuark
+prov_decoder_error_quark(
+	void)
+{
+	return g_quark_from_static_string("prov-decoder-error-quark");
+}
+
+ProvDecoder *
+prov_decoder_new(
+	void)
+{
+	ProvDecoder *decoder = g_new0(ProvDecoder, 1);
+	decoder->limits = provisioning_prescan_defaults;
+	decoder->refcount = 1;
+	return decoder;
+}
+
+ProvDecoder *
+prov_decoder_ref(
+	ProvDecoder *decoder)
+{
+	if (decoder) {
+		g_atomic_int_inc(&decoder->refcount);
+	}
+	return decoder;
+}
+
+void
+prov_decoder_unref(
+	ProvDecoder *decoder)
+{
+	if (decoder && g_atomic_int_dec_and_test(&decoder->refcount)) {
+		g_free(decoder);
+	}
+}
+
+gboolean
+prov_decoder_set_limit(
+	ProvDecoder *decoder,
+	ProvDecoderLimit limit,
+	gsize value)
+{
+	if (decoder) {
+		struct provisioning_prescan_limits *limits = &decoder->limits;
+		const guint n = MIN(value, G_MAXUINT);
+
+		switch (limit) {
+		case PROV_DECODER_LIMIT_BYTES:
+			limits->max_bytes = value;
+			return TRUE;
+		case PROV_DECODER_LIMIT_DEPTH:
+			limits->max_depth = n;
+			return TRUE;
+		case PROV_DECODER_LIMIT_STRTBL:
+			limits->max_strtbl = n;
+			return TRUE;
+		case PROV_DECODER_LIMIT_CHARACTERISTICS:
+			limits->max_characteristics = n;
+			return TRUE;
+		case PROV_DECODER_LIMIT_PARMS:
+			limits->max_parms = n;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+gsize
+prov_decoder_get_limit(
+	ProvDecoder *decoder,
+	ProvDecoderLimit limit)
+{
+	if (decoder) {
+		const struct provisioning_prescan_limits *limits = &decoder->limits;
+
+		switch (limit) {
+		case PROV_DECODER_LIMIT_BYTES:
+			return limits->max_bytes;
+		case PROV_DECODER_LIMIT_DEPTH:
+			return limits->max_depth;
+		case PROV_DECODER_LIMIT_STRTBL:
+			return limits->max_strtbl;
+		case PROV_DECODER_LIMIT_CHARACTERISTICS:
+			return limits->max_characteristics;
+		case PROV_DECODER_LIMIT_PARMS:
+			return limits->max_parms;
+		}
+	}
+	return 0;
+}
+
+ProvSettings *
+prov_decoder_decode(
+	ProvDecoder *decoder,
+	const void *data,
+	gsize size,
+	GError **error)
+{
+	struct provisioning_prescan_info info;
+	const char *reason = provisioning_prescan(data, size,
+		decoder ? &decoder->limits : NULL, &info);
+	struct provisioning_data *prov;
+
+	/* Pre-scan rejects what the parser isn't even supposed to see */
+	if (reason) {
+		g_set_error_literal(error, PROV_DECODER_ERROR,
+			PROV_DECODER_ERROR_REJECTED, reason);
+		return NULL;
+	}
+	prov = decode_provisioning_wbxml_parse(data, size, &info, &reason);
+	if (!prov) {
+		g_set_error_literal(error, PROV_DECODER_ERROR,
+			PROV_DECODER_ERROR_PARSE, reason);
+	}
+	return (ProvSettings*)prov;
+}
+
+ProvSettings *
+prov_settings_ref(
+	ProvSettings *settings)
+{
+	provisioning_data_ref((struct provisioning_data*)settings);
+	return settings;
+}
+
+void
+prov_settings_unref(
+	ProvSettings *settings)
+{
+	provisioning_data_unref((struct provisioning_data*)settings);
+}
+
+gboolean
+prov_settings_has_context(
+	const ProvSettings *settings,
+	ProvSettingsContext context)
+{
+	const struct provisioning_data *data = prov_settings_data(settings);
+
+	if (data) {
+		switch (context) {
+		case PROV_SETTINGS_INTERNET:
+			return data->internet != NULL;
+		case PROV_SETTINGS_MMS:
+			return data->mms != NULL;
+		}
+	}
+	return FALSE;
+}
+
+static
+const char *
+prov_settings_internet_string(
+	const struct provisioning_internet *internet,
+	ProvSettingsKey key)
+{
+	switch (key) {
+	case PROV_SETTINGS_NAME:
+		return internet->name;
+	case PROV_SETTINGS_APN:
+		return internet->apn;
+	case PROV_SETTINGS_USERNAME:
+		return internet->username;
+	case PROV_SETTINGS_PASSWORD:
+		return internet->password;
+	case PROV_SETTINGS_MESSAGE_PROXY:
+	case PROV_SETTINGS_MESSAGE_CENTER:
+	case PROV_SETTINGS_PORT:
+		break;
+	}
+	return NULL;
+}
+
+static
+const char *
+prov_settings_mms_string(
+	const struct provisioning_mms *mms,
+	ProvSettingsKey key)
+{
+	switch (key) {
+	case PROV_SETTINGS_NAME:
+		return mms->name;
+	case PROV_SETTINGS_APN:
+		return mms->apn;
+	case PROV_SETTINGS_USERNAME:
+		return mms->username;
+	case PROV_SETTINGS_PASSWORD:
+		return mms->password;
+	case PROV_SETTINGS_MESSAGE_PROXY:
+		return mms->messageproxy;
+	case PROV_SETTINGS_MESSAGE_CENTER:
+		return mms->messagecenter;
+	case PROV_SETTINGS_PORT:
+		return mms->portnro;
+	}
+	return NULL;
+}
+
+const char *
+prov_settings_get_string(
+	const ProvSettings *settings,
+	ProvSettingsContext context,
+	ProvSettingsKey key)
+{
+	const struct provisioning_data *data = prov_settings_data(settings);
+
+	if (data) {
+		switch (context) {
+		case PROV_SETTINGS_INTERNET:
+			return data->internet ?
+				prov_settings_internet_string(data->internet, key) : NULL;
+		case PROV_SETTINGS_MMS:
+			return data->mms ?
+				prov_settings_mms_string(data->mms, key) : NULL;
+		}
+	}
+	return NULL;
+}
+
+static
+ProvSettingsAuth
+prov_settings_auth(
+	enum prov_authtype authtype)
+{
+	switch (authtype) {
+	case AUTH_PAP:
+		return PROV_SETTINGS_AUTH_PAP;
+	case AUTH_CHAP:
+		return PROV_SETTINGS_AUTH_CHAP;
+	case AUTH_UNKNOWN:
+		break;
+	}
+	return PROV_SETTINGS_AUTH_UNKNOWN;
+}
+
+ProvSettingsAuth
+prov_settings_get_auth(
+	const ProvSettings *settings,
+	ProvSettingsContext context)
+{
+	const struct provisioning_data *data = prov_settings_data(settings);
+
+	if (data) {
+		switch (context) {
+		case PROV_SETTINGS_INTERNET:
+			if (data->internet) {
+				return prov_settings_auth(data->internet->authtype);
+			}
+			break;
+		case PROV_SETTINGS_MMS:
+			if (data->mms) {
+				return prov_settings_auth(data->mms->authtype);
+			}
+			break;
+		}
+	}
+	return PROV_SETTINGS_AUTH_UNKNOWN;
+}
+
+GVariant *
+prov_settings_to_variant(
+	const ProvSettings *settings)
+{
+	const struct provisioning_data *data = prov_settings_data(settings);
+
+	return data ? provisioning_data_variant(data) : NULL;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,55 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/*
+ * Logging for libprovisioning-decoder. Provides what log.c provides
+ * for the service. The version script keeps these symbols local, so
+ * they don't clash with the ones in the service executable.
+ */
+
+#include "provisioning-decoder.h"
+#include "log.h"
+
+GLOG_MODULE_DEFINE("provisioning-decoder");
+
+static provisioning_decoder_log_func provisioning_decoder_log;
+
+void
+decode_provisioning_set_log_func(
+	provisioning_decoder_log_func func)
+{
+	provisioning_decoder_log = func;
+}
+
+void
+prov_debug(
+	const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	if (provisioning_decoder_log) {
+		provisioning_decoder_log(format, args);
+	} else {
+		gutil_logv(GLOG_MODULE_CURRENT, GLOG_LEVEL_DEBUG, format, args);
+	}
+	va_end(args);
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -12,6 +12,7 @@
  */
 
 #include "provisioning-decoder.h"
+#include "provisioning-prescan.h"
 #include "log.h"
 
 #include <wbxml/wbxml.h>
@@ -56,6 +57,9 @@ static const WBXMLLangEntry prov_table[] = {
 #define TYPE_NAPDEF                     "NAPDEF"
 #define TYPE_APPLICATION                "APPLICATION"
 #define TYPE_PXLOGICAL                  "PXLOGICAL"
+#define TYPE_PXPHYSICAL                 "PXPHYSICAL"
+#define TYPE_PORT                       "PORT"
+#define TYPE_NAPAUTHINFO                "NAPAUTHINFO"
 
 #define PARM_APPID                      "APPID"
 #define PARM_TO_NAPID                   "TO-NAPID"
@@ -78,14 +82,56 @@ static const WBXMLLangEntry prov_table[] = {
 #define AUTHTYPE_PAP                    "PAP"
 #define AUTHTYPE_CHAP                   "CHAP"
 
+struct provisioning_data_priv {
+	struct provisioning_data pub;
+	gint refcount;
+};
+
+/*
+ * The whole document is kept in one node array. Node zero is the root
+ * (wap-provisioningdoc), top-level characteristics are its children.
+ * Since the root can't be anyone's child or sibling, zero child and
+ * next indices mean that there's none. Each node's parms occupy a
+ * contiguous slice of the parm array.
+ */
+struct provisioning_wbxml_node {
+	const char *type;
+	guint parent;
+	guint child;                        /* First child */
+	guint next;                         /* Next sibling */
+	guint parm;                         /* First parm */
+	guint nparms;
+};
+
+struct provisioning_wbxml_parm {
+	const char *name;
+	const char *value;                  /* Can be NULL */
+};
+
+struct provisioning_wbxml_tree {
+	GArray *nodes;                      /* struct provisioning_wbxml_node */
+	GArray *parms;                      /* struct provisioning_wbxml_parm */
+	GStringChunk *strings;
+};
+
+/* Characteristic which is being parsed */
+struct provisioning_wbxml_frame {
+	guint node;
+	guint last_child;
+	guint mark;                         /* Its first parm in the stack */
+};
+
 struct provisioning_wbxml_context {
-	GSList *napdef;                     /* NAPDEF characteristics */
-	GSList *application;                /* APPLICATION characteristics */
-	GSList *pxlogical;                  /* PXLOGICAL characteristics */
-	GHashTable *characteristic;         /* Currently being parsed */
-	int characteristic_depth;           /* <characteristic> depth */
+	struct provisioning_wbxml_tree tree;
+	GArray *frames;                     /* Open characteristics */
+	GArray *stack;                      /* Their parms */
 };
 
+#define provisioning_wbxml_tree_node(tree,i) \
+	(&g_array_index((tree)->nodes, struct provisioning_wbxml_node, i))
+#define provisioning_wbxml_tree_parm(tree,i) \
+	(&g_array_index((tree)->parms, struct provisioning_wbxml_parm, i))
+
 static
 const char*
 provisioning_wbxml_attr_value(
@@ -111,44 +157,49 @@ provisioning_wbxml_start_element(
 	WBXMLAttribute **atts)
 {
 	struct provisioning_wbxml_context *context = ctx;
+	struct provisioning_wbxml_tree *tree = &context->tree;
 	const char *elem = (char*)wbxml_tag_get_xml_name(tag);
 	if (!g_strcmp0(elem, ELEM_PARM)) {
-		/*
-		 * If current characteristic is being ignored then
-		 * context->characteristic is going to be NULL
-		 */
-		if (context->characteristic) {
+		/* Parms outside of characteristics are ignored */
+		if (context->frames->len > 1) {
 			const char *name = provisioning_wbxml_attr_value(atts, ATTR_NAME);
 			const char *value = provisioning_wbxml_attr_value(atts, ATTR_VALUE);
 			LOG("  <%s name=\"%s\" value=\"%s\">", elem, name, value);
 			if (name && name[0]) {
-				g_hash_table_insert(context->characteristic,
-					g_strdup(name), g_strdup(value));
+				struct provisioning_wbxml_parm parm;
+				parm.name = g_string_chunk_insert_const(tree->strings, name);
+				parm.value = value ?
+					g_string_chunk_insert(tree->strings, value) : NULL;
+				g_array_append_val(context->stack, parm);
 			}
 		}
 	} else if (!g_strcmp0(elem, ELEM_CHARACTERISTIC)) {
-		GASSERT(context->characteristic_depth >= 0);
-		if (!context->characteristic_depth) {
-			/* New top-level characteristic */
-			GSList **list = NULL;
-			const char *type = provisioning_wbxml_attr_value(atts, ATTR_TYPE);
-			if (!g_strcmp0(type, TYPE_NAPDEF)) {
-				list = &context->napdef;
-			} else if (!g_strcmp0(type, TYPE_APPLICATION)) {
-				list = &context->application;
-			} else if (!g_strcmp0(type, TYPE_PXLOGICAL)) {
-				list = &context->pxlogical;
-			}
-			if (list) {
-				LOG("<%s type=\"%s\">", elem, type);
-				context->characteristic = g_hash_table_new_full(g_str_hash,
-					g_str_equal, g_free, g_free);
-				*list = g_slist_append(*list, context->characteristic);
-			} else {
-				LOG("<%s type=\"%s\"> IGNORED", elem, type);
-			}
+		const char *type = provisioning_wbxml_attr_value(atts, ATTR_TYPE);
+		struct provisioning_wbxml_frame *parent = &g_array_index
+			(context->frames, struct provisioning_wbxml_frame,
+				context->frames->len - 1);
+		struct provisioning_wbxml_frame frame;
+		struct provisioning_wbxml_node node;
+
+		LOG("<%s type=\"%s\">", elem, type);
+		memset(&node, 0, sizeof(node));
+		node.type = type ? g_string_chunk_insert_const(tree->strings, type) :
+			NULL;
+		node.parent = parent->node;
+		frame.node = tree->nodes->len;
+		frame.last_child = 0;
+		frame.mark = context->stack->len;
+		g_array_append_val(tree->nodes, node);
+		if (parent->last_child) {
+			provisioning_wbxml_tree_node(tree, parent->last_child)->next =
+				frame.node;
+		} else {
+			provisioning_wbxml_tree_node(tree, parent->node)->child =
+				frame.node;
 		}
-		context->characteristic_depth++;
+		parent->last_child = frame.node;
+		/* This may reallocate the array and invalidate the parent pointer */
+		g_array_append_val(context->frames, frame);
 	} else {
 		LOG("<%s> IGNORED", elem);
 	}
@@ -163,67 +214,172 @@ provisioning_wbxml_end_element(
 	struct provisioning_wbxml_context *context = ctx;
 	const char *elem = (char*)wbxml_tag_get_xml_name(tag);
 	if (!g_strcmp0(elem, ELEM_CHARACTERISTIC)) {
-		GASSERT(context->characteristic_depth > 0);
-		context->characteristic_depth--;
-		if (!context->characteristic_depth) {
-			context->characteristic = NULL;
-			LOG("</%s>", wbxml_tag_get_xml_name(tag));
-		}
+		struct provisioning_wbxml_tree *tree = &context->tree;
+		const guint top = context->frames->len - 1;
+		const struct provisioning_wbxml_frame *frame = &g_array_index
+			(context->frames, struct provisioning_wbxml_frame, top);
+		struct provisioning_wbxml_node *node =
+			provisioning_wbxml_tree_node(tree, frame->node);
+
+		/* Parms of the nested characteristics are already gone */
+		GASSERT(top > 0);
+		node->parm = tree->parms->len;
+		node->nparms = context->stack->len - frame->mark;
+		g_array_append_vals(tree->parms, &g_array_index(context->stack,
+			struct provisioning_wbxml_parm, frame->mark), node->nparms);
+		g_array_set_size(context->stack, frame->mark);
+		g_array_set_size(context->frames, top);
+		LOG("</%s>", elem);
 	}
 }
 
+/* Looks at the parms of this node only */
 static
-void
-provisioning_wbxml_chars_free(
-	gpointer data)
+const struct provisioning_wbxml_parm*
+provisioning_wbxml_node_parm(
+	const struct provisioning_wbxml_tree *tree,
+	guint index,
+	const char *name)
 {
-	g_hash_table_destroy(data);
+	const struct provisioning_wbxml_node *node =
+		provisioning_wbxml_tree_node(tree, index);
+	const struct provisioning_wbxml_parm *parm =
+		provisioning_wbxml_tree_parm(tree, node->parm);
+	guint i;
+
+	for (i = 0; i < node->nparms; i++, parm++) {
+		if (!strcmp(parm->name, name)) {
+			return parm;
+		}
+	}
+	return NULL;
 }
 
+/* The node's own parms first, then its descendants in document order */
 static
-GHashTable*
-provisioning_wbxml_chars_find(
-	GSList *list,
-	const char *key,
-	const char *value)
+const struct provisioning_wbxml_parm*
+provisioning_wbxml_tree_find_parm(
+	const struct provisioning_wbxml_tree *tree,
+	guint index,
+	const char *name)
 {
-	while (list) {
-		GHashTable *chars = list->data;
-		if (value) {
-			const char *found = g_hash_table_lookup(chars, key);
-			if (found && !strcmp(found, value)) {
-				return chars;
+	const struct provisioning_wbxml_parm *parm = NULL;
+
+	if (index) {
+		parm = provisioning_wbxml_node_parm(tree, index, name);
+		if (!parm) {
+			guint child = provisioning_wbxml_tree_node(tree, index)->child;
+
+			while (child && !parm) {
+				parm = provisioning_wbxml_tree_find_parm(tree, child, name);
+				child = provisioning_wbxml_tree_node(tree, child)->next;
 			}
-		} else if (g_hash_table_contains(chars, key)) {
-			return chars;
 		}
-		list = list->next;
+	}
+	return parm;
+}
+
+static
+const char*
+provisioning_wbxml_tree_value(
+	const struct provisioning_wbxml_tree *tree,
+	guint index,
+	const char *name)
+{
+	const struct provisioning_wbxml_parm *parm =
+		provisioning_wbxml_tree_find_parm(tree, index, name);
+	return parm ? parm->value : NULL;
+}
+
+/* The first node which has the parm wins, zero nodes are skipped */
+static
+const char*
+provisioning_wbxml_tree_lookup(
+	const struct provisioning_wbxml_tree *tree,
+	const guint *nodes,
+	guint count,
+	const char *name)
+{
+	guint i;
+
+	for (i = 0; i < count; i++) {
+		const struct provisioning_wbxml_parm *parm =
+			provisioning_wbxml_tree_find_parm(tree, nodes[i], name);
+		if (parm) {
+			return parm->value;
+		}
 	}
 	return NULL;
 }
 
+/*
+ * Walks the sibling chain starting at the given node and returns the
+ * first node of the given type which has the parm with the given value
+ * (if the value is NULL, having the parm is enough). If the name is NULL,
+ * then any node of that type will do. Zero if nothing matches.
+ */
 static
-void
-provisioning_wbxml_chars_merge(
-	GHashTable *dest,
-	GHashTable *src)
+guint
+provisioning_wbxml_tree_match(
+	const struct provisioning_wbxml_tree *tree,
+	guint index,
+	const char *type,
+	const char *name,
+	const char *value)
 {
-	if (src) {
-		GHashTableIter iter;
-		gpointer key, value;
-		g_hash_table_iter_init(&iter, src);
-		while (g_hash_table_iter_next(&iter, &key, &value)) {
-			g_hash_table_insert(dest, key, value);
+	while (index) {
+		const struct provisioning_wbxml_node *node =
+			provisioning_wbxml_tree_node(tree, index);
+
+		if (!g_strcmp0(node->type, type)) {
+			const struct provisioning_wbxml_parm *parm;
+
+			if (!name) {
+				return index;
+			}
+			parm = provisioning_wbxml_tree_find_parm(tree, index, name);
+			if (parm && (!value || !g_strcmp0(parm->value, value))) {
+				return index;
+			}
 		}
+		index = node->next;
 	}
+	return 0;
+}
+
+/* Top-level characteristic */
+static inline
+guint
+provisioning_wbxml_tree_find(
+	const struct provisioning_wbxml_tree *tree,
+	const char *type,
+	const char *name,
+	const char *value)
+{
+	return provisioning_wbxml_tree_match(tree,
+		provisioning_wbxml_tree_node(tree, 0)->child, type, name, value);
+}
+
+/* Child of the given characteristic, zero node has no children */
+static inline
+guint
+provisioning_wbxml_tree_child(
+	const struct provisioning_wbxml_tree *tree,
+	guint index,
+	const char *type,
+	const char *name,
+	const char *value)
+{
+	return index ? provisioning_wbxml_tree_match(tree,
+		provisioning_wbxml_tree_node(tree, index)->child, type, name, value) :
+		0;
 }
 
 static
 enum prov_authtype
-provisioning_wbxml_chars_authtype(
-	GHashTable *chars)
+provisioning_wbxml_authtype(
+	const char *authtype)
 {
-	const char *authtype = g_hash_table_lookup(chars, PARM_AUTHTYPE);
 	if (authtype) {
 		if (!strcmp(authtype, AUTHTYPE_PAP)) {
 			return AUTH_PAP;
@@ -234,6 +390,29 @@ provisioning_wbxml_chars_authtype(
 	return AUTH_UNKNOWN;
 }
 
+/*
+ * NAPDEF may have several NAPAUTHINFO, the one we can use is preferred.
+ * AUTHTYPE, AUTHNAME and AUTHSECRET all come from the same NAPAUTHINFO.
+ */
+static
+guint
+provisioning_wbxml_tree_napauthinfo(
+	const struct provisioning_wbxml_tree *tree,
+	guint nap)
+{
+	guint auth = provisioning_wbxml_tree_child(tree, nap, TYPE_NAPAUTHINFO,
+		PARM_AUTHTYPE, AUTHTYPE_PAP);
+	if (!auth) {
+		auth = provisioning_wbxml_tree_child(tree, nap, TYPE_NAPAUTHINFO,
+			PARM_AUTHTYPE, AUTHTYPE_CHAP);
+		if (!auth) {
+			auth = provisioning_wbxml_tree_child(tree, nap, TYPE_NAPAUTHINFO,
+				NULL, NULL);
+		}
+	}
+	return auth;
+}
+
 /**
  * This is the main function that actually decides which settings to use.
  * It's not as straighforward as you might have thought.
@@ -243,9 +422,10 @@ struct provisioning_data*
 provisioning_wbxml_context_data(
 	struct provisioning_wbxml_context *context)
 {
-	struct provisioning_data *data = g_new0(struct provisioning_data, 1);
-	GHashTable *mms_app, *mms_nap = NULL, *mms_proxy = NULL;
-	GHashTable *inet_app, *inet_nap = NULL;
+	const struct provisioning_wbxml_tree *tree = &context->tree;
+	struct provisioning_data *data = provisioning_data_new();
+	guint mms_app, mms_nap = 0, mms_proxy = 0, mms_physical = 0;
+	guint inet_app, inet_nap;
 
 	/*
 	 * OMA-WAP-TS-ProvCont-V1_1-20090728-A
@@ -254,150 +434,201 @@ provisioning_wbxml_context_data(
 	 * INTERNET, it implies that the ME can select any network access point
 	 * with the attribute INTERNET defined.
 	 */
-	inet_app = provisioning_wbxml_chars_find(context->application,
+	inet_app = provisioning_wbxml_tree_find(tree, TYPE_APPLICATION,
 		PARM_TO_NAPID, PARM_INTERNET);
-	inet_nap = provisioning_wbxml_chars_find(context->napdef,
+	inet_nap = provisioning_wbxml_tree_find(tree, TYPE_NAPDEF,
 		PARM_INTERNET, NULL);
 	if (inet_nap && !inet_app) {
-		const char *napid = g_hash_table_lookup(inet_nap, PARM_NAPID);
+		const char *napid = provisioning_wbxml_tree_value(tree, inet_nap,
+			PARM_NAPID);
 		if (napid) {
-			inet_app = provisioning_wbxml_chars_find(context->application,
+			inet_app = provisioning_wbxml_tree_find(tree, TYPE_APPLICATION,
 				PARM_TO_NAPID, napid);
 		}
 	}
 	if (!inet_app) {
-		inet_app = provisioning_wbxml_chars_find(context->application,
+		inet_app = provisioning_wbxml_tree_find(tree, TYPE_APPLICATION,
 			PARM_APPID, APPID_INTERNET);
 	}
 	if (!inet_nap && inet_app) {
-		const char *napid = g_hash_table_lookup(inet_app, PARM_TO_NAPID);
+		const char *napid = provisioning_wbxml_tree_value(tree, inet_app,
+			PARM_TO_NAPID);
 		if (napid) {
-			inet_nap = provisioning_wbxml_chars_find(context->napdef,
+			inet_nap = provisioning_wbxml_tree_find(tree, TYPE_NAPDEF,
 				PARM_NAPID, napid);
-			GASSERT(inet_nap);
 		}
 	}
 
-	mms_app = provisioning_wbxml_chars_find(context->application,
+	mms_app = provisioning_wbxml_tree_find(tree, TYPE_APPLICATION,
 		PARM_APPID, APPID_MMS_1);
 	if (!mms_app) {
-		mms_app = provisioning_wbxml_chars_find(context->application,
+		mms_app = provisioning_wbxml_tree_find(tree, TYPE_APPLICATION,
 			PARM_APPID, APPID_MMS_2);
 	}
 	if (mms_app) {
-		const char *proxy = g_hash_table_lookup(mms_app, PARM_TO_PROXY);
-		const char *napid = g_hash_table_lookup(mms_app, PARM_TO_NAPID);
+		const char *proxy = provisioning_wbxml_tree_value(tree, mms_app,
+			PARM_TO_PROXY);
+		const char *napid = provisioning_wbxml_tree_value(tree, mms_app,
+			PARM_TO_NAPID);
 		if (proxy) {
-			mms_proxy = provisioning_wbxml_chars_find(context->pxlogical,
-					PARM_PROXY_ID, proxy);
+			mms_proxy = provisioning_wbxml_tree_find(tree, TYPE_PXLOGICAL,
+				PARM_PROXY_ID, proxy);
 		}
-		if (mms_proxy && !napid) {
-			napid = g_hash_table_lookup(mms_proxy, PARM_TO_NAPID);
+		if (mms_proxy) {
+			/* PXPHYSICAL leading to our NAPDEF, or else the first one */
+			if (napid) {
+				mms_physical = provisioning_wbxml_tree_child(tree, mms_proxy,
+					TYPE_PXPHYSICAL, PARM_TO_NAPID, napid);
+			}
+			if (!mms_physical) {
+				mms_physical = provisioning_wbxml_tree_child(tree, mms_proxy,
+					TYPE_PXPHYSICAL, NULL, NULL);
+			}
+			if (!napid) {
+				const guint nodes[] = { mms_physical, mms_proxy };
+				napid = provisioning_wbxml_tree_lookup(tree, nodes,
+					G_N_ELEMENTS(nodes), PARM_TO_NAPID);
+			}
 		}
 		if (napid) {
-			mms_nap = provisioning_wbxml_chars_find(context->napdef,
+			mms_nap = provisioning_wbxml_tree_find(tree, TYPE_NAPDEF,
 				PARM_NAPID, napid);
-			GASSERT(mms_nap);
 		}
 	}
 
 	/* Internet context */
 	if (inet_nap) {
+		const guint nodes[] = { inet_nap, inet_app };
+		const guint n = G_N_ELEMENTS(nodes);
+		const guint auth = provisioning_wbxml_tree_napauthinfo(tree,
+			inet_nap);
+		/* NAPAUTHINFO as a whole, if there is one */
+		const guint *auth_nodes = auth ? &auth : nodes;
+		const guint auth_n = auth ? 1 : n;
 		const char *apn;
 		const char *addr_type;
 
-		/* Merge all characteristics into one table */
-		GHashTable *inet = g_hash_table_new(g_str_hash, g_str_equal);
-		provisioning_wbxml_chars_merge(inet, inet_app);
-		provisioning_wbxml_chars_merge(inet, inet_nap);
-
-#if GUTIL_LOG_DEBUG
-		if (GLOG_ENABLED(GLOG_LEVEL_DEBUG)) {
-			GHashTableIter iter;
-			gpointer key, value;
-			LOG("Internet:")
-			g_hash_table_iter_init(&iter, inet);
-			while (g_hash_table_iter_next(&iter, &key, &value)) {
-				LOG("  %s = %s", (char*)key, (char*)value);
-			}
-		}
-#endif
+		LOG("Internet: NAPDEF #%u APPLICATION #%u NAPAUTHINFO #%u",
+			inet_nap, inet_app, auth);
 
 		/* APN is required */
-		apn = g_hash_table_lookup(inet, PARM_NAP_ADDRESS);
-		addr_type = g_hash_table_lookup(inet, PARM_NAP_ADDRTYPE);
+		apn = provisioning_wbxml_tree_lookup(tree, nodes, n,
+			PARM_NAP_ADDRESS);
+		addr_type = provisioning_wbxml_tree_lookup(tree, nodes, n,
+			PARM_NAP_ADDRTYPE);
 		if (apn && apn[0] && !g_strcmp0(addr_type, NAP_ADDRTYPE_APN)) {
-			data->internet = g_new0(struct provisioning_internet, 1);
-			data->internet->apn = g_strdup(apn);
-			data->internet->authtype = provisioning_wbxml_chars_authtype(inet);
-			data->internet->name =
-				g_strdup(g_hash_table_lookup(inet, PARM_NAME));
-			data->internet->username =
-				g_strdup(g_hash_table_lookup(inet, PARM_AUTHNAME));
-			data->internet->password =
-				g_strdup(g_hash_table_lookup(inet, PARM_AUTHSECRET));
+			struct provisioning_internet *internet =
+				g_new0(struct provisioning_internet, 1);
+
+			internet->apn = g_strdup(apn);
+			internet->authtype = provisioning_wbxml_authtype(
+				provisioning_wbxml_tree_lookup(tree, auth_nodes, auth_n,
+					PARM_AUTHTYPE));
+			internet->linked = PROV_LINKED_NAPDEF |
+				(inet_app ? PROV_LINKED_APPLICATION : 0);
+			internet->name = g_strdup(provisioning_wbxml_tree_lookup(tree,
+				nodes, n, PARM_NAME));
+			internet->username = g_strdup(provisioning_wbxml_tree_lookup(tree,
+				auth_nodes, auth_n, PARM_AUTHNAME));
+			internet->password = g_strdup(provisioning_wbxml_tree_lookup(tree,
+				auth_nodes, auth_n, PARM_AUTHSECRET));
+			data->internet = internet;
 		} else {
 			GERR("No internet APN");
 		}
-		g_hash_table_destroy(inet);
 	}
 
 	/* MMS context */
 	if (mms_nap) {
+		const guint nodes[] = { mms_nap, mms_proxy, mms_app };
+		const guint n = G_N_ELEMENTS(nodes);
+		const guint proxy_nodes[] = { mms_physical, mms_proxy };
+		const guint proxy_n = G_N_ELEMENTS(proxy_nodes);
+		const guint auth = provisioning_wbxml_tree_napauthinfo(tree,
+			mms_nap);
+		const guint *auth_nodes = auth ? &auth : nodes;
+		const guint auth_n = auth ? 1 : n;
 		const char *apn;
 		const char *addr_type;
-
-		/* Merge all characteristics into one table */
-		GHashTable *mms = g_hash_table_new(g_str_hash, g_str_equal);
-		provisioning_wbxml_chars_merge(mms, mms_app);
-		provisioning_wbxml_chars_merge(mms, mms_proxy);
-		provisioning_wbxml_chars_merge(mms, mms_nap);
-
-#if GUTIL_LOG_DEBUG
-		if (GLOG_ENABLED(GLOG_LEVEL_DEBUG)) {
-			GHashTableIter iter;
-			gpointer key, value;
-			LOG("MMS:")
-			g_hash_table_iter_init(&iter, mms);
-			while (g_hash_table_iter_next(&iter, &key, &value)) {
-				LOG("  %s = %s", (char*)key, (char*)value);
-			}
+		guint port;
+
+		/* PORT of the PXPHYSICAL if it has one, otherwise of PXLOGICAL */
+		port = provisioning_wbxml_tree_child(tree, mms_physical, TYPE_PORT,
+			NULL, NULL);
+		if (!port) {
+			port = provisioning_wbxml_tree_child(tree, mms_proxy, TYPE_PORT,
+				NULL, NULL);
 		}
-#endif
+
+		LOG("MMS: NAPDEF #%u APPLICATION #%u PXLOGICAL #%u PXPHYSICAL #%u "
+			"PORT #%u NAPAUTHINFO #%u", mms_nap, mms_app, mms_proxy,
+			mms_physical, port, auth);
 
 		/* APN is required */
-		apn = g_hash_table_lookup(mms, PARM_NAP_ADDRESS);
-		addr_type = g_hash_table_lookup(mms, PARM_NAP_ADDRTYPE);
+		apn = provisioning_wbxml_tree_lookup(tree, nodes, n,
+			PARM_NAP_ADDRESS);
+		addr_type = provisioning_wbxml_tree_lookup(tree, nodes, n,
+			PARM_NAP_ADDRTYPE);
 		if (apn && apn[0] && !g_strcmp0(addr_type, NAP_ADDRTYPE_APN)) {
-			data->mms = g_new0(struct provisioning_mms, 1);
-			data->mms->apn = g_strdup(apn);
-			data->mms->authtype = provisioning_wbxml_chars_authtype(mms);
-			data->mms->name =
-				g_strdup(g_hash_table_lookup(mms, PARM_NAME));
-			data->mms->username =
-				g_strdup(g_hash_table_lookup(mms, PARM_AUTHNAME));
-			data->mms->password =
-				g_strdup(g_hash_table_lookup(mms, PARM_AUTHSECRET));
-			data->mms->messagecenter =
-				g_strdup(g_hash_table_lookup(mms, PARM_ADDR));
-			data->mms->messageproxy =
-				g_strdup(g_hash_table_lookup(mms, PARM_PXADDR));
-			data->mms->portnro =
-				g_strdup(g_hash_table_lookup(mms, PARM_PORTNBR));
+			struct provisioning_mms *mms = g_new0(struct provisioning_mms, 1);
+
+			mms->apn = g_strdup(apn);
+			mms->authtype = provisioning_wbxml_authtype(
+				provisioning_wbxml_tree_lookup(tree, auth_nodes, auth_n,
+					PARM_AUTHTYPE));
+			mms->linked = PROV_LINKED_APPLICATION | PROV_LINKED_NAPDEF |
+				(mms_proxy ? PROV_LINKED_PXLOGICAL : 0);
+			mms->name = g_strdup(provisioning_wbxml_tree_lookup(tree,
+				nodes, n, PARM_NAME));
+			mms->username = g_strdup(provisioning_wbxml_tree_lookup(tree,
+				auth_nodes, auth_n, PARM_AUTHNAME));
+			mms->password = g_strdup(provisioning_wbxml_tree_lookup(tree,
+				auth_nodes, auth_n, PARM_AUTHSECRET));
+			mms->messagecenter = g_strdup(provisioning_wbxml_tree_value(tree,
+				mms_app, PARM_ADDR));
+			mms->messageproxy = g_strdup(provisioning_wbxml_tree_lookup(tree,
+				proxy_nodes, proxy_n, PARM_PXADDR));
+			mms->portnro = g_strdup(port ?
+				provisioning_wbxml_tree_value(tree, port, PARM_PORTNBR) :
+				provisioning_wbxml_tree_lookup(tree, proxy_nodes, proxy_n,
+					PARM_PORTNBR));
+			data->mms = mms;
 		} else {
-			GERR("No internet APN");
+			GERR("No MMS APN");
 		}
-		g_hash_table_destroy(mms);
 	}
 
 	return data;
 }
 
+/* The info (if any) comes from the pre-scan and is used to size the tree */
 static
 struct provisioning_wbxml_context*
-provisioning_wbxml_context_new(void)
+provisioning_wbxml_context_new(
+	gsize len,
+	const struct provisioning_prescan_info *info)
 {
-	return g_new0(struct provisioning_wbxml_context, 1);
+	struct provisioning_wbxml_context *context =
+		g_new0(struct provisioning_wbxml_context, 1);
+	struct provisioning_wbxml_tree *tree = &context->tree;
+	struct provisioning_wbxml_frame root;
+
+	tree->nodes = g_array_sized_new(FALSE, TRUE,
+		sizeof(struct provisioning_wbxml_node),
+		info ? (info->characteristics + 1) : 16);
+	tree->parms = g_array_sized_new(FALSE, FALSE,
+		sizeof(struct provisioning_wbxml_parm), info ? info->parms : 64);
+	tree->strings = g_string_chunk_new(MAX(len, 64));
+	context->frames = g_array_sized_new(FALSE, FALSE,
+		sizeof(struct provisioning_wbxml_frame), info ? info->depth : 8);
+	context->stack = g_array_sized_new(FALSE, FALSE,
+		sizeof(struct provisioning_wbxml_parm), 16);
+
+	/* The root node and its frame are always there */
+	g_array_set_size(tree->nodes, 1);
+	memset(&root, 0, sizeof(root));
+	g_array_append_val(context->frames, root);
+	return context;
 }
 
 static
@@ -406,17 +637,24 @@ provisioning_wbxml_context_free(
 	struct provisioning_wbxml_context *context)
 {
 	if (context) {
-		g_slist_free_full(context->napdef, provisioning_wbxml_chars_free);
-		g_slist_free_full(context->application, provisioning_wbxml_chars_free);
-		g_slist_free_full(context->pxlogical, provisioning_wbxml_chars_free);
+		struct provisioning_wbxml_tree *tree = &context->tree;
+
+		g_array_free(tree->nodes, TRUE);
+		g_array_free(tree->parms, TRUE);
+		g_string_chunk_free(tree->strings);
+		g_array_free(context->frames, TRUE);
+		g_array_free(context->stack, TRUE);
 		g_free(context);
 	}
 }
 
+static
 struct provisioning_data*
-decode_provisioning_wbxml(
+provisioning_wbxml_parse(
 	const guint8 *bytes,
-	int len)
+	gsize len,
+	const struct provisioning_prescan_info *info,
+	const char **error)
 {
 	static WBXMLContentHandler prov_content_handler = {
 		NULL,                               /* start_document_clb */
@@ -429,7 +667,7 @@ decode_provisioning_wbxml(
 
 	struct provisioning_data *result = NULL;
 	struct provisioning_wbxml_context *context =
-		provisioning_wbxml_context_new();
+		provisioning_wbxml_context_new(len, info);
 
 	WBXMLError err;
 	WBXMLParser *parser = wbxml_parser_create();
@@ -441,13 +679,59 @@ decode_provisioning_wbxml(
 		LOG("WBXML parsing OK");
 		result = provisioning_wbxml_context_data(context);
 	} else {
-		GERR("WBXML parsing error %d %s", err, wbxml_errors_string(err));
+		const char *reason = (const char*)wbxml_errors_string(err);
+		GERR("WBXML parsing error %d %s", err, reason);
+		if (error) {
+			*error = reason ? reason : "WBXML parsing error";
+		}
 	}
 	wbxml_parser_destroy(parser);
 	provisioning_wbxml_context_free(context);
 	return result;
 }
 
+static struct provisioning_prescan_limits decode_custom_limits;
+static const struct provisioning_prescan_limits *decode_limits =
+	&provisioning_prescan_defaults;
+
+void
+decode_provisioning_set_limits(
+	const struct provisioning_prescan_limits *limits)
+{
+	if (limits) {
+		decode_custom_limits = *limits;
+		decode_limits = &decode_custom_limits;
+	} else {
+		decode_limits = &provisioning_prescan_defaults;
+	}
+}
+
+struct provisioning_data*
+decode_provisioning_wbxml(
+	const guint8 *bytes,
+	int len)
+{
+	struct provisioning_prescan_info info;
+	const char *reject = provisioning_prescan(bytes, MAX(len, 0),
+		decode_limits, &info);
+
+	if (reject) {
+		GERR("%s (%d bytes)", reject, len);
+		return NULL;
+	}
+	return provisioning_wbxml_parse(bytes, len, &info, NULL);
+}
+
+struct provisioning_data*
+decode_provisioning_wbxml_parse(
+	const guint8 *bytes,
+	gsize len,
+	const struct provisioning_prescan_info *info,
+	const char **error)
+{
+	return provisioning_wbxml_parse(bytes, len, info, error);
+}
+
 static
 void
 provisioning_internet_free(
@@ -479,14 +763,48 @@ provisioning_mms_free(
 	}
 }
 
+static inline
+struct provisioning_data_priv*
+provisioning_data_priv(
+	struct provisioning_data *data)
+{
+	/* pub is the first member */
+	return (struct provisioning_data_priv*)data;
+}
+
+struct provisioning_data*
+provisioning_data_new(void)
+{
+	struct provisioning_data_priv *priv =
+		g_new0(struct provisioning_data_priv, 1);
+	priv->refcount = 1;
+	return &priv->pub;
+}
+
+struct provisioning_data*
+provisioning_data_ref(
+	struct provisioning_data *data)
+{
+	if (data) {
+		struct provisioning_data_priv *priv = provisioning_data_priv(data);
+		GASSERT(priv->refcount > 0);
+		g_atomic_int_inc(&priv->refcount);
+	}
+	return data;
+}
+
 void
-provisioning_data_free(
+provisioning_data_unref(
 	struct provisioning_data *data)
 {
 	if (data) {
-		provisioning_internet_free(data->internet);
-		provisioning_mms_free(data->mms);
-		g_free(data);
+		struct provisioning_data_priv *priv = provisioning_data_priv(data);
+		GASSERT(priv->refcount > 0);
+		if (g_atomic_int_dec_and_test(&priv->refcount)) {
+			provisioning_internet_free(data->internet);
+			provisioning_mms_free(data->mms);
+			g_free(priv);
+		}
 	}
 }
 
@@ -15,12 +15,32 @@
 
 #include <glib.h>
 
+/*
+ * The service calls these in libprovisioning-decoder, which exports
+ * them with the prov_private_ prefix. They aren't a part of its API
+ * (that's in prov_decoder.h) and may change at any time.
+ */
+#define decode_provisioning_wbxml prov_private_decode_wbxml
+#define decode_provisioning_wbxml_parse prov_private_decode_wbxml_parse
+#define decode_provisioning_set_limits prov_private_decode_set_limits
+#define decode_provisioning_set_log_func prov_private_decode_set_log_func
+#define provisioning_data_new prov_private_data_new
+#define provisioning_data_ref prov_private_data_ref
+#define provisioning_data_unref prov_private_data_unref
+
 enum prov_authtype {
 	AUTH_UNKNOWN = 0,
 	AUTH_PAP,
 	AUTH_CHAP
 };
 
+/* Which kinds of characteristics a context has been merged from */
+enum prov_linked {
+	PROV_LINKED_APPLICATION = 0x01,
+	PROV_LINKED_PXLOGICAL = 0x02,
+	PROV_LINKED_NAPDEF = 0x04
+};
+
 struct provisioning_data {
 	struct provisioning_internet *internet;
 	struct provisioning_mms *mms;
@@ -32,6 +52,7 @@ struct provisioning_internet {
 	char *username;
 	char *password;
 	enum prov_authtype authtype;
+	guint linked;
 };
 
 struct provisioning_mms {
@@ -43,16 +64,67 @@ struct provisioning_mms {
 	char *messagecenter;
 	char *portnro;
 	enum prov_authtype authtype;
+	guint linked;
 };
 
+/*
+ * provisioning_data is reference counted so that it can be shared
+ * between the transactions applying it. It's not supposed to change
+ * once it's been handed over to anyone.
+ */
+struct provisioning_data *
+provisioning_data_new(void);
+
+struct provisioning_data *
+provisioning_data_ref(
+	struct provisioning_data *data);
+
+void
+provisioning_data_unref(
+	struct provisioning_data *data);
+
 struct provisioning_data *
 decode_provisioning_wbxml(
 	const guint8 *bytes,
 	int len);
 
+/*
+ * Documents exceeding these limits are rejected by the pre-scan before
+ * libwbxml gets to see them. NULL restores the defaults. Not thread safe,
+ * supposed to be called before anything gets decoded.
+ */
+struct provisioning_prescan_limits;
+
 void
-provisioning_data_free(
-	struct provisioning_data *data);
+decode_provisioning_set_limits(
+	const struct provisioning_prescan_limits *limits);
+
+/*
+ * decode_provisioning_wbxml() without the pre-scan, for those who have
+ * done it themselves. The info it has collected (if any) is used to
+ * size the parse tree. On failure, returns NULL and (unless the error
+ * pointer is NULL) the reason as a static string. Reentrant.
+ */
+struct provisioning_prescan_info;
+
+struct provisioning_data *
+decode_provisioning_wbxml_parse(
+	const guint8 *bytes,
+	gsize len,
+	const struct provisioning_prescan_info *info,
+	const char **error);
+
+/*
+ * Where the debug output goes when the decoder is built as a shared
+ * library, see provisioning-decoder-log.c. NULL (the default) sends
+ * it to the "provisioning-decoder" log module.
+ */
+typedef void (*provisioning_decoder_log_func)(const char *format,
+	va_list args);
+
+void
+decode_provisioning_set_log_func(
+	provisioning_decoder_log_func func);
 
 #endif /* __PROVSERVICEDECODER_H */
 
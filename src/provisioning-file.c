@@ -0,0 +1,105 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "provisioning-file.h"
+#include "log.h"
+
+#include <errno.h>
+#include <string.h>
+
+/* The file is little-endian */
+static
+GVariant *
+provisioning_file_fix_byte_order(
+	GVariant *value)
+{
+	if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+		GVariant *swapped = g_variant_ref_sink(g_variant_byteswap(value));
+		g_variant_unref(value);
+		return swapped;
+	}
+	return value;
+}
+
+GVariant *
+provisioning_file_load(
+	const char *file,
+	const struct provisioning_file_format *formats,
+	guint count)
+{
+	GVariant *root = NULL;
+	GError *error = NULL;
+	GMappedFile *map = g_mapped_file_new(file, FALSE, &error);
+	if (map) {
+		/* The variant keeps the mapping alive */
+		GBytes *bytes = g_mapped_file_get_bytes(map);
+		guint32 magic = 0;
+		guint i;
+
+		/* The magic comes first whatever the format */
+		if (g_bytes_get_size(bytes) >= sizeof(magic)) {
+			memcpy(&magic, g_bytes_get_data(bytes, NULL), sizeof(magic));
+			magic = GUINT32_FROM_LE(magic);
+		}
+		for (i = 0; i < count && formats[i].magic != magic; i++);
+		if (i < count) {
+			root = provisioning_file_fix_byte_order(
+				g_variant_ref_sink(g_variant_new_from_bytes(
+					G_VARIANT_TYPE(formats[i].type), bytes, FALSE)));
+		} else {
+			GWARN("%s: unexpected contents, ignoring", file);
+		}
+		g_bytes_unref(bytes);
+		g_mapped_file_unref(map);
+	} else {
+		if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+			GWARN("%s", error->message);
+		}
+		g_error_free(error);
+	}
+	return root;
+}
+
+gboolean
+provisioning_file_save(
+	const char *file,
+	GVariant *value,
+	int mode,
+	int dir_mode,
+	GError **error)
+{
+	GVariant *data = provisioning_file_fix_byte_order(
+		g_variant_ref_sink(value));
+	char *dir = g_path_get_dirname(file);
+	gboolean ok;
+
+	if (g_mkdir_with_parents(dir, dir_mode) < 0) {
+		GWARN("Error creating %s: %s", dir, g_strerror(errno));
+	}
+	/* Writes a temporary file and renames it over the old one */
+	ok = g_file_set_contents_full(file, g_variant_get_data(data),
+		g_variant_get_size(data), G_FILE_SET_CONTENTS_CONSISTENT,
+		mode, error);
+	g_variant_unref(data);
+	g_free(dir);
+	return ok;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,61 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef __PROVFILE_H
+#define __PROVFILE_H
+
+#include <glib.h>
+
+/*
+ * Files holding a serialized little-endian GVariant tuple, the first
+ * member of which is a 32-bit magic identifying its type. They are
+ * mapped into memory and used in place.
+ */
+struct provisioning_file_format {
+	guint32 magic;
+	const char *type;
+};
+
+/*
+ * Maps the file and returns the tuple in the format matching its magic.
+ * Returns NULL if the file doesn't exist or has none of the magics,
+ * warning about anything other than a missing file.
+ */
+GVariant *
+provisioning_file_load(
+	const char *file,
+	const struct provisioning_file_format *formats,
+	guint count);
+
+/*
+ * Writes the value (sinking the floating reference, if any), creating
+ * the directory if necessary. The file is replaced atomically.
+ */
+gboolean
+provisioning_file_save(
+	const char *file,
+	GVariant *value,
+	int mode,
+	int dir_mode,
+	GError **error);
+
+#endif /* __PROVFILE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -17,77 +17,189 @@
 #include <gofono_connctx.h>
 #include <gofono_modem.h>
 #include <gofono_names.h>
+#include <gofono_error.h>
 
 #include <gio/gio.h>
 
+#include <string.h>
+
 #include "log.h"
 #include "provisioning-ofono.h"
 #include "provisioning-decoder.h"
+#include "provisioning-stats.h"
+#include "provisioning-trace.h"
 
 #define PROVISIONING_TIMEOUT 30 /* sec */
+#define PROVISIONING_REACTIVATE_TIMEOUT 10 /* sec */
+
+/* Retries of transient SetProperty failures */
+#define PROVISIONING_RETRY_MAX_ATTEMPTS 5
+#define PROVISIONING_RETRY_MIN_DELAY 100 /* ms */
+#define PROVISIONING_RETRY_MAX_DELAY 4000 /* ms */
+
+/*
+ * Transactions, SIMs and contexts are recycled rather than freed, up to
+ * this many objects of each kind. Only the main thread talks to ofono,
+ * so the pools aren't locked.
+ */
+#define PROVISIONING_POOL_SIZE 4
+
+/* Longest property list, the requests live inside the context */
+#define PROVISIONING_MAX_PROPS PROV_PROPERTY_MMS_COUNT
+
+/* IMSI is up to 15 digits, longer ones (if any) are allocated */
+#define PROVISIONING_IMSI_BUF 16
+
+/* Host name (up to 253 characters), colon and port number */
+#define PROVISIONING_PROXY_BUF 264
 
 enum provisioning_context_state {
 	PROV_CONTEXT_INITIALIZING,
 	PROV_CONTEXT_DEACTIVATING,
 	PROV_CONTEXT_PROVISIONING,
+	PROV_CONTEXT_REACTIVATING,
 	/* Final states must be the last: */
 	PROV_CONTEXT_SUCCESS,
 	PROV_CONTEXT_ERROR
 };
 
-enum provisioning_context_property {
-	PROV_PROPERTY_NAME,
-	PROV_PROPERTY_APN,
-	PROV_PROPERTY_USERNAME,
-	PROV_PROPERTY_PASSWORD,
-	PROV_PROPERTY_AUTH,
-	PROV_PROPERTY_INTERNET_COUNT,
-	/* Below are MMS specific properties */
-	PROV_PROPERTY_MMS_PROXY = PROV_PROPERTY_INTERNET_COUNT,
-	PROV_PROPERTY_MMS_CENTER,
-	PROV_PROPERTY_MMS_COUNT
+struct provisioning_pool {
+	gpointer first;             /* Free objects, linked via first pointer */
+	guint count;
+	gsize size;
 };
 
 struct provisioning_ofono {
 	char *imsi;
+	char imsi_buf[PROVISIONING_IMSI_BUF];
 	struct provisioning_data *data;
 	OfonoManager *manager;
 	gulong manager_valid_id;
 	guint timeout_id;
+	gint64 started;
+	gint64 deadline;
 	provisioning_ofono_cb_t done;
 	void *param;
-	GSList *sim_list;
+	struct provisioning_sim *sim_list;
+	struct provisioning_sim *target;
+	guint internet_props;
+	guint mms_props;
+	gboolean update;
+	gboolean adding_sims;
+	gboolean finished;
+	struct provisioning_ofono_report report;
 };
 
 struct provisioning_sim {
+	struct provisioning_sim *next;
 	OfonoSimMgr *simmgr;
 	OfonoConnMgr* connmgr;
 	gulong simmgr_valid_id;
 	gulong connmgr_valid_id;
+	gint64 created;
+	gint64 matched;
 	struct provisioning_ofono *ofono;
 	struct provisioning_context *internet;
 	struct provisioning_context *mms;
 };
 
+struct provisioning_property_request {
+	struct provisioning_context *ctx;
+	const char *name;
+	const char *value;
+	int index;
+	int attempt;
+	guint retry_id;
+	gint64 sent;
+};
+
 struct provisioning_context {
 	int refcount;
+	struct provisioning_data *data;
 	OfonoConnCtx* connctx;
 	gulong connctx_valid_id;
 	gulong connctx_active_id;
+	gulong connctx_failed_id;
 	struct provisioning_sim *sim;
 	enum provisioning_context_state state;
+	enum provisioning_context_state final_state;
+	gint64 deactivated;
+	guint reactivate_timeout_id;
+	guint props;
+	guint written;
+	gboolean checking;
 	int outstanding_requests;
-	GCancellable **req;
+	GCancellable *req[PROVISIONING_MAX_PROPS];
+	struct provisioning_property_request *retry[PROVISIONING_MAX_PROPS];
+	struct provisioning_property_request prop[PROVISIONING_MAX_PROPS];
 	int nreq;
 	void (*set_properties)(struct provisioning_context *ctx);
+	char *proxy_alloc;
+	char proxy[PROVISIONING_PROXY_BUF];
 };
 
-struct provisioning_property_request {
-	struct provisioning_context *ctx;
-	const char *name;
-	int index;
+struct provisioning_ofono_watch {
+	OfonoManager *manager;
+	gulong manager_valid_id;
+	gulong modem_added_id;
+	GSList *sims;
+	provisioning_ofono_sim_cb_t cb;
+	void *param;
+};
+
+/* SIM slot being watched */
+struct provisioning_watch_sim {
+	struct provisioning_ofono_watch *watch;
+	OfonoSimMgr *simmgr;
+	OfonoConnMgr *connmgr;
+	gulong simmgr_id[3];
+	char *imsi;
+};
+
+static gboolean provisioning_reactivate = FALSE;
+
+static struct provisioning_pool provisioning_ofono_pool = {
+	NULL, 0, sizeof(struct provisioning_ofono)
+};
+
+static struct provisioning_pool provisioning_sim_pool = {
+	NULL, 0, sizeof(struct provisioning_sim)
+};
+
+static struct provisioning_pool provisioning_context_pool = {
+	NULL, 0, sizeof(struct provisioning_context)
 };
 
+static
+gpointer
+provisioning_pool_alloc(
+	struct provisioning_pool *pool)
+{
+	gpointer obj = pool->first;
+	if (obj) {
+		pool->first = *(gpointer*)obj;
+		pool->count--;
+		memset(obj, 0, pool->size);
+		return obj;
+	}
+	return g_malloc0(pool->size);
+}
+
+static
+void
+provisioning_pool_free(
+	struct provisioning_pool *pool,
+	gpointer obj)
+{
+	if (pool->count < PROVISIONING_POOL_SIZE) {
+		*(gpointer*)obj = pool->first;
+		pool->first = obj;
+		pool->count++;
+	} else {
+		g_free(obj);
+	}
+}
+
 static
 struct provisioning_context*
 provisioning_context_ref(
@@ -107,10 +219,27 @@ provisioning_context_unref(
 	if (ctx && !--ctx->refcount) {
 		ofono_connctx_remove_handler(ctx->connctx, ctx->connctx_valid_id);
 		ofono_connctx_remove_handler(ctx->connctx, ctx->connctx_active_id);
+		ofono_connctx_remove_handler(ctx->connctx, ctx->connctx_failed_id);
 		ofono_connctx_unref(ctx->connctx);
-		g_free(ctx->req);
-		g_free(ctx);
+		provisioning_data_unref(ctx->data);
+		g_free(ctx->proxy_alloc);
+		provisioning_pool_free(&provisioning_context_pool, ctx);
+	}
+}
+
+/* The request is a part of the context, this drops its reference */
+static
+void
+provisioning_property_request_free(
+	struct provisioning_property_request *prop)
+{
+	struct provisioning_context *ctx = prop->ctx;
+	if (prop->retry_id) {
+		g_source_remove(prop->retry_id);
+		prop->retry_id = 0;
 	}
+	prop->ctx = NULL;
+	provisioning_context_unref(ctx);
 }
 
 static
@@ -126,7 +255,24 @@ provisioning_context_cancel(
 				g_object_unref(context->req[i]);
 				context->req[i] = NULL;
 			}
+			if (context->retry[i]) {
+				/* Waiting for the next attempt, nothing is in flight */
+				provisioning_property_request_free(context->retry[i]);
+				context->retry[i] = NULL;
+			}
+		}
+		if (context->reactivate_timeout_id) {
+			/* Activation has been requested, just stop waiting for it */
+			g_source_remove(context->reactivate_timeout_id);
+			context->reactivate_timeout_id = 0;
 		}
+		/* Same for the deactivation requested by a retry */
+		ofono_connctx_remove_handler(context->connctx,
+			context->connctx_active_id);
+		ofono_connctx_remove_handler(context->connctx,
+			context->connctx_failed_id);
+		context->connctx_active_id = 0;
+		context->connctx_failed_id = 0;
 		context->sim = NULL;
 		provisioning_context_unref(context);
 	}
@@ -135,16 +281,47 @@ provisioning_context_cancel(
 static
 void
 provisioning_ofono_free_sim(
-	gpointer arg)
+	struct provisioning_sim *sim)
 {
-	struct provisioning_sim *sim = arg;
 	provisioning_context_cancel(sim->internet);
 	provisioning_context_cancel(sim->mms);
 	ofono_connmgr_remove_handler(sim->connmgr, sim->connmgr_valid_id);
 	ofono_simmgr_remove_handler(sim->simmgr, sim->simmgr_valid_id);
 	ofono_connmgr_unref(sim->connmgr);
 	ofono_simmgr_unref(sim->simmgr);
-	g_free(sim);
+	provisioning_pool_free(&provisioning_sim_pool, sim);
+}
+
+static
+guint
+provisioning_context_failed(
+	struct provisioning_context *ctx,
+	guint props)
+{
+	/* Missing context means that nothing has been written */
+	return ctx ? (ctx->props & ~ctx->written) : props;
+}
+
+static
+void
+provisioning_ofono_free(
+	struct provisioning_ofono *ofono)
+{
+	if (ofono->timeout_id) {
+		g_source_remove(ofono->timeout_id);
+	}
+	ofono_manager_remove_handler(ofono->manager, ofono->manager_valid_id);
+	ofono_manager_unref(ofono->manager);
+	while (ofono->sim_list) {
+		struct provisioning_sim *sim = ofono->sim_list;
+		ofono->sim_list = sim->next;
+		provisioning_ofono_free_sim(sim);
+	}
+	provisioning_data_unref(ofono->data);
+	if (ofono->imsi != ofono->imsi_buf) {
+		g_free(ofono->imsi);
+	}
+	provisioning_pool_free(&provisioning_ofono_pool, ofono);
 }
 
 static
@@ -154,19 +331,39 @@ provisioning_ofono_done(
 	const char *path,
 	enum prov_result result)
 {
+	struct provisioning_sim *sim = ofono->target;
+	ofono->report.result = result;
+	ofono->report.internet_failed = sim ?
+		provisioning_context_failed(sim->internet, ofono->internet_props) :
+		ofono->internet_props;
+	ofono->report.mms_failed = sim ?
+		provisioning_context_failed(sim->mms, ofono->mms_props) :
+		ofono->mms_props;
+	PROV_TRACE3(provisioning__done, ofono->imsi, path, result);
+	if (ofono->report.downtime_ms) {
+		LOG("%s was offline for %u ms", ofono->imsi, ofono->report.downtime_ms);
+	}
 	if (ofono->done) {
-		ofono->done(ofono->imsi, path, result, ofono->param);
+		ofono->done(ofono->imsi, path, &ofono->report, ofono->param);
 		ofono->done = NULL;
 	}
-	if (ofono->timeout_id) {
-		g_source_remove(ofono->timeout_id);
+	if (ofono->adding_sims) {
+		/* provisioning_manager_valid() will free it */
+		ofono->finished = TRUE;
+	} else {
+		provisioning_ofono_free(ofono);
 	}
-	ofono_manager_remove_handler(ofono->manager, ofono->manager_valid_id);
-	ofono_manager_unref(ofono->manager);
-	g_slist_free_full(ofono->sim_list, provisioning_ofono_free_sim);
-	provisioning_data_free(ofono->data);
-	g_free(ofono->imsi);
-	g_free(ofono);
+}
+
+static
+void
+provisioning_context_set_state(
+	struct provisioning_context *ctx,
+	enum provisioning_context_state state)
+{
+	PROV_TRACE3(context__state, ofono_connctx_path(ctx->connctx),
+		ctx->state, state);
+	ctx->state = state;
 }
 
 static
@@ -176,6 +373,7 @@ provisioning_ofono_timeout(
 {
 	struct provisioning_ofono *ofono = data;
 	LOG("Timeout trying to provision %s", ofono->imsi);
+	provisioning_stats_count(PROV_STATS_TIMEOUTS, 1);
 	ofono->timeout_id = 0;
 	provisioning_ofono_done(ofono, NULL, PROV_FAILURE);
 	return FALSE;
@@ -186,8 +384,8 @@ void
 provisioning_sim_check(
 	struct provisioning_sim *sim)
 {
-	if ((!sim->internet || sim->internet->state > PROV_CONTEXT_PROVISIONING) &&
-	    (!sim->mms || sim->mms->state > PROV_CONTEXT_PROVISIONING)) {
+	if ((!sim->internet || sim->internet->state >= PROV_CONTEXT_SUCCESS) &&
+	    (!sim->mms || sim->mms->state >= PROV_CONTEXT_SUCCESS)) {
 		/* All done */
 		int context_count = 0, success_count = 0, error_count = 0;
 		if (sim->internet) {
@@ -214,6 +412,234 @@ provisioning_sim_check(
 	}
 }
 
+static
+void
+provisioning_context_reactivated(
+	struct provisioning_context *ctx)
+{
+	ofono_connctx_remove_handler(ctx->connctx, ctx->connctx_active_id);
+	ofono_connctx_remove_handler(ctx->connctx, ctx->connctx_failed_id);
+	ctx->connctx_active_id = 0;
+	ctx->connctx_failed_id = 0;
+	if (ctx->reactivate_timeout_id) {
+		g_source_remove(ctx->reactivate_timeout_id);
+		ctx->reactivate_timeout_id = 0;
+	}
+	provisioning_context_set_state(ctx, ctx->final_state);
+	provisioning_sim_check(ctx->sim);
+}
+
+static
+void
+provisioning_context_reactivate_active_changed(
+	OfonoConnCtx *connctx,
+	void *arg)
+{
+	struct provisioning_context *ctx = arg;
+	if (connctx->active) {
+		const gint64 usec = g_get_monotonic_time() - ctx->deactivated;
+		const guint gap = (guint)(usec / 1000);
+		struct provisioning_ofono_report *report = &ctx->sim->ofono->report;
+		LOG("%s re-activated, %u ms gap", ofono_connctx_path(connctx), gap);
+		provisioning_stats_record(PROV_STATS_DOWNTIME, usec);
+		report->downtime_ms = MAX(report->downtime_ms, gap);
+		provisioning_context_reactivated(ctx);
+	}
+}
+
+static
+void
+provisioning_context_reactivate_failed(
+	OfonoConnCtx *connctx,
+	const GError *error,
+	void *arg)
+{
+	/* No point in waiting for the timeout, ofono has given up */
+	LOG("%s failed to re-activate: %s", ofono_connctx_path(connctx),
+		error ? error->message : "unknown error");
+	provisioning_context_reactivated(arg);
+}
+
+static
+gboolean
+provisioning_context_reactivate_timeout(
+	gpointer data)
+{
+	struct provisioning_context *ctx = data;
+	LOG("%s failed to re-activate", ofono_connctx_path(ctx->connctx));
+	ctx->reactivate_timeout_id = 0;
+	provisioning_context_reactivated(ctx);
+	return G_SOURCE_REMOVE;
+}
+
+/* Called when the last property request has been completed */
+static
+void
+provisioning_context_finish(
+	struct provisioning_context *ctx)
+{
+	const enum provisioning_context_state state =
+		(ctx->written == ctx->props) ?
+		PROV_CONTEXT_SUCCESS :
+		PROV_CONTEXT_ERROR;
+	if (ctx->deactivated && provisioning_reactivate &&
+		state == PROV_CONTEXT_SUCCESS) {
+		/* Bring the context back up before reporting the result */
+		LOG("Re-activating %s", ofono_connctx_path(ctx->connctx));
+		GASSERT(!ctx->connctx_active_id);
+		GASSERT(!ctx->connctx_failed_id);
+		ctx->final_state = state;
+		provisioning_context_set_state(ctx, PROV_CONTEXT_REACTIVATING);
+		ctx->connctx_active_id = ofono_connctx_add_active_changed_handler(
+			ctx->connctx, provisioning_context_reactivate_active_changed, ctx);
+		ctx->connctx_failed_id = ofono_connctx_add_activate_failed_handler(
+			ctx->connctx, provisioning_context_reactivate_failed, ctx);
+		ctx->reactivate_timeout_id = g_timeout_add_seconds(
+			PROVISIONING_REACTIVATE_TIMEOUT,
+			provisioning_context_reactivate_timeout, ctx);
+		if (!ofono_connctx_activate(ctx->connctx)) {
+			LOG("Failed to re-activate %s",
+				ofono_connctx_path(ctx->connctx));
+			provisioning_context_reactivated(ctx);
+		}
+	} else {
+		if (ctx->deactivated && provisioning_reactivate) {
+			/* Half-written settings, leave the context down */
+			LOG("Not re-activating %s", ofono_connctx_path(ctx->connctx));
+		}
+		provisioning_context_set_state(ctx, state);
+		provisioning_sim_check(ctx->sim);
+	}
+}
+
+static
+gboolean
+provisioning_error_is_transient(
+	const GError *error)
+{
+	if (error->domain == OFONO_ERROR) {
+		switch (error->code) {
+		case OFONO_ERROR_IN_PROGRESS:
+		case OFONO_ERROR_IN_USE:
+		case OFONO_ERROR_ATTACH_IN_PROGRESS:
+		case OFONO_ERROR_SIM_NOT_READY:
+		case OFONO_ERROR_TIMED_OUT:
+			return TRUE;
+		default:
+			break;
+		}
+	} else if (error->domain == G_DBUS_ERROR) {
+		switch (error->code) {
+		case G_DBUS_ERROR_NO_REPLY:
+		case G_DBUS_ERROR_TIMEOUT:
+		case G_DBUS_ERROR_TIMED_OUT:
+		case G_DBUS_ERROR_LIMITS_EXCEEDED:
+			return TRUE;
+		default:
+			break;
+		}
+	} else if (error->domain == G_IO_ERROR) {
+		return error->code == G_IO_ERROR_TIMED_OUT;
+	}
+	return FALSE;
+}
+
+static void provisioning_property_request_send(
+	struct provisioning_property_request *prop);
+
+/* Sends the retries which have been waiting for the context to go down */
+static
+void
+provisioning_context_retry_active_changed(
+	OfonoConnCtx *connctx,
+	void *arg)
+{
+	struct provisioning_context *ctx = arg;
+	if (!connctx->active) {
+		int i;
+		LOG("%s is down, retrying", ofono_connctx_path(connctx));
+		ofono_connctx_remove_handler(connctx, ctx->connctx_active_id);
+		ctx->connctx_active_id = 0;
+		for (i=0; i<ctx->nreq; i++) {
+			struct provisioning_property_request *prop = ctx->retry[i];
+			if (prop && !prop->retry_id) {
+				ctx->retry[i] = NULL;
+				provisioning_property_request_send(prop);
+			}
+		}
+	}
+}
+
+static
+gboolean
+provisioning_property_request_retry_cb(
+	gpointer data)
+{
+	struct provisioning_property_request *prop = data;
+	struct provisioning_context *ctx = prop->ctx;
+	GASSERT(ctx->retry[prop->index] == prop);
+	prop->retry_id = 0;
+	if (ctx->connctx->active) {
+		/*
+		 * Something has re-activated the context behind our back.
+		 * The write would fail while it's up, the request stays in
+		 * ctx->retry until it's down again.
+		 */
+		if (!ctx->connctx_active_id) {
+			LOG("%s is active again", ofono_connctx_path(ctx->connctx));
+			ctx->connctx_active_id = ofono_connctx_add_active_changed_handler(
+				ctx->connctx, provisioning_context_retry_active_changed, ctx);
+			ofono_connctx_deactivate(ctx->connctx);
+		}
+	} else {
+		ctx->retry[prop->index] = NULL;
+		provisioning_property_request_send(prop);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * Schedules another attempt if the error is worth retrying and there's
+ * enough time left before the transaction deadline. The delay grows
+ * exponentially, half of it is randomized so that requests failed
+ * at the same time don't hit ofono again at the same time.
+ */
+static
+gboolean
+provisioning_property_request_retry(
+	struct provisioning_property_request *prop,
+	const GError *error)
+{
+	struct provisioning_context *ctx = prop->ctx;
+	struct provisioning_ofono *ofono;
+	guint delay;
+
+	if (!ctx->sim || !provisioning_error_is_transient(error) ||
+		prop->attempt >= PROVISIONING_RETRY_MAX_ATTEMPTS) {
+		return FALSE;
+	}
+
+	ofono = ctx->sim->ofono;
+	delay = MIN(PROVISIONING_RETRY_MIN_DELAY << (prop->attempt - 1),
+		PROVISIONING_RETRY_MAX_DELAY);
+	delay = delay/2 + g_random_int_range(0, delay/2 + 1);
+	if (g_get_monotonic_time() + delay * (gint64)1000 >= ofono->deadline) {
+		LOG("%s %s no time left to retry", ofono_connctx_path(ctx->connctx),
+			prop->name);
+		return FALSE;
+	}
+
+	LOG("%s %s %s, retrying in %u ms", ofono_connctx_path(ctx->connctx),
+		prop->name, error->message, delay);
+	GASSERT(!ctx->retry[prop->index]);
+	ctx->retry[prop->index] = prop;
+	prop->retry_id = g_timeout_add(delay,
+		provisioning_property_request_retry_cb, prop);
+	ofono->report.retries++;
+	provisioning_stats_count(PROV_STATS_RETRIES, 1);
+	return TRUE;
+}
+
 static
 void
 provisioning_property_request_done(
@@ -223,24 +649,69 @@ provisioning_property_request_done(
 {
 	struct provisioning_property_request *prop = data;
 	struct provisioning_context *ctx = prop->ctx;
-	ctx->outstanding_requests--;
-	LOG("%s (%d) %s %s", ofono_connctx_path(connctx), ctx->outstanding_requests,
-		prop->name, error ? error->message : "OK");
 	GASSERT(ctx->req[prop->index]);
 	g_object_unref(ctx->req[prop->index]);
 	ctx->req[prop->index] = NULL;
-	if (error) {
-		ctx->state = PROV_CONTEXT_ERROR;
+	provisioning_stats_record_since(PROV_STATS_PROPERTY_WRITE, prop->sent);
+	PROV_TRACE3(property__done, ofono_connctx_path(connctx), prop->name,
+		error ? error->message : NULL);
+	if (error && provisioning_property_request_retry(prop, error)) {
+		/* The request remains outstanding */
+		return;
 	}
-	if (!ctx->outstanding_requests) {
+	ctx->outstanding_requests--;
+	LOG("%s (%d) %s %s", ofono_connctx_path(connctx), ctx->outstanding_requests,
+		prop->name, error ? error->message : "OK");
+	if (!error) {
+		ctx->written |= PROV_PROPERTY_BIT(prop->index);
+	}
+	if (!ctx->outstanding_requests && ctx->sim) {
 		/* Last request has been completed */
-		if (ctx->state == PROV_CONTEXT_PROVISIONING) {
-			ctx->state = PROV_CONTEXT_SUCCESS;
-		}
-		provisioning_sim_check(ctx->sim);
+		provisioning_context_finish(ctx);
 	}
-	provisioning_context_unref(ctx);
-	g_free(prop);
+	provisioning_property_request_free(prop);
+}
+
+static
+void
+provisioning_property_request_send(
+	struct provisioning_property_request *prop)
+{
+	struct provisioning_context *ctx = prop->ctx;
+	GASSERT(!ctx->req[prop->index]);
+	prop->attempt++;
+	prop->sent = g_get_monotonic_time();
+	PROV_TRACE3(property__submit, ofono_connctx_path(ctx->connctx),
+		prop->name, prop->attempt);
+	ctx->req[prop->index] = ofono_connctx_set_string_full(ctx->connctx,
+		prop->name, prop->value, provisioning_property_request_done, prop);
+	g_object_ref(ctx->req[prop->index]);
+}
+
+static
+const char *
+provisioning_context_current(
+	struct provisioning_context *ctx,
+	int index)
+{
+	OfonoConnCtx *connctx = ctx->connctx;
+	switch (index) {
+	case PROV_PROPERTY_NAME:
+		return connctx->name;
+	case PROV_PROPERTY_APN:
+		return connctx->apn;
+	case PROV_PROPERTY_USERNAME:
+		return connctx->username;
+	case PROV_PROPERTY_PASSWORD:
+		return connctx->password;
+	case PROV_PROPERTY_AUTH:
+		return ofono_connctx_auth_string(connctx->auth);
+	case PROV_PROPERTY_MMS_PROXY:
+		return connctx->mms_proxy;
+	case PROV_PROPERTY_MMS_CENTER:
+		return connctx->mms_center;
+	}
+	return NULL;
 }
 
 static
@@ -252,18 +723,31 @@ provisioning_context_request_submit(
 	const char *value)
 {
 	struct provisioning_property_request *prop;
-	GASSERT(!ctx->req[index]);
+	if (!(ctx->props & PROV_PROPERTY_BIT(index))) {
+		/* Not this time */
+		return;
+	}
 	if (!value) value = "";
-	prop = g_new(struct provisioning_property_request, 1);
+	if (ctx->checking) {
+		/* Only the properties which differ remain selected */
+		const char *current = provisioning_context_current(ctx, index);
+		if (!strcmp(current ? current : "", value)) {
+			ctx->props &= ~PROV_PROPERTY_BIT(index);
+		}
+		return;
+	}
+	/* Values belong to ctx->data (or the context itself) */
+	prop = ctx->prop + index;
+	GASSERT(!prop->ctx);
+	memset(prop, 0, sizeof(*prop));
 	prop->ctx = provisioning_context_ref(ctx);
 	prop->index = index;
 	prop->name = name;
+	prop->value = value;
 	ctx->outstanding_requests++;
 	LOG("%s (%d) %s = \"%s\"", ofono_connctx_path(ctx->connctx),
 		ctx->outstanding_requests, name, value);
-	ctx->req[index] = ofono_connctx_set_string_full(ctx->connctx,
-		name, value, provisioning_property_request_done, prop);
-	g_object_ref(ctx->req[index]);
+	provisioning_property_request_send(prop);
 }
 
 static
@@ -292,8 +776,7 @@ void
 provisioning_context_set_internet_properties(
 	struct provisioning_context *ctx)
 {
-	const struct provisioning_internet *internet =
-		ctx->sim->ofono->data->internet;
+	const struct provisioning_internet *internet = ctx->data->internet;
 	if (internet) {
 		provisioning_context_request_submit(ctx, PROV_PROPERTY_NAME,
 			OFONO_CONNCTX_PROPERTY_NAME, internet->name);
@@ -314,7 +797,7 @@ void
 provisioning_context_set_mms_properties(
 	struct provisioning_context *ctx)
 {
-	const struct provisioning_mms *mms = ctx->sim->ofono->data->mms;
+	const struct provisioning_mms *mms = ctx->data->mms;
 	if (mms) {
 		provisioning_context_request_submit(ctx, PROV_PROPERTY_NAME,
 			OFONO_CONNCTX_PROPERTY_NAME, mms->name);
@@ -331,10 +814,16 @@ provisioning_context_set_mms_properties(
 			OFONO_CONNCTX_PROPERTY_MMS_CENTER, mms->messagecenter);
 		if (mms->messageproxy && mms->messageproxy[0] &&
 		    mms->portnro && mms->portnro[0]) {
-			char *val = g_strconcat(mms->messageproxy, ":", mms->portnro, NULL);
+			const char *val = ctx->proxy;
+			if (g_snprintf(ctx->proxy, sizeof(ctx->proxy), "%s:%s",
+				mms->messageproxy, mms->portnro) >= (int)sizeof(ctx->proxy)) {
+				/* Not a valid host name, but that's not our problem */
+				g_free(ctx->proxy_alloc);
+				val = ctx->proxy_alloc = g_strconcat(mms->messageproxy, ":",
+					mms->portnro, NULL);
+			}
 			provisioning_context_request_submit(ctx, PROV_PROPERTY_MMS_PROXY,
 				OFONO_CONNCTX_PROPERTY_MMS_PROXY, val);
-			g_free(val);
 		} else {
 			provisioning_context_request_submit(ctx, PROV_PROPERTY_MMS_PROXY,
 				OFONO_CONNCTX_PROPERTY_MMS_PROXY, mms->messageproxy);
@@ -348,9 +837,9 @@ provisioning_context_inactive(
 	struct provisioning_context *ctx)
 {
 	ctx->set_properties(ctx);
-	ctx->state = ctx->outstanding_requests ?
+	provisioning_context_set_state(ctx, ctx->outstanding_requests ?
 		PROV_CONTEXT_PROVISIONING :
-		PROV_CONTEXT_ERROR;
+		PROV_CONTEXT_ERROR);
 }
 
 static
@@ -365,6 +854,10 @@ provisioning_context_active_changed(
 		ofono_connctx_remove_handler(ctx->connctx, ctx->connctx_active_id);
 		ctx->connctx_valid_id = 0;
 		ctx->connctx_active_id = 0;
+		LOG("%s deactivated in %u ms", ofono_connctx_path(connctx),
+			(guint)((g_get_monotonic_time() - ctx->deactivated) / 1000));
+		provisioning_stats_record_since(PROV_STATS_DEACTIVATE,
+			ctx->deactivated);
 		provisioning_context_inactive(ctx);
 	}
 }
@@ -374,15 +867,31 @@ void
 provisioning_context_valid(
 	struct provisioning_context *ctx)
 {
+	struct provisioning_sim *sim = ctx->sim;
 	LOG("%s active %d", ofono_connctx_path(ctx->connctx), ctx->connctx->active);
+	if (sim->ofono->update) {
+		ctx->checking = TRUE;
+		ctx->set_properties(ctx);
+		ctx->checking = FALSE;
+		if (!ctx->props) {
+			/* Nothing to write, no need to deactivate either */
+			LOG("%s is up to date", ofono_connctx_path(ctx->connctx));
+			provisioning_context_set_state(ctx, PROV_CONTEXT_SUCCESS);
+			if (ctx == sim->internet || ctx == sim->mms) {
+				provisioning_sim_check(sim);
+			}
+			return;
+		}
+	}
 	if (ctx->connctx->active) {
-		ctx->state = PROV_CONTEXT_DEACTIVATING;
+		provisioning_context_set_state(ctx, PROV_CONTEXT_DEACTIVATING);
 		GASSERT(!ctx->connctx_active_id);
 		GASSERT(!ctx->connctx_valid_id);
 		ctx->connctx_active_id = ofono_connctx_add_active_changed_handler(
 			ctx->connctx, provisioning_context_active_changed, ctx);
 		ctx->connctx_valid_id = ofono_connctx_add_valid_changed_handler(
 			ctx->connctx, provisioning_context_active_changed, ctx);
+		ctx->deactivated = g_get_monotonic_time();
 		ofono_connctx_deactivate(ctx->connctx);
 	} else {
 		provisioning_context_inactive(ctx);
@@ -409,15 +918,19 @@ provisioning_context_new(
 	struct provisioning_sim *sim,
 	OfonoConnCtx *connctx,
 	void (*set_properties)(struct provisioning_context *ctx),
+	guint props,
 	int nreq)
 {
-	struct provisioning_context *ctx = g_new0(struct provisioning_context, 1);
+	struct provisioning_context *ctx =
+		provisioning_pool_alloc(&provisioning_context_pool);
+	GASSERT(nreq <= PROVISIONING_MAX_PROPS);
 	ctx->refcount = 1;
+	ctx->data = provisioning_data_ref(sim->ofono->data);
 	ctx->connctx = ofono_connctx_ref(connctx);
 	ctx->sim = sim;
-	ctx->req = g_new0(GCancellable*, nreq);
 	ctx->nreq = nreq;
 	ctx->state = PROV_CONTEXT_INITIALIZING;
+	ctx->props = props;
 	ctx->set_properties = set_properties;
 	LOG("Configuring %s", ofono_connctx_path(connctx));
 	if (ofono_connctx_valid(ctx->connctx)) {
@@ -439,26 +952,24 @@ provisioning_connmgr_valid(
 	 * contexts if they don't exist.
 	 */
 	struct provisioning_ofono *ofono = sim->ofono;
-	if (ofono->data->internet &&
-	    ofono->data->internet->apn &&
-	    ofono->data->internet->apn[0]) {
+	provisioning_stats_record_since(PROV_STATS_CONNMGR_VALID, sim->matched);
+	PROV_TRACE1(connmgr__valid, ofono_connmgr_path(sim->connmgr));
+	if (ofono->internet_props) {
 		OfonoConnCtx *ctx = ofono_connmgr_get_context_for_type(sim->connmgr,
 			OFONO_CONNCTX_TYPE_INTERNET);
 		if (ctx) {
 			sim->internet = provisioning_context_new(sim, ctx,
 				provisioning_context_set_internet_properties,
-				PROV_PROPERTY_INTERNET_COUNT);
+				ofono->internet_props, PROV_PROPERTY_INTERNET_COUNT);
 		}
 	}
-	if (ofono->data->mms &&
-	    ofono->data->mms->apn &&
-	    ofono->data->mms->apn[0]) {
+	if (ofono->mms_props) {
 		OfonoConnCtx *ctx = ofono_connmgr_get_context_for_type(sim->connmgr,
 			OFONO_CONNCTX_TYPE_MMS);
 		if (ctx) {
 			sim->mms = provisioning_context_new(sim, ctx,
 				provisioning_context_set_mms_properties,
-				PROV_PROPERTY_MMS_COUNT);
+				ofono->mms_props, PROV_PROPERTY_MMS_COUNT);
 		}
 	}
 	provisioning_sim_check(sim);
@@ -484,9 +995,17 @@ provisioning_sim_valid(
 	struct provisioning_sim *sim)
 {
 	OfonoSimMgr *simmgr = sim->simmgr;
+	const gboolean match = simmgr->present &&
+		!g_strcmp0(sim->ofono->imsi, simmgr->imsi);
 	LOG("%s -> %s", ofono_simmgr_path(simmgr), simmgr->imsi);
-	if (simmgr->present && !g_strcmp0(sim->ofono->imsi, simmgr->imsi)) {
+	provisioning_stats_record_since(PROV_STATS_SIM_VALID, sim->created);
+	PROV_TRACE3(sim__valid, ofono_simmgr_path(simmgr), simmgr->present, match);
+	if (match) {
 		LOG("Provisioning %s", simmgr->imsi);
+		if (!sim->ofono->target) {
+			sim->ofono->target = sim;
+		}
+		sim->matched = g_get_monotonic_time();
 		if (ofono_connmgr_valid(sim->connmgr)) {
 			provisioning_connmgr_valid(sim);
 		} else {
@@ -519,11 +1038,14 @@ provisioning_sim_new(
 	struct provisioning_ofono *ofono,
 	OfonoModem *modem)
 {
-	struct provisioning_sim *sim = g_new0(struct provisioning_sim, 1);
+	struct provisioning_sim *sim =
+		provisioning_pool_alloc(&provisioning_sim_pool);
 	const char *path = ofono_modem_path(modem);
 	sim->simmgr = ofono_simmgr_new(path);
 	sim->connmgr = ofono_connmgr_new(path);
 	sim->ofono = ofono;
+	sim->created = g_get_monotonic_time();
+	PROV_TRACE1(sim__new, path);
 	if (ofono_simmgr_valid(sim->simmgr)) {
 		provisioning_sim_valid(sim);
 	} else {
@@ -539,10 +1061,18 @@ provisioning_manager_valid(
 	struct provisioning_ofono *ofono)
 {
 	GPtrArray *modems = ofono_manager_get_modems(ofono->manager);
+	struct provisioning_sim **tail = &ofono->sim_list;
 	guint i;
-	for (i=0; i<modems->len; i++) {
-		ofono->sim_list = g_slist_append(ofono->sim_list,
-			provisioning_sim_new(ofono, modems->pdata[i]));
+	provisioning_stats_record_since(PROV_STATS_MANAGER_VALID, ofono->started);
+	/* Provisioning may be finished before we are done with the list */
+	ofono->adding_sims = TRUE;
+	for (i=0; i<modems->len && !ofono->finished; i++) {
+		*tail = provisioning_sim_new(ofono, modems->pdata[i]);
+		tail = &(*tail)->next;
+	}
+	ofono->adding_sims = FALSE;
+	if (ofono->finished) {
+		provisioning_ofono_free(ofono);
 	}
 }
 
@@ -560,19 +1090,39 @@ provisioning_manager_valid_changed(
 	}
 }
 
+static
 void
-provisioning_ofono(
+provisioning_ofono_start(
 	const char *imsi,
 	struct provisioning_data *data,
+	unsigned int internet_props,
+	unsigned int mms_props,
+	gboolean update,
 	provisioning_ofono_cb_t done,
 	void *param)
 {
-	struct provisioning_ofono *ofono = g_new0(struct provisioning_ofono, 1);
-	ofono->imsi = g_strdup(imsi);
-	ofono->data = data;
+	struct provisioning_ofono *ofono =
+		provisioning_pool_alloc(&provisioning_ofono_pool);
+	if (strlen(imsi) < sizeof(ofono->imsi_buf)) {
+		ofono->imsi = strcpy(ofono->imsi_buf, imsi);
+	} else {
+		ofono->imsi = g_strdup(imsi);
+	}
+	ofono->update = update;
+	ofono->data = provisioning_data_ref(data);
+	if (data->internet && data->internet->apn && data->internet->apn[0]) {
+		ofono->internet_props = internet_props & PROV_PROPERTIES_INTERNET;
+	}
+	if (data->mms && data->mms->apn && data->mms->apn[0]) {
+		ofono->mms_props = mms_props & PROV_PROPERTIES_MMS;
+	}
 	ofono->done = done;
 	ofono->param = param;
 	ofono->manager = ofono_manager_new();
+	ofono->started = g_get_monotonic_time();
+	ofono->deadline = ofono->started + PROVISIONING_TIMEOUT * G_USEC_PER_SEC;
+	PROV_TRACE3(provisioning__start, ofono->imsi, ofono->internet_props,
+		ofono->mms_props);
 	ofono->timeout_id = g_timeout_add_seconds(PROVISIONING_TIMEOUT,
 		provisioning_ofono_timeout, ofono);
 	if (ofono->manager->valid) {
@@ -583,6 +1133,196 @@ provisioning_ofono(
 	}
 }
 
+void
+provisioning_ofono_props(
+	const char *imsi,
+	struct provisioning_data *data,
+	unsigned int internet_props,
+	unsigned int mms_props,
+	provisioning_ofono_cb_t done,
+	void *param)
+{
+	provisioning_ofono_start(imsi, data, internet_props, mms_props, FALSE,
+		done, param);
+}
+
+void
+provisioning_ofono_update(
+	const char *imsi,
+	struct provisioning_data *data,
+	provisioning_ofono_cb_t done,
+	void *param)
+{
+	provisioning_ofono_start(imsi, data, PROV_PROPERTIES_INTERNET,
+		PROV_PROPERTIES_MMS, TRUE, done, param);
+}
+
+void
+provisioning_ofono_set_reactivate(
+	int enable)
+{
+	provisioning_reactivate = (enable != 0);
+}
+
+void
+provisioning_ofono(
+	const char *imsi,
+	struct provisioning_data *data,
+	provisioning_ofono_cb_t done,
+	void *param)
+{
+	provisioning_ofono_props(imsi, data, PROV_PROPERTIES_INTERNET,
+		PROV_PROPERTIES_MMS, done, param);
+}
+
+/*==========================================================================*
+ * SIM watch
+ *==========================================================================*/
+
+static
+void
+provisioning_watch_sim_check(
+	OfonoSimMgr *simmgr,
+	void *arg)
+{
+	struct provisioning_watch_sim *sim = arg;
+	if (ofono_simmgr_valid(simmgr) && simmgr->present &&
+		simmgr->imsi && simmgr->imsi[0]) {
+		if (g_strcmp0(sim->imsi, simmgr->imsi)) {
+			struct provisioning_ofono_watch *watch = sim->watch;
+			g_free(sim->imsi);
+			sim->imsi = g_strdup(simmgr->imsi);
+			LOG("%s appeared at %s", sim->imsi, ofono_simmgr_path(simmgr));
+			if (watch->cb) {
+				watch->cb(sim->imsi, watch->param);
+			}
+		}
+	} else if (sim->imsi) {
+		/* Gone, report it again when it comes back */
+		LOG("%s is gone", sim->imsi);
+		g_free(sim->imsi);
+		sim->imsi = NULL;
+	}
+}
+
+static
+void
+provisioning_watch_sim_free(
+	gpointer data)
+{
+	struct provisioning_watch_sim *sim = data;
+	int i;
+	for (i = 0; i < G_N_ELEMENTS(sim->simmgr_id); i++) {
+		ofono_simmgr_remove_handler(sim->simmgr, sim->simmgr_id[i]);
+	}
+	ofono_simmgr_unref(sim->simmgr);
+	ofono_connmgr_unref(sim->connmgr);
+	g_free(sim->imsi);
+	g_free(sim);
+}
+
+static
+void
+provisioning_watch_add_modem(
+	struct provisioning_ofono_watch *watch,
+	OfonoModem *modem)
+{
+	const char *path = ofono_modem_path(modem);
+	struct provisioning_watch_sim *sim;
+	GSList *l;
+
+	for (l = watch->sims; l; l = l->next) {
+		sim = l->data;
+		if (!g_strcmp0(ofono_simmgr_path(sim->simmgr), path)) {
+			/* Modem has been re-added */
+			return;
+		}
+	}
+	sim = g_new0(struct provisioning_watch_sim, 1);
+	sim->watch = watch;
+	sim->simmgr = ofono_simmgr_new(path);
+	/* Nobody's watching it, it's there to have the contexts ready */
+	sim->connmgr = ofono_connmgr_new(path);
+	sim->simmgr_id[0] = ofono_simmgr_add_valid_changed_handler(sim->simmgr,
+		provisioning_watch_sim_check, sim);
+	sim->simmgr_id[1] = ofono_simmgr_add_present_changed_handler(sim->simmgr,
+		provisioning_watch_sim_check, sim);
+	sim->simmgr_id[2] = ofono_simmgr_add_imsi_changed_handler(sim->simmgr,
+		provisioning_watch_sim_check, sim);
+	watch->sims = g_slist_append(watch->sims, sim);
+	provisioning_watch_sim_check(sim->simmgr, sim);
+}
+
+static
+void
+provisioning_watch_modem_added(
+	OfonoManager *manager,
+	OfonoModem *modem,
+	void *arg)
+{
+	provisioning_watch_add_modem(arg, modem);
+}
+
+static
+void
+provisioning_watch_manager_valid(
+	struct provisioning_ofono_watch *watch)
+{
+	GPtrArray *modems = ofono_manager_get_modems(watch->manager);
+	guint i;
+	for (i = 0; i < modems->len; i++) {
+		provisioning_watch_add_modem(watch, modems->pdata[i]);
+	}
+}
+
+static
+void
+provisioning_watch_manager_valid_changed(
+	OfonoManager *manager,
+	void *arg)
+{
+	if (manager->valid) {
+		struct provisioning_ofono_watch *watch = arg;
+		ofono_manager_remove_handler(manager, watch->manager_valid_id);
+		watch->manager_valid_id = 0;
+		provisioning_watch_manager_valid(watch);
+	}
+}
+
+struct provisioning_ofono_watch *
+provisioning_ofono_watch_new(
+	provisioning_ofono_sim_cb_t cb,
+	void *param)
+{
+	struct provisioning_ofono_watch *watch =
+		g_new0(struct provisioning_ofono_watch, 1);
+	watch->cb = cb;
+	watch->param = param;
+	watch->manager = ofono_manager_new();
+	watch->modem_added_id = ofono_manager_add_modem_added_handler(
+		watch->manager, provisioning_watch_modem_added, watch);
+	if (watch->manager->valid) {
+		provisioning_watch_manager_valid(watch);
+	} else {
+		watch->manager_valid_id = ofono_manager_add_valid_changed_handler(
+			watch->manager, provisioning_watch_manager_valid_changed, watch);
+	}
+	return watch;
+}
+
+void
+provisioning_ofono_watch_free(
+	struct provisioning_ofono_watch *watch)
+{
+	if (watch) {
+		g_slist_free_full(watch->sims, provisioning_watch_sim_free);
+		ofono_manager_remove_handler(watch->manager, watch->manager_valid_id);
+		ofono_manager_remove_handler(watch->manager, watch->modem_added_id);
+		ofono_manager_unref(watch->manager);
+		g_free(watch);
+	}
+}
+
 /*
  * Local Variables:
  * mode: C
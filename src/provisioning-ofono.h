@@ -22,14 +22,49 @@ enum prov_result {
 	PROV_FAILURE
 };
 
+/* Context properties, also bit numbers in property masks */
+enum prov_property {
+	PROV_PROPERTY_NAME,
+	PROV_PROPERTY_APN,
+	PROV_PROPERTY_USERNAME,
+	PROV_PROPERTY_PASSWORD,
+	PROV_PROPERTY_AUTH,
+	PROV_PROPERTY_INTERNET_COUNT,
+	/* Below are MMS specific properties */
+	PROV_PROPERTY_MMS_PROXY = PROV_PROPERTY_INTERNET_COUNT,
+	PROV_PROPERTY_MMS_CENTER,
+	PROV_PROPERTY_MMS_COUNT
+};
+
+#define PROV_PROPERTY_BIT(prop) (1u << (prop))
+#define PROV_PROPERTIES_INTERNET ((1u << PROV_PROPERTY_INTERNET_COUNT) - 1)
+#define PROV_PROPERTIES_MMS ((1u << PROV_PROPERTY_MMS_COUNT) - 1)
+
+struct provisioning_ofono_report {
+	enum prov_result result;
+	unsigned int retries;       /* Number of retried property writes */
+	unsigned int internet_failed;   /* Mask of failed internet properties */
+	unsigned int mms_failed;        /* Mask of failed MMS properties */
+	unsigned int downtime_ms;       /* Longest deactivate/activate gap */
+};
+
 typedef
 void
 (*provisioning_ofono_cb_t)(
 	const char *imsi,
 	const char *path,
-	enum prov_result result,
+	const struct provisioning_ofono_report *report,
 	void *param);
 
+/*
+ * If enabled, contexts which had to be deactivated are activated again
+ * as soon as their properties are written. Disabled by default.
+ */
+void
+provisioning_ofono_set_reactivate(
+	int enable);
+
+/* Both functions take their own reference to data */
 void
 provisioning_ofono(
 	const char *imsi,
@@ -37,6 +72,52 @@ provisioning_ofono(
 	provisioning_ofono_cb_t done,
 	void *param);
 
+/* Writes only the properties selected by the masks */
+void
+provisioning_ofono_props(
+	const char *imsi,
+	struct provisioning_data *data,
+	unsigned int internet_props,
+	unsigned int mms_props,
+	provisioning_ofono_cb_t done,
+	void *param);
+
+/*
+ * Same as provisioning_ofono() but only writes the properties which
+ * differ from their current values. A context which is already set up
+ * right is left alone, even if it's active.
+ */
+void
+provisioning_ofono_update(
+	const char *imsi,
+	struct provisioning_data *data,
+	provisioning_ofono_cb_t done,
+	void *param);
+
+/*
+ * Invokes the callback for each SIM which is there when the watch is
+ * created, and whenever a SIM gets inserted or a modem shows up later.
+ * While the watch exists, the ofono objects stay alive and up to date,
+ * so provisioning doesn't have to wait for them. The callback is
+ * optional.
+ */
+struct provisioning_ofono_watch;
+
+typedef
+void
+(*provisioning_ofono_sim_cb_t)(
+	const char *imsi,
+	void *param);
+
+struct provisioning_ofono_watch *
+provisioning_ofono_watch_new(
+	provisioning_ofono_sim_cb_t cb,
+	void *param);
+
+void
+provisioning_ofono_watch_free(
+	struct provisioning_ofono_watch *watch);
+
 #endif /* __PROVOFONO_H */
 
 /*
@@ -0,0 +1,384 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "provisioning-prescan.h"
+
+#include <string.h>
+
+const struct provisioning_prescan_limits provisioning_prescan_defaults = {
+	PROV_PRESCAN_MAX_BYTES,
+	PROV_PRESCAN_MAX_DEPTH,
+	PROV_PRESCAN_MAX_STRTBL,
+	PROV_PRESCAN_MAX_CHARACTERISTICS,
+	PROV_PRESCAN_MAX_PARMS
+};
+
+/* WBXML 1.3 */
+#define WBXML_VERSION_MAX       (0x03)
+
+#define WBXML_SWITCH_PAGE       (0x00)
+#define WBXML_END               (0x01)
+#define WBXML_ENTITY            (0x02)
+#define WBXML_STR_I             (0x03)
+#define WBXML_LITERAL           (0x04) /* Also 0x44, 0x84 and 0xC4 */
+#define WBXML_EXT_I_0           (0x40)
+#define WBXML_EXT_I_2           (0x42)
+#define WBXML_PI                (0x43)
+#define WBXML_EXT_T_0           (0x80)
+#define WBXML_EXT_T_2           (0x82)
+#define WBXML_STR_T             (0x83)
+#define WBXML_EXT_0             (0xC0)
+#define WBXML_EXT_2             (0xC2)
+#define WBXML_OPAQUE            (0xC3)
+
+#define WBXML_TAG_ATTRS         (0x80)
+#define WBXML_TAG_CONTENT       (0x40)
+#define WBXML_TAG_ID_MASK       (0x3f)
+
+#define WBXML_PUBLIC_ID_STRTBL  (0x00)
+#define WBXML_PUBLIC_ID_UNKNOWN (0x01)
+#define WBXML_PUBLIC_ID_PROV10  (0x0B)
+#define PROV10_PUBLIC_ID        "-//WAPFORUM//DTD PROV 1.0//EN"
+
+/* Same on both code pages of the PROV 1.0 tag table */
+#define PROV_TAG_CHARACTERISTIC (0x06)
+#define PROV_TAG_PARM           (0x07)
+
+#define PRESCAN_TRUNCATED       "Truncated WBXML document"
+
+struct provisioning_prescan {
+	const guint8 *ptr;
+	const guint8 *end;
+	const guint8 *strtbl;
+	guint32 strtbl_len;
+	const struct provisioning_prescan_limits *limits;
+	struct provisioning_prescan_info *info;
+};
+
+static
+const char *
+provisioning_prescan_mb(
+	struct provisioning_prescan *scan,
+	guint32 *value)
+{
+	guint32 v = 0;
+	guint i;
+
+	/* mb_u_int32 takes at most 5 bytes */
+	for (i = 0; i < 5 && scan->ptr < scan->end; i++) {
+		const guint8 b = *scan->ptr++;
+
+		if (v > (G_MAXUINT32 >> 7)) {
+			return "Invalid WBXML integer";
+		}
+		v = (v << 7) | (b & 0x7f);
+		if (!(b & 0x80)) {
+			*value = v;
+			return NULL;
+		}
+	}
+	return (i == 5) ? "Invalid WBXML integer" : PRESCAN_TRUNCATED;
+}
+
+static
+const char *
+provisioning_prescan_skip(
+	struct provisioning_prescan *scan,
+	gsize n)
+{
+	if ((gsize)(scan->end - scan->ptr) < n) {
+		return PRESCAN_TRUNCATED;
+	} else {
+		scan->ptr += n;
+		return NULL;
+	}
+}
+
+static
+const char *
+provisioning_prescan_termstr(
+	struct provisioning_prescan *scan)
+{
+	const guint8 *nul = memchr(scan->ptr, 0, scan->end - scan->ptr);
+
+	if (nul) {
+		scan->ptr = nul + 1;
+		return NULL;
+	} else {
+		return "Unterminated inline string";
+	}
+}
+
+static
+const char *
+provisioning_prescan_strtbl_ref(
+	struct provisioning_prescan *scan)
+{
+	guint32 index;
+	const char *error = provisioning_prescan_mb(scan, &index);
+
+	return error ? error : (index < scan->strtbl_len) ? NULL :
+		"Invalid string table reference";
+}
+
+static
+const char *
+provisioning_prescan_opaque(
+	struct provisioning_prescan *scan)
+{
+	guint32 len;
+	const char *error = provisioning_prescan_mb(scan, &len);
+
+	return error ? error : provisioning_prescan_skip(scan, len);
+}
+
+/* Tokens shared by the tag and the attribute code spaces */
+static
+const char *
+provisioning_prescan_global(
+	struct provisioning_prescan *scan,
+	guint8 token,
+	gboolean *handled)
+{
+	guint32 ignored;
+
+	*handled = TRUE;
+	switch (token) {
+	case WBXML_SWITCH_PAGE:
+		return provisioning_prescan_skip(scan, 1);
+	case WBXML_ENTITY:
+	case WBXML_EXT_T_0:
+	case WBXML_EXT_T_0 + 1:
+	case WBXML_EXT_T_2:
+		return provisioning_prescan_mb(scan, &ignored);
+	case WBXML_STR_I:
+	case WBXML_EXT_I_0:
+	case WBXML_EXT_I_0 + 1:
+	case WBXML_EXT_I_2:
+		return provisioning_prescan_termstr(scan);
+	case WBXML_STR_T:
+		return provisioning_prescan_strtbl_ref(scan);
+	case WBXML_EXT_0:
+	case WBXML_EXT_0 + 1:
+	case WBXML_EXT_2:
+		return NULL;
+	case WBXML_OPAQUE:
+		return provisioning_prescan_opaque(scan);
+	default:
+		*handled = FALSE;
+		return NULL;
+	}
+}
+
+/* Attribute list of an element or a PI, up to and including END */
+static
+const char *
+provisioning_prescan_attrs(
+	struct provisioning_prescan *scan)
+{
+	while (scan->ptr < scan->end) {
+		const guint8 token = *scan->ptr++;
+		const char *error;
+		gboolean handled;
+
+		if (token == WBXML_END) {
+			return NULL;
+		} else if (token == WBXML_LITERAL) {
+			error = provisioning_prescan_strtbl_ref(scan);
+		} else if (token == WBXML_PI) {
+			error = "Unexpected PI in attribute list";
+		} else {
+			/* Otherwise it's ATTRSTART or ATTRVALUE */
+			error = provisioning_prescan_global(scan, token, &handled);
+		}
+		if (error) {
+			return error;
+		}
+	}
+	return PRESCAN_TRUNCATED;
+}
+
+static
+const char *
+provisioning_prescan_tag(
+	struct provisioning_prescan *scan,
+	guint8 token,
+	guint *depth)
+{
+	const struct provisioning_prescan_limits *limits = scan->limits;
+	struct provisioning_prescan_info *info = scan->info;
+	const char *error;
+
+	switch (token & WBXML_TAG_ID_MASK) {
+	case WBXML_LITERAL:
+		if ((error = provisioning_prescan_strtbl_ref(scan)) != NULL) {
+			return error;
+		}
+		break;
+	case PROV_TAG_CHARACTERISTIC:
+		if (++info->characteristics > limits->max_characteristics &&
+			limits->max_characteristics) {
+			return "Too many characteristics";
+		}
+		break;
+	case PROV_TAG_PARM:
+		if (++info->parms > limits->max_parms && limits->max_parms) {
+			return "Too many parms";
+		}
+		break;
+	}
+	if ((token & WBXML_TAG_ATTRS) &&
+		(error = provisioning_prescan_attrs(scan)) != NULL) {
+		return error;
+	}
+	if (token & WBXML_TAG_CONTENT) {
+		if (++(*depth) > limits->max_depth && limits->max_depth) {
+			return "WBXML document is nested too deep";
+		}
+		if (info->depth < *depth) {
+			info->depth = *depth;
+		}
+	}
+	return NULL;
+}
+
+static
+const char *
+provisioning_prescan_body(
+	struct provisioning_prescan *scan)
+{
+	guint depth = 0;
+
+	while (scan->ptr < scan->end) {
+		const guint8 token = *scan->ptr++;
+		const char *error;
+		gboolean handled;
+
+		if (token == WBXML_END) {
+			if (!depth) {
+				return "Unbalanced WBXML END token";
+			} else if (!--depth) {
+				/* Root element is done, the rest is ignored */
+				return NULL;
+			}
+			continue;
+		} else if (token == WBXML_PI) {
+			error = provisioning_prescan_attrs(scan);
+		} else {
+			error = provisioning_prescan_global(scan, token, &handled);
+			if (!error && !handled) {
+				error = provisioning_prescan_tag(scan, token, &depth);
+				if (!error && !depth) {
+					/* Empty root element */
+					return NULL;
+				}
+			} else if (!error && !depth && token != WBXML_SWITCH_PAGE) {
+				error = "Unexpected data before the root element";
+			}
+		}
+		if (error) {
+			return error;
+		}
+	}
+	return PRESCAN_TRUNCATED;
+}
+
+static
+const char *
+provisioning_prescan_header(
+	struct provisioning_prescan *scan)
+{
+	const guint8 version = *scan->ptr++;
+	guint32 public_id, public_id_index = 0, charset, strtbl_len;
+	const char *error;
+
+	if (version > WBXML_VERSION_MAX) {
+		return "Unsupported WBXML version";
+	}
+	if ((error = provisioning_prescan_mb(scan, &public_id)) != NULL ||
+		(public_id == WBXML_PUBLIC_ID_STRTBL &&
+		(error = provisioning_prescan_mb(scan, &public_id_index)) != NULL)) {
+		return error;
+	}
+	if (public_id != WBXML_PUBLIC_ID_STRTBL &&
+		public_id != WBXML_PUBLIC_ID_UNKNOWN &&
+		public_id != WBXML_PUBLIC_ID_PROV10) {
+		return "Not a provisioning document";
+	}
+	/* WBXML 1.0 has no charset */
+	if ((version && (error = provisioning_prescan_mb(scan,
+		&charset)) != NULL) ||
+		(error = provisioning_prescan_mb(scan, &strtbl_len)) != NULL) {
+		return error;
+	}
+	if (strtbl_len > scan->limits->max_strtbl && scan->limits->max_strtbl) {
+		return "WBXML string table is too large";
+	}
+	scan->strtbl = scan->ptr;
+	scan->strtbl_len = strtbl_len;
+	scan->info->strtbl = strtbl_len;
+	if ((error = provisioning_prescan_skip(scan, strtbl_len)) != NULL) {
+		return error;
+	}
+	if (public_id == WBXML_PUBLIC_ID_STRTBL) {
+		const guint8 *id = scan->strtbl + public_id_index;
+
+		if (public_id_index >= strtbl_len ||
+			strtbl_len - public_id_index < sizeof(PROV10_PUBLIC_ID) ||
+			memcmp(id, PROV10_PUBLIC_ID, sizeof(PROV10_PUBLIC_ID))) {
+			return "Not a provisioning document";
+		}
+	}
+	return NULL;
+}
+
+const char *
+provisioning_prescan(
+	const guint8 *bytes,
+	gsize len,
+	const struct provisioning_prescan_limits *limits,
+	struct provisioning_prescan_info *info)
+{
+	struct provisioning_prescan scan;
+	struct provisioning_prescan_info scan_info;
+	const char *error;
+
+	if (!limits) {
+		limits = &provisioning_prescan_defaults;
+	}
+	if (!info) {
+		info = &scan_info;
+	}
+	memset(info, 0, sizeof(*info));
+	if (!bytes || !len) {
+		return "Empty WBXML document";
+	} else if (len > limits->max_bytes && limits->max_bytes) {
+		return "WBXML document is too large";
+	}
+	memset(&scan, 0, sizeof(scan));
+	scan.ptr = bytes;
+	scan.end = bytes + len;
+	scan.limits = limits;
+	scan.info = info;
+	error = provisioning_prescan_header(&scan);
+	return error ? error : provisioning_prescan_body(&scan);
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,86 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef __PROVPRESCAN_H
+#define __PROVPRESCAN_H
+
+#include <glib.h>
+
+/* Exported by the decoder library, see provisioning-decoder.h */
+#define provisioning_prescan prov_private_prescan
+#define provisioning_prescan_defaults prov_private_prescan_defaults
+
+/*
+ * Structural check of a WBXML provisioning document, done before it's
+ * handed over to libwbxml. Walks the token stream once without building
+ * anything, allocates no memory and stops at the first problem. Inline
+ * strings are skipped with memchr() which is vectorized by libc.
+ *
+ * Zero limit means no limit.
+ */
+struct provisioning_prescan_limits {
+	gsize max_bytes;
+	guint max_depth;
+	guint max_strtbl;
+	guint max_characteristics;
+	guint max_parms;
+};
+
+struct provisioning_prescan_info {
+	guint depth;            /* Maximum element depth */
+	guint strtbl;           /* String table size */
+	guint characteristics;
+	guint parms;
+};
+
+/* Default limits. Real provisioning documents are a few hundred bytes */
+#ifndef PROV_PRESCAN_MAX_BYTES
+#  define PROV_PRESCAN_MAX_BYTES (65536)
+#endif
+
+#ifndef PROV_PRESCAN_MAX_DEPTH
+#  define PROV_PRESCAN_MAX_DEPTH (16)
+#endif
+
+#ifndef PROV_PRESCAN_MAX_STRTBL
+#  define PROV_PRESCAN_MAX_STRTBL (16384)
+#endif
+
+#ifndef PROV_PRESCAN_MAX_CHARACTERISTICS
+#  define PROV_PRESCAN_MAX_CHARACTERISTICS (256)
+#endif
+
+#ifndef PROV_PRESCAN_MAX_PARMS
+#  define PROV_PRESCAN_MAX_PARMS (2048)
+#endif
+
+extern const struct provisioning_prescan_limits provisioning_prescan_defaults;
+
+/* Returns NULL if the document looks sane, otherwise the reason why not */
+const char *
+provisioning_prescan(
+	const guint8 *bytes,
+	gsize len,
+	const struct provisioning_prescan_limits *limits,
+	struct provisioning_prescan_info *info);
+
+#endif /* __PROVPRESCAN_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,660 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "provisioning-providers.h"
+#include "provisioning-file.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Bump the magic if the format changes */
+#define PROV_PROVIDERS_MAGIC (0x4d425031) /* MBP1 */
+#define PROV_PROVIDERS_APN_TYPE "(ssssssyy)"
+#define PROV_PROVIDERS_APNS_TYPE "a" PROV_PROVIDERS_APN_TYPE
+#define PROV_PROVIDERS_NETWORK_TYPE "(s" PROV_PROVIDERS_APNS_TYPE ")"
+#define PROV_PROVIDERS_TYPE "(ua" PROV_PROVIDERS_NETWORK_TYPE ")"
+
+#define PROV_PROVIDERS_FILE_MODE (0644)
+#define PROV_PROVIDERS_DIR_MODE (0755)
+
+#define EMPTY(s) (!(s) || !(s)[0])
+
+struct provisioning_providers {
+	GVariant *networks; /* Sorted by MCC+MNC */
+};
+
+struct provisioning_providers_apn {
+	const char *apn;
+	const char *name;
+	const char *username;
+	const char *password;
+	const char *mmsc;
+	const char *mmsproxy;
+	guint8 usage;
+	guint8 auth;
+};
+
+/* Compiler state */
+struct provisioning_providers_parser {
+	GHashTable *networks; /* MCC+MNC => GPtrArray of APN records */
+	GPtrArray *gsm_networks;
+	GPtrArray *gsm_apns;
+	GString *text;
+	char *provider_name;
+	gboolean in_provider;
+	gboolean in_gsm;
+	gboolean in_apn;
+	gboolean text_wanted;
+	/* The APN being parsed */
+	char *apn;
+	char *name;
+	char *username;
+	char *password;
+	char *mmsc;
+	char *mmsproxy;
+	guint8 usage;
+	guint8 auth;
+};
+
+struct provisioning_providers *
+provisioning_providers_new(
+	const char *file)
+{
+	static const struct provisioning_file_format format = {
+		PROV_PROVIDERS_MAGIC, PROV_PROVIDERS_TYPE
+	};
+	struct provisioning_providers *providers = NULL;
+	GVariant *root = provisioning_file_load(file, &format, 1);
+	if (root) {
+		providers = g_new0(struct provisioning_providers, 1);
+		providers->networks = g_variant_get_child_value(root, 1);
+		LOG("%s: %u networks", file, (guint)
+			g_variant_n_children(providers->networks));
+		g_variant_unref(root);
+	}
+	return providers;
+}
+
+void
+provisioning_providers_free(
+	struct provisioning_providers *providers)
+{
+	if (providers) {
+		g_variant_unref(providers->networks);
+		g_free(providers);
+	}
+}
+
+/*==========================================================================*
+ * Compiler
+ *==========================================================================*/
+
+static
+void
+provisioning_providers_parser_reset_apn(
+	struct provisioning_providers_parser *parser)
+{
+	g_free(parser->apn);
+	g_free(parser->name);
+	g_free(parser->username);
+	g_free(parser->password);
+	g_free(parser->mmsc);
+	g_free(parser->mmsproxy);
+	parser->apn = NULL;
+	parser->name = NULL;
+	parser->username = NULL;
+	parser->password = NULL;
+	parser->mmsc = NULL;
+	parser->mmsproxy = NULL;
+	parser->usage = 0;
+	parser->auth = AUTH_UNKNOWN;
+}
+
+static
+gboolean
+provisioning_providers_digits(
+	const char *str,
+	gsize min,
+	gsize max)
+{
+	gsize n = 0;
+	if (str) {
+		while (g_ascii_isdigit(str[n])) n++;
+		return !str[n] && n >= min && n <= max;
+	}
+	return FALSE;
+}
+
+static
+void
+provisioning_providers_parser_start(
+	GMarkupParseContext *context,
+	const char *element,
+	const char **names,
+	const char **values,
+	gpointer user_data,
+	GError **error)
+{
+	struct provisioning_providers_parser *parser = user_data;
+	guint i;
+
+	if (!strcmp(element, "provider")) {
+		parser->in_provider = TRUE;
+		g_free(parser->provider_name);
+		parser->provider_name = NULL;
+	} else if (!strcmp(element, "gsm") && parser->in_provider) {
+		parser->in_gsm = TRUE;
+	} else if (!strcmp(element, "network-id") && parser->in_gsm) {
+		const char *mcc = NULL;
+		const char *mnc = NULL;
+		for (i = 0; names[i]; i++) {
+			if (!strcmp(names[i], "mcc")) {
+				mcc = values[i];
+			} else if (!strcmp(names[i], "mnc")) {
+				mnc = values[i];
+			}
+		}
+		if (provisioning_providers_digits(mcc, 3, 3) &&
+			provisioning_providers_digits(mnc, 2, 3)) {
+			g_ptr_array_add(parser->gsm_networks, g_strconcat(mcc, mnc,
+				NULL));
+		}
+	} else if (!strcmp(element, "apn") && parser->in_gsm) {
+		provisioning_providers_parser_reset_apn(parser);
+		for (i = 0; names[i]; i++) {
+			if (!strcmp(names[i], "value")) {
+				parser->apn = g_strstrip(g_strdup(values[i]));
+			}
+		}
+		parser->in_apn = (parser->apn && parser->apn[0]);
+	} else if (!strcmp(element, "usage") && parser->in_apn) {
+		for (i = 0; names[i]; i++) {
+			if (!strcmp(names[i], "type")) {
+				if (!strcmp(values[i], "internet")) {
+					parser->usage |= PROV_PROVIDERS_USAGE_INTERNET;
+				} else if (!strcmp(values[i], "mms")) {
+					parser->usage |= PROV_PROVIDERS_USAGE_MMS;
+				}
+			}
+		}
+	} else if (!strcmp(element, "authentication") && parser->in_apn) {
+		for (i = 0; names[i]; i++) {
+			if (!strcmp(names[i], "method")) {
+				if (!g_ascii_strcasecmp(values[i], "pap")) {
+					parser->auth = AUTH_PAP;
+				} else if (!g_ascii_strcasecmp(values[i], "chap")) {
+					parser->auth = AUTH_CHAP;
+				}
+			}
+		}
+	} else if (!strcmp(element, "name")) {
+		/* Only the first (untranslated) provider name is used */
+		parser->text_wanted = parser->in_apn ? !parser->name :
+			(parser->in_provider && !parser->provider_name);
+	} else if (parser->in_apn && (!strcmp(element, "username") ||
+		!strcmp(element, "password") || !strcmp(element, "mmsc") ||
+		!strcmp(element, "mmsproxy"))) {
+		parser->text_wanted = TRUE;
+	}
+	g_string_truncate(parser->text, 0);
+}
+
+static
+void
+provisioning_providers_parser_add_apn(
+	struct provisioning_providers_parser *parser)
+{
+	const char *name = parser->name ? parser->name : parser->provider_name;
+
+	/* Same as ofono, APNs without usage are for internet */
+	g_ptr_array_add(parser->gsm_apns, g_variant_ref_sink(g_variant_new(
+		PROV_PROVIDERS_APN_TYPE, parser->apn, name ? name : "",
+		parser->username ? parser->username : "",
+		parser->password ? parser->password : "",
+		parser->mmsc ? parser->mmsc : "",
+		parser->mmsproxy ? parser->mmsproxy : "",
+		parser->usage ? parser->usage : PROV_PROVIDERS_USAGE_INTERNET,
+		parser->auth)));
+}
+
+static
+void
+provisioning_providers_parser_add_gsm(
+	struct provisioning_providers_parser *parser)
+{
+	guint i, k;
+
+	for (i = 0; i < parser->gsm_networks->len; i++) {
+		const char *key = parser->gsm_networks->pdata[i];
+		GPtrArray *apns = g_hash_table_lookup(parser->networks, key);
+		if (!apns) {
+			apns = g_ptr_array_new_with_free_func((GDestroyNotify)
+				g_variant_unref);
+			g_hash_table_insert(parser->networks, g_strdup(key), apns);
+		}
+		for (k = 0; k < parser->gsm_apns->len; k++) {
+			g_ptr_array_add(apns, g_variant_ref(parser->gsm_apns->pdata[k]));
+		}
+	}
+	g_ptr_array_set_size(parser->gsm_networks, 0);
+	g_ptr_array_set_size(parser->gsm_apns, 0);
+}
+
+static
+void
+provisioning_providers_parser_end(
+	GMarkupParseContext *context,
+	const char *element,
+	gpointer user_data,
+	GError **error)
+{
+	struct provisioning_providers_parser *parser = user_data;
+
+	if (parser->text_wanted) {
+		char **field = NULL;
+		if (!strcmp(element, "name")) {
+			field = parser->in_apn ? &parser->name : &parser->provider_name;
+		} else if (!strcmp(element, "username")) {
+			field = &parser->username;
+		} else if (!strcmp(element, "password")) {
+			field = &parser->password;
+		} else if (!strcmp(element, "mmsc")) {
+			field = &parser->mmsc;
+		} else if (!strcmp(element, "mmsproxy")) {
+			field = &parser->mmsproxy;
+		}
+		if (field) {
+			g_free(*field);
+			*field = g_strdup(g_strstrip(parser->text->str));
+		}
+		parser->text_wanted = FALSE;
+	} else if (!strcmp(element, "apn")) {
+		if (parser->in_apn) {
+			provisioning_providers_parser_add_apn(parser);
+			parser->in_apn = FALSE;
+		}
+		provisioning_providers_parser_reset_apn(parser);
+	} else if (!strcmp(element, "gsm")) {
+		if (parser->in_gsm) {
+			provisioning_providers_parser_add_gsm(parser);
+			parser->in_gsm = FALSE;
+		}
+	} else if (!strcmp(element, "provider")) {
+		parser->in_provider = FALSE;
+	}
+}
+
+static
+void
+provisioning_providers_parser_text(
+	GMarkupParseContext *context,
+	const char *text,
+	gsize len,
+	gpointer user_data,
+	GError **error)
+{
+	struct provisioning_providers_parser *parser = user_data;
+
+	if (parser->text_wanted) {
+		g_string_append_len(parser->text, text, len);
+	}
+}
+
+static
+int
+provisioning_providers_compare_keys(
+	gconstpointer a,
+	gconstpointer b)
+{
+	return strcmp(*(const char **)a, *(const char **)b);
+}
+
+GVariant *
+provisioning_providers_compile(
+	const char *xml,
+	gsize len,
+	GError **error)
+{
+	static const GMarkupParser callbacks = {
+		provisioning_providers_parser_start,
+		provisioning_providers_parser_end,
+		provisioning_providers_parser_text,
+		NULL, NULL
+	};
+	struct provisioning_providers_parser parser;
+	GMarkupParseContext *context;
+	GVariant *root = NULL;
+
+	memset(&parser, 0, sizeof(parser));
+	parser.networks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify) g_ptr_array_unref);
+	parser.gsm_networks = g_ptr_array_new_with_free_func(g_free);
+	parser.gsm_apns = g_ptr_array_new_with_free_func((GDestroyNotify)
+		g_variant_unref);
+	parser.text = g_string_new(NULL);
+
+	context = g_markup_parse_context_new(&callbacks, 0, &parser, NULL);
+	if (g_markup_parse_context_parse(context, xml, len, error) &&
+		g_markup_parse_context_end_parse(context, error)) {
+		GVariantBuilder builder;
+		guint i, n = 0;
+		gpointer *keys = g_hash_table_get_keys_as_array(parser.networks, &n);
+
+		/* Sorted for binary search */
+		qsort(keys, n, sizeof(keys[0]), provisioning_providers_compare_keys);
+		g_variant_builder_init(&builder, G_VARIANT_TYPE("a"
+			PROV_PROVIDERS_NETWORK_TYPE));
+		for (i = 0; i < n; i++) {
+			GPtrArray *apns = g_hash_table_lookup(parser.networks, keys[i]);
+			g_variant_builder_add(&builder, "(s@" PROV_PROVIDERS_APNS_TYPE ")",
+				keys[i], g_variant_new_array(G_VARIANT_TYPE(
+					PROV_PROVIDERS_APN_TYPE), (GVariant**)apns->pdata,
+					apns->len));
+		}
+		root = g_variant_ref_sink(g_variant_new("(u@a"
+			PROV_PROVIDERS_NETWORK_TYPE ")", PROV_PROVIDERS_MAGIC,
+			g_variant_builder_end(&builder)));
+		g_free(keys);
+	}
+	g_markup_parse_context_free(context);
+
+	provisioning_providers_parser_reset_apn(&parser);
+	g_hash_table_destroy(parser.networks);
+	g_ptr_array_free(parser.gsm_networks, TRUE);
+	g_ptr_array_free(parser.gsm_apns, TRUE);
+	g_string_free(parser.text, TRUE);
+	g_free(parser.provider_name);
+	return root;
+}
+
+gboolean
+provisioning_providers_compile_file(
+	const char *xml_file,
+	const char *file,
+	GError **error)
+{
+	gboolean ok = FALSE;
+	char *xml = NULL;
+	gsize len = 0;
+
+	if (g_file_get_contents(xml_file, &xml, &len, error)) {
+		GVariant *root = provisioning_providers_compile(xml, len, error);
+		if (root) {
+			ok = provisioning_file_save(file, root,
+				PROV_PROVIDERS_FILE_MODE, PROV_PROVIDERS_DIR_MODE, error);
+			g_variant_unref(root);
+		}
+		g_free(xml);
+	}
+	return ok;
+}
+
+/*==========================================================================*
+ * Lookup
+ *==========================================================================*/
+
+static
+GVariant *
+provisioning_providers_find_network(
+	GVariant *networks,
+	const char *key)
+{
+	gsize lo = 0, hi = g_variant_n_children(networks);
+
+	/* Children are located through the framing offsets, no copying */
+	while (lo < hi) {
+		const gsize mid = (lo + hi) / 2;
+		GVariant *network = g_variant_get_child_value(networks, mid);
+		const char *mccmnc = NULL;
+		int cmp;
+
+		g_variant_get_child(network, 0, "&s", &mccmnc);
+		cmp = strcmp(key, mccmnc);
+		if (!cmp) {
+			GVariant *apns = g_variant_get_child_value(network, 1);
+			g_variant_unref(network);
+			return apns;
+		}
+		g_variant_unref(network);
+		if (cmp < 0) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	return NULL;
+}
+
+GVariant *
+provisioning_providers_lookup(
+	struct provisioning_providers *providers,
+	const char *imsi)
+{
+	if (providers && provisioning_providers_digits(imsi, 6, 15)) {
+		char key[7];
+		GVariant *apns;
+
+		/* MCC and 3-digit MNC, then 2-digit MNC */
+		memcpy(key, imsi, 6);
+		key[6] = 0;
+		apns = provisioning_providers_find_network(providers->networks, key);
+		if (!apns) {
+			key[5] = 0;
+			apns = provisioning_providers_find_network(providers->networks,
+				key);
+		}
+		return apns;
+	}
+	return NULL;
+}
+
+/*==========================================================================*
+ * Completion
+ *==========================================================================*/
+
+/* Prefers the APN with matching usage. Strings point to the index */
+static
+gboolean
+provisioning_providers_find_apn(
+	GVariant *apns,
+	const char *apn,
+	guint usage,
+	struct provisioning_providers_apn *out)
+{
+	gboolean found = FALSE;
+	GVariantIter it;
+	struct provisioning_providers_apn rec;
+
+	g_variant_iter_init(&it, apns);
+	while (g_variant_iter_next(&it, "(&s&s&s&s&s&syy)", &rec.apn, &rec.name,
+		&rec.username, &rec.password, &rec.mmsc, &rec.mmsproxy,
+		&rec.usage, &rec.auth)) {
+		if (!g_ascii_strcasecmp(rec.apn, apn)) {
+			if (rec.usage & usage) {
+				*out = rec;
+				return TRUE;
+			} else if (!found) {
+				*out = rec;
+				found = TRUE;
+			}
+		}
+	}
+	return found;
+}
+
+static
+gboolean
+provisioning_providers_fill(
+	char **field,
+	const char *value)
+{
+	if (EMPTY(*field) && value[0]) {
+		g_free(*field);
+		*field = g_strdup(value);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+static
+gboolean
+provisioning_providers_fill_auth(
+	char **username,
+	char **password,
+	enum prov_authtype *authtype,
+	const struct provisioning_providers_apn *rec)
+{
+	gboolean changed = FALSE;
+
+	/*
+	 * Don't mix credentials from different sources. The authentication
+	 * method goes together with the credentials it's meant for.
+	 */
+	if (EMPTY(*username) && EMPTY(*password)) {
+		changed |= provisioning_providers_fill(username, rec->username);
+		changed |= provisioning_providers_fill(password, rec->password);
+		if (changed && *authtype == AUTH_UNKNOWN &&
+			rec->auth != AUTH_UNKNOWN) {
+			*authtype = rec->auth;
+		}
+	}
+	return changed;
+}
+
+static
+gboolean
+provisioning_providers_fill_internet(
+	struct provisioning_internet *internet,
+	GVariant *apns)
+{
+	struct provisioning_providers_apn rec;
+	gboolean changed = FALSE;
+
+	if (internet && provisioning_providers_find_apn(apns, internet->apn,
+		PROV_PROVIDERS_USAGE_INTERNET, &rec)) {
+		changed |= provisioning_providers_fill(&internet->name, rec.name);
+		changed |= provisioning_providers_fill_auth(&internet->username,
+			&internet->password, &internet->authtype, &rec);
+	}
+	return changed;
+}
+
+static
+gboolean
+provisioning_providers_fill_mms(
+	struct provisioning_mms *mms,
+	GVariant *apns)
+{
+	struct provisioning_providers_apn rec;
+	gboolean changed = FALSE;
+
+	if (mms && provisioning_providers_find_apn(apns, mms->apn,
+		PROV_PROVIDERS_USAGE_MMS, &rec)) {
+		/* The database has the port as part of the proxy address */
+		const char *colon = strrchr(rec.mmsproxy, ':');
+		const gboolean has_port = colon &&
+			provisioning_providers_digits(colon + 1, 1, 5);
+		char *host = has_port ? g_strndup(rec.mmsproxy, colon -
+			rec.mmsproxy) : g_strdup(rec.mmsproxy);
+		const char *port = has_port ? (colon + 1) : "";
+
+		changed |= provisioning_providers_fill(&mms->name, rec.name);
+		changed |= provisioning_providers_fill_auth(&mms->username,
+			&mms->password, &mms->authtype, &rec);
+		changed |= provisioning_providers_fill(&mms->messagecenter,
+			rec.mmsc);
+		if (EMPTY(mms->messageproxy)) {
+			changed |= provisioning_providers_fill(&mms->messageproxy, host);
+			changed |= provisioning_providers_fill(&mms->portnro, port);
+		} else if (!g_ascii_strcasecmp(mms->messageproxy, host)) {
+			changed |= provisioning_providers_fill(&mms->portnro, port);
+		}
+		g_free(host);
+	}
+	return changed;
+}
+
+static
+struct provisioning_data *
+provisioning_providers_copy(
+	const struct provisioning_data *data)
+{
+	struct provisioning_data *copy = provisioning_data_new();
+
+	if (data->internet) {
+		const struct provisioning_internet *src = data->internet;
+		struct provisioning_internet *dest =
+			g_new0(struct provisioning_internet, 1);
+
+		dest->name = g_strdup(src->name);
+		dest->apn = g_strdup(src->apn);
+		dest->username = g_strdup(src->username);
+		dest->password = g_strdup(src->password);
+		dest->authtype = src->authtype;
+		dest->linked = src->linked;
+		copy->internet = dest;
+	}
+	if (data->mms) {
+		const struct provisioning_mms *src = data->mms;
+		struct provisioning_mms *dest = g_new0(struct provisioning_mms, 1);
+
+		dest->name = g_strdup(src->name);
+		dest->apn = g_strdup(src->apn);
+		dest->username = g_strdup(src->username);
+		dest->password = g_strdup(src->password);
+		dest->messageproxy = g_strdup(src->messageproxy);
+		dest->messagecenter = g_strdup(src->messagecenter);
+		dest->portnro = g_strdup(src->portnro);
+		dest->authtype = src->authtype;
+		dest->linked = src->linked;
+		copy->mms = dest;
+	}
+	return copy;
+}
+
+struct provisioning_data *
+provisioning_providers_complete(
+	struct provisioning_providers *providers,
+	const char *imsi,
+	struct provisioning_data *data)
+{
+	GVariant *apns = data ? provisioning_providers_lookup(providers, imsi) :
+		NULL;
+
+	if (apns) {
+		/* The data may be shared, fill in a copy */
+		struct provisioning_data *copy = provisioning_providers_copy(data);
+		const gboolean internet = provisioning_providers_fill_internet(
+			copy->internet, apns);
+		const gboolean mms = provisioning_providers_fill_mms(copy->mms, apns);
+
+		g_variant_unref(apns);
+		if (internet || mms) {
+			LOG("Completed%s%s settings for %s from the provider database",
+				internet ? " internet" : "", mms ? " MMS" : "", imsi);
+			return copy;
+		}
+		provisioning_data_unref(copy);
+	}
+	return data ? provisioning_data_ref(data) : NULL;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef __PROVPROVIDERS_H
+#define __PROVPROVIDERS_H
+
+#include "provisioning-decoder.h"
+
+/*
+ * Access point settings from mobile-broadband-provider-info, used to fill
+ * in what the push message has left out. The XML is compiled in advance
+ * (see --compile-providers) into an index sorted by MCC+MNC, which is a
+ * serialized GVariant mapped into memory and searched in place.
+ */
+struct provisioning_providers;
+
+enum provisioning_providers_usage {
+	PROV_PROVIDERS_USAGE_INTERNET = 0x01,
+	PROV_PROVIDERS_USAGE_MMS = 0x02
+};
+
+/* Returns NULL if the file doesn't exist or can't be used */
+struct provisioning_providers *
+provisioning_providers_new(
+	const char *file);
+
+void
+provisioning_providers_free(
+	struct provisioning_providers *providers);
+
+/*
+ * Compiles serviceproviders.xml into the index. Only GSM networks and
+ * their APNs are picked up. Returns a new reference or NULL.
+ */
+GVariant *
+provisioning_providers_compile(
+	const char *xml,
+	gsize len,
+	GError **error);
+
+/* Same as above, from file to file. Replaces the index atomically */
+gboolean
+provisioning_providers_compile_file(
+	const char *xml_file,
+	const char *file,
+	GError **error);
+
+/*
+ * APNs of the network the IMSI belongs to, as a(ssssssyy) array of APN,
+ * name, username, password, MMSC, MMS proxy, usage mask and auth type.
+ * The MNC length isn't known, so the 3-digit MNC is tried first. Returns
+ * a new reference or NULL.
+ */
+GVariant *
+provisioning_providers_lookup(
+	struct provisioning_providers *providers,
+	const char *imsi);
+
+/*
+ * Fills in the settings missing from the contexts whose APN is known to
+ * the database. Contexts aren't added, credentials are only taken if
+ * the context has neither username nor password. Returns a new reference,
+ * to the same data if there was nothing to add.
+ */
+struct provisioning_data *
+provisioning_providers_complete(
+	struct provisioning_providers *providers,
+	const char *imsi,
+	struct provisioning_data *data);
+
+#endif /* __PROVPROVIDERS_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,135 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "provisioning-ratelimit.h"
+
+struct provisioning_ratelimit {
+	GHashTable *buckets;        /* key => gint64 time when it's full */
+	gint64 interval;            /* One token, usec */
+	gint64 depth;               /* Whole bucket, usec */
+};
+
+struct provisioning_ratelimit *
+provisioning_ratelimit_new(
+	guint burst,
+	guint per_minute)
+{
+	struct provisioning_ratelimit *limit =
+		g_new0(struct provisioning_ratelimit, 1);
+
+	if (per_minute) {
+		limit->interval = 60 * G_USEC_PER_SEC / per_minute;
+		limit->depth = limit->interval * MAX(burst, 1);
+		limit->buckets = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, g_free);
+	}
+	return limit;
+}
+
+void
+provisioning_ratelimit_free(
+	struct provisioning_ratelimit *limit)
+{
+	if (limit) {
+		if (limit->buckets) {
+			g_hash_table_destroy(limit->buckets);
+		}
+		g_free(limit);
+	}
+}
+
+static
+gboolean
+provisioning_ratelimit_full(
+	gpointer key,
+	gpointer value,
+	gpointer now)
+{
+	return *(gint64*)value <= *(gint64*)now;
+}
+
+/* Makes room for another key, FALSE if there's none */
+static
+gboolean
+provisioning_ratelimit_room(
+	struct provisioning_ratelimit *limit,
+	gint64 now)
+{
+	if (g_hash_table_size(limit->buckets) >= PROV_RATELIMIT_MAX_KEYS) {
+		/* Full buckets don't need to be remembered */
+		g_hash_table_foreach_remove(limit->buckets,
+			provisioning_ratelimit_full, &now);
+	}
+	return g_hash_table_size(limit->buckets) < PROV_RATELIMIT_MAX_KEYS;
+}
+
+guint
+provisioning_ratelimit_delay(
+	struct provisioning_ratelimit *limit,
+	const char *key,
+	gint64 now)
+{
+	if (limit && limit->buckets) {
+		const gint64 *full = g_hash_table_lookup(limit->buckets, key);
+		gint64 usec;
+
+		if (full) {
+			/* What it would be after taking a token */
+			usec = MAX(*full, now) + limit->interval - limit->depth - now;
+		} else if (provisioning_ratelimit_room(limit, now)) {
+			usec = 0;
+		} else {
+			/* Too many keys, newcomers have to wait */
+			usec = limit->interval;
+		}
+		if (usec > 0) {
+			return (guint)MIN((usec + 999) / 1000, G_MAXUINT);
+		}
+	}
+	return 0;
+}
+
+void
+provisioning_ratelimit_take(
+	struct provisioning_ratelimit *limit,
+	const char *key,
+	gint64 now)
+{
+	if (limit && limit->buckets) {
+		gint64 *full = g_hash_table_lookup(limit->buckets, key);
+
+		if (full) {
+			*full = MAX(*full, now) + limit->interval;
+		} else if (provisioning_ratelimit_room(limit, now)) {
+			full = g_new(gint64, 1);
+			*full = now + limit->interval;
+			g_hash_table_insert(limit->buckets, g_strdup(key), full);
+		}
+	}
+}
+
+guint
+provisioning_ratelimit_size(
+	struct provisioning_ratelimit *limit)
+{
+	return (limit && limit->buckets) ? g_hash_table_size(limit->buckets) : 0;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
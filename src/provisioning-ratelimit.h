@@ -0,0 +1,73 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef __PROVRATELIMIT_H
+#define __PROVRATELIMIT_H
+
+#include <glib.h>
+
+/*
+ * Token buckets keyed by a string, e.g. the sender or the IMSI. Each
+ * key may go up to burst messages at once, after that it gets one
+ * more every 60/per_minute seconds. Times are g_get_monotonic_time()
+ * values, passed in by the caller.
+ *
+ * A bucket is a single timestamp (the time when it's going to be full
+ * again), full buckets are forgotten as soon as there's too many keys.
+ */
+struct provisioning_ratelimit;
+
+/* Upper bound for the number of keys being tracked */
+#ifndef PROV_RATELIMIT_MAX_KEYS
+#  define PROV_RATELIMIT_MAX_KEYS (256)
+#endif
+
+/* Zero per_minute disables the limit */
+struct provisioning_ratelimit *
+provisioning_ratelimit_new(
+	guint burst,
+	guint per_minute);
+
+void
+provisioning_ratelimit_free(
+	struct provisioning_ratelimit *limit);
+
+/* Milliseconds until the key gets a token, zero if it has one now */
+guint
+provisioning_ratelimit_delay(
+	struct provisioning_ratelimit *limit,
+	const char *key,
+	gint64 now);
+
+/* Takes a token, should only be called if the delay is zero */
+void
+provisioning_ratelimit_take(
+	struct provisioning_ratelimit *limit,
+	const char *key,
+	gint64 now);
+
+/* Number of keys being tracked */
+guint
+provisioning_ratelimit_size(
+	struct provisioning_ratelimit *limit);
+
+#endif /* __PROVRATELIMIT_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
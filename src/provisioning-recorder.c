@@ -0,0 +1,463 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "provisioning-recorder.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PROV_RECORDER_SIZE 512      /* entries */
+#define PROV_RECORDER_MAX_ARGS 8
+#define PROV_RECORDER_STRINGS 120   /* bytes per entry */
+#define PROV_RECORDER_MAX_SPEC 32
+
+enum provisioning_recorder_type {
+	PROV_ARG_NONE,                  /* %% or something we don't know */
+	PROV_ARG_INT,
+	PROV_ARG_UINT,
+	PROV_ARG_CHAR,
+	PROV_ARG_DOUBLE,
+	PROV_ARG_STRING,
+	PROV_ARG_POINTER,
+	PROV_ARG_SKIP                   /* %n */
+};
+
+enum provisioning_recorder_length {
+	PROV_LEN_DEFAULT,
+	PROV_LEN_CHAR,
+	PROV_LEN_SHORT,
+	PROV_LEN_LONG,
+	PROV_LEN_LLONG,
+	PROV_LEN_SIZE,
+	PROV_LEN_INTMAX,
+	PROV_LEN_PTRDIFF,
+	PROV_LEN_LDOUBLE
+};
+
+struct provisioning_recorder_spec {
+	const char *end;                /* Past the conversion character */
+	int stars;                      /* Width and precision from args */
+	enum provisioning_recorder_type type;
+	enum provisioning_recorder_length length;
+};
+
+union provisioning_recorder_arg {
+	gint64 i;
+	double d;
+	gsize s;                        /* String offset or pointer */
+};
+
+struct provisioning_recorder_entry {
+	volatile gint seq;              /* Position + 1, zero while writing */
+	guint8 nargs;
+	guint8 truncated;
+	guint8 used;
+	gint64 time;
+	const char *format;
+	union provisioning_recorder_arg args[PROV_RECORDER_MAX_ARGS];
+	char strings[PROV_RECORDER_STRINGS];
+};
+
+static struct provisioning_recorder_entry
+	provisioning_recorder_entries[PROV_RECORDER_SIZE];
+static volatile gint provisioning_recorder_next;
+static volatile gint provisioning_recorder_dumped;
+
+/* Parses the conversion specification starting at '%' */
+static
+void
+provisioning_recorder_parse(
+	const char *p,
+	struct provisioning_recorder_spec *spec)
+{
+	memset(spec, 0, sizeof(*spec));
+	p++;
+	while (*p && strchr("-+ #0'", *p)) p++;
+	if (*p == '*') {
+		spec->stars++;
+		p++;
+	} else {
+		while (g_ascii_isdigit(*p)) p++;
+	}
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->stars++;
+			p++;
+		} else {
+			while (g_ascii_isdigit(*p)) p++;
+		}
+	}
+	switch (*p) {
+	case 'h':
+		if (*++p == 'h') {
+			spec->length = PROV_LEN_CHAR;
+			p++;
+		} else {
+			spec->length = PROV_LEN_SHORT;
+		}
+		break;
+	case 'l':
+		if (*++p == 'l') {
+			spec->length = PROV_LEN_LLONG;
+			p++;
+		} else {
+			spec->length = PROV_LEN_LONG;
+		}
+		break;
+	case 'q':
+		spec->length = PROV_LEN_LLONG;
+		p++;
+		break;
+	case 'L':
+		spec->length = PROV_LEN_LDOUBLE;
+		p++;
+		break;
+	case 'z':
+		spec->length = PROV_LEN_SIZE;
+		p++;
+		break;
+	case 'j':
+		spec->length = PROV_LEN_INTMAX;
+		p++;
+		break;
+	case 't':
+		spec->length = PROV_LEN_PTRDIFF;
+		p++;
+		break;
+	}
+	switch (*p) {
+	case 'd':
+	case 'i':
+		spec->type = PROV_ARG_INT;
+		break;
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+		spec->type = PROV_ARG_UINT;
+		break;
+	case 'c':
+		spec->type = PROV_ARG_CHAR;
+		break;
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		spec->type = PROV_ARG_DOUBLE;
+		break;
+	case 's':
+		spec->type = PROV_ARG_STRING;
+		break;
+	case 'p':
+		spec->type = PROV_ARG_POINTER;
+		break;
+	case 'n':
+		spec->type = PROV_ARG_SKIP;
+		break;
+	default:
+		spec->type = PROV_ARG_NONE;
+		spec->stars = 0;
+		break;
+	}
+	spec->end = *p ? (p + 1) : p;
+}
+
+static
+gint64
+provisioning_recorder_int_arg(
+	enum provisioning_recorder_length length,
+	va_list *args)
+{
+	switch (length) {
+	case PROV_LEN_CHAR: return (signed char)va_arg(*args, int);
+	case PROV_LEN_SHORT: return (short)va_arg(*args, int);
+	case PROV_LEN_LONG: return va_arg(*args, long);
+	case PROV_LEN_LLONG: return va_arg(*args, long long);
+	case PROV_LEN_SIZE: return va_arg(*args, gssize);
+	case PROV_LEN_INTMAX: return va_arg(*args, intmax_t);
+	case PROV_LEN_PTRDIFF: return va_arg(*args, ptrdiff_t);
+	default: return va_arg(*args, int);
+	}
+}
+
+static
+guint64
+provisioning_recorder_uint_arg(
+	enum provisioning_recorder_length length,
+	va_list *args)
+{
+	switch (length) {
+	case PROV_LEN_CHAR: return (unsigned char)va_arg(*args, unsigned int);
+	case PROV_LEN_SHORT: return (unsigned short)va_arg(*args, unsigned int);
+	case PROV_LEN_LONG: return va_arg(*args, unsigned long);
+	case PROV_LEN_LLONG: return va_arg(*args, unsigned long long);
+	case PROV_LEN_SIZE: return va_arg(*args, gsize);
+	case PROV_LEN_INTMAX: return va_arg(*args, uintmax_t);
+	case PROV_LEN_PTRDIFF: return va_arg(*args, ptrdiff_t);
+	default: return va_arg(*args, unsigned int);
+	}
+}
+
+static
+gsize
+provisioning_recorder_copy_string(
+	struct provisioning_recorder_entry *entry,
+	const char *str)
+{
+	const gsize offset = entry->used;
+	const gsize avail = PROV_RECORDER_STRINGS - offset;
+
+	if (!str) str = "(null)";
+	if (avail > 0) {
+		/* Long strings get truncated */
+		const gsize len = MIN(strlen(str), avail - 1);
+		memcpy(entry->strings + offset, str, len);
+		entry->strings[offset + len] = 0;
+		entry->used += len + 1;
+		return offset;
+	} else {
+		/* Points to the terminating NULL of the previous string */
+		return PROV_RECORDER_STRINGS - 1;
+	}
+}
+
+void
+provisioning_recorder_addv(
+	const char *format,
+	va_list args)
+{
+	const guint pos = (guint)g_atomic_int_add(&provisioning_recorder_next, 1);
+	struct provisioning_recorder_entry *entry = provisioning_recorder_entries +
+		(pos % PROV_RECORDER_SIZE);
+	const char *p = format;
+	va_list va;
+
+	g_atomic_int_set(&entry->seq, 0);
+	entry->time = g_get_monotonic_time();
+	entry->format = format;
+	entry->nargs = 0;
+	entry->truncated = FALSE;
+	entry->used = 0;
+	entry->strings[PROV_RECORDER_STRINGS - 1] = 0;
+
+	G_VA_COPY(va, args);
+	while ((p = strchr(p, '%')) != NULL) {
+		struct provisioning_recorder_spec spec;
+		union provisioning_recorder_arg *arg;
+		int i;
+
+		provisioning_recorder_parse(p, &spec);
+		p = spec.end;
+		if (spec.type == PROV_ARG_NONE) {
+			continue;
+		}
+		if (entry->nargs + spec.stars + 1 > PROV_RECORDER_MAX_ARGS) {
+			/* The rest of the message is lost */
+			entry->truncated = TRUE;
+			break;
+		}
+		for (i = 0; i < spec.stars; i++) {
+			entry->args[entry->nargs++].i = va_arg(va, int);
+		}
+		arg = entry->args + (entry->nargs++);
+		switch (spec.type) {
+		case PROV_ARG_INT:
+			arg->i = provisioning_recorder_int_arg(spec.length, &va);
+			break;
+		case PROV_ARG_UINT:
+			arg->i = (gint64)provisioning_recorder_uint_arg(spec.length, &va);
+			break;
+		case PROV_ARG_CHAR:
+			arg->i = va_arg(va, int);
+			break;
+		case PROV_ARG_DOUBLE:
+			arg->d = (spec.length == PROV_LEN_LDOUBLE) ?
+				(double)va_arg(va, long double) :
+				va_arg(va, double);
+			break;
+		case PROV_ARG_STRING:
+			arg->s = provisioning_recorder_copy_string(entry,
+				va_arg(va, const char*));
+			break;
+		case PROV_ARG_POINTER:
+		case PROV_ARG_SKIP:
+			arg->s = (gsize)va_arg(va, void*);
+			break;
+		case PROV_ARG_NONE:
+			break;
+		}
+	}
+	va_end(va);
+	g_atomic_int_set(&entry->seq, pos + 1);
+}
+
+void
+provisioning_recorder_add(
+	const char *format,
+	...)
+{
+	va_list args;
+	va_start(args, format);
+	provisioning_recorder_addv(format, args);
+	va_end(args);
+}
+
+static
+void
+provisioning_recorder_render(
+	GString *buf,
+	const struct provisioning_recorder_entry *entry)
+{
+	const char *p = entry->format;
+	const char *pct;
+	int argno = 0;
+
+	while ((pct = strchr(p, '%')) != NULL) {
+		struct provisioning_recorder_spec spec;
+		const union provisioning_recorder_arg *arg;
+		char fmt[PROV_RECORDER_MAX_SPEC];
+		const char *s;
+		gsize n = 0;
+
+		g_string_append_len(buf, p, pct - p);
+		provisioning_recorder_parse(pct, &spec);
+		p = spec.end;
+		if (spec.type == PROV_ARG_NONE) {
+			if (p == pct + 2 && pct[1] == '%') {
+				g_string_append_c(buf, '%');
+			} else {
+				g_string_append_len(buf, pct, p - pct);
+			}
+			continue;
+		}
+		if (argno + spec.stars + 1 > entry->nargs) {
+			g_string_append(buf, "...");
+			return;
+		}
+
+		/* Rebuild the specification with a known length modifier */
+		for (s = pct; s < (p - 1) && n < (sizeof(fmt) - 16); s++) {
+			if (*s == '*') {
+				n += g_snprintf(fmt + n, sizeof(fmt) - n, "%d",
+					(int)entry->args[argno++].i);
+			} else if (!strchr("hlLqjzt", *s)) {
+				fmt[n++] = *s;
+			}
+		}
+		if ((spec.type == PROV_ARG_INT || spec.type == PROV_ARG_UINT)) {
+			fmt[n++] = 'l';
+			fmt[n++] = 'l';
+		}
+		fmt[n++] = p[-1];
+		fmt[n] = 0;
+
+		arg = entry->args + (argno++);
+		switch (spec.type) {
+		case PROV_ARG_INT:
+			g_string_append_printf(buf, fmt, (long long)arg->i);
+			break;
+		case PROV_ARG_UINT:
+			g_string_append_printf(buf, fmt, (unsigned long long)arg->i);
+			break;
+		case PROV_ARG_CHAR:
+			g_string_append_printf(buf, fmt, (int)arg->i);
+			break;
+		case PROV_ARG_DOUBLE:
+			g_string_append_printf(buf, fmt, arg->d);
+			break;
+		case PROV_ARG_STRING:
+			g_string_append_printf(buf, fmt, entry->strings + arg->s);
+			break;
+		case PROV_ARG_POINTER:
+			g_string_append_printf(buf, fmt, (void*)arg->s);
+			break;
+		case PROV_ARG_SKIP:
+		case PROV_ARG_NONE:
+			break;
+		}
+	}
+	g_string_append(buf, p);
+	if (entry->truncated) {
+		g_string_append(buf, "...");
+	}
+}
+
+guint
+provisioning_recorder_dump(
+	gboolean all,
+	provisioning_recorder_func fn,
+	void *user_data)
+{
+	const guint next = (guint)g_atomic_int_get(&provisioning_recorder_next);
+	const gint64 now = g_get_monotonic_time();
+	guint first = (next > PROV_RECORDER_SIZE) ? (next - PROV_RECORDER_SIZE) : 0;
+	GString *buf = g_string_new(NULL);
+	guint pos, count = 0;
+
+	if (!all) {
+		const guint dumped = (guint)
+			g_atomic_int_get(&provisioning_recorder_dumped);
+		if (dumped > first) {
+			first = dumped;
+		}
+	}
+	g_atomic_int_set(&provisioning_recorder_dumped, next);
+	for (pos = first; pos != next; pos++) {
+		const struct provisioning_recorder_entry *entry =
+			provisioning_recorder_entries + (pos % PROV_RECORDER_SIZE);
+		struct provisioning_recorder_entry copy;
+		gint64 age;
+
+		/* Skip entries which are being written or have been reused */
+		if ((guint)g_atomic_int_get(&entry->seq) != pos + 1) {
+			continue;
+		}
+		memcpy(&copy, entry, sizeof(copy));
+		if ((guint)g_atomic_int_get(&entry->seq) != pos + 1) {
+			continue;
+		}
+		copy.strings[PROV_RECORDER_STRINGS - 1] = 0;
+		age = MAX(now - copy.time, 0);
+		g_string_printf(buf, "[-%u.%03u] ", (guint)(age / G_USEC_PER_SEC),
+			(guint)((age % G_USEC_PER_SEC) / 1000));
+		provisioning_recorder_render(buf, &copy);
+		fn(buf->str, user_data);
+		count++;
+	}
+	g_string_free(buf, TRUE);
+	return count;
+}
+
+void
+provisioning_recorder_clear(void)
+{
+	memset(provisioning_recorder_entries, 0,
+		sizeof(provisioning_recorder_entries));
+	g_atomic_int_set(&provisioning_recorder_next, 0);
+	g_atomic_int_set(&provisioning_recorder_dumped, 0);
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
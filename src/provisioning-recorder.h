@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef __PROVRECORDER_H
+#define __PROVRECORDER_H
+
+#include <glib.h>
+#include <stdarg.h>
+
+/*
+ * Flight recorder. Keeps the last few hundred debug messages in a fixed
+ * size ring without formatting them. Only the format pointer (which must
+ * be a string literal) and the arguments are stored, strings are copied.
+ * Formatting happens when the ring is dumped.
+ */
+
+typedef void (*provisioning_recorder_func)(const char *line, void *user_data);
+
+void
+provisioning_recorder_addv(
+	const char *format,
+	va_list args);
+
+void
+provisioning_recorder_add(
+	const char *format,
+	...) G_GNUC_PRINTF(1,2);
+
+/*
+ * Renders the recorded messages, oldest first. Unless all is TRUE,
+ * only those recorded since the previous dump are rendered. Returns
+ * the number of lines passed to the callback.
+ */
+guint
+provisioning_recorder_dump(
+	gboolean all,
+	provisioning_recorder_func fn,
+	void *user_data);
+
+void
+provisioning_recorder_clear(void);
+
+#endif /* __PROVRECORDER_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
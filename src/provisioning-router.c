@@ -0,0 +1,1807 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "provisioning-router.h"
+#include "provisioning-batch.h"
+#include "provisioning-ofono.h"
+#include "provisioning-recorder.h"
+#include "log.h"
+
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SIGNAL_PROVISIONING_RESULT "ProvisioningResult"
+#define SIGNAL_BATCH_RESULT "ProvisioningBatchResult"
+#define SIGNAL_APN_RESULT "apnProvisioningResult"
+#define SIGNAL_APN_FAILED "apnProvisioningFailed"
+
+struct provisioning_worker {
+	struct provisioning_router *router;
+	guint index;
+	GSubprocess *proc;
+	GDBusConnection *conn;
+	guint signal_id;
+	gulong closed_id;
+	guint restart_id;
+	guint restarts;
+	guint last_txid;                /* Highest one we have seen */
+	guint tx_calls;                 /* Calls whose reply has txids */
+	GHashTable *early;              /* txid => result without a tx yet */
+};
+
+/* HandleSharedProvisioningMessage as seen by its caller */
+struct provisioning_router_batch {
+	guint id;
+	char *sender;
+	guint count;
+	guint finished;
+	guint results[PROV_FAILURE + 1];
+	gboolean replied;
+};
+
+/* Transaction running in one of the workers */
+struct provisioning_router_tx {
+	char *sender;
+	char *imsi;
+	guint worker;
+	struct provisioning_router_batch *batch;
+	GVariant *result;               /* Arrived before the reply */
+	gboolean replied;
+};
+
+struct provisioning_router {
+	char **argv;
+	char *error_busy;
+	GDBusServer *server;
+	GDBusAuthObserver *observer;
+	GCancellable *cancel;
+	struct provisioning_worker *workers;
+	guint count;
+	guint connected;
+	gboolean ready;
+	gboolean busy;
+	GDBusConnection *bus;
+	char *path;
+	char *iface;
+	guint object_id;
+	GHashTable *txs;                /* txid => provisioning_router_tx */
+	guint calls;                    /* Forwarded calls in flight */
+	guint last_batch;
+	guint next_worker;              /* Round robin for decoding */
+	const struct provisioning_router_callbacks *cb;
+	void *param;
+};
+
+/* Call forwarded to one worker */
+struct provisioning_router_call {
+	struct provisioning_router *router;
+	GDBusMethodInvocation *call;
+	guint worker;
+	char *imsi;                     /* Set if the reply is a txid */
+	gboolean no_reply_args;         /* Caller doesn't get the txid */
+};
+
+/*
+ * Call split between the workers, e.g. a batch of messages. Each part
+ * carries the positions of its entries in the original call.
+ */
+struct provisioning_router_split {
+	struct provisioning_router *router;
+	GDBusMethodInvocation *call;
+	GVariant *args;
+	guint pending;
+	guint count;
+	GVariant **results;             /* Per entry or per worker */
+	GError *error;
+	struct provisioning_router_batch *batch;
+};
+
+struct provisioning_router_part {
+	struct provisioning_router_split *split;
+	guint worker;
+	GArray *index;                  /* guint */
+};
+
+static
+void
+provisioning_worker_start(
+	struct provisioning_worker *worker);
+
+guint
+provisioning_router_shard(
+	const char *imsi,
+	guint workers)
+{
+	/* FNV-1a, which unlike g_str_hash() is never going to change */
+	guint32 hash = 2166136261U;
+
+	if (imsi) {
+		const guchar *p;
+
+		for (p = (const guchar*)imsi; *p; p++) {
+			hash = (hash ^ *p) * 16777619U;
+		}
+	}
+	return workers ? (hash % workers) : 0;
+}
+
+static
+void
+provisioning_router_update_busy(
+	struct provisioning_router *router)
+{
+	const gboolean busy = router->calls || g_hash_table_size(router->txs);
+
+	if (router->busy != busy) {
+		router->busy = busy;
+		if (busy) {
+			if (router->cb->busy) router->cb->busy(router->param);
+		} else {
+			if (router->cb->idle) router->cb->idle(router->param);
+		}
+	}
+}
+
+gboolean
+provisioning_router_busy(
+	struct provisioning_router *router)
+{
+	return router && router->busy;
+}
+
+static
+void
+provisioning_router_return_busy(
+	struct provisioning_router *router,
+	GDBusMethodInvocation *call)
+{
+	char *msg = g_strdup_printf("Busy, retry after %u ms",
+		PROV_ROUTER_RESTART_MS);
+
+	g_dbus_method_invocation_return_dbus_error(call, router->error_busy, msg);
+	g_free(msg);
+}
+
+/* Passes the error of a forwarded call to our caller as is */
+static
+void
+provisioning_router_return_error(
+	GDBusMethodInvocation *call,
+	GError *error)
+{
+	char *name = g_dbus_error_get_remote_error(error);
+
+	if (name) {
+		g_dbus_error_strip_remote_error(error);
+		g_dbus_method_invocation_return_dbus_error(call, name,
+			error->message);
+		g_free(name);
+	} else {
+		g_dbus_method_invocation_return_gerror(call, error);
+	}
+}
+
+static
+struct provisioning_router_batch *
+provisioning_router_batch_new(
+	struct provisioning_router *router,
+	const char *sender,
+	guint count)
+{
+	struct provisioning_router_batch *batch =
+		g_new0(struct provisioning_router_batch, 1);
+	const guint step = router->count + 1;
+
+	/* Workers take the other slots of the ID space, see main.c */
+	batch->id = (router->last_batch++) * step + 1;
+	if (!batch->id) {
+		batch->id = (router->last_batch++) * step + 1;
+	}
+	batch->sender = g_strdup(sender);
+	batch->count = count;
+	return batch;
+}
+
+static
+void
+provisioning_router_batch_free(
+	struct provisioning_router_batch *batch)
+{
+	g_free(batch->sender);
+	g_free(batch);
+}
+
+/* The result is reported after the reply, like the service does it */
+static
+void
+provisioning_router_batch_check(
+	struct provisioning_router *router,
+	struct provisioning_router_batch *batch)
+{
+	if (batch->replied && batch->finished == batch->count) {
+		LOG("Batch %u done %u/%u/%u", batch->id,
+			batch->results[PROV_SUCCESS],
+			batch->results[PROV_PARTIAL_SUCCESS],
+			batch->results[PROV_FAILURE]);
+		if (router->bus) {
+			g_dbus_connection_emit_signal(router->bus, batch->sender,
+				router->path, router->iface, SIGNAL_BATCH_RESULT,
+				g_variant_new("(uuuu)", batch->id,
+				batch->results[PROV_SUCCESS],
+				batch->results[PROV_PARTIAL_SUCCESS],
+				batch->results[PROV_FAILURE]), NULL);
+		}
+		provisioning_router_batch_free(batch);
+	}
+}
+
+static
+void
+provisioning_router_batch_done(
+	struct provisioning_router *router,
+	struct provisioning_router_batch *batch,
+	guint result,
+	guint n)
+{
+	batch->results[MIN(result, PROV_FAILURE)] += n;
+	batch->finished += n;
+	provisioning_router_batch_check(router, batch);
+}
+
+static
+void
+provisioning_router_tx_free(
+	gpointer data)
+{
+	struct provisioning_router_tx *tx = data;
+
+	if (tx->result) {
+		g_variant_unref(tx->result);
+	}
+	g_free(tx->sender);
+	g_free(tx->imsi);
+	g_free(tx);
+}
+
+static
+void
+provisioning_router_tx_add(
+	struct provisioning_router *router,
+	guint txid,
+	guint worker,
+	const char *sender,
+	const char *imsi,
+	struct provisioning_router_batch *batch)
+{
+	struct provisioning_router_tx *tx = g_new0(struct provisioning_router_tx,
+		1);
+	struct provisioning_worker *w = router->workers + worker;
+	gpointer key = GUINT_TO_POINTER(txid);
+
+	w->last_txid = MAX(w->last_txid, txid);
+	tx->sender = g_strdup(sender);
+	tx->imsi = g_strdup(imsi);
+	tx->worker = worker;
+	tx->batch = batch;
+	if (w->early && g_hash_table_steal_extended(w->early, key, NULL,
+		(gpointer*)&tx->result)) {
+		GDEBUG("Transaction %u has finished before the reply", txid);
+	}
+	g_hash_table_replace(router->txs, key, tx);
+}
+
+/* Removes the transaction, and updates its batch (if any) */
+static
+void
+provisioning_router_tx_done(
+	struct provisioning_router *router,
+	guint txid,
+	guint result)
+{
+	gpointer key = GUINT_TO_POINTER(txid);
+	struct provisioning_router_tx *tx = g_hash_table_lookup(router->txs, key);
+
+	if (tx) {
+		struct provisioning_router_batch *batch = tx->batch;
+
+		g_hash_table_remove(router->txs, key);
+		if (batch) {
+			provisioning_router_batch_done(router, batch, result, 1);
+		}
+	}
+}
+
+/* Passes ProvisioningResult to the caller, and removes the transaction */
+static
+void
+provisioning_router_tx_result(
+	struct provisioning_router *router,
+	guint txid,
+	GVariant *args)
+{
+	const struct provisioning_router_tx *tx =
+		g_hash_table_lookup(router->txs, GUINT_TO_POINTER(txid));
+	guint result = PROV_FAILURE;
+
+	g_variant_get(args, "(u&s&suuuu)", NULL, NULL, NULL, &result,
+		NULL, NULL, NULL);
+	if (tx->sender && router->bus) {
+		g_dbus_connection_emit_signal(router->bus, tx->sender,
+			router->path, router->iface, SIGNAL_PROVISIONING_RESULT, args,
+			NULL);
+	}
+	provisioning_router_tx_done(router, txid, result);
+}
+
+/*
+ * Our caller has got the transaction ID. Its result, if the worker has
+ * already sent it, can be passed on now.
+ */
+static
+void
+provisioning_router_tx_replied(
+	struct provisioning_router *router,
+	guint txid)
+{
+	struct provisioning_router_tx *tx =
+		g_hash_table_lookup(router->txs, GUINT_TO_POINTER(txid));
+
+	if (tx && !tx->replied) {
+		tx->replied = TRUE;
+		if (tx->result) {
+			GVariant *args = tx->result;
+
+			tx->result = NULL;
+			provisioning_router_tx_result(router, txid, args);
+			g_variant_unref(args);
+		}
+	}
+}
+
+/*
+ * The worker replies before it starts a transaction, but the reply and
+ * the result come through different paths and the result may get here
+ * first. Until all calls which return txids have been replied, results
+ * for unknown transactions are kept.
+ */
+static
+void
+provisioning_worker_tx_call_start(
+	struct provisioning_worker *worker)
+{
+	worker->tx_calls++;
+}
+
+static
+void
+provisioning_worker_tx_call_done(
+	struct provisioning_worker *worker)
+{
+	if (!--worker->tx_calls && worker->early) {
+		g_hash_table_remove_all(worker->early);
+	}
+}
+
+/* Reports the transactions of the worker which has gone as failed */
+static
+void
+provisioning_router_fail_txs(
+	struct provisioning_router *router,
+	guint worker)
+{
+	GHashTableIter it;
+	gpointer key, value;
+	GArray *failed = g_array_new(FALSE, FALSE, sizeof(guint));
+	guint i;
+
+	g_hash_table_iter_init(&it, router->txs);
+	while (g_hash_table_iter_next(&it, &key, &value)) {
+		struct provisioning_router_tx *tx = value;
+
+		if (tx->worker == worker && !tx->result) {
+			const guint txid = GPOINTER_TO_UINT(key);
+
+			if (tx->replied) {
+				g_array_append_val(failed, txid);
+			} else {
+				/* Reported when the caller has the txid */
+				tx->result = g_variant_ref_sink(g_variant_new("(ussuuuu)",
+					txid, tx->imsi, "", PROV_FAILURE, 0, 0, 0));
+			}
+			if (router->bus) {
+				g_dbus_connection_emit_signal(router->bus, NULL,
+					router->path, router->iface, SIGNAL_APN_RESULT,
+					g_variant_new("(ssuuuu)", tx->imsi, "", PROV_FAILURE,
+					0, 0, 0), NULL);
+				g_dbus_connection_emit_signal(router->bus, NULL,
+					router->path, router->iface, SIGNAL_APN_FAILED,
+					g_variant_new("(ss)", tx->imsi, ""), NULL);
+				if (tx->sender && tx->replied) {
+					g_dbus_connection_emit_signal(router->bus, tx->sender,
+						router->path, router->iface,
+						SIGNAL_PROVISIONING_RESULT,
+						g_variant_new("(ussuuuu)", txid, tx->imsi, "",
+						PROV_FAILURE, 0, 0, 0), NULL);
+				}
+			}
+		}
+	}
+	if (failed->len) {
+		GWARN("Worker %u took %u transaction(s) with it", worker, failed->len);
+	}
+	if (router->workers[worker].early) {
+		g_hash_table_remove_all(router->workers[worker].early);
+	}
+	for (i = 0; i < failed->len; i++) {
+		provisioning_router_tx_done(router, g_array_index(failed, guint, i),
+			PROV_FAILURE);
+	}
+	g_array_free(failed, TRUE);
+}
+
+/* ==========================================================================*
+ * Signals from the workers
+ * ==========================================================================*/
+
+static
+void
+provisioning_router_signal(
+	GDBusConnection *conn,
+	const char *sender,
+	const char *path,
+	const char *iface,
+	const char *name,
+	GVariant *args,
+	gpointer user_data)
+{
+	struct provisioning_worker *worker = user_data;
+	struct provisioning_router *router = worker->router;
+
+	if (!strcmp(name, SIGNAL_PROVISIONING_RESULT)) {
+		guint txid = 0;
+		struct provisioning_router_tx *tx;
+
+		g_variant_get(args, "(u&s&suuuu)", &txid, NULL, NULL, NULL,
+			NULL, NULL, NULL);
+		tx = g_hash_table_lookup(router->txs, GUINT_TO_POINTER(txid));
+		if (tx) {
+			if (tx->replied) {
+				provisioning_router_tx_result(router, txid, args);
+				provisioning_router_update_busy(router);
+			} else if (!tx->result) {
+				tx->result = g_variant_ref(args);
+			}
+		} else if (worker->tx_calls) {
+			if (!worker->early) {
+				worker->early = g_hash_table_new_full(g_direct_hash,
+					g_direct_equal, NULL, (GDestroyNotify)g_variant_unref);
+			}
+			g_hash_table_replace(worker->early, GUINT_TO_POINTER(txid),
+				g_variant_ref(args));
+		}
+	} else if (!strcmp(name, SIGNAL_BATCH_RESULT)) {
+		/* Batches are counted here, workers only see parts of them */
+	} else if (router->bus) {
+		g_dbus_connection_emit_signal(router->bus, NULL, router->path,
+			router->iface, name, args, NULL);
+	}
+}
+
+/* ==========================================================================*
+ * Workers
+ * ==========================================================================*/
+
+static
+void
+provisioning_worker_disconnect(
+	struct provisioning_worker *worker)
+{
+	if (worker->conn) {
+		struct provisioning_router *router = worker->router;
+
+		g_dbus_connection_signal_unsubscribe(worker->conn, worker->signal_id);
+		g_signal_handler_disconnect(worker->conn, worker->closed_id);
+		g_dbus_connection_close(worker->conn, NULL, NULL, NULL);
+		g_object_unref(worker->conn);
+		worker->conn = NULL;
+		worker->signal_id = 0;
+		worker->closed_id = 0;
+		router->connected--;
+		provisioning_router_fail_txs(router, worker->index);
+		provisioning_router_update_busy(router);
+	}
+}
+
+static
+void
+provisioning_worker_closed(
+	GDBusConnection *conn,
+	gboolean remote_peer_vanished,
+	GError *error,
+	gpointer user_data)
+{
+	struct provisioning_worker *worker = user_data;
+
+	GWARN("Worker %u disconnected", worker->index);
+	provisioning_worker_disconnect(worker);
+}
+
+static
+gboolean
+provisioning_worker_restart(
+	gpointer user_data)
+{
+	struct provisioning_worker *worker = user_data;
+
+	worker->restart_id = 0;
+	worker->restarts++;
+	GINFO("Restarting worker %u (%u)", worker->index, worker->restarts);
+	provisioning_worker_start(worker);
+	return G_SOURCE_REMOVE;
+}
+
+static
+void
+provisioning_worker_exited(
+	GObject *object,
+	GAsyncResult *result,
+	gpointer user_data)
+{
+	GSubprocess *proc = G_SUBPROCESS(object);
+	struct provisioning_worker *worker = user_data;
+
+	/* Cancelled if the router is gone */
+	if (g_subprocess_wait_finish(proc, result, NULL) &&
+		worker->proc == proc) {
+		GWARN("Worker %u exited with status %d", worker->index,
+			g_subprocess_get_status(proc));
+		g_object_unref(worker->proc);
+		worker->proc = NULL;
+		provisioning_worker_disconnect(worker);
+		worker->restart_id = g_timeout_add(PROV_ROUTER_RESTART_MS,
+			provisioning_worker_restart, worker);
+	}
+	g_object_unref(proc);
+}
+
+static
+void
+provisioning_worker_start(
+	struct provisioning_worker *worker)
+{
+	struct provisioning_router *router = worker->router;
+	const guint argc = g_strv_length(router->argv);
+	const char **argv = g_new(const char*, argc + 7);
+	char *shard = g_strdup_printf("%u", worker->index);
+	char *first = g_strdup_printf("%u", worker->last_txid ?
+		(worker->last_txid / (router->count + 1) + 1) : 0);
+	GError *error = NULL;
+
+	/* Restarted worker doesn't reuse the IDs its predecessor gave out */
+	memcpy(argv, router->argv, sizeof(char*) * argc);
+	argv[argc] = "--worker";
+	argv[argc + 1] = g_dbus_server_get_client_address(router->server);
+	argv[argc + 2] = "--shard";
+	argv[argc + 3] = shard;
+	argv[argc + 4] = "--first-tx";
+	argv[argc + 5] = first;
+	argv[argc + 6] = NULL;
+	worker->proc = g_subprocess_newv(argv, G_SUBPROCESS_FLAGS_NONE, &error);
+	if (worker->proc) {
+		LOG("Worker %u is pid %s", worker->index,
+			g_subprocess_get_identifier(worker->proc));
+		g_subprocess_wait_async(g_object_ref(worker->proc), router->cancel,
+			provisioning_worker_exited, worker);
+	} else {
+		GERR("Failed to start worker %u: %s", worker->index, GERRMSG(error));
+		g_error_free(error);
+		worker->restart_id = g_timeout_add(PROV_ROUTER_RESTART_MS,
+			provisioning_worker_restart, worker);
+	}
+	g_free(shard);
+	g_free(first);
+	g_free(argv);
+}
+
+/* Only our own workers get to talk to us */
+static
+gboolean
+provisioning_router_authorize(
+	GDBusAuthObserver *observer,
+	GIOStream *stream,
+	GCredentials *credentials,
+	gpointer user_data)
+{
+	return credentials &&
+		g_credentials_get_unix_user(credentials, NULL) == getuid();
+}
+
+static
+gboolean
+provisioning_router_allow_mechanism(
+	GDBusAuthObserver *observer,
+	const char *mechanism,
+	gpointer user_data)
+{
+	return !g_strcmp0(mechanism, "EXTERNAL");
+}
+
+static
+gboolean
+provisioning_router_new_connection(
+	GDBusServer *server,
+	GDBusConnection *conn,
+	gpointer user_data)
+{
+	struct provisioning_router *router = user_data;
+	GCredentials *creds = g_dbus_connection_get_peer_credentials(conn);
+	const pid_t pid = creds ? g_credentials_get_unix_pid(creds, NULL) : -1;
+	guint i;
+
+	/* Which one is it? */
+	for (i = 0; i < router->count; i++) {
+		struct provisioning_worker *worker = router->workers + i;
+		const char *id = worker->proc ?
+			g_subprocess_get_identifier(worker->proc) : NULL;
+
+		if (id && atoi(id) == pid && !worker->conn) {
+			LOG("Worker %u connected", i);
+			worker->conn = g_object_ref(conn);
+			g_dbus_connection_set_exit_on_close(conn, FALSE);
+			worker->closed_id = g_signal_connect(conn, "closed",
+				G_CALLBACK(provisioning_worker_closed), worker);
+			worker->signal_id = g_dbus_connection_signal_subscribe(conn,
+				NULL, router->iface, NULL, router->path, NULL,
+				G_DBUS_SIGNAL_FLAGS_NONE, provisioning_router_signal,
+				worker, NULL);
+			router->connected++;
+			/* The others get Error.Busy until they are there */
+			if (!router->ready) {
+				router->ready = TRUE;
+				if (router->cb->ready) router->cb->ready(router->param);
+			}
+			return TRUE;
+		}
+	}
+	GWARN("Unexpected connection from pid %d", (int)pid);
+	return FALSE;
+}
+
+/* ==========================================================================*
+ * Calls concerning one IMSI
+ * ==========================================================================*/
+
+static
+struct provisioning_worker *
+provisioning_router_worker(
+	struct provisioning_router *router,
+	const char *imsi)
+{
+	return router->workers + provisioning_router_shard(imsi, router->count);
+}
+
+static
+void
+provisioning_router_call_done(
+	GObject *object,
+	GAsyncResult *result,
+	gpointer user_data)
+{
+	struct provisioning_router_call *fwd = user_data;
+	struct provisioning_router *router = fwd->router;
+	GError *error = NULL;
+	GVariant *reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object),
+		result, &error);
+
+	if (reply) {
+		guint txid = 0;
+
+		if (fwd->imsi) {
+			g_variant_get(reply, "(u)", &txid);
+			provisioning_router_tx_add(router, txid, fwd->worker,
+				g_dbus_method_invocation_get_sender(fwd->call), fwd->imsi,
+				NULL);
+		}
+		g_dbus_method_invocation_return_value(fwd->call,
+			fwd->no_reply_args ? NULL : reply);
+		g_variant_unref(reply);
+		if (fwd->imsi) {
+			provisioning_router_tx_replied(router, txid);
+		}
+	} else {
+		provisioning_router_return_error(fwd->call, error);
+		g_error_free(error);
+	}
+	if (fwd->imsi) {
+		provisioning_worker_tx_call_done(router->workers + fwd->worker);
+	}
+	router->calls--;
+	provisioning_router_update_busy(router);
+	g_object_unref(fwd->call);
+	g_free(fwd->imsi);
+	g_free(fwd);
+}
+
+/*
+ * The worker gets the same call, or the named method if the reply
+ * to the caller is empty but we need the transaction ID.
+ */
+static
+void
+provisioning_router_forward_as(
+	struct provisioning_router *router,
+	struct provisioning_worker *worker,
+	GDBusMethodInvocation *call,
+	const char *txid_imsi,
+	const char *method)
+{
+	if (worker->conn) {
+		struct provisioning_router_call *fwd =
+			g_new(struct provisioning_router_call, 1);
+
+		fwd->router = router;
+		fwd->call = g_object_ref(call);
+		fwd->worker = worker->index;
+		fwd->imsi = g_strdup(txid_imsi);
+		fwd->no_reply_args = (method != NULL);
+		if (txid_imsi) {
+			provisioning_worker_tx_call_start(worker);
+		}
+		router->calls++;
+		provisioning_router_update_busy(router);
+		g_dbus_connection_call(worker->conn, NULL, router->path,
+			router->iface, method ? method :
+			g_dbus_method_invocation_get_method_name(call),
+			g_dbus_method_invocation_get_parameters(call), NULL,
+			G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+			provisioning_router_call_done, fwd);
+	} else {
+		provisioning_router_return_busy(router, call);
+	}
+}
+
+static
+void
+provisioning_router_forward(
+	struct provisioning_router *router,
+	struct provisioning_worker *worker,
+	GDBusMethodInvocation *call,
+	const char *txid_imsi)
+{
+	provisioning_router_forward_as(router, worker, call, txid_imsi, NULL);
+}
+
+/* The first argument is the IMSI, the reply is the transaction ID */
+static
+void
+provisioning_router_route_tx(
+	struct provisioning_router *router,
+	GDBusMethodInvocation *call,
+	GVariant *args)
+{
+	const char *imsi = NULL;
+
+	g_variant_get_child(args, 0, "&s", &imsi);
+	provisioning_router_forward(router,
+		provisioning_router_worker(router, imsi), call, imsi);
+}
+
+/* Same as above, but the caller gets an empty reply */
+static
+void
+provisioning_router_route_push(
+	struct provisioning_router *router,
+	GDBusMethodInvocation *call,
+	GVariant *args)
+{
+	const char *imsi = NULL;
+
+	g_variant_get_child(args, 0, "&s", &imsi);
+	provisioning_router_forward_as(router,
+		provisioning_router_worker(router, imsi), call, imsi,
+		"SubmitProvisioningMessage");
+}
+
+static
+void
+provisioning_router_route_retry(
+	struct provisioning_router *router,
+	GDBusMethodInvocation *call,
+	GVariant *args)
+{
+	const char *imsi = NULL;
+
+	g_variant_get_child(args, 0, "&s", &imsi);
+	provisioning_router_forward_as(router,
+		provisioning_router_worker(router, imsi), call, imsi,
+		"SubmitRetryFailed");
+}
+
+static
+void
+provisioning_router_route_imsi(
+	struct provisioning_router *router,
+	GDBusMethodInvocation *call,
+	GVariant *args)
+{
+	const char *imsi = NULL;
+
+	g_variant_get_child(args, 0, "&s", &imsi);
+	provisioning_router_forward(router,
+		provisioning_router_worker(router, imsi), call, NULL);
+}
+
+/* Nothing to do with a SIM, any worker can do that */
+static
+void
+provisioning_router_route_any(
+	struct provisioning_router *router,
+	GDBusMethodInvocation *call,
+	GVariant *args)
+{
+	guint i;
+
+	for (i = 0; i < router->count; i++) {
+		struct provisioning_worker *worker = router->workers +
+			(router->next_worker++ % router->count);
+
+		if (worker->conn) {
+			provisioning_router_forward(router, worker, call, NULL);
+			return;
+		}
+	}
+	provisioning_router_return_busy(router, call);
+}
+
+/* ==========================================================================*
+ * Calls split between the workers
+ * ==========================================================================*/
+
+static
+struct provisioning_router_split *
+provisioning_router_split_new(
+	struct provisioning_router *router,
+	GDBusMethodInvocation *call,
+	guint count)
+{
+	struct provisioning_router_split *split =
+		g_new0(struct provisioning_router_split, 1);
+
+	split->router = router;
+	split->call = g_object_ref(call);
+	split->args = g_variant_ref(g_dbus_method_invocation_get_parameters(call));
+	split->count = count;
+	split->results = g_new0(GVariant*, count);
+	router->calls++;
+	provisioning_router_update_busy(router);
+	return split;
+}
+
+static
+void
+provisioning_router_split_free(
+	struct provisioning_router_split *split)
+{
+	struct provisioning_router *router = split->router;
+	guint i;
+
+	for (i = 0; i < split->count; i++) {
+		if (split->results[i]) {
+			g_variant_unref(split->results[i]);
+		}
+	}
+	if (split->error) {
+		g_error_free(split->error);
+	}
+	g_variant_unref(split->args);
+	g_object_unref(split->call);
+	g_free(split->results);
+	g_free(split);
+	router->calls--;
+	provisioning_router_update_busy(router);
+}
+
+static
+void
+provisioning_router_part_free(
+	struct provisioning_router_part *part)
+{
+	g_array_free(part->index, TRUE);
+	g_free(part);
+}
+
+/*
+ * Sends the part to the worker, or completes it right away with
+ * the error if the worker isn't there. Floating args are consumed.
+ */
+static
+void
+provisioning_router_part_call(
+	struct provisioning_router_part *part,
+	const char *method,
+	GVariant *args,
+	GAsyncReadyCallback done)
+{
+	struct provisioning_router_split *split = part->split;
+	struct provisioning_router *router = split->router;
+	struct provisioning_worker *worker = router->workers + part->worker;
+
+	g_variant_ref_sink(args);
+	split->pending++;
+	if (worker->conn) {
+		g_dbus_connection_call(worker->conn, NULL, router->path,
+			router->iface, method, args, NULL, G_DBUS_CALL_FLAGS_NONE,
+			-1, NULL, done, part);
+	} else {
+		done(NULL, NULL, part);
+	}
+	g_variant_unref(args);
+}
+
+/* NULL object means the worker wasn't there */
+static
+GVariant *
+provisioning_router_part_finish(
+	struct provisioning_router_part *part,
+	GObject *object,
+	GAsyncResult *result,
+	GError **error)
+{
+	if (object) {
+		return g_dbus_connection_call_finish(G_DBUS_CONNECTION(object),
+			result, error);
+	} else {
+		g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+			"Worker %u is restarting", part->worker);
+		return NULL;
+	}
+}
+
+/* HandleProvisioningMessages */
+
+static
+void
+provisioning_router_messages_done(
+	GObject *object,
+	GAsyncResult *result,
+	gpointer user_data)
+{
+	struct provisioning_router_part *part = user_data;
+	struct provisioning_router_split *split = part->split;
+	struct provisioning_router *router = split->router;
+	const char *sender = g_dbus_method_invocation_get_sender(split->call);
+	GError *error = NULL;
+	GVariant *reply = provisioning_router_part_finish(part, object, result,
+		&error);
+	GVariant *entries = g_variant_get_child_value(split->args, 0);
+	GVariant *results = reply ? g_variant_get_child_value(reply, 0) : NULL;
+	guint i;
+
+	for (i = 0; i < part->index->len; i++) {
+		const guint pos = g_array_index(part->index, guint, i);
+
+		if (results && i < g_variant_n_children(results)) {
+			GVariant *res = g_variant_get_child_value(results, i);
+			gboolean ok = FALSE;
+			guint txid = 0;
+
+			g_variant_get(res, "(bu&s)", &ok, &txid, NULL);
+			if (ok) {
+				const char *imsi = NULL;
+
+				g_variant_get_child(entries, pos, "(&s&s@ay)", &imsi, NULL,
+					NULL);
+				provisioning_router_tx_add(router, txid, part->worker,
+					sender, imsi, NULL);
+			}
+			split->results[pos] = res;
+		} else {
+			split->results[pos] = g_variant_ref_sink(g_variant_new("(bus)",
+				FALSE, 0, error ? error->message : "Missing result"));
+		}
+	}
+	if (results) g_variant_unref(results);
+	if (reply) g_variant_unref(reply);
+	if (error) g_error_free(error);
+	g_variant_unref(entries);
+	provisioning_worker_tx_call_done(router->workers + part->worker);
+
+	if (!--split->pending) {
+		GVariantBuilder builder;
+
+		g_variant_builder_init(&builder, G_VARIANT_TYPE("a(bus)"));
+		for (i = 0; i < split->count; i++) {
+			g_variant_builder_add_value(&builder, split->results[i]);
+		}
+		g_dbus_method_invocation_return_value(split->call,
+			g_variant_new("(@a(bus))", g_variant_builder_end(&builder)));
+		for (i = 0; i < split->count; i++) {
+			gboolean ok = FALSE;
+			guint txid = 0;
+
+			g_variant_get(split->results[i], "(bu&s)", &ok, &txid, NULL);
+			if (ok) {
+				provisioning_router_tx_replied(router, txid);
+			}
+		}
+		provisioning_router_split_free(split);
+	}
+	provisioning_router_part_free(part);
+}
+
+/* Entries are grouped by worker, each worker gets one call */
+static
+void
+provisioning_router_route_messages(
+	struct provisioning_router *router,
+	GDBusMethodInvocation *call,
+	GVariant *args)
+{
+	GVariant *entries = g_variant_get_child_value(args, 0);
+	const guint n = g_variant_n_children(entries);
+	struct provisioning_router_split *split =
+		provisioning_router_split_new(router, call, n);
+	guint w, i;
+
+	/* Holds the split until all parts have been sent */
+	split->pending++;
+	for (w = 0; w < router->count; w++) {
+		struct provisioning_router_part *part = NULL;
+		GVariantBuilder builder;
+
+		for (i = 0; i < n; i++) {
+			GVariant *entry = g_variant_get_child_value(entries, i);
+			const char *imsi = NULL;
+
+			g_variant_get_child(entry, 0, "&s", &imsi);
+			if (provisioning_router_shard(imsi, router->count) == w) {
+				if (!part) {
+					part = g_new(struct provisioning_router_part, 1);
+					part->split = split;
+					part->worker = w;
+					part->index = g_array_new(FALSE, FALSE, sizeof(guint));
+					g_variant_builder_init(&builder,
+						G_VARIANT_TYPE("a(ssay)"));
+				}
+				g_array_append_val(part->index, i);
+				g_variant_builder_add_value(&builder, entry);
+			}
+			g_variant_unref(entry);
+		}
+		if (part) {
+			provisioning_worker_tx_call_start(router->workers + w);
+			provisioning_router_part_call(part,
+				g_dbus_method_invocation_get_method_name(call),
+				g_variant_new("(@a(ssay))", g_variant_builder_end(&builder)),
+				provisioning_router_messages_done);
+		}
+	}
+	g_variant_unref(entries);
+
+	/* An empty batch is fine too */
+	if (!--split->pending) {
+		g_dbus_method_invocation_return_value(call,
+			g_variant_new("(@a(bus))", g_variant_new_array(
+			G_VARIANT_TYPE("(bus)"), NULL, 0)));
+		provisioning_router_split_free(split);
+	}
+}
+
+/* HandleSharedProvisioningMessage */
+
+static
+void
+provisioning_router_shared_reply(
+	struct provisioning_router_split *split)
+{
+	struct provisioning_router *router = split->router;
+	struct provisioning_router_batch *batch = split->batch;
+	guint *txids = g_new0(guint, split->count);
+	gboolean started = FALSE;
+	guint i;
+
+	for (i = 0; i < split->count; i++) {
+		if (split->results[i]) {
+			txids[i] = g_variant_get_uint32(split->results[i]);
+			started = TRUE;
+		}
+	}
+	if (started) {
+		g_dbus_method_invocation_return_value(split->call,
+			g_variant_new("(u@au)", batch->id,
+			g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32, txids,
+			split->count, sizeof(guint))));
+		for (i = 0; i < split->count; i++) {
+			if (txids[i]) {
+				provisioning_router_tx_replied(router, txids[i]);
+			}
+		}
+		/* The batch is complete only after this */
+		batch->replied = TRUE;
+		provisioning_router_batch_check(router, batch);
+	} else {
+		/* Nothing has been started */
+		if (split->error) {
+			provisioning_router_return_error(split->call, split->error);
+		} else {
+			g_dbus_method_invocation_return_error(split->call, G_DBUS_ERROR,
+				G_DBUS_ERROR_FAILED, "No transactions");
+		}
+		provisioning_router_batch_free(batch);
+	}
+	g_free(txids);
+}
+
+static
+void
+provisioning_router_shared_done(
+	GObject *object,
+	GAsyncResult *result,
+	gpointer user_data)
+{
+	struct provisioning_router_part *part = user_data;
+	struct provisioning_router_split *split = part->split;
+	struct provisioning_router *router = split->router;
+	struct provisioning_router_batch *batch = split->batch;
+	GError *error = NULL;
+	GVariant *reply = provisioning_router_part_finish(part, object, result,
+		&error);
+	guint i;
+
+	if (reply) {
+		GVariant *imsis = g_variant_get_child_value(split->args, 0);
+		GVariant *txids = g_variant_get_child_value(reply, 1);
+		gsize n = 0;
+		const guint32 *ids = g_variant_get_fixed_array(txids, &n,
+			sizeof(guint32));
+
+		for (i = 0; i < part->index->len; i++) {
+			const guint pos = g_array_index(part->index, guint, i);
+
+			if (i < n) {
+				const char *imsi = NULL;
+
+				g_variant_get_child(imsis, pos, "&s", &imsi);
+				provisioning_router_tx_add(router, ids[i], part->worker,
+					batch->sender, imsi, batch);
+				split->results[pos] = g_variant_ref_sink(
+					g_variant_new_uint32(ids[i]));
+			} else {
+				provisioning_router_batch_done(router, batch, PROV_FAILURE,
+					1);
+			}
+		}
+		g_variant_unref(txids);
+		g_variant_unref(imsis);
+		g_variant_unref(reply);
+	} else {
+		/* These IMSIs are done with as far as the batch is concerned */
+		provisioning_router_batch_done(router, batch, PROV_FAILURE,
+			part->index->len);
+		if (!split->error) {
+			split->error = error;
+			error = NULL;
+		}
+	}
+	if (error) {
+		g_error_free(error);
+	}
+	provisioning_worker_tx_call_done(router->workers + part->worker);
+	if (!--split->pending) {
+		provisioning_router_shared_reply(split);
+		provisioning_router_split_free(split);
+	}
+	provisioning_router_part_free(part);
+}
+
+/*
+ * Each worker decodes the message for its own IMSIs. The caller gets
+ * one batch ID and one ProvisioningBatchResult, counted here.
+ */
+static
+void
+provisioning_router_route_shared(
+	struct provisioning_router *router,
+	GDBusMethodInvocation *call,
+	GVariant *args)
+{
+	GVariant *imsis = g_variant_get_child_value(args, 0);
+	GVariant *type = g_variant_get_child_value(args, 1);
+	GVariant *data = g_variant_get_child_value(args, 2);
+	const guint n = g_variant_n_children(imsis);
+	const char **strv = g_variant_get_strv(imsis, NULL);
+	const char *error = provisioning_batch_check_imsis(strv);
+	struct provisioning_router_split *split;
+	guint w, i;
+
+	g_free(strv);
+	if (error) {
+		/* Let a worker reject it in its own words */
+		provisioning_router_route_any(router, call, args);
+		g_variant_unref(imsis);
+		g_variant_unref(type);
+		g_variant_unref(data);
+		return;
+	}
+
+	split = provisioning_router_split_new(router, call, n);
+	split->batch = provisioning_router_batch_new(router,
+		g_dbus_method_invocation_get_sender(call), n);
+	split->pending++;
+	for (w = 0; w < router->count; w++) {
+		struct provisioning_router_part *part = NULL;
+		GPtrArray *list = g_ptr_array_new();
+
+		for (i = 0; i < n; i++) {
+			const char *imsi = NULL;
+
+			g_variant_get_child(imsis, i, "&s", &imsi);
+			if (provisioning_router_shard(imsi, router->count) == w) {
+				if (!part) {
+					part = g_new(struct provisioning_router_part, 1);
+					part->split = split;
+					part->worker = w;
+					part->index = g_array_new(FALSE, FALSE, sizeof(guint));
+				}
+				g_array_append_val(part->index, i);
+				g_ptr_array_add(list, (gpointer)imsi);
+			}
+		}
+		if (part) {
+			provisioning_worker_tx_call_start(router->workers + w);
+			provisioning_router_part_call(part,
+				g_dbus_method_invocation_get_method_name(call),
+				g_variant_new("(@as@s@ay)", g_variant_new_strv(
+				(const char *const *)list->pdata, list->len), type, data),
+				provisioning_router_shared_done);
+		}
+		g_ptr_array_free(list, TRUE);
+	}
+	g_variant_unref(imsis);
+	g_variant_unref(type);
+	g_variant_unref(data);
+	if (!--split->pending) {
+		provisioning_router_shared_reply(split);
+		provisioning_router_split_free(split);
+	}
+}
+
+/* ==========================================================================*
+ * Calls going to all workers
+ * ==========================================================================*/
+
+static
+void
+provisioning_router_collect_log_line(
+	const char *line,
+	void *user_data)
+{
+	g_ptr_array_add(user_data, g_strdup(line));
+}
+
+static
+void
+provisioning_router_all_finish(
+	struct provisioning_router_split *split)
+{
+	const char *method = g_dbus_method_invocation_get_method_name(split->call);
+	guint i;
+
+	if (!strcmp(method, "GetStatistics")) {
+		GVariant *totals = NULL;
+
+		for (i = 0; i < split->count; i++) {
+			if (split->results[i]) {
+				GVariant *merged = g_variant_ref_sink(
+					provisioning_router_merge_stats(totals,
+					split->results[i]));
+
+				if (totals) g_variant_unref(totals);
+				totals = merged;
+			}
+		}
+		if (totals) {
+			g_dbus_method_invocation_return_value(split->call,
+				g_variant_new("(@a{sv})", totals));
+			g_variant_unref(totals);
+		} else {
+			provisioning_router_return_busy(split->router, split->call);
+		}
+	} else if (!strcmp(method, "DumpLog")) {
+		GPtrArray *lines = g_ptr_array_new_with_free_func(g_free);
+
+		/* Ours first, then the workers' prefixed with the shard */
+		provisioning_recorder_dump(TRUE, provisioning_router_collect_log_line,
+			lines);
+		for (i = 0; i < split->count; i++) {
+			if (split->results[i]) {
+				GVariantIter it;
+				const char *line;
+
+				g_variant_iter_init(&it, split->results[i]);
+				while (g_variant_iter_next(&it, "&s", &line)) {
+					g_ptr_array_add(lines, g_strdup_printf("[%u] %s", i,
+						line));
+				}
+			}
+		}
+		g_ptr_array_add(lines, NULL);
+		g_dbus_method_invocation_return_value(split->call,
+			g_variant_new("(^as)", lines->pdata));
+		g_ptr_array_free(lines, TRUE);
+	} else {
+		g_dbus_method_invocation_return_value(split->call, NULL);
+	}
+	provisioning_router_split_free(split);
+}
+
+static
+void
+provisioning_router_all_done(
+	GObject *object,
+	GAsyncResult *result,
+	gpointer user_data)
+{
+	struct provisioning_router_part *part = user_data;
+	struct provisioning_router_split *split = part->split;
+	GError *error = NULL;
+	GVariant *reply = provisioning_router_part_finish(part, object, result,
+		&error);
+
+	if (reply) {
+		if (g_variant_n_children(reply)) {
+			split->results[part->worker] =
+				g_variant_get_child_value(reply, 0);
+		}
+		g_variant_unref(reply);
+	} else {
+		GWARN("Worker %u: %s", part->worker, GERRMSG(error));
+		g_error_free(error);
+	}
+	if (!--split->pending) {
+		provisioning_router_all_finish(split);
+	}
+	provisioning_router_part_free(part);
+}
+
+static
+void
+provisioning_router_route_all(
+	struct provisioning_router *router,
+	GDBusMethodInvocation *call,
+	GVariant *args)
+{
+	struct provisioning_router_split *split =
+		provisioning_router_split_new(router, call, router->count);
+	guint w;
+
+	split->pending++;
+	for (w = 0; w < router->count; w++) {
+		struct provisioning_router_part *part =
+			g_new(struct provisioning_router_part, 1);
+
+		part->split = split;
+		part->worker = w;
+		part->index = g_array_new(FALSE, FALSE, sizeof(guint));
+		provisioning_router_part_call(part,
+			g_dbus_method_invocation_get_method_name(call), args,
+			provisioning_router_all_done);
+	}
+	if (!--split->pending) {
+		provisioning_router_all_finish(split);
+	}
+}
+
+/* Validated here, then passed on to the workers */
+static
+void
+provisioning_router_route_log_level(
+	struct provisioning_router *router,
+	GDBusMethodInvocation *call,
+	GVariant *args)
+{
+	const char *module = NULL;
+	gint32 level = 0;
+
+	g_variant_get(args, "(&si)", &module, &level);
+	if (prov_log_set_level(module, level)) {
+		GINFO("Log level of %s set to %d", module, level);
+		provisioning_router_route_all(router, call, args);
+	} else {
+		g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+			G_DBUS_ERROR_INVALID_ARGS, "Invalid module or level");
+	}
+}
+
+/* ==========================================================================*
+ * Interface
+ * ==========================================================================*/
+
+static const struct provisioning_router_method {
+	const char *name;
+	void (*route)(struct provisioning_router *router,
+		GDBusMethodInvocation *call, GVariant *args);
+} provisioning_router_methods[] = {
+	{ "HandleProvisioningMessage", provisioning_router_route_push },
+	{ "SubmitProvisioningMessage", provisioning_router_route_tx },
+	{ "HandleProvisioningMessages", provisioning_router_route_messages },
+	{ "HandleSharedProvisioningMessage", provisioning_router_route_shared },
+	{ "DecodeProvisioningMessage", provisioning_router_route_any },
+	{ "ProvisionSettings", provisioning_router_route_tx },
+	{ "GetProvisionedSettings", provisioning_router_route_imsi },
+	{ "RetryFailed", provisioning_router_route_retry },
+	{ "SubmitRetryFailed", provisioning_router_route_tx },
+	{ "GetStatistics", provisioning_router_route_all },
+	{ "DumpLog", provisioning_router_route_all },
+	{ "SetLogLevel", provisioning_router_route_log_level }
+};
+
+static
+void
+provisioning_router_method_call(
+	GDBusConnection *bus,
+	const char *sender,
+	const char *path,
+	const char *iface,
+	const char *method,
+	GVariant *args,
+	GDBusMethodInvocation *call,
+	gpointer user_data)
+{
+	struct provisioning_router *router = user_data;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(provisioning_router_methods); i++) {
+		const struct provisioning_router_method *m =
+			provisioning_router_methods + i;
+
+		if (!strcmp(m->name, method)) {
+			m->route(router, call, args);
+			return;
+		}
+	}
+	g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+		G_DBUS_ERROR_UNKNOWN_METHOD, "Unknown method %s", method);
+}
+
+static const GDBusInterfaceVTable provisioning_router_vtable = {
+	provisioning_router_method_call
+};
+
+gboolean
+provisioning_router_export(
+	struct provisioning_router *router,
+	GDBusConnection *bus,
+	const char *path,
+	GDBusInterfaceInfo *info,
+	GError **error)
+{
+	GASSERT(!router->bus);
+	router->object_id = g_dbus_connection_register_object(bus, path, info,
+		&provisioning_router_vtable, router, NULL, error);
+	if (router->object_id) {
+		router->bus = g_object_ref(bus);
+		router->path = g_strdup(path);
+		router->iface = g_strdup(info->name);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/* ==========================================================================*
+ * Statistics
+ * ==========================================================================*/
+
+static
+GVariant *
+provisioning_router_merge_value(
+	GVariant *a,
+	GVariant *b)
+{
+	if (!g_variant_type_equal(g_variant_get_type(a),
+		g_variant_get_type(b))) {
+		/* Shouldn't happen, the workers run the same code */
+		return g_variant_ref(a);
+	} else if (g_variant_is_of_type(a, G_VARIANT_TYPE_UINT64)) {
+		return g_variant_ref_sink(g_variant_new_uint64(
+			g_variant_get_uint64(a) + g_variant_get_uint64(b)));
+	} else if (g_variant_is_of_type(a, G_VARIANT_TYPE_UINT32)) {
+		return g_variant_ref_sink(g_variant_new_uint32(
+			g_variant_get_uint32(a) + g_variant_get_uint32(b)));
+	} else if (g_variant_is_of_type(a, G_VARIANT_TYPE("(ttttat)"))) {
+		guint64 count1, sum1, min1, max1, count2, sum2, min2, max2;
+		GVariant *buckets1, *buckets2;
+		const guint64 *b1, *b2;
+		gsize n1 = 0, n2 = 0, i;
+		guint64 *buckets;
+		GVariant *merged;
+
+		g_variant_get(a, "(tttt@at)", &count1, &sum1, &min1, &max1,
+			&buckets1);
+		g_variant_get(b, "(tttt@at)", &count2, &sum2, &min2, &max2,
+			&buckets2);
+		b1 = g_variant_get_fixed_array(buckets1, &n1, sizeof(guint64));
+		b2 = g_variant_get_fixed_array(buckets2, &n2, sizeof(guint64));
+		buckets = g_new0(guint64, MAX(n1, n2) + 1);
+		for (i = 0; i < n1; i++) buckets[i] += b1[i];
+		for (i = 0; i < n2; i++) buckets[i] += b2[i];
+
+		/* Minimum of an empty histogram means nothing */
+		if (!count1) {
+			min1 = min2;
+		} else if (count2) {
+			min1 = MIN(min1, min2);
+		}
+		merged = g_variant_ref_sink(g_variant_new("(tttt@at)",
+			count1 + count2, sum1 + sum2, min1, MAX(max1, max2),
+			g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64, buckets,
+			MAX(n1, n2), sizeof(guint64))));
+		g_variant_unref(buckets1);
+		g_variant_unref(buckets2);
+		g_free(buckets);
+		return merged;
+	} else {
+		return g_variant_ref(a);
+	}
+}
+
+GVariant *
+provisioning_router_merge_stats(
+	GVariant *totals,
+	GVariant *stats)
+{
+	GVariantBuilder builder;
+	GVariantIter it;
+	const char *key;
+	GVariant *value;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+	if (totals) {
+		g_variant_iter_init(&it, totals);
+		while (g_variant_iter_next(&it, "{&sv}", &key, &value)) {
+			GVariant *other = g_variant_lookup_value(stats, key, NULL);
+
+			if (other) {
+				GVariant *merged = provisioning_router_merge_value(value,
+					other);
+
+				g_variant_builder_add(&builder, "{sv}", key, merged);
+				g_variant_unref(merged);
+				g_variant_unref(other);
+			} else {
+				g_variant_builder_add(&builder, "{sv}", key, value);
+			}
+			g_variant_unref(value);
+		}
+	}
+
+	/* And whatever the totals don't have yet */
+	g_variant_iter_init(&it, stats);
+	while (g_variant_iter_next(&it, "{&sv}", &key, &value)) {
+		GVariant *known = totals ?
+			g_variant_lookup_value(totals, key, NULL) : NULL;
+
+		if (known) {
+			g_variant_unref(known);
+		} else {
+			g_variant_builder_add(&builder, "{sv}", key, value);
+		}
+		g_variant_unref(value);
+	}
+	return g_variant_builder_end(&builder);
+}
+
+/* ==========================================================================*
+ * Shutdown
+ * ==========================================================================*/
+
+static
+void
+provisioning_worker_stop_done(
+	GObject *proc,
+	GAsyncResult *result,
+	gpointer user_data)
+{
+	gboolean *done = user_data;
+
+	g_subprocess_wait_finish(G_SUBPROCESS(proc), result, NULL);
+	*done = TRUE;
+}
+
+static
+gboolean
+provisioning_worker_stop_timeout(
+	gpointer user_data)
+{
+	gboolean *timed_out = user_data;
+
+	*timed_out = TRUE;
+	return G_SOURCE_REMOVE;
+}
+
+/* Waits up to PROV_ROUTER_STOP_MS, FALSE if the worker is still there */
+static
+gboolean
+provisioning_worker_stop_wait(
+	GMainContext *context,
+	const gboolean *done)
+{
+	gboolean timed_out = FALSE;
+	GSource *timeout = g_timeout_source_new(PROV_ROUTER_STOP_MS);
+
+	g_source_set_callback(timeout, provisioning_worker_stop_timeout,
+		&timed_out, NULL);
+	g_source_attach(timeout, context);
+	while (!*done && !timed_out) {
+		g_main_context_iteration(context, TRUE);
+	}
+	g_source_destroy(timeout);
+	g_source_unref(timeout);
+	return *done;
+}
+
+/*
+ * Closing the connection makes the worker exit, but a worker stuck in
+ * something isn't allowed to hold up the shutdown. Runs a private main
+ * context so that nothing else gets dispatched meanwhile.
+ */
+static
+void
+provisioning_worker_stop(
+	guint index,
+	GSubprocess *proc)
+{
+	GMainContext *context = g_main_context_new();
+	gboolean done = FALSE;
+
+	g_main_context_push_thread_default(context);
+	g_subprocess_wait_async(proc, NULL, provisioning_worker_stop_done, &done);
+	if (!provisioning_worker_stop_wait(context, &done)) {
+		GWARN("Worker %u doesn't exit, terminating it", index);
+		g_subprocess_send_signal(proc, SIGTERM);
+		if (!provisioning_worker_stop_wait(context, &done)) {
+			GWARN("Worker %u is still there, killing it", index);
+			g_subprocess_force_exit(proc);
+			while (!done) {
+				g_main_context_iteration(context, TRUE);
+			}
+		}
+	}
+	g_main_context_pop_thread_default(context);
+	g_main_context_unref(context);
+}
+
+/* ==========================================================================*
+ * API
+ * ==========================================================================*/
+
+struct provisioning_router *
+provisioning_router_new(
+	const char *const *argv,
+	guint workers,
+	const char *error_busy,
+	const struct provisioning_router_callbacks *cb,
+	void *param,
+	GError **error)
+{
+	struct provisioning_router *router;
+	char *address, *guid;
+	guint i;
+
+	GASSERT(workers > 0);
+	router = g_new0(struct provisioning_router, 1);
+	router->argv = g_strdupv((char**)argv);
+	router->error_busy = g_strdup(error_busy);
+	router->count = workers;
+	router->cb = cb;
+	router->param = param;
+	router->txs = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+		NULL, provisioning_router_tx_free);
+	router->cancel = g_cancellable_new();
+
+	/* Workers are authenticated by their uid and then by their pid */
+	router->observer = g_dbus_auth_observer_new();
+	g_signal_connect(router->observer, "authorize-authenticated-peer",
+		G_CALLBACK(provisioning_router_authorize), router);
+	g_signal_connect(router->observer, "allow-mechanism",
+		G_CALLBACK(provisioning_router_allow_mechanism), router);
+
+	address = g_strconcat("unix:tmpdir=", g_get_tmp_dir(), NULL);
+	guid = g_dbus_generate_guid();
+	router->server = g_dbus_server_new_sync(address,
+		G_DBUS_SERVER_FLAGS_NONE, guid, router->observer, NULL, error);
+	g_free(address);
+	g_free(guid);
+	if (!router->server) {
+		provisioning_router_free(router);
+		return NULL;
+	}
+
+	g_signal_connect(router->server, "new-connection",
+		G_CALLBACK(provisioning_router_new_connection), router);
+	g_dbus_server_start(router->server);
+	LOG("Listening on %s", g_dbus_server_get_client_address(router->server));
+
+	router->workers = g_new0(struct provisioning_worker, workers);
+	for (i = 0; i < workers; i++) {
+		struct provisioning_worker *worker = router->workers + i;
+
+		worker->router = router;
+		worker->index = i;
+		provisioning_worker_start(worker);
+	}
+	return router;
+}
+
+void
+provisioning_router_free(
+	struct provisioning_router *router)
+{
+	if (router) {
+		guint i;
+
+		g_cancellable_cancel(router->cancel);
+		if (router->bus) {
+			g_dbus_connection_unregister_object(router->bus,
+				router->object_id);
+			g_object_unref(router->bus);
+		}
+		for (i = 0; i < router->count && router->workers; i++) {
+			struct provisioning_worker *worker = router->workers + i;
+
+			if (worker->restart_id) {
+				g_source_remove(worker->restart_id);
+			}
+			if (worker->early) {
+				g_hash_table_destroy(worker->early);
+			}
+			if (worker->conn) {
+				g_dbus_connection_signal_unsubscribe(worker->conn,
+					worker->signal_id);
+				g_signal_handler_disconnect(worker->conn, worker->closed_id);
+				g_dbus_connection_close_sync(worker->conn, NULL, NULL);
+				g_object_unref(worker->conn);
+			}
+			if (worker->proc) {
+				GSubprocess *proc = worker->proc;
+
+				worker->proc = NULL;
+				provisioning_worker_stop(worker->index, proc);
+				g_object_unref(proc);
+			}
+		}
+		if (router->server) {
+			g_dbus_server_stop(router->server);
+			g_object_unref(router->server);
+		}
+		g_object_unref(router->observer);
+		g_object_unref(router->cancel);
+		g_hash_table_destroy(router->txs);
+		g_strfreev(router->argv);
+		g_free(router->error_busy);
+		g_free(router->workers);
+		g_free(router->path);
+		g_free(router->iface);
+		g_free(router);
+	}
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,117 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef __PROVROUTER_H
+#define __PROVROUTER_H
+
+#include <gio/gio.h>
+
+/*
+ * Front end of the sharded service (see --workers). Spawns the workers,
+ * each of them being the same executable connected back to us over a
+ * private peer-to-peer D-Bus connection, and implements the service
+ * interface on the bus by forwarding the calls. Everything concerning
+ * a particular SIM goes to the worker owning its IMSI, so a slow modem
+ * only holds up the SIMs of one worker. Signals coming from the workers
+ * are passed on to the bus.
+ *
+ * A worker which dies is restarted. Transactions it had in flight are
+ * reported as failed, calls for its IMSIs get Error.Busy until it's back.
+ *
+ * Nothing is throttled here. The workers do that, each for its own
+ * IMSIs, which makes the per-originator and in-flight limits per worker.
+ */
+struct provisioning_router;
+
+struct provisioning_router_callbacks {
+	/* The first worker has connected, the service may go public */
+	void (*ready)(void *param);
+	/* Transitions between having and not having something in flight */
+	void (*busy)(void *param);
+	void (*idle)(void *param);
+};
+
+/* Delay before restarting a worker which has died */
+#ifndef PROV_ROUTER_RESTART_MS
+#  define PROV_ROUTER_RESTART_MS (1000)
+#endif
+
+/*
+ * How long a worker gets to exit on its own at shutdown, and then
+ * after SIGTERM, before it's killed.
+ */
+#ifndef PROV_ROUTER_STOP_MS
+#  define PROV_ROUTER_STOP_MS (2000)
+#endif
+
+/*
+ * Each worker is started as argv plus "--worker ADDRESS --shard N
+ * --first-tx SEQ", see provisioning_next_txid() in main.c
+ * Returns NULL (and sets the error) if the server can't be started.
+ */
+struct provisioning_router *
+provisioning_router_new(
+	const char *const *argv,
+	guint workers,
+	const char *error_busy,
+	const struct provisioning_router_callbacks *cb,
+	void *param,
+	GError **error);
+
+void
+provisioning_router_free(
+	struct provisioning_router *router);
+
+/* Exports the service object on the bus connection */
+gboolean
+provisioning_router_export(
+	struct provisioning_router *router,
+	GDBusConnection *bus,
+	const char *path,
+	GDBusInterfaceInfo *info,
+	GError **error);
+
+/* TRUE if calls or transactions are in flight */
+gboolean
+provisioning_router_busy(
+	struct provisioning_router *router);
+
+/*
+ * Worker owning the IMSI, stable for the given number of workers.
+ * Exposed for unit tests, as is the rest.
+ */
+guint
+provisioning_router_shard(
+	const char *imsi,
+	guint workers);
+
+/*
+ * Adds the GetStatistics snapshot of a worker to the totals. Counters
+ * are summed up, histograms are merged. Both are a{sv}, the result is
+ * floating. The totals may be NULL.
+ */
+GVariant *
+provisioning_router_merge_stats(
+	GVariant *totals,
+	GVariant *stats);
+
+#endif /* __PROVROUTER_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,169 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "provisioning-stats.h"
+
+/*
+ * Bucket N counts values in [2^N, 2^(N+1)) microseconds, the first one
+ * also gets zeros and the last one everything that doesn't fit.
+ */
+#define PROV_STATS_BUCKETS 32
+
+struct provisioning_histogram {
+	guint64 count;
+	guint64 sum;
+	guint64 min;
+	guint64 max;
+	guint64 buckets[PROV_STATS_BUCKETS];
+};
+
+static const char *const provisioning_histogram_names[] = {
+	"push_to_apply",
+	"sent_to_apply",
+	"decode",
+	"manager_valid",
+	"sim_valid",
+	"connmgr_valid",
+	"deactivate",
+	"property_write",
+	"downtime",
+	"queue_wait"
+};
+
+static const char *const provisioning_counter_names[] = {
+	"result_success",
+	"result_partial_success",
+	"result_failure",
+	"decode_errors",
+	"rejected",
+	"timeouts",
+	"retries",
+	"throttled_sender",
+	"throttled_imsi",
+	"throttled_busy"
+};
+
+G_STATIC_ASSERT(G_N_ELEMENTS(provisioning_histogram_names) ==
+	PROV_STATS_HISTOGRAM_COUNT);
+G_STATIC_ASSERT(G_N_ELEMENTS(provisioning_counter_names) ==
+	PROV_STATS_COUNTER_COUNT);
+
+static struct provisioning_histogram
+	provisioning_histograms[PROV_STATS_HISTOGRAM_COUNT];
+static guint64 provisioning_counters[PROV_STATS_COUNTER_COUNT];
+static guint provisioning_in_flight;
+
+guint
+provisioning_stats_bucket(
+	guint64 usec)
+{
+	guint bucket = 0;
+	while (usec > 1 && bucket < (PROV_STATS_BUCKETS - 1)) {
+		usec >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+void
+provisioning_stats_record(
+	enum prov_stats_histogram histogram,
+	gint64 usec)
+{
+	if (usec >= 0 && histogram < PROV_STATS_HISTOGRAM_COUNT) {
+		struct provisioning_histogram *h =
+			provisioning_histograms + histogram;
+		const guint64 value = usec;
+		if (!h->count || h->min > value) {
+			h->min = value;
+		}
+		if (h->max < value) {
+			h->max = value;
+		}
+		h->count++;
+		h->sum += value;
+		h->buckets[provisioning_stats_bucket(value)]++;
+	}
+}
+
+void
+provisioning_stats_record_since(
+	enum prov_stats_histogram histogram,
+	gint64 start)
+{
+	if (start) {
+		provisioning_stats_record(histogram,
+			g_get_monotonic_time() - start);
+	}
+}
+
+void
+provisioning_stats_count(
+	enum prov_stats_counter counter,
+	guint n)
+{
+	if (counter < PROV_STATS_COUNTER_COUNT) {
+		provisioning_counters[counter] += n;
+	}
+}
+
+void
+provisioning_stats_set_in_flight(
+	guint n)
+{
+	provisioning_in_flight = n;
+}
+
+GVariant *
+provisioning_stats_variant(void)
+{
+	GVariantBuilder builder;
+	guint i;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+	for (i = 0; i < PROV_STATS_COUNTER_COUNT; i++) {
+		g_variant_builder_add(&builder, "{sv}", provisioning_counter_names[i],
+			g_variant_new_uint64(provisioning_counters[i]));
+	}
+	g_variant_builder_add(&builder, "{sv}", "in_flight",
+		g_variant_new_uint32(provisioning_in_flight));
+	for (i = 0; i < PROV_STATS_HISTOGRAM_COUNT; i++) {
+		const struct provisioning_histogram *h = provisioning_histograms + i;
+		guint n = PROV_STATS_BUCKETS;
+
+		/* Trailing empty buckets are not worth sending */
+		while (n > 0 && !h->buckets[n - 1]) n--;
+		g_variant_builder_add(&builder, "{sv}", provisioning_histogram_names[i],
+			g_variant_new("(tttt@at)", h->count, h->sum, h->min, h->max,
+				g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64,
+					h->buckets, n, sizeof(h->buckets[0]))));
+	}
+	return g_variant_builder_end(&builder);
+}
+
+void
+provisioning_stats_reset(void)
+{
+	memset(provisioning_histograms, 0, sizeof(provisioning_histograms));
+	memset(provisioning_counters, 0, sizeof(provisioning_counters));
+	provisioning_in_flight = 0;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
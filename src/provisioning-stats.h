@@ -0,0 +1,94 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef __PROVSTATS_H
+#define __PROVSTATS_H
+
+#include <glib.h>
+
+/*
+ * Latency histograms and counters. Recording is cheap (no locks, no
+ * allocations) and therefore only allowed on the main thread.
+ */
+
+enum prov_stats_histogram {
+	PROV_STATS_PUSH_TO_APPLY,       /* Local receive time to result */
+	PROV_STATS_SENT_TO_APPLY,       /* Remote (SMSC) time to result */
+	PROV_STATS_DECODE,              /* WBXML decoding */
+	PROV_STATS_MANAGER_VALID,       /* Transaction start to manager valid */
+	PROV_STATS_SIM_VALID,           /* Modem found to SIM manager valid */
+	PROV_STATS_CONNMGR_VALID,       /* SIM matched to connmgr valid */
+	PROV_STATS_DEACTIVATE,          /* Context deactivation */
+	PROV_STATS_PROPERTY_WRITE,      /* SetProperty round trip */
+	PROV_STATS_DOWNTIME,            /* Deactivation to re-activation */
+	PROV_STATS_QUEUE_WAIT,          /* Batch entry queued to decoded */
+	PROV_STATS_HISTOGRAM_COUNT
+};
+
+enum prov_stats_counter {
+	PROV_STATS_RESULT_SUCCESS,
+	PROV_STATS_RESULT_PARTIAL_SUCCESS,
+	PROV_STATS_RESULT_FAILURE,
+	PROV_STATS_DECODE_ERRORS,
+	PROV_STATS_REJECTED,            /* Failed the WBXML pre-scan */
+	PROV_STATS_TIMEOUTS,
+	PROV_STATS_RETRIES,
+	PROV_STATS_THROTTLED_SENDER,    /* Sender over its rate limit */
+	PROV_STATS_THROTTLED_IMSI,      /* IMSI over its rate limit */
+	PROV_STATS_THROTTLED_BUSY,      /* Too many messages in flight */
+	PROV_STATS_COUNTER_COUNT
+};
+
+/* Values are in microseconds, negative ones are ignored */
+void
+provisioning_stats_record(
+	enum prov_stats_histogram histogram,
+	gint64 usec);
+
+/* Records the time elapsed since the given g_get_monotonic_time() */
+void
+provisioning_stats_record_since(
+	enum prov_stats_histogram histogram,
+	gint64 start);
+
+void
+provisioning_stats_count(
+	enum prov_stats_counter counter,
+	guint n);
+
+void
+provisioning_stats_set_in_flight(
+	guint n);
+
+/* Returns a floating a{sv} snapshot */
+GVariant *
+provisioning_stats_variant(void);
+
+/* Exposed for unit tests */
+guint
+provisioning_stats_bucket(
+	guint64 usec);
+
+void
+provisioning_stats_reset(void);
+
+#endif /* __PROVSTATS_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,332 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "provisioning-store.h"
+#include "provisioning-file.h"
+#include "provisioning-variant.h"
+#include "log.h"
+
+/* Bump the magic if the format changes */
+#define PROV_STORE_MAGIC (0x50525632) /* PRV2 */
+#define PROV_STORE_TYPE "(ua{sa{sv}}a{s(a{sv}uu)})"
+#define PROV_STORE_ENTRIES_TYPE "a{sa{sv}}"
+#define PROV_STORE_FAILED_TYPE "a{s(a{sv}uu)}"
+
+/* Files written before failed settings were kept */
+#define PROV_STORE_MAGIC_V1 (0x50525631) /* PRV1 */
+#define PROV_STORE_TYPE_V1 "(ua{sa{sv}})"
+
+/* The settings include passwords */
+#define PROV_STORE_FILE_MODE (0600)
+#define PROV_STORE_DIR_MODE (0700)
+
+#ifndef PROV_STORE_MAX_ENTRIES
+#  define PROV_STORE_MAX_ENTRIES (32)
+#endif
+
+struct provisioning_store {
+	char *file;
+	GVariant *entries; /* a{sa{sv}}, oldest first */
+	GVariant *failed;  /* a{s(a{sv}uu)}, oldest first */
+};
+
+static
+void
+provisioning_store_load(
+	struct provisioning_store *store)
+{
+	static const struct provisioning_file_format formats[] = {
+		{ PROV_STORE_MAGIC, PROV_STORE_TYPE },
+		{ PROV_STORE_MAGIC_V1, PROV_STORE_TYPE_V1 }
+	};
+	GVariant *root = provisioning_file_load(store->file, formats,
+		G_N_ELEMENTS(formats));
+	if (root) {
+		guint32 magic = 0;
+		g_variant_get_child(root, 0, "u", &magic);
+		store->entries = g_variant_get_child_value(root, 1);
+		if (magic == PROV_STORE_MAGIC) {
+			store->failed = g_variant_get_child_value(root, 2);
+		}
+		LOG("%s: %u entries", store->file, (guint)
+			g_variant_n_children(store->entries));
+		g_variant_unref(root);
+	}
+}
+
+struct provisioning_store *
+provisioning_store_new(
+	const char *file)
+{
+	struct provisioning_store *store = g_new0(struct provisioning_store, 1);
+	store->file = g_strdup(file);
+	provisioning_store_load(store);
+	if (!store->entries) {
+		store->entries = g_variant_ref_sink(g_variant_new_array(
+			G_VARIANT_TYPE("{sa{sv}}"), NULL, 0));
+	}
+	if (!store->failed) {
+		store->failed = g_variant_ref_sink(g_variant_new_array(
+			G_VARIANT_TYPE("{s(a{sv}uu)}"), NULL, 0));
+	}
+	return store;
+}
+
+void
+provisioning_store_free(
+	struct provisioning_store *store)
+{
+	if (store) {
+		g_variant_unref(store->entries);
+		g_variant_unref(store->failed);
+		g_free(store->file);
+		g_free(store);
+	}
+}
+
+GVariant *
+provisioning_store_lookup(
+	struct provisioning_store *store,
+	const char *imsi)
+{
+	return (store && imsi) ? g_variant_lookup_value(store->entries, imsi,
+		G_VARIANT_TYPE_VARDICT) : NULL;
+}
+
+/* The value is in the provisioning_data_variant() format */
+static
+struct provisioning_data *
+provisioning_store_data(
+	const char *imsi,
+	GVariant *value)
+{
+	GVariant *empty = g_variant_ref_sink(g_variant_new_array(
+		G_VARIANT_TYPE("{sv}"), NULL, 0));
+	GVariant *internet = g_variant_lookup_value(value, "internet",
+		G_VARIANT_TYPE_VARDICT);
+	GVariant *mms = g_variant_lookup_value(value, "mms",
+		G_VARIANT_TYPE_VARDICT);
+	const char *error = NULL;
+	struct provisioning_data *data = provisioning_data_from_variant(
+		internet ? internet : empty, mms ? mms : empty, &error);
+
+	if (!data) {
+		GWARN("%s: %s", imsi, error);
+	}
+	if (internet) g_variant_unref(internet);
+	if (mms) g_variant_unref(mms);
+	g_variant_unref(empty);
+	return data;
+}
+
+struct provisioning_data *
+provisioning_store_get(
+	struct provisioning_store *store,
+	const char *imsi)
+{
+	struct provisioning_data *data = NULL;
+	GVariant *value = provisioning_store_lookup(store, imsi);
+	if (value) {
+		data = provisioning_store_data(imsi, value);
+		g_variant_unref(value);
+	}
+	return data;
+}
+
+static
+gboolean
+provisioning_store_write(
+	struct provisioning_store *store,
+	GVariant *entries,
+	GVariant *failed)
+{
+	GError *error = NULL;
+	const gboolean ok = provisioning_file_save(store->file,
+		g_variant_new("(u@" PROV_STORE_ENTRIES_TYPE "@"
+			PROV_STORE_FAILED_TYPE ")", PROV_STORE_MAGIC, entries, failed),
+		PROV_STORE_FILE_MODE, PROV_STORE_DIR_MODE, &error);
+
+	if (!ok) {
+		GWARN("%s", error->message);
+		g_error_free(error);
+	}
+	return ok;
+}
+
+/*
+ * Copy of the dictionary with the value for the key replaced, or
+ * removed if the value is NULL. The new value goes to the end, the
+ * oldest ones are dropped to stay within the limit.
+ */
+static
+GVariant *
+provisioning_store_dict_update(
+	GVariant *dict,
+	const char *key,
+	GVariant *value)
+{
+	GVariantBuilder builder;
+	GVariantIter it;
+	GVariant *entry;
+	GVariant *old = g_variant_lookup_value(dict, key, NULL);
+	gsize n = g_variant_n_children(dict) - (old ? 1 : 0) + (value ? 1 : 0);
+
+	g_variant_builder_init(&builder, g_variant_get_type(dict));
+	g_variant_iter_init(&it, dict);
+	while ((entry = g_variant_iter_next_value(&it)) != NULL) {
+		const char *k = NULL;
+
+		g_variant_get_child(entry, 0, "&s", &k);
+		if (strcmp(k, key)) {
+			if (n <= PROV_STORE_MAX_ENTRIES) {
+				g_variant_builder_add_value(&builder, entry);
+			} else {
+				LOG("Forgetting %s", k);
+				n--;
+			}
+		}
+		g_variant_unref(entry);
+	}
+	if (value) {
+		g_variant_builder_add_value(&builder, g_variant_new_dict_entry(
+			g_variant_new_string(key), value));
+	}
+	if (old) {
+		g_variant_unref(old);
+	}
+	return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+/* Takes over the references, keeps the old contents if writing fails */
+static
+gboolean
+provisioning_store_update(
+	struct provisioning_store *store,
+	GVariant *entries,
+	GVariant *failed)
+{
+	const gboolean ok = provisioning_store_write(store, entries, failed);
+
+	if (ok) {
+		g_variant_unref(store->entries);
+		g_variant_unref(store->failed);
+		store->entries = entries;
+		store->failed = failed;
+	} else {
+		g_variant_unref(entries);
+		g_variant_unref(failed);
+	}
+	return ok;
+}
+
+gboolean
+provisioning_store_put(
+	struct provisioning_store *store,
+	const char *imsi,
+	const struct provisioning_data *data)
+{
+	GVariant *value = g_variant_ref_sink(provisioning_data_variant(data));
+	GVariant *old = provisioning_store_lookup(store, imsi);
+	gboolean ok = TRUE;
+
+	if (!old || !g_variant_equal(old, value)) {
+		ok = provisioning_store_update(store,
+			provisioning_store_dict_update(store->entries, imsi, value),
+			g_variant_ref(store->failed));
+		if (ok) {
+			LOG("Stored settings for %s", imsi);
+		}
+	}
+	if (old) {
+		g_variant_unref(old);
+	}
+	g_variant_unref(value);
+	return ok;
+}
+
+struct provisioning_data *
+provisioning_store_get_failed(
+	struct provisioning_store *store,
+	const char *imsi,
+	guint *internet,
+	guint *mms)
+{
+	struct provisioning_data *data = NULL;
+	GVariant *value = (store && imsi) ? g_variant_lookup_value(store->failed,
+		imsi, G_VARIANT_TYPE("(a{sv}uu)")) : NULL;
+
+	if (value) {
+		GVariant *settings = NULL;
+		guint32 internet_failed = 0, mms_failed = 0;
+
+		g_variant_get(value, "(@a{sv}uu)", &settings, &internet_failed,
+			&mms_failed);
+		data = provisioning_store_data(imsi, settings);
+		if (data) {
+			*internet = internet_failed;
+			*mms = mms_failed;
+		}
+		g_variant_unref(settings);
+		g_variant_unref(value);
+	}
+	return data;
+}
+
+gboolean
+provisioning_store_put_failed(
+	struct provisioning_store *store,
+	const char *imsi,
+	const struct provisioning_data *data,
+	guint internet,
+	guint mms)
+{
+	GVariant *value = g_variant_ref_sink(g_variant_new("(@a{sv}uu)",
+		provisioning_data_variant(data), internet, mms));
+	GVariant *old = g_variant_lookup_value(store->failed, imsi, NULL);
+	gboolean ok = TRUE;
+
+	if (!old || !g_variant_equal(old, value)) {
+		ok = provisioning_store_update(store, g_variant_ref(store->entries),
+			provisioning_store_dict_update(store->failed, imsi, value));
+	}
+	if (old) {
+		g_variant_unref(old);
+	}
+	g_variant_unref(value);
+	return ok;
+}
+
+gboolean
+provisioning_store_remove_failed(
+	struct provisioning_store *store,
+	const char *imsi)
+{
+	GVariant *old = g_variant_lookup_value(store->failed, imsi, NULL);
+	gboolean ok = TRUE;
+
+	if (old) {
+		ok = provisioning_store_update(store, g_variant_ref(store->entries),
+			provisioning_store_dict_update(store->failed, imsi, NULL));
+		g_variant_unref(old);
+	}
+	return ok;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
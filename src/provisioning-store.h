@@ -0,0 +1,93 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef __PROVSTORE_H
+#define __PROVSTORE_H
+
+#include "provisioning-decoder.h"
+
+/*
+ * Last successfully applied settings per IMSI, kept in a single file,
+ * together with the settings which failed to get applied in full. The
+ * file is a serialized GVariant which is mapped into memory and looked
+ * up in place. Updates replace the whole file atomically, so it's never
+ * seen half-written. The least recently stored IMSIs are dropped when
+ * the limit is reached.
+ */
+struct provisioning_store;
+
+struct provisioning_store *
+provisioning_store_new(
+	const char *file);
+
+void
+provisioning_store_free(
+	struct provisioning_store *store);
+
+/*
+ * Same format as provisioning_data_variant(). Returns a new reference,
+ * NULL if nothing has been stored for this IMSI.
+ */
+GVariant *
+provisioning_store_lookup(
+	struct provisioning_store *store,
+	const char *imsi);
+
+/* Free the result with provisioning_data_unref() */
+struct provisioning_data *
+provisioning_store_get(
+	struct provisioning_store *store,
+	const char *imsi);
+
+/* Doesn't touch the file if nothing has changed */
+gboolean
+provisioning_store_put(
+	struct provisioning_store *store,
+	const char *imsi,
+	const struct provisioning_data *data);
+
+/*
+ * Settings to retry, with the masks of the properties which failed.
+ * Free the result with provisioning_data_unref(), NULL if there's none.
+ */
+struct provisioning_data *
+provisioning_store_get_failed(
+	struct provisioning_store *store,
+	const char *imsi,
+	guint *internet,
+	guint *mms);
+
+gboolean
+provisioning_store_put_failed(
+	struct provisioning_store *store,
+	const char *imsi,
+	const struct provisioning_data *data,
+	guint internet,
+	guint mms);
+
+/* Doesn't touch the file if there's nothing to remove */
+gboolean
+provisioning_store_remove_failed(
+	struct provisioning_store *store,
+	const char *imsi);
+
+#endif /* __PROVSTORE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,105 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "provisioning-throttle.h"
+#include "provisioning-ratelimit.h"
+#include "provisioning-stats.h"
+
+struct provisioning_throttle {
+	struct provisioning_ratelimit *sender_limit;
+	struct provisioning_ratelimit *imsi_limit;
+	guint max_in_flight;
+};
+
+struct provisioning_throttle *
+provisioning_throttle_new(
+	guint burst,
+	guint sender_rate,
+	guint imsi_rate,
+	guint max_in_flight)
+{
+	struct provisioning_throttle *throttle =
+		g_new0(struct provisioning_throttle, 1);
+
+	throttle->sender_limit = provisioning_ratelimit_new(burst, sender_rate);
+	throttle->imsi_limit = provisioning_ratelimit_new(burst, imsi_rate);
+	throttle->max_in_flight = max_in_flight;
+	return throttle;
+}
+
+void
+provisioning_throttle_free(
+	struct provisioning_throttle *throttle)
+{
+	if (throttle) {
+		provisioning_ratelimit_free(throttle->sender_limit);
+		provisioning_ratelimit_free(throttle->imsi_limit);
+		g_free(throttle);
+	}
+}
+
+guint
+provisioning_throttle_call(
+	struct provisioning_throttle *throttle,
+	guint in_flight)
+{
+	if (throttle && throttle->max_in_flight &&
+		in_flight >= throttle->max_in_flight) {
+		provisioning_stats_count(PROV_STATS_THROTTLED_BUSY, 1);
+		return PROV_BUSY_RETRY_MS;
+	}
+	return 0;
+}
+
+guint
+provisioning_throttle_push(
+	struct provisioning_throttle *throttle,
+	const char *from,
+	const char *imsi,
+	guint in_flight,
+	gint64 now)
+{
+	/* Empty keys would all share one bucket */
+	const gboolean by_from = (from && from[0]);
+	const gboolean by_imsi = (imsi && imsi[0]);
+	guint delay = provisioning_throttle_call(throttle, in_flight);
+
+	if (delay || !throttle) {
+		return delay;
+	} else if (by_from && (delay = provisioning_ratelimit_delay(
+		throttle->sender_limit, from, now)) > 0) {
+		provisioning_stats_count(PROV_STATS_THROTTLED_SENDER, 1);
+		return delay;
+	} else if (by_imsi && (delay = provisioning_ratelimit_delay(
+		throttle->imsi_limit, imsi, now)) > 0) {
+		provisioning_stats_count(PROV_STATS_THROTTLED_IMSI, 1);
+		return delay;
+	} else {
+		if (by_from) {
+			provisioning_ratelimit_take(throttle->sender_limit, from, now);
+		}
+		if (by_imsi) {
+			provisioning_ratelimit_take(throttle->imsi_limit, imsi, now);
+		}
+		return 0;
+	}
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
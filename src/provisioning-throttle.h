@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef __PROVTHROTTLE_H
+#define __PROVTHROTTLE_H
+
+#include <glib.h>
+
+/*
+ * Back-pressure for the calls which start transactions. Push messages
+ * come from the network and are limited per originator (the from
+ * argument) and per IMSI. Batches, shared messages and the rest come
+ * from the trusted clients allowed by provisioning.conf, those aren't
+ * rate limited. Everything is turned away while too many transactions
+ * are in flight; a call starting many of them is either accepted or
+ * turned away as a whole.
+ *
+ * The functions return zero if the call may go ahead, otherwise the
+ * number of milliseconds to wait.
+ */
+struct provisioning_throttle;
+
+/* Retry hint given when there's too much in flight */
+#ifndef PROV_BUSY_RETRY_MS
+#  define PROV_BUSY_RETRY_MS (1000)
+#endif
+
+/* Zero rates and zero max_in_flight mean no limit */
+struct provisioning_throttle *
+provisioning_throttle_new(
+	guint burst,
+	guint sender_rate,
+	guint imsi_rate,
+	guint max_in_flight);
+
+void
+provisioning_throttle_free(
+	struct provisioning_throttle *throttle);
+
+/* Any call, in_flight being the number of transactions already there */
+guint
+provisioning_throttle_call(
+	struct provisioning_throttle *throttle,
+	guint in_flight);
+
+/* A push message, empty originator or IMSI isn't limited by that */
+guint
+provisioning_throttle_push(
+	struct provisioning_throttle *throttle,
+	const char *from,
+	const char *imsi,
+	guint in_flight,
+	gint64 now);
+
+#endif /* __PROVTHROTTLE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
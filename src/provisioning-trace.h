@@ -0,0 +1,66 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef __PROVTRACE_H
+#define __PROVTRACE_H
+
+/*
+ * USDT probes in the "provisioning" provider. Each probe compiles
+ * into a single nop and a note in the .note.stapsdt section, so they
+ * survive inlining and stripping, e.g.
+ *
+ *   bpftrace -e 'usdt:/usr/libexec/provisioning-service:decode__done
+ *     { @[arg1] = hist(arg0); }'
+ *
+ * Probes and their arguments:
+ *
+ *   message__received   imsi, bytes
+ *   decode__start       bytes
+ *   decode__done        bytes, ok
+ *   provisioning__start imsi, internet props, mms props
+ *   provisioning__done  imsi, modem path, result
+ *   sim__new            modem path
+ *   sim__valid          modem path, present, matched
+ *   connmgr__valid      modem path
+ *   context__state      context path, old state, new state
+ *   property__submit    context path, property, attempt
+ *   property__done      context path, property, error message or NULL
+ *   signal__emit        imsi, modem path, result
+ *
+ * Without <sys/sdt.h> (HAVE_SDT undefined) the probes compile to nothing.
+ */
+
+#ifdef HAVE_SDT
+#  include <sys/sdt.h>
+#  define PROV_TRACE1(name,a) \
+	DTRACE_PROBE1(provisioning, name, a)
+#  define PROV_TRACE2(name,a,b) \
+	DTRACE_PROBE2(provisioning, name, a, b)
+#  define PROV_TRACE3(name,a,b,c) \
+	DTRACE_PROBE3(provisioning, name, a, b, c)
+#else
+#  define PROV_TRACE1(name,a) ((void)0)
+#  define PROV_TRACE2(name,a,b) ((void)0)
+#  define PROV_TRACE3(name,a,b,c) ((void)0)
+#endif
+
+#endif /* __PROVTRACE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,274 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "provisioning-variant.h"
+
+#include <string.h>
+
+static
+void
+provisioning_variant_add_string(
+	GVariantBuilder *builder,
+	const char *key,
+	const char *value)
+{
+	if (value) {
+		g_variant_builder_add(builder, "{sv}", key,
+			g_variant_new_string(value));
+	}
+}
+
+static
+void
+provisioning_variant_add_auth(
+	GVariantBuilder *builder,
+	enum prov_authtype authtype)
+{
+	const char *auth;
+	switch (authtype) {
+	case AUTH_PAP:
+		auth = "pap";
+		break;
+	case AUTH_CHAP:
+		auth = "chap";
+		break;
+	default:
+		auth = "";
+		break;
+	}
+	g_variant_builder_add(builder, "{sv}", "auth",
+		g_variant_new_string(auth));
+}
+
+static
+void
+provisioning_variant_add_linked(
+	GVariantBuilder *builder,
+	guint linked)
+{
+	const char *types[4];
+	int n = 0;
+	if (linked & PROV_LINKED_APPLICATION) {
+		types[n++] = "application";
+	}
+	if (linked & PROV_LINKED_PXLOGICAL) {
+		types[n++] = "pxlogical";
+	}
+	if (linked & PROV_LINKED_NAPDEF) {
+		types[n++] = "napdef";
+	}
+	g_variant_builder_add(builder, "{sv}", "linked",
+		g_variant_new_strv(types, n));
+}
+
+static
+GVariant *
+provisioning_internet_variant(
+	const struct provisioning_internet *internet)
+{
+	GVariantBuilder builder;
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+	provisioning_variant_add_string(&builder, "name", internet->name);
+	provisioning_variant_add_string(&builder, "apn", internet->apn);
+	provisioning_variant_add_string(&builder, "username", internet->username);
+	provisioning_variant_add_string(&builder, "password", internet->password);
+	provisioning_variant_add_auth(&builder, internet->authtype);
+	provisioning_variant_add_linked(&builder, internet->linked);
+	return g_variant_builder_end(&builder);
+}
+
+static
+GVariant *
+provisioning_mms_variant(
+	const struct provisioning_mms *mms)
+{
+	GVariantBuilder builder;
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+	provisioning_variant_add_string(&builder, "name", mms->name);
+	provisioning_variant_add_string(&builder, "apn", mms->apn);
+	provisioning_variant_add_string(&builder, "username", mms->username);
+	provisioning_variant_add_string(&builder, "password", mms->password);
+	provisioning_variant_add_auth(&builder, mms->authtype);
+	provisioning_variant_add_string(&builder, "messageproxy",
+		mms->messageproxy);
+	provisioning_variant_add_string(&builder, "messagecenter",
+		mms->messagecenter);
+	provisioning_variant_add_string(&builder, "port", mms->portnro);
+	provisioning_variant_add_linked(&builder, mms->linked);
+	return g_variant_builder_end(&builder);
+}
+
+GVariant *
+provisioning_data_variant(
+	const struct provisioning_data *data)
+{
+	GVariantBuilder builder;
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+	if (data->internet) {
+		g_variant_builder_add(&builder, "{sv}", "internet",
+			provisioning_internet_variant(data->internet));
+	}
+	if (data->mms) {
+		g_variant_builder_add(&builder, "{sv}", "mms",
+			provisioning_mms_variant(data->mms));
+	}
+	return g_variant_builder_end(&builder);
+}
+
+static
+gboolean
+provisioning_variant_parse_auth(
+	const char *auth,
+	enum prov_authtype *authtype)
+{
+	if (!auth[0]) {
+		*authtype = AUTH_UNKNOWN;
+	} else if (!g_ascii_strcasecmp(auth, "pap")) {
+		*authtype = AUTH_PAP;
+	} else if (!g_ascii_strcasecmp(auth, "chap")) {
+		*authtype = AUTH_CHAP;
+	} else {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static
+char **
+provisioning_internet_field(
+	void *context,
+	const char *key)
+{
+	struct provisioning_internet *internet = context;
+	if (!strcmp(key, "name")) {
+		return &internet->name;
+	} else if (!strcmp(key, "apn")) {
+		return &internet->apn;
+	} else if (!strcmp(key, "username")) {
+		return &internet->username;
+	} else if (!strcmp(key, "password")) {
+		return &internet->password;
+	} else {
+		return NULL;
+	}
+}
+
+static
+char **
+provisioning_mms_field(
+	void *context,
+	const char *key)
+{
+	struct provisioning_mms *mms = context;
+	if (!strcmp(key, "name")) {
+		return &mms->name;
+	} else if (!strcmp(key, "apn")) {
+		return &mms->apn;
+	} else if (!strcmp(key, "username")) {
+		return &mms->username;
+	} else if (!strcmp(key, "password")) {
+		return &mms->password;
+	} else if (!strcmp(key, "messageproxy")) {
+		return &mms->messageproxy;
+	} else if (!strcmp(key, "messagecenter")) {
+		return &mms->messagecenter;
+	} else if (!strcmp(key, "port")) {
+		return &mms->portnro;
+	} else {
+		return NULL;
+	}
+}
+
+/* Fills in the strings and the auth type, returns the reason on failure */
+static
+const char *
+provisioning_variant_parse(
+	GVariant *dict,
+	char **(*field)(void *context, const char *key),
+	void *context,
+	enum prov_authtype *authtype)
+{
+	GVariantIter it;
+	const char *key;
+	GVariant *value;
+	const char *error = NULL;
+
+	g_variant_iter_init(&it, dict);
+	while (!error && g_variant_iter_next(&it, "{&sv}", &key, &value)) {
+		const gboolean is_string =
+			g_variant_is_of_type(value, G_VARIANT_TYPE_STRING);
+		char **str;
+		if (!strcmp(key, "auth")) {
+			if (!is_string || !provisioning_variant_parse_auth(
+				g_variant_get_string(value, NULL), authtype)) {
+				error = "Invalid authentication method";
+			}
+		} else if ((str = field(context, key)) != NULL) {
+			if (is_string) {
+				g_free(*str);
+				*str = g_variant_dup_string(value, NULL);
+			} else {
+				error = "Settings must be strings";
+			}
+		}
+		g_variant_unref(value);
+	}
+	return error;
+}
+
+struct provisioning_data *
+provisioning_data_from_variant(
+	GVariant *internet,
+	GVariant *mms,
+	const char **error)
+{
+	struct provisioning_data *data = provisioning_data_new();
+	const char *reason = NULL;
+
+	if (g_variant_n_children(internet)) {
+		data->internet = g_new0(struct provisioning_internet, 1);
+		reason = provisioning_variant_parse(internet,
+			provisioning_internet_field, data->internet,
+			&data->internet->authtype);
+		if (!reason && !(data->internet->apn && data->internet->apn[0])) {
+			reason = "Missing internet APN";
+		}
+	}
+	if (!reason && g_variant_n_children(mms)) {
+		data->mms = g_new0(struct provisioning_mms, 1);
+		reason = provisioning_variant_parse(mms,
+			provisioning_mms_field, data->mms,
+			&data->mms->authtype);
+		if (!reason && !(data->mms->apn && data->mms->apn[0])) {
+			reason = "Missing MMS APN";
+		}
+	}
+	if (!reason && !data->internet && !data->mms) {
+		reason = "No settings";
+	}
+	if (reason) {
+		provisioning_data_unref(data);
+		if (error) *error = reason;
+		return NULL;
+	}
+	return data;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,58 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef __PROVVARIANT_H
+#define __PROVVARIANT_H
+
+#include "provisioning-decoder.h"
+
+/* Exported by the decoder library, see provisioning-decoder.h */
+#define provisioning_data_variant prov_private_data_variant
+#define provisioning_data_from_variant prov_private_data_from_variant
+
+/*
+ * Returns a floating a{sv} describing the decoded settings. Contexts
+ * which the message doesn't define are omitted, and so are the strings
+ * which are NULL in the decoded data:
+ *
+ *   "internet" a{sv}: name, apn, username, password, auth, linked
+ *   "mms"      a{sv}: the above plus messageproxy, messagecenter, port
+ *
+ * "auth" is "pap", "chap" or "" and "linked" is an array of the
+ * characteristic types the context has been merged from.
+ */
+GVariant *
+provisioning_data_variant(
+	const struct provisioning_data *data);
+
+/*
+ * The reverse of the above. Either dictionary may be empty, but not
+ * both, and a non-empty one must have the "apn". Unknown keys (like
+ * "linked") are ignored. Returns NULL and the reason on failure.
+ */
+struct provisioning_data *
+provisioning_data_from_variant(
+	GVariant *internet,
+	GVariant *mms,
+	const char **error);
+
+#endif /* __PROVVARIANT_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
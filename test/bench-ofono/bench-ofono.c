@@ -0,0 +1,174 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/*
+ * Drives the provisioning-ofono.c state machine against the fake
+ * libgofono and reports transactions per second and allocations per
+ * transaction. Example:
+ *
+ *   build/release/bench-ofono -n 100000 -c 16 -m 2 -a
+ */
+
+#include "test-common.h"
+#include "test-data.h"
+#include "test-malloc.h"
+#include "fake-ofono.h"
+#include "provisioning-ofono.h"
+#include "provisioning-decoder.h"
+
+#include <gutil_log.h>
+
+#include <stdio.h>
+
+#define BENCH_IMSI "244051234567890"
+
+struct bench {
+	GMainLoop *loop;
+	struct provisioning_data *data;
+	FakeOfonoModem *target;
+	guint started;
+	guint finished;
+	guint failed;
+	gint count;
+	gint concurrency;
+	gboolean active;
+};
+
+static void bench_start(struct bench *bench);
+
+static
+void
+bench_done(
+	const char *imsi,
+	const char *path,
+	const struct provisioning_ofono_report *report,
+	void *param)
+{
+	struct bench *bench = param;
+	bench->finished++;
+	if (report->result != PROV_SUCCESS) {
+		bench->failed++;
+	}
+	if (bench->started < (guint)bench->count) {
+		bench_start(bench);
+	} else if (bench->finished == bench->started) {
+		g_main_loop_quit(bench->loop);
+	}
+}
+
+static
+void
+bench_start(
+	struct bench *bench)
+{
+	if (bench->active) {
+		fake_ofono_modem_set_active(bench->target,
+			OFONO_CONNCTX_TYPE_INTERNET, TRUE);
+	}
+	bench->started++;
+	provisioning_ofono(BENCH_IMSI, bench->data, bench_done, bench);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench bench;
+	gint modems = 1;
+	gint latency = 0;
+	gboolean reactivate = FALSE;
+	GError *error = NULL;
+	GOptionContext *options;
+	GOptionEntry entries[] = {
+		{ "count", 'n', 0, G_OPTION_ARG_INT, &bench.count,
+		  "Number of transactions [10000]", "N" },
+		{ "concurrency", 'c', 0, G_OPTION_ARG_INT, &bench.concurrency,
+		  "Transactions in flight [1]", "N" },
+		{ "modems", 'm', 0, G_OPTION_ARG_INT, &modems,
+		  "Number of modems, the last one matches [1]", "N" },
+		{ "latency", 'l', 0, G_OPTION_ARG_INT, &latency,
+		  "Latency of each ofono call [0]", "MS" },
+		{ "active", 'a', 0, G_OPTION_ARG_NONE, &bench.active,
+		  "Internet context is active", NULL },
+		{ "reactivate", 'r', 0, G_OPTION_ARG_NONE, &reactivate,
+		  "Re-activate deactivated contexts", NULL },
+		{ NULL }
+	};
+	gboolean ok;
+
+	memset(&bench, 0, sizeof(bench));
+	bench.count = 10000;
+	bench.concurrency = 1;
+	options = g_option_context_new(NULL);
+	g_option_context_add_main_entries(options, entries, NULL);
+	ok = g_option_context_parse(options, &argc, &argv, &error);
+	g_option_context_free(options);
+	if (!ok) {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+		return 1;
+	} else if (bench.count < 1 || bench.concurrency < 1 || modems < 1 ||
+		latency < 0) {
+		fprintf(stderr, "Invalid arguments\n");
+		return 1;
+	} else {
+		TestMallocStats before, after;
+		gint64 start, usec;
+		char *path;
+		int i;
+
+		gutil_log_default.level = GLOG_LEVEL_NONE;
+		fake_ofono_init();
+		for (i = 0; i < modems; i++) {
+			path = g_strdup_printf("/ril_%d", i);
+			bench.target = fake_ofono_add_modem(path,
+				(i == modems - 1) ? BENCH_IMSI : "244050000000000");
+			fake_ofono_modem_set_latency(bench.target, latency, latency);
+			g_free(path);
+		}
+		provisioning_ofono_set_reactivate(reactivate);
+		bench.loop = g_main_loop_new(NULL, FALSE);
+		bench.data = test_data_new();
+
+		test_malloc_get_stats(&before);
+		start = g_get_monotonic_time();
+		for (i = 0; i < bench.concurrency && i < bench.count; i++) {
+			bench_start(&bench);
+		}
+		g_main_loop_run(bench.loop);
+		usec = MAX(g_get_monotonic_time() - start, 1);
+		test_malloc_get_stats(&after);
+
+		printf("%u transactions (%u failed) in %u ms\n", bench.finished,
+			bench.failed, (guint)(usec / 1000));
+		printf("%.1f transactions/sec\n", bench.finished *
+			(double)G_USEC_PER_SEC / usec);
+		printf("%.1f allocations, %.1f frees, %.0f bytes per transaction\n",
+			(double)(after.allocs - before.allocs) / bench.finished,
+			(double)(after.frees - before.frees) / bench.finished,
+			(double)(after.bytes - before.bytes) / bench.finished);
+
+		provisioning_data_unref(bench.data);
+		g_main_loop_unref(bench.loop);
+		while (g_main_context_iteration(NULL, FALSE));
+		fake_ofono_deinit();
+		return bench.failed ? 2 : 0;
+	}
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
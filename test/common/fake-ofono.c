@@ -0,0 +1,1280 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "fake-ofono.h"
+
+#include <gofono_manager.h>
+#include <gofono_modem.h>
+#include <gofono_simmgr.h>
+#include <gofono_connmgr.h>
+#include <gofono_names.h>
+
+#define FAKE_CONTEXT_TYPES (OFONO_CONNCTX_TYPE_MMS + 1)
+
+enum fake_ofono_signal {
+	FAKE_SIGNAL_VALID,
+	FAKE_SIGNAL_ACTIVE,
+	FAKE_SIGNAL_ACTIVATE_FAILED,
+	FAKE_SIGNAL_PRESENT,
+	FAKE_SIGNAL_IMSI,
+	FAKE_SIGNAL_MODEM_ADDED
+};
+
+struct fake_ofono_handler {
+	gulong id;
+	enum fake_ofono_signal signal;
+	void (*cb)(void *pub, void *arg);
+	void *arg;
+};
+
+/* Common part of all fake objects */
+typedef struct fake_ofono_object {
+	void *pub;
+	gboolean *valid;
+	int refcount;
+	GSList *handlers;
+	guint valid_id;
+	void (*finalize)(void *pub);
+} FakeOfonoObject;
+
+typedef struct fake_ofono_manager {
+	OfonoManager pub;
+	FakeOfonoObject obj;
+} FakeOfonoManager;
+
+typedef struct fake_ofono_simmgr {
+	OfonoSimMgr pub;
+	FakeOfonoObject obj;
+	FakeOfonoModem *modem;
+	char *path;
+} FakeOfonoSimMgr;
+
+typedef struct fake_ofono_connctx {
+	OfonoConnCtx pub;
+	FakeOfonoObject obj;
+	FakeOfonoModem *modem;
+	char *path;
+} FakeOfonoConnCtx;
+
+typedef struct fake_ofono_connmgr {
+	OfonoConnMgr pub;
+	FakeOfonoObject obj;
+	FakeOfonoModem *modem;
+	FakeOfonoConnCtx *ctx[FAKE_CONTEXT_TYPES];
+	char *path;
+} FakeOfonoConnMgr;
+
+struct fake_ofono_failure {
+	OFONO_ERROR_CODE code;
+	guint count;
+};
+
+struct fake_ofono_modem {
+	OfonoModem pub;
+	char *path;
+	char *imsi;
+	guint simmgr_delay;
+	guint connmgr_delay;
+	guint connctx_delay;
+	guint set_latency;
+	guint activate_latency;
+	gboolean active[FAKE_CONTEXT_TYPES];
+	GHashTable *props[FAKE_CONTEXT_TYPES];
+	GHashTable *failures[FAKE_CONTEXT_TYPES];
+	/* Weak references */
+	FakeOfonoSimMgr *simmgr;
+	FakeOfonoConnMgr *connmgr;
+	FakeOfonoConnCtx *connctx[FAKE_CONTEXT_TYPES];
+};
+
+struct fake_ofono_call {
+	FakeOfonoConnCtx *ctx;
+	GCancellable *cancel;
+	char *name;
+	char *value;
+	gboolean active;
+	GError *error;
+	OfonoConnCtxCallFinishedCallback done;
+	void *arg;
+	guint id;
+};
+
+static struct fake_ofono {
+	FakeOfonoManager *manager;
+	GSList *modems;
+	GPtrArray *modem_list;
+	GSList *calls;
+	guint manager_delay;
+	guint ncalls;
+	guint objects;
+	guint pending;              /* Objects which aren't valid yet */
+	gulong last_id;
+	FakeOfonoAllocCounter alloc_counter;
+	guint64 alloc_mark;
+	guint64 allocs;
+	guint depth;                /* Nesting of the calls into the fake */
+} fake_ofono;
+
+/*==========================================================================*
+ * Allocations
+ *
+ * Made between fake_ofono_enter() and fake_ofono_leave(), except those
+ * made by the callbacks, are the fake's own.
+ *==========================================================================*/
+
+static
+void
+fake_ofono_enter(void)
+{
+	if (!fake_ofono.depth++ && fake_ofono.alloc_counter) {
+		fake_ofono.alloc_mark = fake_ofono.alloc_counter();
+	}
+}
+
+static
+void
+fake_ofono_leave(void)
+{
+	g_assert(fake_ofono.depth > 0);
+	if (!--fake_ofono.depth && fake_ofono.alloc_counter) {
+		fake_ofono.allocs += fake_ofono.alloc_counter() -
+			fake_ofono.alloc_mark;
+	}
+}
+
+/* Returns the depth to pass to fake_ofono_callback_done() */
+static
+guint
+fake_ofono_callback(void)
+{
+	const guint depth = fake_ofono.depth;
+
+	if (depth) {
+		fake_ofono.depth = 1;
+		fake_ofono_leave();
+	}
+	return depth;
+}
+
+static
+void
+fake_ofono_callback_done(
+	guint depth)
+{
+	if (depth) {
+		fake_ofono_enter();
+		fake_ofono.depth = depth;
+	}
+}
+
+/*==========================================================================*
+ * Objects
+ *==========================================================================*/
+
+static
+gboolean
+fake_ofono_object_valid_cb(
+	gpointer data);
+
+static
+void
+fake_ofono_object_init(
+	FakeOfonoObject *obj,
+	void *pub,
+	gboolean *valid,
+	guint delay,
+	void (*finalize)(void *pub))
+{
+	obj->pub = pub;
+	obj->valid = valid;
+	obj->refcount = 1;
+	obj->finalize = finalize;
+	if (delay) {
+		obj->valid_id = g_timeout_add(delay, fake_ofono_object_valid_cb, obj);
+		fake_ofono.pending++;
+	} else {
+		*valid = TRUE;
+	}
+	fake_ofono.objects++;
+}
+
+static
+void
+fake_ofono_object_ref(
+	FakeOfonoObject *obj)
+{
+	g_assert(obj->refcount > 0);
+	obj->refcount++;
+}
+
+static
+void
+fake_ofono_object_unref(
+	FakeOfonoObject *obj)
+{
+	g_assert(obj->refcount > 0);
+	if (!--obj->refcount) {
+		if (obj->valid_id) {
+			g_source_remove(obj->valid_id);
+			fake_ofono.pending--;
+		}
+		g_slist_free_full(obj->handlers, g_free);
+		fake_ofono.objects--;
+		obj->finalize(obj->pub);
+	}
+}
+
+/* Only FAKE_SIGNAL_ACTIVATE_FAILED handlers get the error */
+static
+void
+fake_ofono_object_emit_error(
+	FakeOfonoObject *obj,
+	enum fake_ofono_signal signal,
+	const GError *error)
+{
+	GArray *ids;
+	GSList *l;
+	guint i;
+
+	fake_ofono_enter();
+	ids = g_array_new(FALSE, FALSE, sizeof(gulong));
+
+	/* Handlers may be added and removed by the callbacks */
+	for (l = obj->handlers; l; l = l->next) {
+		const struct fake_ofono_handler *h = l->data;
+		if (h->signal == signal) {
+			g_array_append_val(ids, h->id);
+		}
+	}
+	fake_ofono_object_ref(obj);
+	for (i = 0; i < ids->len; i++) {
+		const gulong id = g_array_index(ids, gulong, i);
+		for (l = obj->handlers; l; l = l->next) {
+			const struct fake_ofono_handler *h = l->data;
+			if (h->id == id) {
+				const guint depth = fake_ofono_callback();
+
+				if (signal == FAKE_SIGNAL_ACTIVATE_FAILED) {
+					((OfonoConnCtxErrorHandler)h->cb)(obj->pub, error,
+						h->arg);
+				} else {
+					h->cb(obj->pub, h->arg);
+				}
+				fake_ofono_callback_done(depth);
+				break;
+			}
+		}
+	}
+	fake_ofono_object_unref(obj);
+	g_array_free(ids, TRUE);
+	fake_ofono_leave();
+}
+
+static
+void
+fake_ofono_object_emit(
+	FakeOfonoObject *obj,
+	enum fake_ofono_signal signal)
+{
+	fake_ofono_object_emit_error(obj, signal, NULL);
+}
+
+static
+gboolean
+fake_ofono_object_valid_cb(
+	gpointer data)
+{
+	FakeOfonoObject *obj = data;
+	obj->valid_id = 0;
+	fake_ofono.pending--;
+	*obj->valid = TRUE;
+	fake_ofono_object_emit(obj, FAKE_SIGNAL_VALID);
+	return G_SOURCE_REMOVE;
+}
+
+static
+gulong
+fake_ofono_object_add_handler(
+	FakeOfonoObject *obj,
+	enum fake_ofono_signal signal,
+	void *cb,
+	void *arg)
+{
+	struct fake_ofono_handler *h;
+
+	fake_ofono_enter();
+	h = g_new0(struct fake_ofono_handler, 1);
+	h->id = ++fake_ofono.last_id;
+	h->signal = signal;
+	h->cb = cb;
+	h->arg = arg;
+	obj->handlers = g_slist_append(obj->handlers, h);
+	fake_ofono_leave();
+	return h->id;
+}
+
+static
+void
+fake_ofono_object_remove_handler(
+	FakeOfonoObject *obj,
+	gulong id)
+{
+	GSList *l;
+	for (l = obj->handlers; l && id; l = l->next) {
+		struct fake_ofono_handler *h = l->data;
+		if (h->id == id) {
+			obj->handlers = g_slist_delete_link(obj->handlers, l);
+			g_free(h);
+			break;
+		}
+	}
+}
+
+static
+FakeOfonoModem *
+fake_ofono_find_modem(
+	const char *path)
+{
+	GSList *l;
+	for (l = fake_ofono.modems; l; l = l->next) {
+		FakeOfonoModem *modem = l->data;
+		if (!g_strcmp0(modem->path, path)) {
+			return modem;
+		}
+	}
+	return NULL;
+}
+
+/*==========================================================================*
+ * OfonoManager
+ *==========================================================================*/
+
+static
+void
+fake_ofono_manager_finalize(
+	void *pub)
+{
+	FakeOfonoManager *self = pub;
+	fake_ofono.manager = NULL;
+	g_free(self);
+}
+
+OfonoManager *
+ofono_manager_new(void)
+{
+	fake_ofono_enter();
+	if (fake_ofono.manager) {
+		fake_ofono_object_ref(&fake_ofono.manager->obj);
+	} else {
+		FakeOfonoManager *self = g_new0(FakeOfonoManager, 1);
+		fake_ofono_object_init(&self->obj, self, &self->pub.valid,
+			fake_ofono.manager_delay, fake_ofono_manager_finalize);
+		fake_ofono.manager = self;
+	}
+	fake_ofono_leave();
+	return &fake_ofono.manager->pub;
+}
+
+void
+ofono_manager_unref(
+	OfonoManager *manager)
+{
+	if (manager) {
+		fake_ofono_object_unref(&((FakeOfonoManager*)manager)->obj);
+	}
+}
+
+GPtrArray *
+ofono_manager_get_modems(
+	OfonoManager *manager)
+{
+	return fake_ofono.modem_list;
+}
+
+gulong
+ofono_manager_add_modem_added_handler(
+	OfonoManager *manager,
+	OfonoManagerModemAddedHandler handler,
+	void *arg)
+{
+	return fake_ofono_object_add_handler(&((FakeOfonoManager*)manager)->obj,
+		FAKE_SIGNAL_MODEM_ADDED, handler, arg);
+}
+
+static
+void
+fake_ofono_manager_emit_modem_added(
+	FakeOfonoModem *modem)
+{
+	FakeOfonoManager *self = fake_ofono.manager;
+	if (self && self->pub.valid) {
+		FakeOfonoObject *obj = &self->obj;
+		GArray *ids;
+		GSList *l;
+		guint i;
+
+		fake_ofono_enter();
+		ids = g_array_new(FALSE, FALSE, sizeof(gulong));
+
+		/* Same as fake_ofono_object_emit but with an extra argument */
+		for (l = obj->handlers; l; l = l->next) {
+			const struct fake_ofono_handler *h = l->data;
+			if (h->signal == FAKE_SIGNAL_MODEM_ADDED) {
+				g_array_append_val(ids, h->id);
+			}
+		}
+		fake_ofono_object_ref(obj);
+		for (i = 0; i < ids->len; i++) {
+			const gulong id = g_array_index(ids, gulong, i);
+			for (l = obj->handlers; l; l = l->next) {
+				const struct fake_ofono_handler *h = l->data;
+				if (h->id == id) {
+					const guint depth = fake_ofono_callback();
+
+					((OfonoManagerModemAddedHandler)h->cb)(&self->pub,
+						&modem->pub, h->arg);
+					fake_ofono_callback_done(depth);
+					break;
+				}
+			}
+		}
+		fake_ofono_object_unref(obj);
+		g_array_free(ids, TRUE);
+		fake_ofono_leave();
+	}
+}
+
+gulong
+ofono_manager_add_valid_changed_handler(
+	OfonoManager *manager,
+	OfonoManagerHandler handler,
+	void *arg)
+{
+	return fake_ofono_object_add_handler(&((FakeOfonoManager*)manager)->obj,
+		FAKE_SIGNAL_VALID, handler, arg);
+}
+
+void
+ofono_manager_remove_handler(
+	OfonoManager *manager,
+	gulong id)
+{
+	if (manager) {
+		fake_ofono_object_remove_handler(&((FakeOfonoManager*)manager)->obj,
+			id);
+	}
+}
+
+/*==========================================================================*
+ * OfonoModem
+ *==========================================================================*/
+
+const char *
+ofono_modem_path(
+	OfonoModem *modem)
+{
+	return modem ? ((FakeOfonoModem*)modem)->path : NULL;
+}
+
+/*==========================================================================*
+ * OfonoSimMgr
+ *==========================================================================*/
+
+static
+void
+fake_ofono_simmgr_finalize(
+	void *pub)
+{
+	FakeOfonoSimMgr *self = pub;
+	if (self->modem) {
+		self->modem->simmgr = NULL;
+	}
+	g_free(self->path);
+	g_free(self);
+}
+
+OfonoSimMgr *
+ofono_simmgr_new(
+	const char *path)
+{
+	FakeOfonoModem *modem = fake_ofono_find_modem(path);
+	FakeOfonoSimMgr *self;
+
+	if (modem && modem->simmgr) {
+		fake_ofono_object_ref(&modem->simmgr->obj);
+		return &modem->simmgr->pub;
+	}
+	fake_ofono_enter();
+	self = g_new0(FakeOfonoSimMgr, 1);
+	self->path = g_strdup(path);
+	if (modem) {
+		self->modem = modem;
+		self->pub.present = (modem->imsi != NULL);
+		self->pub.imsi = modem->imsi;
+		modem->simmgr = self;
+		fake_ofono_object_init(&self->obj, self, &self->pub.object.valid,
+			modem->simmgr_delay, fake_ofono_simmgr_finalize);
+	} else {
+		/* Never becomes valid */
+		fake_ofono_object_init(&self->obj, self, &self->pub.object.valid,
+			G_MAXUINT, fake_ofono_simmgr_finalize);
+	}
+	fake_ofono_leave();
+	return &self->pub;
+}
+
+void
+ofono_simmgr_unref(
+	OfonoSimMgr *simmgr)
+{
+	if (simmgr) {
+		fake_ofono_object_unref(&((FakeOfonoSimMgr*)simmgr)->obj);
+	}
+}
+
+gboolean
+ofono_simmgr_valid(
+	OfonoSimMgr *simmgr)
+{
+	return simmgr && simmgr->object.valid;
+}
+
+const char *
+ofono_simmgr_path(
+	OfonoSimMgr *simmgr)
+{
+	return simmgr ? ((FakeOfonoSimMgr*)simmgr)->path : NULL;
+}
+
+gulong
+ofono_simmgr_add_valid_changed_handler(
+	OfonoSimMgr *simmgr,
+	OfonoSimMgrHandler handler,
+	void *arg)
+{
+	return fake_ofono_object_add_handler(&((FakeOfonoSimMgr*)simmgr)->obj,
+		FAKE_SIGNAL_VALID, handler, arg);
+}
+
+gulong
+ofono_simmgr_add_present_changed_handler(
+	OfonoSimMgr *simmgr,
+	OfonoSimMgrHandler handler,
+	void *arg)
+{
+	return fake_ofono_object_add_handler(&((FakeOfonoSimMgr*)simmgr)->obj,
+		FAKE_SIGNAL_PRESENT, handler, arg);
+}
+
+gulong
+ofono_simmgr_add_imsi_changed_handler(
+	OfonoSimMgr *simmgr,
+	OfonoSimMgrHandler handler,
+	void *arg)
+{
+	return fake_ofono_object_add_handler(&((FakeOfonoSimMgr*)simmgr)->obj,
+		FAKE_SIGNAL_IMSI, handler, arg);
+}
+
+void
+ofono_simmgr_remove_handler(
+	OfonoSimMgr *simmgr,
+	gulong id)
+{
+	if (simmgr) {
+		fake_ofono_object_remove_handler(&((FakeOfonoSimMgr*)simmgr)->obj,
+			id);
+	}
+}
+
+/*==========================================================================*
+ * OfonoConnCtx
+ *==========================================================================*/
+
+static
+void
+fake_ofono_connctx_finalize(
+	void *pub)
+{
+	FakeOfonoConnCtx *self = pub;
+	if (self->modem) {
+		self->modem->connctx[self->pub.type] = NULL;
+	}
+	g_free(self->path);
+	g_free(self);
+}
+
+/* Public fields point to the values stored in the modem */
+static
+void
+fake_ofono_connctx_update(
+	FakeOfonoConnCtx *self)
+{
+	OfonoConnCtx *pub = &self->pub;
+	if (self->modem) {
+		GHashTable *props = self->modem->props[pub->type];
+		const char *auth = g_hash_table_lookup(props,
+			OFONO_CONNCTX_PROPERTY_AUTH);
+		pub->name = g_hash_table_lookup(props, OFONO_CONNCTX_PROPERTY_NAME);
+		pub->apn = g_hash_table_lookup(props, OFONO_CONNCTX_PROPERTY_APN);
+		pub->username = g_hash_table_lookup(props,
+			OFONO_CONNCTX_PROPERTY_USERNAME);
+		pub->password = g_hash_table_lookup(props,
+			OFONO_CONNCTX_PROPERTY_PASSWORD);
+		pub->mms_proxy = g_hash_table_lookup(props,
+			OFONO_CONNCTX_PROPERTY_MMS_PROXY);
+		pub->mms_center = g_hash_table_lookup(props,
+			OFONO_CONNCTX_PROPERTY_MMS_CENTER);
+		pub->auth = !g_strcmp0(auth, "none") ? OFONO_CONNCTX_AUTH_NONE :
+			!g_strcmp0(auth, "pap") ? OFONO_CONNCTX_AUTH_PAP :
+			!g_strcmp0(auth, "chap") ? OFONO_CONNCTX_AUTH_CHAP :
+			OFONO_CONNCTX_AUTH_ANY;
+	} else {
+		pub->name = pub->apn = pub->username = pub->password =
+			pub->mms_proxy = pub->mms_center = NULL;
+	}
+}
+
+static
+FakeOfonoConnCtx *
+fake_ofono_connctx_new(
+	FakeOfonoModem *modem,
+	OFONO_CONNCTX_TYPE type)
+{
+	FakeOfonoConnCtx *self = modem->connctx[type];
+	if (self) {
+		fake_ofono_object_ref(&self->obj);
+	} else {
+		self = g_new0(FakeOfonoConnCtx, 1);
+		self->modem = modem;
+		self->path = g_strdup_printf("%s/context%d", modem->path, type);
+		self->pub.type = type;
+		self->pub.active = modem->active[type];
+		modem->connctx[type] = self;
+		fake_ofono_connctx_update(self);
+		fake_ofono_object_init(&self->obj, self, &self->pub.object.valid,
+			modem->connctx_delay, fake_ofono_connctx_finalize);
+	}
+	return self;
+}
+
+OfonoConnCtx *
+ofono_connctx_ref(
+	OfonoConnCtx *ctx)
+{
+	if (ctx) {
+		fake_ofono_object_ref(&((FakeOfonoConnCtx*)ctx)->obj);
+	}
+	return ctx;
+}
+
+void
+ofono_connctx_unref(
+	OfonoConnCtx *ctx)
+{
+	if (ctx) {
+		fake_ofono_object_unref(&((FakeOfonoConnCtx*)ctx)->obj);
+	}
+}
+
+gboolean
+ofono_connctx_valid(
+	OfonoConnCtx *ctx)
+{
+	return ctx && ctx->object.valid;
+}
+
+const char *
+ofono_connctx_path(
+	OfonoConnCtx *ctx)
+{
+	return ctx ? ((FakeOfonoConnCtx*)ctx)->path : NULL;
+}
+
+const char *
+ofono_connctx_auth_string(
+	OFONO_CONNCTX_AUTH auth)
+{
+	switch (auth) {
+	case OFONO_CONNCTX_AUTH_NONE: return "none";
+	case OFONO_CONNCTX_AUTH_PAP: return "pap";
+	case OFONO_CONNCTX_AUTH_CHAP: return "chap";
+	case OFONO_CONNCTX_AUTH_ANY: break;
+	}
+	return "any";
+}
+
+static
+void
+fake_ofono_connctx_set_active(
+	FakeOfonoConnCtx *self,
+	gboolean active)
+{
+	if (self->modem) {
+		self->modem->active[self->pub.type] = active;
+	}
+	if (self->pub.active != active) {
+		self->pub.active = active;
+		fake_ofono_object_emit(&self->obj, FAKE_SIGNAL_ACTIVE);
+	}
+}
+
+static
+void
+fake_ofono_call_free(
+	struct fake_ofono_call *call)
+{
+	fake_ofono_object_unref(&call->ctx->obj);
+	g_object_unref(call->cancel);
+	if (call->error) {
+		g_error_free(call->error);
+	}
+	g_free(call->name);
+	g_free(call->value);
+	g_free(call);
+}
+
+static
+gboolean
+fake_ofono_call_done(
+	gpointer data)
+{
+	struct fake_ofono_call *call = data;
+	FakeOfonoConnCtx *self = call->ctx;
+
+	fake_ofono_enter();
+	call->id = 0;
+	fake_ofono.calls = g_slist_remove(fake_ofono.calls, call);
+	if (!g_cancellable_is_cancelled(call->cancel)) {
+		if (!call->name) {
+			if (call->error) {
+				fake_ofono_object_emit_error(&self->obj,
+					FAKE_SIGNAL_ACTIVATE_FAILED, call->error);
+			} else {
+				fake_ofono_connctx_set_active(self, call->active);
+			}
+		} else {
+			if (!call->error && self->modem) {
+				g_hash_table_replace(self->modem->props[self->pub.type],
+					g_strdup(call->name), g_strdup(call->value));
+				fake_ofono_connctx_update(self);
+			}
+			if (call->done) {
+				const guint depth = fake_ofono_callback();
+
+				call->done(&self->pub, call->error, call->arg);
+				fake_ofono_callback_done(depth);
+			}
+		}
+	}
+	fake_ofono_call_free(call);
+	fake_ofono_leave();
+	return G_SOURCE_REMOVE;
+}
+
+static
+struct fake_ofono_call *
+fake_ofono_call_new(
+	FakeOfonoConnCtx *self,
+	gboolean set)
+{
+	FakeOfonoModem *modem = self->modem;
+	const guint latency = !modem ? 0 :
+		set ? modem->set_latency : modem->activate_latency;
+	struct fake_ofono_call *call;
+
+	fake_ofono_enter();
+	call = g_new0(struct fake_ofono_call, 1);
+	fake_ofono_object_ref(&self->obj);
+	call->ctx = self;
+	call->cancel = g_cancellable_new();
+	call->id = latency ?
+		g_timeout_add(latency, fake_ofono_call_done, call) :
+		g_idle_add(fake_ofono_call_done, call);
+	fake_ofono.calls = g_slist_append(fake_ofono.calls, call);
+	fake_ofono_leave();
+	return call;
+}
+
+gboolean
+ofono_connctx_activate(
+	OfonoConnCtx *ctx)
+{
+	FakeOfonoConnCtx *self = (FakeOfonoConnCtx*)ctx;
+	struct fake_ofono_call *call;
+
+	fake_ofono_enter();
+	call = fake_ofono_call_new(self, FALSE);
+	call->active = TRUE;
+	if (self->modem) {
+		/* Like writing the Active property */
+		struct fake_ofono_failure *failure = g_hash_table_lookup(
+			self->modem->failures[ctx->type],
+			OFONO_CONNCTX_PROPERTY_ACTIVE);
+		if (failure && failure->count) {
+			failure->count--;
+			call->error = g_error_new(OFONO_ERROR, failure->code,
+				"Scripted failure %d", failure->code);
+		}
+	}
+	fake_ofono_leave();
+	return TRUE;
+}
+
+gboolean
+ofono_connctx_deactivate(
+	OfonoConnCtx *ctx)
+{
+	fake_ofono_call_new((FakeOfonoConnCtx*)ctx, FALSE)->active = FALSE;
+	return TRUE;
+}
+
+GCancellable *
+ofono_connctx_set_string_full(
+	OfonoConnCtx *ctx,
+	const char *name,
+	const char *value,
+	OfonoConnCtxCallFinishedCallback done,
+	void *arg)
+{
+	FakeOfonoConnCtx *self = (FakeOfonoConnCtx*)ctx;
+	struct fake_ofono_call *call;
+
+	fake_ofono_enter();
+	call = fake_ofono_call_new(self, TRUE);
+	call->name = g_strdup(name);
+	call->value = g_strdup(value);
+	call->done = done;
+	call->arg = arg;
+	if (self->modem) {
+		struct fake_ofono_failure *failure =
+			g_hash_table_lookup(self->modem->failures[ctx->type], name);
+		if (failure && failure->count) {
+			failure->count--;
+			call->error = g_error_new(OFONO_ERROR, failure->code,
+				"Scripted failure %d", failure->code);
+		}
+	}
+	if (!call->error && ctx->active) {
+		/* Like ofono, which doesn't let an active context be changed */
+		call->error = g_error_new(OFONO_ERROR, OFONO_ERROR_IN_USE,
+			"Context is active");
+	}
+	fake_ofono.ncalls++;
+	fake_ofono_leave();
+	return call->cancel;
+}
+
+gulong
+ofono_connctx_add_valid_changed_handler(
+	OfonoConnCtx *ctx,
+	OfonoConnCtxHandler handler,
+	void *arg)
+{
+	return fake_ofono_object_add_handler(&((FakeOfonoConnCtx*)ctx)->obj,
+		FAKE_SIGNAL_VALID, handler, arg);
+}
+
+gulong
+ofono_connctx_add_active_changed_handler(
+	OfonoConnCtx *ctx,
+	OfonoConnCtxHandler handler,
+	void *arg)
+{
+	return fake_ofono_object_add_handler(&((FakeOfonoConnCtx*)ctx)->obj,
+		FAKE_SIGNAL_ACTIVE, handler, arg);
+}
+
+gulong
+ofono_connctx_add_activate_failed_handler(
+	OfonoConnCtx *ctx,
+	OfonoConnCtxErrorHandler handler,
+	void *arg)
+{
+	return fake_ofono_object_add_handler(&((FakeOfonoConnCtx*)ctx)->obj,
+		FAKE_SIGNAL_ACTIVATE_FAILED, handler, arg);
+}
+
+void
+ofono_connctx_remove_handler(
+	OfonoConnCtx *ctx,
+	gulong id)
+{
+	if (ctx) {
+		fake_ofono_object_remove_handler(&((FakeOfonoConnCtx*)ctx)->obj,
+			id);
+	}
+}
+
+/*==========================================================================*
+ * OfonoConnMgr
+ *==========================================================================*/
+
+static
+void
+fake_ofono_connmgr_finalize(
+	void *pub)
+{
+	FakeOfonoConnMgr *self = pub;
+	int i;
+	for (i = 0; i < FAKE_CONTEXT_TYPES; i++) {
+		if (self->ctx[i]) {
+			fake_ofono_object_unref(&self->ctx[i]->obj);
+		}
+	}
+	if (self->modem) {
+		self->modem->connmgr = NULL;
+	}
+	g_free(self->path);
+	g_free(self);
+}
+
+OfonoConnMgr *
+ofono_connmgr_new(
+	const char *path)
+{
+	FakeOfonoModem *modem = fake_ofono_find_modem(path);
+	FakeOfonoConnMgr *self;
+
+	if (modem && modem->connmgr) {
+		fake_ofono_object_ref(&modem->connmgr->obj);
+		return &modem->connmgr->pub;
+	}
+	fake_ofono_enter();
+	self = g_new0(FakeOfonoConnMgr, 1);
+	self->path = g_strdup(path);
+	if (modem) {
+		self->modem = modem;
+		self->ctx[OFONO_CONNCTX_TYPE_INTERNET] =
+			fake_ofono_connctx_new(modem, OFONO_CONNCTX_TYPE_INTERNET);
+		self->ctx[OFONO_CONNCTX_TYPE_MMS] =
+			fake_ofono_connctx_new(modem, OFONO_CONNCTX_TYPE_MMS);
+		modem->connmgr = self;
+		fake_ofono_object_init(&self->obj, self, &self->pub.object.valid,
+			modem->connmgr_delay, fake_ofono_connmgr_finalize);
+	} else {
+		fake_ofono_object_init(&self->obj, self, &self->pub.object.valid,
+			G_MAXUINT, fake_ofono_connmgr_finalize);
+	}
+	fake_ofono_leave();
+	return &self->pub;
+}
+
+void
+ofono_connmgr_unref(
+	OfonoConnMgr *connmgr)
+{
+	if (connmgr) {
+		fake_ofono_object_unref(&((FakeOfonoConnMgr*)connmgr)->obj);
+	}
+}
+
+gboolean
+ofono_connmgr_valid(
+	OfonoConnMgr *connmgr)
+{
+	return connmgr && connmgr->object.valid;
+}
+
+const char *
+ofono_connmgr_path(
+	OfonoConnMgr *connmgr)
+{
+	return connmgr ? ((FakeOfonoConnMgr*)connmgr)->path : NULL;
+}
+
+OfonoConnCtx *
+ofono_connmgr_get_context_for_type(
+	OfonoConnMgr *connmgr,
+	OFONO_CONNCTX_TYPE type)
+{
+	FakeOfonoConnMgr *self = (FakeOfonoConnMgr*)connmgr;
+	if (self && type > OFONO_CONNCTX_TYPE_NONE && type < FAKE_CONTEXT_TYPES &&
+		self->ctx[type]) {
+		return &self->ctx[type]->pub;
+	}
+	return NULL;
+}
+
+gulong
+ofono_connmgr_add_valid_changed_handler(
+	OfonoConnMgr *connmgr,
+	OfonoConnMgrHandler handler,
+	void *arg)
+{
+	return fake_ofono_object_add_handler(&((FakeOfonoConnMgr*)connmgr)->obj,
+		FAKE_SIGNAL_VALID, handler, arg);
+}
+
+void
+ofono_connmgr_remove_handler(
+	OfonoConnMgr *connmgr,
+	gulong id)
+{
+	if (connmgr) {
+		fake_ofono_object_remove_handler(&((FakeOfonoConnMgr*)connmgr)->obj,
+			id);
+	}
+}
+
+GQuark
+ofono_error_quark(void)
+{
+	return g_quark_from_static_string("fake-ofono-error-quark");
+}
+
+/*==========================================================================*
+ * Scripting API
+ *==========================================================================*/
+
+static
+void
+fake_ofono_modem_free(
+	gpointer data)
+{
+	FakeOfonoModem *modem = data;
+	int i;
+
+	/* Whatever is still alive gets detached */
+	if (modem->simmgr) {
+		modem->simmgr->modem = NULL;
+	}
+	if (modem->connmgr) {
+		modem->connmgr->modem = NULL;
+	}
+	for (i = 0; i < FAKE_CONTEXT_TYPES; i++) {
+		if (modem->connctx[i]) {
+			modem->connctx[i]->modem = NULL;
+			fake_ofono_connctx_update(modem->connctx[i]);
+		}
+		g_hash_table_destroy(modem->props[i]);
+		g_hash_table_destroy(modem->failures[i]);
+	}
+	g_free(modem->path);
+	g_free(modem->imsi);
+	g_free(modem);
+}
+
+static
+void
+fake_ofono_call_cancel(
+	gpointer data)
+{
+	struct fake_ofono_call *call = data;
+	g_source_remove(call->id);
+	fake_ofono_call_free(call);
+}
+
+void
+fake_ofono_init(void)
+{
+	fake_ofono_deinit();
+	fake_ofono.modem_list = g_ptr_array_new();
+}
+
+void
+fake_ofono_deinit(void)
+{
+	g_slist_free_full(fake_ofono.calls, fake_ofono_call_cancel);
+	g_slist_free_full(fake_ofono.modems, fake_ofono_modem_free);
+	if (fake_ofono.modem_list) {
+		g_ptr_array_free(fake_ofono.modem_list, TRUE);
+	}
+	fake_ofono.calls = NULL;
+	fake_ofono.modems = NULL;
+	fake_ofono.modem_list = NULL;
+	fake_ofono.manager_delay = 0;
+	fake_ofono.ncalls = 0;
+	fake_ofono.alloc_counter = NULL;
+	fake_ofono.allocs = 0;
+}
+
+void
+fake_ofono_set_manager_delay(
+	guint ms)
+{
+	fake_ofono.manager_delay = ms;
+}
+
+guint
+fake_ofono_calls(void)
+{
+	return fake_ofono.ncalls;
+}
+
+void
+fake_ofono_set_alloc_counter(
+	FakeOfonoAllocCounter counter)
+{
+	fake_ofono.alloc_counter = counter;
+}
+
+guint64
+fake_ofono_allocs(void)
+{
+	return fake_ofono.allocs;
+}
+
+guint
+fake_ofono_objects(void)
+{
+	return fake_ofono.objects;
+}
+
+guint
+fake_ofono_pending_objects(void)
+{
+	return fake_ofono.pending;
+}
+
+FakeOfonoModem *
+fake_ofono_add_modem(
+	const char *path,
+	const char *imsi)
+{
+	FakeOfonoModem *modem = g_new0(FakeOfonoModem, 1);
+	int i;
+
+	modem->path = g_strdup(path);
+	modem->imsi = g_strdup(imsi);
+	modem->pub.object.valid = TRUE;
+	modem->pub.powered = TRUE;
+	modem->pub.online = TRUE;
+	for (i = 0; i < FAKE_CONTEXT_TYPES; i++) {
+		modem->props[i] = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, g_free);
+		modem->failures[i] = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, g_free);
+	}
+	fake_ofono.modems = g_slist_append(fake_ofono.modems, modem);
+	g_ptr_array_add(fake_ofono.modem_list, &modem->pub);
+	fake_ofono_manager_emit_modem_added(modem);
+	return modem;
+}
+
+void
+fake_ofono_modem_set_imsi(
+	FakeOfonoModem *modem,
+	const char *imsi)
+{
+	char *old = modem->imsi;
+	FakeOfonoSimMgr *simmgr = modem->simmgr;
+
+	modem->imsi = g_strdup(imsi);
+	if (simmgr) {
+		const gboolean present = (imsi != NULL);
+		simmgr->pub.imsi = modem->imsi;
+		if (simmgr->pub.object.valid) {
+			fake_ofono_object_ref(&simmgr->obj);
+			if (simmgr->pub.present != present) {
+				simmgr->pub.present = present;
+				fake_ofono_object_emit(&simmgr->obj, FAKE_SIGNAL_PRESENT);
+			}
+			if (g_strcmp0(old, imsi)) {
+				fake_ofono_object_emit(&simmgr->obj, FAKE_SIGNAL_IMSI);
+			}
+			fake_ofono_object_unref(&simmgr->obj);
+		} else {
+			simmgr->pub.present = present;
+		}
+	}
+	g_free(old);
+}
+
+void
+fake_ofono_modem_set_delays(
+	FakeOfonoModem *modem,
+	guint simmgr_ms,
+	guint connmgr_ms,
+	guint connctx_ms)
+{
+	modem->simmgr_delay = simmgr_ms;
+	modem->connmgr_delay = connmgr_ms;
+	modem->connctx_delay = connctx_ms;
+}
+
+void
+fake_ofono_modem_set_latency(
+	FakeOfonoModem *modem,
+	guint set_ms,
+	guint activate_ms)
+{
+	modem->set_latency = set_ms;
+	modem->activate_latency = activate_ms;
+}
+
+void
+fake_ofono_modem_set_active(
+	FakeOfonoModem *modem,
+	OFONO_CONNCTX_TYPE type,
+	gboolean active)
+{
+	modem->active[type] = active;
+	if (modem->connctx[type]) {
+		fake_ofono_connctx_set_active(modem->connctx[type], active);
+	}
+}
+
+gboolean
+fake_ofono_modem_active(
+	FakeOfonoModem *modem,
+	OFONO_CONNCTX_TYPE type)
+{
+	return modem->active[type];
+}
+
+void
+fake_ofono_modem_fail(
+	FakeOfonoModem *modem,
+	OFONO_CONNCTX_TYPE type,
+	const char *property,
+	OFONO_ERROR_CODE code,
+	guint count)
+{
+	struct fake_ofono_failure *failure = g_new0(struct fake_ofono_failure, 1);
+	failure->code = code;
+	failure->count = count;
+	g_hash_table_replace(modem->failures[type], g_strdup(property), failure);
+}
+
+const char *
+fake_ofono_modem_property(
+	FakeOfonoModem *modem,
+	OFONO_CONNCTX_TYPE type,
+	const char *property)
+{
+	return g_hash_table_lookup(modem->props[type], property);
+}
+
+void
+fake_ofono_modem_set_property(
+	FakeOfonoModem *modem,
+	OFONO_CONNCTX_TYPE type,
+	const char *property,
+	const char *value)
+{
+	g_hash_table_replace(modem->props[type], g_strdup(property),
+		g_strdup(value));
+	if (modem->connctx[type]) {
+		fake_ofono_connctx_update(modem->connctx[type]);
+	}
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
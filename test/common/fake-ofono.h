@@ -0,0 +1,145 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef FAKE_OFONO_H
+#define FAKE_OFONO_H
+
+/*
+ * In-process fake of libgofono. Tests which define FAKE_OFONO in their
+ * Makefile get the headers from common/gofono and link this instead of
+ * the real library, no D-Bus is involved.
+ *
+ * Objects are created when the service asks for them and become valid
+ * after the configured delay (immediately if it's zero). Calls complete
+ * asynchronously after the latency configured for the modem and the
+ * method. All delays are in milliseconds.
+ */
+
+#include <gofono_connctx.h>
+#include <gofono_error.h>
+
+typedef struct fake_ofono_modem FakeOfonoModem;
+
+/* Total number of heap allocations made so far, e.g. by test-malloc.c */
+typedef guint64 (*FakeOfonoAllocCounter)(void);
+
+/* Drops all modems and resets the settings */
+void
+fake_ofono_init(void);
+
+void
+fake_ofono_deinit(void);
+
+void
+fake_ofono_set_manager_delay(
+	guint ms);
+
+/* Number of SetProperty calls made since init */
+guint
+fake_ofono_calls(void);
+
+/*
+ * With the counter set, the fake keeps track of the allocations made
+ * by its own code (not by the callbacks it invokes), so that the tests
+ * can tell them apart from those made by the service.
+ */
+void
+fake_ofono_set_alloc_counter(
+	FakeOfonoAllocCounter counter);
+
+guint64
+fake_ofono_allocs(void);
+
+/* Number of fake objects which are still alive */
+guint
+fake_ofono_objects(void);
+
+/* Number of those still waiting for their delay to become valid */
+guint
+fake_ofono_pending_objects(void);
+
+/* NULL imsi means no SIM. Existing managers emit modem-added */
+FakeOfonoModem *
+fake_ofono_add_modem(
+	const char *path,
+	const char *imsi);
+
+/* Inserts (or removes, if imsi is NULL) the SIM */
+void
+fake_ofono_modem_set_imsi(
+	FakeOfonoModem *modem,
+	const char *imsi);
+
+void
+fake_ofono_modem_set_delays(
+	FakeOfonoModem *modem,
+	guint simmgr_ms,
+	guint connmgr_ms,
+	guint connctx_ms);
+
+/* Latency of SetProperty and (de)activation calls on its contexts */
+void
+fake_ofono_modem_set_latency(
+	FakeOfonoModem *modem,
+	guint set_ms,
+	guint activate_ms);
+
+/* Applies to the existing context and to the future ones */
+void
+fake_ofono_modem_set_active(
+	FakeOfonoModem *modem,
+	OFONO_CONNCTX_TYPE type,
+	gboolean active);
+
+gboolean
+fake_ofono_modem_active(
+	FakeOfonoModem *modem,
+	OFONO_CONNCTX_TYPE type);
+
+/*
+ * Fails the next count attempts to set this property. Activation counts
+ * as setting OFONO_CONNCTX_PROPERTY_ACTIVE, it fails with activate-failed.
+ */
+void
+fake_ofono_modem_fail(
+	FakeOfonoModem *modem,
+	OFONO_CONNCTX_TYPE type,
+	const char *property,
+	OFONO_ERROR_CODE code,
+	guint count);
+
+/* Sets the current value, as if it had been written earlier */
+void
+fake_ofono_modem_set_property(
+	FakeOfonoModem *modem,
+	OFONO_CONNCTX_TYPE type,
+	const char *property,
+	const char *value);
+
+/* Last value successfully written to the property, NULL if none */
+const char *
+fake_ofono_modem_property(
+	FakeOfonoModem *modem,
+	OFONO_CONNCTX_TYPE type,
+	const char *property);
+
+#endif /* FAKE_OFONO_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,120 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef GOFONO_CONNCTX_H
+#define GOFONO_CONNCTX_H
+
+#include "gofono_types.h"
+
+typedef enum ofono_connctx_type {
+	OFONO_CONNCTX_TYPE_NONE,
+	OFONO_CONNCTX_TYPE_INTERNET,
+	OFONO_CONNCTX_TYPE_MMS
+} OFONO_CONNCTX_TYPE;
+
+typedef enum ofono_connctx_auth {
+	OFONO_CONNCTX_AUTH_NONE,
+	OFONO_CONNCTX_AUTH_ANY,
+	OFONO_CONNCTX_AUTH_PAP,
+	OFONO_CONNCTX_AUTH_CHAP
+} OFONO_CONNCTX_AUTH;
+
+struct ofono_connctx {
+	OfonoObject object;
+	gboolean active;
+	const char *apn;
+	OFONO_CONNCTX_TYPE type;
+	const char *username;
+	const char *password;
+	const char *name;
+	const char *mms_proxy;
+	const char *mms_center;
+	OFONO_CONNCTX_AUTH auth;
+};
+
+typedef void (*OfonoConnCtxHandler)(OfonoConnCtx *ctx, void *arg);
+typedef void (*OfonoConnCtxCallFinishedCallback)(OfonoConnCtx *ctx,
+	const GError *error, void *arg);
+typedef void (*OfonoConnCtxErrorHandler)(OfonoConnCtx *ctx,
+	const GError *error, void *arg);
+
+OfonoConnCtx *
+ofono_connctx_ref(
+	OfonoConnCtx *ctx);
+
+void
+ofono_connctx_unref(
+	OfonoConnCtx *ctx);
+
+gboolean
+ofono_connctx_valid(
+	OfonoConnCtx *ctx);
+
+const char *
+ofono_connctx_path(
+	OfonoConnCtx *ctx);
+
+const char *
+ofono_connctx_auth_string(
+	OFONO_CONNCTX_AUTH auth);
+
+gboolean
+ofono_connctx_activate(
+	OfonoConnCtx *ctx);
+
+gboolean
+ofono_connctx_deactivate(
+	OfonoConnCtx *ctx);
+
+/* The returned GCancellable belongs to the call */
+GCancellable *
+ofono_connctx_set_string_full(
+	OfonoConnCtx *ctx,
+	const char *name,
+	const char *value,
+	OfonoConnCtxCallFinishedCallback done,
+	void *arg);
+
+gulong
+ofono_connctx_add_valid_changed_handler(
+	OfonoConnCtx *ctx,
+	OfonoConnCtxHandler handler,
+	void *arg);
+
+gulong
+ofono_connctx_add_active_changed_handler(
+	OfonoConnCtx *ctx,
+	OfonoConnCtxHandler handler,
+	void *arg);
+
+gulong
+ofono_connctx_add_activate_failed_handler(
+	OfonoConnCtx *ctx,
+	OfonoConnCtxErrorHandler handler,
+	void *arg);
+
+void
+ofono_connctx_remove_handler(
+	OfonoConnCtx *ctx,
+	gulong id);
+
+#endif /* GOFONO_CONNCTX_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,67 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef GOFONO_CONNMGR_H
+#define GOFONO_CONNMGR_H
+
+#include "gofono_connctx.h"
+
+struct ofono_connmgr {
+	OfonoObject object;
+	gboolean attached;
+};
+
+typedef void (*OfonoConnMgrHandler)(OfonoConnMgr *connmgr, void *arg);
+
+OfonoConnMgr *
+ofono_connmgr_new(
+	const char *path);
+
+void
+ofono_connmgr_unref(
+	OfonoConnMgr *connmgr);
+
+gboolean
+ofono_connmgr_valid(
+	OfonoConnMgr *connmgr);
+
+const char *
+ofono_connmgr_path(
+	OfonoConnMgr *connmgr);
+
+OfonoConnCtx *
+ofono_connmgr_get_context_for_type(
+	OfonoConnMgr *connmgr,
+	OFONO_CONNCTX_TYPE type);
+
+gulong
+ofono_connmgr_add_valid_changed_handler(
+	OfonoConnMgr *connmgr,
+	OfonoConnMgrHandler handler,
+	void *arg);
+
+void
+ofono_connmgr_remove_handler(
+	OfonoConnMgr *connmgr,
+	gulong id);
+
+#endif /* GOFONO_CONNMGR_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,44 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef GOFONO_ERROR_H
+#define GOFONO_ERROR_H
+
+#include "gofono_types.h"
+
+#define OFONO_ERROR (ofono_error_quark())
+
+typedef enum ofono_error_code {
+	OFONO_ERROR_FAILED,
+	OFONO_ERROR_ATTACH_IN_PROGRESS,
+	OFONO_ERROR_IN_PROGRESS,
+	OFONO_ERROR_IN_USE,
+	OFONO_ERROR_INVALID_ARGS,
+	OFONO_ERROR_NOT_ALLOWED,
+	OFONO_ERROR_SIM_NOT_READY,
+	OFONO_ERROR_TIMED_OUT
+} OFONO_ERROR_CODE;
+
+GQuark
+ofono_error_quark(void);
+
+#endif /* GOFONO_ERROR_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,64 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef GOFONO_MANAGER_H
+#define GOFONO_MANAGER_H
+
+#include "gofono_types.h"
+
+struct ofono_manager {
+	gboolean valid;
+};
+
+typedef void (*OfonoManagerHandler)(OfonoManager *manager, void *arg);
+typedef void (*OfonoManagerModemAddedHandler)(OfonoManager *manager,
+	OfonoModem *modem, void *arg);
+
+OfonoManager *
+ofono_manager_new(void);
+
+void
+ofono_manager_unref(
+	OfonoManager *manager);
+
+GPtrArray *
+ofono_manager_get_modems(
+	OfonoManager *manager);
+
+gulong
+ofono_manager_add_valid_changed_handler(
+	OfonoManager *manager,
+	OfonoManagerHandler handler,
+	void *arg);
+
+gulong
+ofono_manager_add_modem_added_handler(
+	OfonoManager *manager,
+	OfonoManagerModemAddedHandler handler,
+	void *arg);
+
+void
+ofono_manager_remove_handler(
+	OfonoManager *manager,
+	gulong id);
+
+#endif /* GOFONO_MANAGER_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
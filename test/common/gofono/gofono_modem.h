@@ -0,0 +1,38 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef GOFONO_MODEM_H
+#define GOFONO_MODEM_H
+
+#include "gofono_types.h"
+
+struct ofono_modem {
+	OfonoObject object;
+	gboolean powered;
+	gboolean online;
+};
+
+const char *
+ofono_modem_path(
+	OfonoModem *modem);
+
+#endif /* GOFONO_MODEM_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
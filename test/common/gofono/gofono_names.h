@@ -0,0 +1,35 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef GOFONO_NAMES_H
+#define GOFONO_NAMES_H
+
+#define OFONO_CONNCTX_PROPERTY_ACTIVE "Active"
+#define OFONO_CONNCTX_PROPERTY_NAME "Name"
+#define OFONO_CONNCTX_PROPERTY_APN "AccessPointName"
+#define OFONO_CONNCTX_PROPERTY_USERNAME "Username"
+#define OFONO_CONNCTX_PROPERTY_PASSWORD "Password"
+#define OFONO_CONNCTX_PROPERTY_AUTH "AuthenticationMethod"
+#define OFONO_CONNCTX_PROPERTY_MMS_PROXY "MessageProxy"
+#define OFONO_CONNCTX_PROPERTY_MMS_CENTER "MessageCenter"
+
+#endif /* GOFONO_NAMES_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,75 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef GOFONO_SIMMGR_H
+#define GOFONO_SIMMGR_H
+
+#include "gofono_types.h"
+
+struct ofono_simmgr {
+	OfonoObject object;
+	gboolean present;
+	const char *imsi;
+};
+
+typedef void (*OfonoSimMgrHandler)(OfonoSimMgr *simmgr, void *arg);
+
+OfonoSimMgr *
+ofono_simmgr_new(
+	const char *path);
+
+void
+ofono_simmgr_unref(
+	OfonoSimMgr *simmgr);
+
+gboolean
+ofono_simmgr_valid(
+	OfonoSimMgr *simmgr);
+
+const char *
+ofono_simmgr_path(
+	OfonoSimMgr *simmgr);
+
+gulong
+ofono_simmgr_add_valid_changed_handler(
+	OfonoSimMgr *simmgr,
+	OfonoSimMgrHandler handler,
+	void *arg);
+
+gulong
+ofono_simmgr_add_present_changed_handler(
+	OfonoSimMgr *simmgr,
+	OfonoSimMgrHandler handler,
+	void *arg);
+
+gulong
+ofono_simmgr_add_imsi_changed_handler(
+	OfonoSimMgr *simmgr,
+	OfonoSimMgrHandler handler,
+	void *arg);
+
+void
+ofono_simmgr_remove_handler(
+	OfonoSimMgr *simmgr,
+	gulong id);
+
+#endif /* GOFONO_SIMMGR_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
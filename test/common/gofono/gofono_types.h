@@ -0,0 +1,43 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef GOFONO_TYPES_H
+#define GOFONO_TYPES_H
+
+/*
+ * Fake libgofono, implemented by fake-ofono.c. Only declares what the
+ * service is using, field names match the real library.
+ */
+
+#include <gio/gio.h>
+
+typedef struct ofono_object {
+	gboolean valid;
+} OfonoObject;
+
+typedef struct ofono_manager OfonoManager;
+typedef struct ofono_modem OfonoModem;
+typedef struct ofono_simmgr OfonoSimMgr;
+typedef struct ofono_connmgr OfonoConnMgr;
+typedef struct ofono_connctx OfonoConnCtx;
+
+#endif /* GOFONO_TYPES_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
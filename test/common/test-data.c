@@ -0,0 +1,46 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-data.h"
+
+struct provisioning_data *
+test_data_new(void)
+{
+	struct provisioning_data *data = provisioning_data_new();
+	struct provisioning_internet *internet =
+		g_new0(struct provisioning_internet, 1);
+	struct provisioning_mms *mms = g_new0(struct provisioning_mms, 1);
+
+	internet->name = g_strdup("Internet");
+	internet->apn = g_strdup("internet");
+	internet->username = g_strdup("user");
+	internet->password = g_strdup("secret");
+	internet->authtype = AUTH_PAP;
+	mms->name = g_strdup("MMS");
+	mms->apn = g_strdup("mms");
+	mms->messageproxy = g_strdup("10.0.0.1");
+	mms->portnro = g_strdup("8080");
+	mms->messagecenter = g_strdup("http://mms/");
+	data->internet = internet;
+	data->mms = mms;
+	return data;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,35 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef TEST_DATA_H
+#define TEST_DATA_H
+
+#include "provisioning-decoder.h"
+
+/*
+ * Decoded settings with both the internet and the MMS context filled
+ * in, as if they came from a push message. Needs provisioning-decoder.c
+ */
+struct provisioning_data *
+test_data_new(void);
+
+#endif /* TEST_DATA_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,78 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-dir.h"
+
+#include <glib/gstdio.h>
+
+static
+void
+test_dir_remove(
+	const char *path)
+{
+	if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+		GDir *dir = g_dir_open(path, 0, NULL);
+		if (dir) {
+			const char *name;
+			while ((name = g_dir_read_name(dir)) != NULL) {
+				char *child = g_build_filename(path, name, NULL);
+				test_dir_remove(child);
+				g_free(child);
+			}
+			g_dir_close(dir);
+		}
+		g_rmdir(path);
+	} else {
+		g_unlink(path);
+	}
+}
+
+void
+test_dir_init(
+	TestDir *test,
+	const char *file)
+{
+	test->path = g_dir_make_tmp("test-XXXXXX", NULL);
+	g_assert(test->path);
+	test->file = g_build_filename(test->path, file, NULL);
+}
+
+char *
+test_dir_write(
+	TestDir *test,
+	const char *name,
+	const char *contents)
+{
+	char *path = g_build_filename(test->path, name, NULL);
+	g_assert(g_file_set_contents(path, contents, -1, NULL));
+	return path;
+}
+
+void
+test_dir_deinit(
+	TestDir *test)
+{
+	test_dir_remove(test->path);
+	g_assert(!g_file_test(test->path, G_FILE_TEST_EXISTS));
+	g_free(test->file);
+	g_free(test->path);
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,55 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef TEST_DIR_H
+#define TEST_DIR_H
+
+#include <glib.h>
+
+/*
+ * Temporary directory for the tests which write files. The file is a
+ * path (possibly in a subdirectory) which doesn't exist until the code
+ * under test creates it.
+ */
+typedef struct test_dir {
+	char *path;
+	char *file;
+} TestDir;
+
+void
+test_dir_init(
+	TestDir *test,
+	const char *file);
+
+/* Writes another file into the directory, returns its path */
+char *
+test_dir_write(
+	TestDir *test,
+	const char *name,
+	const char *contents);
+
+/* Removes the directory with everything in it */
+void
+test_dir_deinit(
+	TestDir *test);
+
+#endif /* TEST_DIR_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,86 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-malloc.h"
+
+#include <stdlib.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static TestMallocStats test_malloc_stats;
+
+#define TEST_MALLOC_ADD(field,n) \
+	__atomic_add_fetch(&test_malloc_stats.field, n, __ATOMIC_RELAXED)
+
+void *
+malloc(
+	size_t size)
+{
+	TEST_MALLOC_ADD(allocs, 1);
+	TEST_MALLOC_ADD(bytes, size);
+	return __libc_malloc(size);
+}
+
+void *
+calloc(
+	size_t nmemb,
+	size_t size)
+{
+	TEST_MALLOC_ADD(allocs, 1);
+	TEST_MALLOC_ADD(bytes, nmemb * size);
+	return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(
+	void *ptr,
+	size_t size)
+{
+	TEST_MALLOC_ADD(allocs, 1);
+	TEST_MALLOC_ADD(bytes, size);
+	return __libc_realloc(ptr, size);
+}
+
+void
+free(
+	void *ptr)
+{
+	if (ptr) {
+		TEST_MALLOC_ADD(frees, 1);
+		__libc_free(ptr);
+	}
+}
+
+void
+test_malloc_get_stats(
+	TestMallocStats *stats)
+{
+	stats->allocs = __atomic_load_n(&test_malloc_stats.allocs,
+		__ATOMIC_RELAXED);
+	stats->frees = __atomic_load_n(&test_malloc_stats.frees,
+		__ATOMIC_RELAXED);
+	stats->bytes = __atomic_load_n(&test_malloc_stats.bytes,
+		__ATOMIC_RELAXED);
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
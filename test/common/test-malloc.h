@@ -0,0 +1,43 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#ifndef TEST_MALLOC_H
+#define TEST_MALLOC_H
+
+#include <glib.h>
+
+/*
+ * Linking test-malloc.c replaces malloc and friends with wrappers
+ * counting the calls (glibc only).
+ */
+
+typedef struct test_malloc_stats {
+	guint64 allocs;             /* malloc, calloc and realloc calls */
+	guint64 frees;
+	guint64 bytes;              /* Requested by the above */
+} TestMallocStats;
+
+void
+test_malloc_get_stats(
+	TestMallocStats *stats);
+
+#endif /* TEST_MALLOC_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,702 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/*
+ * Stand-alone fake ofono daemon. Implements the subset of org.ofono
+ * interfaces which libgofono needs for the provisioning service (Manager,
+ * Modem, SimManager, ConnectionManager and ConnectionContext) for up to
+ * 1024 modems, each with an internet and an MMS context. Run it on a
+ * private bus and point the service at the same bus:
+ *
+ *   eval `dbus-launch --sh-syntax`
+ *   export DBUS_SYSTEM_BUS_ADDRESS=$DBUS_SESSION_BUS_ADDRESS
+ *   build/release/fake-ofonod -n 256 -l 5 -e 1 &
+ *   ofono-provisioning -d
+ *
+ * Modem N has path /ril_N and IMSI <mccmnc> followed by N padded with
+ * zeros to 15 digits. SIGINT or SIGTERM prints call statistics and exits.
+ */
+
+#include <gio/gio.h>
+#include <glib-unix.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define OFONO_SERVICE           "org.ofono"
+#define OFONO_MANAGER_IFACE     "org.ofono.Manager"
+#define OFONO_MODEM_IFACE       "org.ofono.Modem"
+#define OFONO_SIMMGR_IFACE      "org.ofono.SimManager"
+#define OFONO_CONNMGR_IFACE     "org.ofono.ConnectionManager"
+#define OFONO_CONNCTX_IFACE     "org.ofono.ConnectionContext"
+
+#define OFONO_ERROR_FAILED      "org.ofono.Error.Failed"
+#define OFONO_ERROR_IN_USE      "org.ofono.Error.InUse"
+#define OFONO_ERROR_INVALID     "org.ofono.Error.InvalidArguments"
+#define OFONO_ERROR_NOT_IMPL    "org.ofono.Error.NotImplemented"
+
+#define FAKE_MAX_MODEMS         1024
+#define FAKE_IMSI_LEN           15
+
+#define FAKE_PROPERTIES_METHOD \
+	"<method name='GetProperties'>" \
+	"  <arg name='properties' type='a{sv}' direction='out'/>" \
+	"</method>" \
+	"<method name='SetProperty'>" \
+	"  <arg name='property' type='s' direction='in'/>" \
+	"  <arg name='value' type='v' direction='in'/>" \
+	"</method>" \
+	"<signal name='PropertyChanged'>" \
+	"  <arg name='name' type='s'/>" \
+	"  <arg name='value' type='v'/>" \
+	"</signal>"
+
+static const char fake_ofonod_xml[] =
+	"<node>"
+	"<interface name='" OFONO_MANAGER_IFACE "'>"
+	"  <method name='GetModems'>"
+	"    <arg name='modems' type='a(oa{sv})' direction='out'/>"
+	"  </method>"
+	"  <signal name='ModemAdded'>"
+	"    <arg name='path' type='o'/>"
+	"    <arg name='properties' type='a{sv}'/>"
+	"  </signal>"
+	"  <signal name='ModemRemoved'>"
+	"    <arg name='path' type='o'/>"
+	"  </signal>"
+	"</interface>"
+	"<interface name='" OFONO_MODEM_IFACE "'>"
+	FAKE_PROPERTIES_METHOD
+	"</interface>"
+	"<interface name='" OFONO_SIMMGR_IFACE "'>"
+	FAKE_PROPERTIES_METHOD
+	"</interface>"
+	"<interface name='" OFONO_CONNMGR_IFACE "'>"
+	FAKE_PROPERTIES_METHOD
+	"  <method name='GetContexts'>"
+	"    <arg name='contexts' type='a(oa{sv})' direction='out'/>"
+	"  </method>"
+	"  <signal name='ContextAdded'>"
+	"    <arg name='path' type='o'/>"
+	"    <arg name='properties' type='a{sv}'/>"
+	"  </signal>"
+	"  <signal name='ContextRemoved'>"
+	"    <arg name='path' type='o'/>"
+	"  </signal>"
+	"</interface>"
+	"<interface name='" OFONO_CONNCTX_IFACE "'>"
+	FAKE_PROPERTIES_METHOD
+	"</interface>"
+	"</node>";
+
+struct fake_daemon;
+struct fake_modem;
+
+/*
+ * Each D-Bus object (or interface thereof) is a named property table
+ * with optional write access. Contexts are the only writable objects.
+ */
+struct fake_object {
+	struct fake_daemon *daemon;
+	struct fake_modem *modem;
+	GDBusInterfaceInfo *info;
+	char *path;
+	GHashTable *props;
+	gboolean writable;
+	guint reg_id;
+};
+
+struct fake_modem {
+	struct fake_object modem;
+	struct fake_object simmgr;
+	struct fake_object connmgr;
+	struct fake_object internet;
+	struct fake_object mms;
+};
+
+struct fake_stats {
+	guint calls;
+	guint get_calls;
+	guint set_calls;
+	guint set_errors;
+	guint injected_errors;
+	guint signals;
+};
+
+struct fake_daemon {
+	GMainLoop *loop;
+	GDBusConnection *bus;
+	GDBusNodeInfo *node;
+	GRand *rand;
+	struct fake_object manager;
+	struct fake_modem *modems;
+	struct fake_stats stats;
+	gint modem_count;
+	gint latency;
+	gint jitter;
+	gint error_rate;
+	const char *error_name;
+	gboolean active;
+	gboolean verbose;
+};
+
+/* Method call waiting for its simulated latency to expire */
+struct fake_call {
+	struct fake_object *obj;
+	GDBusMethodInvocation *call;
+	char *method;
+	GVariant *args;
+};
+
+static
+void
+fake_object_emit(
+	struct fake_object *obj,
+	const char *name,
+	GVariant *value)
+{
+	struct fake_daemon *daemon = obj->daemon;
+
+	daemon->stats.signals++;
+	g_dbus_connection_emit_signal(daemon->bus, NULL, obj->path,
+		obj->info->name,
+		"PropertyChanged", g_variant_new("(sv)", name, value), NULL);
+}
+
+static
+GVariant *
+fake_object_properties(
+	struct fake_object *obj)
+{
+	GHashTableIter it;
+	gpointer key, value;
+	GVariantBuilder b;
+
+	g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+	g_hash_table_iter_init(&it, obj->props);
+	while (g_hash_table_iter_next(&it, &key, &value)) {
+		g_variant_builder_add(&b, "{sv}", key, value);
+	}
+	return g_variant_builder_end(&b);
+}
+
+static
+void
+fake_object_set(
+	struct fake_object *obj,
+	const char *name,
+	GVariant *value)
+{
+	g_hash_table_replace(obj->props, g_strdup(name),
+		g_variant_ref_sink(value));
+}
+
+static
+gboolean
+fake_object_active(
+	struct fake_object *obj)
+{
+	GVariant *active = g_hash_table_lookup(obj->props, "Active");
+
+	return active && g_variant_get_boolean(active);
+}
+
+static
+void
+fake_object_set_property(
+	struct fake_object *obj,
+	GDBusMethodInvocation *call,
+	GVariant *args)
+{
+	struct fake_daemon *daemon = obj->daemon;
+	const char *name = NULL;
+	GVariant *value = NULL;
+	GVariant *old;
+
+	daemon->stats.set_calls++;
+	g_variant_get(args, "(&sv)", &name, &value);
+	old = g_hash_table_lookup(obj->props, name);
+	if (!obj->writable) {
+		daemon->stats.set_errors++;
+		g_dbus_method_invocation_return_dbus_error(call,
+			OFONO_ERROR_NOT_IMPL, "Not implemented");
+	} else if (!old || !g_variant_is_of_type(value,
+			g_variant_get_type(old))) {
+		daemon->stats.set_errors++;
+		g_dbus_method_invocation_return_dbus_error(call,
+			OFONO_ERROR_INVALID, "Invalid arguments in method call");
+	} else if (daemon->error_rate > 0 &&
+			g_rand_int_range(daemon->rand, 0, 100) < daemon->error_rate) {
+		daemon->stats.set_errors++;
+		daemon->stats.injected_errors++;
+		g_dbus_method_invocation_return_dbus_error(call,
+			daemon->error_name, "Injected error");
+	} else if (strcmp(name, "Active") && fake_object_active(obj)) {
+		/* Like ofono, refuse to modify an active context */
+		daemon->stats.set_errors++;
+		g_dbus_method_invocation_return_dbus_error(call,
+			OFONO_ERROR_IN_USE, "Operation already in progress");
+	} else {
+		if (daemon->verbose) {
+			char *text = g_variant_print(value, FALSE);
+			printf("%s %s = %s\n", obj->path, name, text);
+			g_free(text);
+		}
+		if (!g_variant_equal(old, value)) {
+			fake_object_set(obj, name, value);
+			fake_object_emit(obj, name, value);
+		}
+		g_dbus_method_invocation_return_value(call, NULL);
+	}
+	g_variant_unref(value);
+}
+
+static
+GVariant *
+fake_modem_list(
+	struct fake_daemon *daemon)
+{
+	GVariantBuilder b;
+	gint i;
+
+	g_variant_builder_init(&b, G_VARIANT_TYPE("a(oa{sv})"));
+	for (i = 0; i < daemon->modem_count; i++) {
+		struct fake_object *modem = &daemon->modems[i].modem;
+
+		g_variant_builder_add(&b, "(o@a{sv})", modem->path,
+			fake_object_properties(modem));
+	}
+	return g_variant_builder_end(&b);
+}
+
+static
+GVariant *
+fake_context_list(
+	struct fake_modem *modem)
+{
+	GVariantBuilder b;
+
+	g_variant_builder_init(&b, G_VARIANT_TYPE("a(oa{sv})"));
+	g_variant_builder_add(&b, "(o@a{sv})", modem->internet.path,
+		fake_object_properties(&modem->internet));
+	g_variant_builder_add(&b, "(o@a{sv})", modem->mms.path,
+		fake_object_properties(&modem->mms));
+	return g_variant_builder_end(&b);
+}
+
+static
+void
+fake_call_complete(
+	struct fake_object *obj,
+	GDBusMethodInvocation *call,
+	const char *method,
+	GVariant *args)
+{
+	struct fake_daemon *daemon = obj->daemon;
+
+	if (!strcmp(method, "GetProperties")) {
+		daemon->stats.get_calls++;
+		g_dbus_method_invocation_return_value(call,
+			g_variant_new("(@a{sv})", fake_object_properties(obj)));
+	} else if (!strcmp(method, "SetProperty")) {
+		fake_object_set_property(obj, call, args);
+	} else if (!strcmp(method, "GetModems")) {
+		g_dbus_method_invocation_return_value(call,
+			g_variant_new("(@a(oa{sv}))", fake_modem_list(daemon)));
+	} else if (!strcmp(method, "GetContexts")) {
+		g_dbus_method_invocation_return_value(call,
+			g_variant_new("(@a(oa{sv}))", fake_context_list(obj->modem)));
+	} else {
+		g_dbus_method_invocation_return_dbus_error(call,
+			OFONO_ERROR_NOT_IMPL, "Not implemented");
+	}
+}
+
+static
+gboolean
+fake_call_timeout(
+	gpointer data)
+{
+	struct fake_call *fc = data;
+
+	fake_call_complete(fc->obj, fc->call, fc->method, fc->args);
+	g_variant_unref(fc->args);
+	g_free(fc->method);
+	g_free(fc);
+	return G_SOURCE_REMOVE;
+}
+
+static
+void
+fake_method_call(
+	GDBusConnection *bus,
+	const gchar *sender,
+	const gchar *path,
+	const gchar *iface,
+	const gchar *method,
+	GVariant *args,
+	GDBusMethodInvocation *call,
+	gpointer data)
+{
+	struct fake_object *obj = data;
+	struct fake_daemon *daemon = obj->daemon;
+	gint delay = daemon->latency;
+
+	daemon->stats.calls++;
+	if (daemon->jitter > 0) {
+		delay += g_rand_int_range(daemon->rand, 0, daemon->jitter + 1);
+	}
+	if (delay > 0) {
+		struct fake_call *fc = g_new(struct fake_call, 1);
+
+		fc->obj = obj;
+		fc->call = call;
+		fc->method = g_strdup(method);
+		fc->args = g_variant_ref(args);
+		g_timeout_add(delay, fake_call_timeout, fc);
+	} else {
+		fake_call_complete(obj, call, method, args);
+	}
+}
+
+static const GDBusInterfaceVTable fake_vtable = {
+	fake_method_call, NULL, NULL
+};
+
+static
+void
+fake_object_init(
+	struct fake_object *obj,
+	struct fake_daemon *daemon,
+	struct fake_modem *modem,
+	const char *iface,
+	char *path)
+{
+	obj->daemon = daemon;
+	obj->modem = modem;
+	obj->info = g_dbus_node_info_lookup_interface(daemon->node, iface);
+	obj->path = path;
+	obj->props = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+}
+
+static
+gboolean
+fake_object_register(
+	struct fake_object *obj)
+{
+	struct fake_daemon *daemon = obj->daemon;
+	GError *error = NULL;
+
+	obj->reg_id = g_dbus_connection_register_object(daemon->bus, obj->path,
+		obj->info, &fake_vtable, obj, NULL,
+		&error);
+	if (!obj->reg_id) {
+		fprintf(stderr, "%s: %s\n", obj->path, error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static
+void
+fake_object_destroy(
+	struct fake_object *obj)
+{
+	if (obj->reg_id) {
+		g_dbus_connection_unregister_object(obj->daemon->bus, obj->reg_id);
+	}
+	g_hash_table_destroy(obj->props);
+	g_free(obj->path);
+}
+
+static
+void
+fake_context_init(
+	struct fake_object *ctx,
+	struct fake_modem *fm,
+	guint id,
+	const char *type)
+{
+	struct fake_daemon *daemon = fm->modem.daemon;
+
+	fake_object_init(ctx, daemon, fm, OFONO_CONNCTX_IFACE,
+		g_strdup_printf("%s/context%u", fm->modem.path, id));
+	ctx->writable = TRUE;
+	fake_object_set(ctx, "Active", g_variant_new_boolean(daemon->active &&
+		!strcmp(type, "internet")));
+	fake_object_set(ctx, "Type", g_variant_new_string(type));
+	fake_object_set(ctx, "Name", g_variant_new_string(type));
+	fake_object_set(ctx, "AccessPointName", g_variant_new_string(""));
+	fake_object_set(ctx, "Username", g_variant_new_string(""));
+	fake_object_set(ctx, "Password", g_variant_new_string(""));
+	fake_object_set(ctx, "Protocol", g_variant_new_string("ip"));
+	fake_object_set(ctx, "AuthenticationMethod",
+		g_variant_new_string("chap"));
+	if (!strcmp(type, "mms")) {
+		fake_object_set(ctx, "MessageProxy", g_variant_new_string(""));
+		fake_object_set(ctx, "MessageCenter", g_variant_new_string(""));
+	}
+}
+
+static
+void
+fake_modem_init(
+	struct fake_modem *fm,
+	struct fake_daemon *daemon,
+	guint index,
+	const char *mccmnc)
+{
+	static const char *interfaces[] = {
+		OFONO_SIMMGR_IFACE, OFONO_CONNMGR_IFACE, NULL
+	};
+	char *path = g_strdup_printf("/ril_%u", index);
+	char *imsi = g_strdup_printf("%s%0*u", mccmnc,
+		(int)(FAKE_IMSI_LEN - strlen(mccmnc)), index);
+	char *mcc = g_strndup(mccmnc, 3);
+
+	fake_object_init(&fm->modem, daemon, fm, OFONO_MODEM_IFACE, path);
+	fake_object_set(&fm->modem, "Powered", g_variant_new_boolean(TRUE));
+	fake_object_set(&fm->modem, "Online", g_variant_new_boolean(TRUE));
+	fake_object_set(&fm->modem, "Emergency", g_variant_new_boolean(FALSE));
+	fake_object_set(&fm->modem, "Lockdown", g_variant_new_boolean(FALSE));
+	fake_object_set(&fm->modem, "Name", g_variant_new_string("Fake"));
+	fake_object_set(&fm->modem, "Type", g_variant_new_string("hardware"));
+	fake_object_set(&fm->modem, "Interfaces",
+		g_variant_new_strv(interfaces, -1));
+	fake_object_set(&fm->modem, "Features",
+		g_variant_new_strv(NULL, 0));
+
+	fake_object_init(&fm->simmgr, daemon, fm, OFONO_SIMMGR_IFACE,
+		g_strdup(path));
+	fake_object_set(&fm->simmgr, "Present", g_variant_new_boolean(TRUE));
+	fake_object_set(&fm->simmgr, "SubscriberIdentity",
+		g_variant_new_string(imsi));
+	fake_object_set(&fm->simmgr, "MobileCountryCode",
+		g_variant_new_string(mcc));
+	fake_object_set(&fm->simmgr, "MobileNetworkCode",
+		g_variant_new_string(mccmnc + 3));
+
+	fake_object_init(&fm->connmgr, daemon, fm, OFONO_CONNMGR_IFACE,
+		g_strdup(path));
+	fake_object_set(&fm->connmgr, "Attached", g_variant_new_boolean(TRUE));
+	fake_object_set(&fm->connmgr, "Powered", g_variant_new_boolean(TRUE));
+	fake_object_set(&fm->connmgr, "Suspended",
+		g_variant_new_boolean(FALSE));
+	fake_object_set(&fm->connmgr, "RoamingAllowed",
+		g_variant_new_boolean(FALSE));
+	fake_object_set(&fm->connmgr, "Bearer", g_variant_new_string("lte"));
+
+	fake_context_init(&fm->internet, fm, 1, "internet");
+	fake_context_init(&fm->mms, fm, 2, "mms");
+	g_free(imsi);
+	g_free(mcc);
+}
+
+static
+gboolean
+fake_modem_register(
+	struct fake_modem *fm)
+{
+	return fake_object_register(&fm->modem) &&
+		fake_object_register(&fm->simmgr) &&
+		fake_object_register(&fm->connmgr) &&
+		fake_object_register(&fm->internet) &&
+		fake_object_register(&fm->mms);
+}
+
+static
+void
+fake_modem_destroy(
+	struct fake_modem *fm)
+{
+	fake_object_destroy(&fm->mms);
+	fake_object_destroy(&fm->internet);
+	fake_object_destroy(&fm->connmgr);
+	fake_object_destroy(&fm->simmgr);
+	fake_object_destroy(&fm->modem);
+}
+
+static
+void
+fake_name_acquired(
+	GDBusConnection *bus,
+	const gchar *name,
+	gpointer data)
+{
+	struct fake_daemon *daemon = data;
+
+	printf("%s ready with %d modem(s)\n", name, daemon->modem_count);
+	fflush(stdout);
+}
+
+static
+void
+fake_name_lost(
+	GDBusConnection *bus,
+	const gchar *name,
+	gpointer data)
+{
+	struct fake_daemon *daemon = data;
+
+	fprintf(stderr, "Failed to own %s\n", name);
+	g_main_loop_quit(daemon->loop);
+}
+
+static
+gboolean
+fake_signal(
+	gpointer data)
+{
+	struct fake_daemon *daemon = data;
+
+	g_main_loop_quit(daemon->loop);
+	return G_SOURCE_CONTINUE;
+}
+
+static
+GDBusConnection *
+fake_bus_connect(
+	const char *address,
+	GError **error)
+{
+	if (address) {
+		return g_dbus_connection_new_for_address_sync(address,
+			G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+			G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+			NULL, NULL, error);
+	} else {
+		/* Honors DBUS_SYSTEM_BUS_ADDRESS */
+		return g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, error);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct fake_daemon daemon;
+	char *address = NULL;
+	char *mccmnc = NULL;
+	char *error_name = NULL;
+	gint seed = 0;
+	GError *error = NULL;
+	GOptionContext *options;
+	GOptionEntry entries[] = {
+		{ "modems", 'n', 0, G_OPTION_ARG_INT, &daemon.modem_count,
+		  "Number of modems, 1.." G_STRINGIFY(FAKE_MAX_MODEMS) " [1]",
+		  "N" },
+		{ "latency", 'l', 0, G_OPTION_ARG_INT, &daemon.latency,
+		  "Delay before each reply [0]", "MS" },
+		{ "jitter", 'j', 0, G_OPTION_ARG_INT, &daemon.jitter,
+		  "Random extra delay, up to MS [0]", "MS" },
+		{ "error-rate", 'e', 0, G_OPTION_ARG_INT, &daemon.error_rate,
+		  "Percentage of failed SetProperty calls [0]", "0..100" },
+		{ "error", 'E', 0, G_OPTION_ARG_STRING, &error_name,
+		  "D-Bus error for failed calls [" OFONO_ERROR_FAILED "]",
+		  "NAME" },
+		{ "mccmnc", 'i', 0, G_OPTION_ARG_STRING, &mccmnc,
+		  "IMSI prefix [24499]", "MCCMNC" },
+		{ "active", 'a', 0, G_OPTION_ARG_NONE, &daemon.active,
+		  "Internet contexts are initially active", NULL },
+		{ "seed", 's', 0, G_OPTION_ARG_INT, &seed,
+		  "Random seed for latency jitter and errors", "N" },
+		{ "address", 'A', 0, G_OPTION_ARG_STRING, &address,
+		  "Bus address [system bus]", "ADDRESS" },
+		{ "verbose", 'v', 0, G_OPTION_ARG_NONE, &daemon.verbose,
+		  "Print property changes", NULL },
+		{ NULL }
+	};
+	gboolean ok;
+	int ret = 1;
+
+	memset(&daemon, 0, sizeof(daemon));
+	daemon.modem_count = 1;
+	options = g_option_context_new(NULL);
+	g_option_context_add_main_entries(options, entries, NULL);
+	ok = g_option_context_parse(options, &argc, &argv, &error);
+	g_option_context_free(options);
+	if (!ok) {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+	} else if (daemon.modem_count < 1 ||
+		daemon.modem_count > FAKE_MAX_MODEMS ||
+		daemon.latency < 0 || daemon.jitter < 0 ||
+		daemon.error_rate < 0 || daemon.error_rate > 100 ||
+		(mccmnc && (strlen(mccmnc) < 5 || strlen(mccmnc) > 6))) {
+		fprintf(stderr, "Invalid arguments\n");
+	} else if (!(daemon.bus = fake_bus_connect(address, &error))) {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+	} else {
+		gboolean registered;
+		guint name_id;
+		gint i;
+
+		daemon.error_name = error_name ? error_name : OFONO_ERROR_FAILED;
+		daemon.rand = seed ? g_rand_new_with_seed(seed) : g_rand_new();
+		daemon.node = g_dbus_node_info_new_for_xml(fake_ofonod_xml, NULL);
+		daemon.loop = g_main_loop_new(NULL, FALSE);
+		daemon.modems = g_new0(struct fake_modem, daemon.modem_count);
+
+		fake_object_init(&daemon.manager, &daemon, NULL,
+			OFONO_MANAGER_IFACE, g_strdup("/"));
+		registered = fake_object_register(&daemon.manager);
+		for (i = 0; i < daemon.modem_count; i++) {
+			fake_modem_init(daemon.modems + i, &daemon, i,
+				mccmnc ? mccmnc : "24499");
+			registered = registered &&
+				fake_modem_register(daemon.modems + i);
+		}
+
+		if (registered) {
+			g_unix_signal_add(SIGINT, fake_signal, &daemon);
+			g_unix_signal_add(SIGTERM, fake_signal, &daemon);
+			name_id = g_bus_own_name_on_connection(daemon.bus,
+				OFONO_SERVICE, G_BUS_NAME_OWNER_FLAGS_NONE,
+				fake_name_acquired, fake_name_lost, &daemon, NULL);
+			g_main_loop_run(daemon.loop);
+			g_bus_unown_name(name_id);
+
+			printf("%u calls, %u GetProperties, %u SetProperty "
+				"(%u failed, %u injected), %u signals\n",
+				daemon.stats.calls, daemon.stats.get_calls,
+				daemon.stats.set_calls, daemon.stats.set_errors,
+				daemon.stats.injected_errors, daemon.stats.signals);
+			ret = 0;
+		}
+
+		for (i = 0; i < daemon.modem_count; i++) {
+			fake_modem_destroy(daemon.modems + i);
+		}
+		fake_object_destroy(&daemon.manager);
+		g_free(daemon.modems);
+		g_main_loop_unref(daemon.loop);
+		g_dbus_node_info_unref(daemon.node);
+		g_rand_free(daemon.rand);
+		g_dbus_connection_flush_sync(daemon.bus, NULL, NULL);
+		g_object_unref(daemon.bus);
+	}
+	g_free(address);
+	g_free(mccmnc);
+	g_free(error_name);
+	return ret;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,318 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/*
+ * Looks for inputs which make decode_provisioning_wbxml() expensive
+ * relative to their size, rather than for crashes. The cost of each
+ * input is measured in nanoseconds and allocations per byte. Inputs
+ * exceeding the thresholds are minimized (while they stay expensive)
+ * and saved to the regression corpus, which test-decoder checks
+ * against its time budget.
+ *
+ * libFuzzer (settings come from the environment, see below):
+ *
+ *   make FUZZER=1 CC=clang release
+ *   FUZZ_DECODER_SAVE=../data/slow build/release/fuzz-decoder \
+ *     -max_len=65536 corpus ../data
+ *
+ * AFL:
+ *
+ *   make CC=afl-clang-fast release
+ *   afl-fuzz -i ../data -o findings -- \
+ *     build/release/fuzz-decoder -s ../data/slow @@
+ *
+ * Standalone, to see what individual inputs cost:
+ *
+ *   build/release/fuzz-decoder ../data/prov_*.wbxml
+ */
+
+#include "test-common.h"
+#include "test-malloc.h"
+#include "provisioning-decoder.h"
+
+#include <gutil_log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Fixed per-call overhead is spread over at least this many bytes */
+#ifndef FUZZ_MIN_LEN
+#  define FUZZ_MIN_LEN (64)
+#endif
+
+#ifndef FUZZ_NSEC_PER_BYTE
+#  define FUZZ_NSEC_PER_BYTE (1000)
+#endif
+
+#ifndef FUZZ_ALLOCS_PER_BYTE
+#  define FUZZ_ALLOCS_PER_BYTE (2)
+#endif
+
+/* Time is noisy, the best of this many runs is taken */
+#ifndef FUZZ_RUNS
+#  define FUZZ_RUNS (3)
+#endif
+
+/* Upper bound for decoding attempts made by the minimizer */
+#ifndef FUZZ_MINIMIZE_TRIES
+#  define FUZZ_MINIMIZE_TRIES (2000)
+#endif
+
+#define FUZZ_ENV_SAVE "FUZZ_DECODER_SAVE"
+#define FUZZ_ENV_NSEC "FUZZ_DECODER_NSEC_PER_BYTE"
+#define FUZZ_ENV_ALLOCS "FUZZ_DECODER_ALLOCS_PER_BYTE"
+
+struct fuzz_cost {
+	double nsec;                /* Per byte */
+	double allocs;              /* Per byte */
+};
+
+static char *fuzz_save_dir;
+static double fuzz_max_nsec = FUZZ_NSEC_PER_BYTE;
+static double fuzz_max_allocs = FUZZ_ALLOCS_PER_BYTE;
+
+static
+void
+fuzz_measure(
+	const guint8 *bytes,
+	gsize len,
+	int runs,
+	struct fuzz_cost *cost)
+{
+	const double n = MAX(len, FUZZ_MIN_LEN);
+	gint64 best = G_MAXINT64;
+	guint64 allocs = 0;
+	int i;
+
+	for (i = 0; i < runs; i++) {
+		TestMallocStats before, after;
+		struct provisioning_data *data;
+		gint64 start, nsec;
+
+		test_malloc_get_stats(&before);
+		start = g_get_monotonic_time();
+		data = decode_provisioning_wbxml(bytes, len);
+		nsec = (g_get_monotonic_time() - start) * 1000;
+		test_malloc_get_stats(&after);
+		if (data) {
+			provisioning_data_unref(data);
+		}
+		best = MIN(best, nsec);
+		allocs = after.allocs - before.allocs;
+	}
+	cost->nsec = best / n;
+	cost->allocs = allocs / n;
+}
+
+static
+gboolean
+fuzz_expensive(
+	const struct fuzz_cost *cost)
+{
+	return cost->nsec > fuzz_max_nsec || cost->allocs > fuzz_max_allocs;
+}
+
+/* Greedily cuts out chunks as long as the input stays expensive */
+static
+GByteArray *
+fuzz_minimize(
+	const guint8 *bytes,
+	gsize len)
+{
+	GByteArray *in = g_byte_array_sized_new(len);
+	GByteArray *out = g_byte_array_sized_new(len);
+	gsize chunk = len / 2;
+	int tries = 0;
+
+	g_byte_array_append(in, bytes, len);
+	while (chunk > 0 && tries < FUZZ_MINIMIZE_TRIES) {
+		gsize off = 0;
+
+		while (off + chunk <= in->len && tries < FUZZ_MINIMIZE_TRIES) {
+			struct fuzz_cost cost;
+
+			g_byte_array_set_size(out, 0);
+			g_byte_array_append(out, in->data, off);
+			g_byte_array_append(out, in->data + off + chunk,
+				in->len - off - chunk);
+			fuzz_measure(out->data, out->len, FUZZ_RUNS, &cost);
+			tries++;
+			if (fuzz_expensive(&cost)) {
+				GByteArray *tmp = in;
+				in = out;
+				out = tmp;
+			} else {
+				off += chunk;
+			}
+		}
+		chunk /= 2;
+	}
+	g_byte_array_free(out, TRUE);
+	return in;
+}
+
+static
+void
+fuzz_save(
+	const guint8 *bytes,
+	gsize len)
+{
+	GByteArray *min = fuzz_minimize(bytes, len);
+	char *sum = g_compute_checksum_for_data(G_CHECKSUM_SHA1,
+		min->data, min->len);
+	char *name = g_strconcat("slow-", sum, ".wbxml", NULL);
+	char *path = g_build_filename(fuzz_save_dir, name, NULL);
+	GError *error = NULL;
+
+	if (g_file_set_contents(path, (char*)min->data, min->len, &error)) {
+		fprintf(stderr, "Saved %s (%u bytes, was %u)\n", path,
+			min->len, (guint)len);
+	} else {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+	}
+	g_free(path);
+	g_free(name);
+	g_free(sum);
+	g_byte_array_free(min, TRUE);
+}
+
+static
+gboolean
+fuzz_one(
+	const guint8 *bytes,
+	gsize len)
+{
+	struct fuzz_cost cost;
+
+	/* The first run is cheap, expensive ones get measured again */
+	fuzz_measure(bytes, len, 1, &cost);
+	if (fuzz_expensive(&cost)) {
+		fuzz_measure(bytes, len, FUZZ_RUNS, &cost);
+		if (fuzz_expensive(&cost)) {
+			if (fuzz_save_dir) {
+				fuzz_save(bytes, len);
+			}
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static
+void
+fuzz_init(void)
+{
+	const char *env;
+
+	gutil_log_default.level = GLOG_LEVEL_NONE;
+	if ((env = getenv(FUZZ_ENV_SAVE)) != NULL && env[0]) {
+		fuzz_save_dir = g_strdup(env);
+	}
+	if ((env = getenv(FUZZ_ENV_NSEC)) != NULL && env[0]) {
+		fuzz_max_nsec = g_ascii_strtod(env, NULL);
+	}
+	if ((env = getenv(FUZZ_ENV_ALLOCS)) != NULL && env[0]) {
+		fuzz_max_allocs = g_ascii_strtod(env, NULL);
+	}
+}
+
+#ifdef FUZZER
+
+int
+LLVMFuzzerInitialize(
+	int *argc,
+	char ***argv)
+{
+	fuzz_init();
+	return 0;
+}
+
+int
+LLVMFuzzerTestOneInput(
+	const guint8 *data,
+	size_t size)
+{
+	fuzz_one(data, size);
+	return 0;
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+	GError *error = NULL;
+	GOptionContext *options;
+	GOptionEntry entries[] = {
+		{ "save", 's', 0, G_OPTION_ARG_FILENAME, &fuzz_save_dir,
+		  "Save expensive inputs to DIR", "DIR" },
+		{ "nsec", 't', 0, G_OPTION_ARG_DOUBLE, &fuzz_max_nsec,
+		  "Nanoseconds per byte threshold [" G_STRINGIFY(FUZZ_NSEC_PER_BYTE)
+		  "]", "NS" },
+		{ "allocs", 'a', 0, G_OPTION_ARG_DOUBLE, &fuzz_max_allocs,
+		  "Allocations per byte threshold ["
+		  G_STRINGIFY(FUZZ_ALLOCS_PER_BYTE) "]", "N" },
+		{ NULL }
+	};
+	gboolean ok;
+	int i, ret = 0;
+
+	fuzz_init();
+	options = g_option_context_new("FILE...");
+	g_option_context_add_main_entries(options, entries, NULL);
+	ok = g_option_context_parse(options, &argc, &argv, &error);
+	g_option_context_free(options);
+	if (!ok) {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+		return 1;
+	} else if (argc < 2) {
+		fprintf(stderr, "Nothing to do\n");
+		return 1;
+	}
+	for (i = 1; i < argc; i++) {
+		gchar *bytes;
+		gsize len;
+
+		if (g_file_get_contents(argv[i], &bytes, &len, &error)) {
+			struct fuzz_cost cost;
+			const gboolean slow = fuzz_one((guint8*)bytes, len);
+
+			fuzz_measure((guint8*)bytes, len, FUZZ_RUNS, &cost);
+			printf("%s: %u bytes, %.1f ns/byte, %.2f allocs/byte%s\n",
+				argv[i], (guint)len, cost.nsec, cost.allocs,
+				slow ? " (slow)" : "");
+			if (slow) {
+				ret = 2;
+			}
+			g_free(bytes);
+		} else {
+			fprintf(stderr, "%s\n", error->message);
+			g_clear_error(&error);
+			ret = 1;
+		}
+	}
+	g_free(fuzz_save_dir);
+	return ret;
+}
+
+#endif /* FUZZER */
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
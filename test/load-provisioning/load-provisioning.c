@@ -0,0 +1,845 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/*
+ * Load generator for the provisioning service. Sends
+ * SubmitProvisioningMessage calls over N bus connections, matches
+ * ProvisioningResult signals to the calls by transaction ID and reports
+ * throughput and latency percentiles. Example, with fake-ofonod and
+ * the service on a private bus:
+ *
+ *   build/release/load-provisioning -b $DBUS_SYSTEM_BUS_ADDRESS \
+ *     -c 8 -n 10000 -r 500 -k 256 -d zipf \
+ *     -f ../data/prov_dna_1.wbxml:3 -f ../data/prov_sonera.wbxml
+ *
+ * Without a rate the load is closed-loop, each connection keeping
+ * WINDOW messages in flight. With --batch, messages which are due at
+ * the same time are sent in HandleProvisioningMessages calls of up to
+ * N entries.
+ *
+ * With --cold each message is sent only after the service has exited,
+ * so that it gets started by the bus. The result latency is then the
+ * activation-to-signal time. The service has to be bus activatable:
+ *
+ *   build/release/load-provisioning --cold -n 20 -f ../data/prov_dna_1.wbxml
+ */
+
+#include <gio/gio.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROVISIONING_SERVICE "org.nemomobile.provisioning"
+#define PROVISIONING_SERVICE_INTERFACE "org.nemomobile.provisioning.interface"
+#define PROVISIONING_SERVICE_PATH "/"
+#define PROVISIONING_CONTENT_TYPE "application/vnd.wap.connectivity-wbxml"
+
+#define LOAD_IMSI_LEN 15
+#define LOAD_RESULT_COUNT 3
+
+enum load_arrival {
+	LOAD_ARRIVAL_POISSON,
+	LOAD_ARRIVAL_UNIFORM,
+	LOAD_ARRIVAL_BURST
+};
+
+enum load_distribution {
+	LOAD_IMSI_UNIFORM,
+	LOAD_IMSI_ZIPF,
+	LOAD_IMSI_SEQUENTIAL
+};
+
+struct load_payload {
+	char *path;
+	GVariant *data;
+	guint weight;
+	guint sent;
+};
+
+struct load {
+	GMainLoop *loop;
+	GDBusConnection **conns;
+	GRand *rand;
+	GHashTable *pending;
+	struct load_payload *payloads;
+	double *zipf_cdf;
+	GArray *call_latency;
+	GArray *result_latency;
+	GPtrArray *batch;
+	gint64 start;
+	gint64 next_send;
+	gint64 last_done;
+	guint tick_id;
+	guint timeout_id;
+	guint *signal_ids;
+	guint name_watch_id;
+	gboolean service_up;
+	guint sent;
+	guint calls;
+	guint in_flight;
+	guint call_errors;
+	guint results[LOAD_RESULT_COUNT];
+	guint unexpected;
+	guint payload_count;
+	guint total_weight;
+	gint conn_count;
+	gint count;
+	gint rate;
+	gint window;
+	gint batch_size;
+	gint imsi_count;
+	gint timeout;
+	gboolean cold;
+	enum load_arrival arrival;
+	enum load_distribution distribution;
+	const char *mccmnc;
+};
+
+/* Waits for the reply, then (with the txid) for the result */
+struct load_request {
+	struct load *load;
+	struct load_payload *payload;
+	char *imsi;
+	gint64 sent;
+};
+
+static
+void
+load_request_free(
+	gpointer data)
+{
+	struct load_request *req = data;
+
+	g_free(req->imsi);
+	g_free(req);
+}
+
+static
+void
+load_check_done(
+	struct load *load)
+{
+	if (load->sent == (guint)load->count && !load->in_flight) {
+		g_main_loop_quit(load->loop);
+	}
+}
+
+static
+void
+load_request_finish(
+	struct load *load,
+	struct load_request *req)
+{
+	load->in_flight--;
+	load->last_done = g_get_monotonic_time();
+	load_request_free(req);
+}
+
+static void load_send_due(struct load *load);
+
+static
+void
+load_request_replied(
+	struct load *load,
+	struct load_request *req,
+	guint txid,
+	const char *error)
+{
+	if (!error) {
+		gint64 usec = g_get_monotonic_time() - req->sent;
+
+		/* The service replies before sending the result */
+		g_array_append_val(load->call_latency, usec);
+		g_hash_table_insert(load->pending, GUINT_TO_POINTER(txid), req);
+	} else {
+		fprintf(stderr, "%s: %s\n", req->imsi, error);
+		load->call_errors++;
+		load_request_finish(load, req);
+	}
+}
+
+static
+void
+load_call_done(
+	GObject *conn,
+	GAsyncResult *result,
+	gpointer data)
+{
+	struct load_request *req = data;
+	struct load *load = req->load;
+	GError *error = NULL;
+	GVariant *ret = g_dbus_connection_call_finish(G_DBUS_CONNECTION(conn),
+		result, &error);
+
+	if (ret) {
+		guint txid = 0;
+
+		g_variant_get(ret, "(u)", &txid);
+		load_request_replied(load, req, txid, NULL);
+		g_variant_unref(ret);
+	} else {
+		load_request_replied(load, req, 0, error->message);
+		g_error_free(error);
+	}
+	load_send_due(load);
+	load_check_done(load);
+}
+
+static
+void
+load_batch_done(
+	GObject *conn,
+	GAsyncResult *result,
+	gpointer data)
+{
+	GPtrArray *batch = data;
+	struct load *load = ((struct load_request *)batch->pdata[0])->load;
+	GError *error = NULL;
+	GVariant *ret = g_dbus_connection_call_finish(G_DBUS_CONNECTION(conn),
+		result, &error);
+	guint i;
+
+	if (ret) {
+		GVariantIter *it = NULL;
+		gboolean accepted;
+		const char *reason;
+		guint txid;
+
+		g_variant_get(ret, "(a(bus))", &it);
+		for (i = 0; i < batch->len; i++) {
+			if (!g_variant_iter_next(it, "(bu&s)", &accepted, &txid,
+				&reason)) {
+				accepted = FALSE;
+				reason = "Missing result";
+			}
+			load_request_replied(load, batch->pdata[i], txid, accepted ?
+				NULL : reason);
+		}
+		g_variant_iter_free(it);
+		g_variant_unref(ret);
+	} else {
+		for (i = 0; i < batch->len; i++) {
+			load_request_replied(load, batch->pdata[i], 0, error->message);
+		}
+		g_error_free(error);
+	}
+	g_ptr_array_free(batch, TRUE);
+	load_send_due(load);
+	load_check_done(load);
+}
+
+static
+void
+load_result(
+	GDBusConnection *conn,
+	const char *sender,
+	const char *path,
+	const char *iface,
+	const char *name,
+	GVariant *args,
+	gpointer data)
+{
+	struct load *load = data;
+	struct load_request *req;
+	guint txid = 0, result = 0;
+
+	g_variant_get(args, "(u&s&suuuu)", &txid, NULL, NULL, &result, NULL,
+		NULL, NULL);
+	req = g_hash_table_lookup(load->pending, GUINT_TO_POINTER(txid));
+	if (req) {
+		gint64 usec = g_get_monotonic_time() - req->sent;
+
+		g_hash_table_steal(load->pending, GUINT_TO_POINTER(txid));
+		g_array_append_val(load->result_latency, usec);
+		load->results[MIN(result, LOAD_RESULT_COUNT - 1)]++;
+		load_request_finish(load, req);
+		load_send_due(load);
+		load_check_done(load);
+	} else {
+		load->unexpected++;
+	}
+}
+
+static
+guint
+load_pick_imsi(
+	struct load *load)
+{
+	if (load->imsi_count == 1) {
+		return 0;
+	}
+	switch (load->distribution) {
+	case LOAD_IMSI_SEQUENTIAL:
+		return load->sent % load->imsi_count;
+	case LOAD_IMSI_ZIPF:
+		{
+			const double u = g_rand_double(load->rand);
+			guint lo = 0, hi = load->imsi_count - 1;
+
+			while (lo < hi) {
+				const guint mid = (lo + hi) / 2;
+
+				if (load->zipf_cdf[mid] < u) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			return lo;
+		}
+	case LOAD_IMSI_UNIFORM:
+		break;
+	}
+	return g_rand_int_range(load->rand, 0, load->imsi_count);
+}
+
+static
+struct load_payload *
+load_pick_payload(
+	struct load *load)
+{
+	guint i, w = g_rand_int_range(load->rand, 0, load->total_weight);
+
+	for (i = 0; i < load->payload_count - 1; i++) {
+		if (w < load->payloads[i].weight) {
+			break;
+		}
+		w -= load->payloads[i].weight;
+	}
+	return load->payloads + i;
+}
+
+/* Sends the pending batch, if there's one */
+static
+void
+load_flush(
+	struct load *load)
+{
+	if (load->batch->len) {
+		GVariantBuilder b;
+		guint i;
+
+		g_variant_builder_init(&b, G_VARIANT_TYPE("a(ssay)"));
+		for (i = 0; i < load->batch->len; i++) {
+			struct load_request *req = load->batch->pdata[i];
+
+			g_variant_builder_add(&b, "(ss@ay)", req->imsi,
+				PROVISIONING_CONTENT_TYPE, req->payload->data);
+		}
+		g_dbus_connection_call(load->conns[load->calls++ % load->conn_count],
+			PROVISIONING_SERVICE, PROVISIONING_SERVICE_PATH,
+			PROVISIONING_SERVICE_INTERFACE, "HandleProvisioningMessages",
+			g_variant_new("(a(ssay))", &b), G_VARIANT_TYPE("(a(bus))"),
+			G_DBUS_CALL_FLAGS_NONE, -1, NULL, load_batch_done, load->batch);
+		load->batch = g_ptr_array_new();
+	}
+}
+
+static
+void
+load_send(
+	struct load *load)
+{
+	struct load_request *req = g_new0(struct load_request, 1);
+	struct load_payload *payload = load_pick_payload(load);
+	guint index = load_pick_imsi(load);
+
+	req->load = load;
+	req->payload = payload;
+	req->imsi = g_strdup_printf("%s%0*u", load->mccmnc,
+		(int)(LOAD_IMSI_LEN - strlen(load->mccmnc)), index);
+
+	payload->sent++;
+	load->sent++;
+	load->in_flight++;
+	req->sent = g_get_monotonic_time();
+	if (load->batch_size > 1) {
+		g_ptr_array_add(load->batch, req);
+		if (load->batch->len == (guint)load->batch_size) {
+			load_flush(load);
+		}
+	} else {
+		g_dbus_connection_call(load->conns[load->calls++ % load->conn_count],
+			PROVISIONING_SERVICE, PROVISIONING_SERVICE_PATH,
+			PROVISIONING_SERVICE_INTERFACE, "SubmitProvisioningMessage",
+			g_variant_new("(ssuuiis@ay)", req->imsi, "", 0, 0, 0, 0,
+			PROVISIONING_CONTENT_TYPE, payload->data), G_VARIANT_TYPE("(u)"),
+			G_DBUS_CALL_FLAGS_NONE, -1, NULL, load_call_done, req);
+	}
+}
+
+static
+gint64
+load_interval(
+	struct load *load)
+{
+	switch (load->arrival) {
+	case LOAD_ARRIVAL_UNIFORM:
+		return G_USEC_PER_SEC / load->rate;
+	case LOAD_ARRIVAL_BURST:
+		return (load->sent % load->rate) ? 0 : G_USEC_PER_SEC;
+	case LOAD_ARRIVAL_POISSON:
+		break;
+	}
+	return (gint64)(-log(1.0 - g_rand_double(load->rand)) *
+		G_USEC_PER_SEC / load->rate);
+}
+
+/* Sends whatever the arrival process or the window allows right now */
+static
+void
+load_send_due(
+	struct load *load)
+{
+	if (load->rate > 0) {
+		const gint64 now = g_get_monotonic_time();
+
+		while (load->sent < (guint)load->count && now >= load->next_send) {
+			load_send(load);
+			load->next_send += load_interval(load);
+		}
+	} else if (load->cold) {
+		/* One at a time, each one activating the service */
+		if (load->sent < (guint)load->count && !load->in_flight &&
+			!load->service_up) {
+			load->service_up = TRUE;
+			load_send(load);
+		}
+	} else {
+		const guint max = load->conn_count * load->window;
+
+		while (load->sent < (guint)load->count && load->in_flight < max) {
+			load_send(load);
+		}
+	}
+	load_flush(load);
+}
+
+static
+void
+load_service_appeared(
+	GDBusConnection *conn,
+	const char *name,
+	const char *owner,
+	gpointer data)
+{
+	struct load *load = data;
+
+	load->service_up = TRUE;
+}
+
+static
+void
+load_service_vanished(
+	GDBusConnection *conn,
+	const char *name,
+	gpointer data)
+{
+	struct load *load = data;
+
+	load->service_up = FALSE;
+	load_send_due(load);
+}
+
+static
+gboolean
+load_tick(
+	gpointer data)
+{
+	struct load *load = data;
+
+	load_send_due(load);
+	if (load->sent < (guint)load->count) {
+		return G_SOURCE_CONTINUE;
+	}
+	load->tick_id = 0;
+	return G_SOURCE_REMOVE;
+}
+
+static
+gboolean
+load_timeout(
+	gpointer data)
+{
+	struct load *load = data;
+
+	/* Reset each time something completes */
+	if (load->sent == (guint)load->count && g_get_monotonic_time() -
+		load->last_done >= load->timeout * G_USEC_PER_SEC) {
+		load->timeout_id = 0;
+		g_main_loop_quit(load->loop);
+		return G_SOURCE_REMOVE;
+	}
+	return G_SOURCE_CONTINUE;
+}
+
+static
+gint
+load_compare_usec(
+	gconstpointer a,
+	gconstpointer b)
+{
+	const gint64 x = *(const gint64*)a;
+	const gint64 y = *(const gint64*)b;
+
+	return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static
+void
+load_print_latency(
+	const char *name,
+	GArray *usec)
+{
+	static const double pct[] = { 50, 90, 99, 99.9 };
+	guint i;
+
+	printf("%-8s", name);
+	if (usec->len) {
+		const gint64 *v;
+
+		g_array_sort(usec, load_compare_usec);
+		v = (const gint64*)usec->data;
+		for (i = 0; i < G_N_ELEMENTS(pct); i++) {
+			guint k = (guint)(pct[i] * (usec->len - 1) / 100 + 0.5);
+
+			printf(" p%g %.2f", pct[i], v[k] / 1000.0);
+		}
+		printf(" max %.2f ms\n", v[usec->len - 1] / 1000.0);
+	} else {
+		printf(" -\n");
+	}
+}
+
+static
+void
+load_report(
+	struct load *load)
+{
+	const guint done = load->results[0] + load->results[1] +
+		load->results[2];
+	const gint64 usec = MAX(load->last_done - load->start, 1);
+	guint i;
+
+	printf("%u sent, %u succeeded, %u partially succeeded, %u failed\n",
+		load->sent, load->results[0], load->results[1], load->results[2]);
+	printf("%u calls, %u call errors, %u lost, %u unexpected results\n",
+		load->calls, load->call_errors, load->in_flight, load->unexpected);
+	for (i = 0; i < load->payload_count; i++) {
+		printf("  %u x %s\n", load->payloads[i].sent, load->payloads[i].path);
+	}
+	printf("%.1f results/sec\n", done * (double)G_USEC_PER_SEC / usec);
+	load_print_latency("call", load->call_latency);
+	load_print_latency("result", load->result_latency);
+}
+
+static
+gboolean
+load_parse_payloads(
+	struct load *load,
+	char **files)
+{
+	const guint n = files ? g_strv_length(files) : 0;
+	guint i;
+
+	if (!n) {
+		fprintf(stderr, "No payload files given\n");
+		return FALSE;
+	}
+
+	load->payload_count = n;
+	load->payloads = g_new0(struct load_payload, n);
+	for (i = 0; i < n; i++) {
+		struct load_payload *payload = load->payloads + i;
+		char *sep = strrchr(files[i], ':');
+		GError *error = NULL;
+		gchar *contents;
+		gsize len;
+
+		payload->weight = 1;
+		if (sep) {
+			*sep++ = 0;
+			payload->weight = atoi(sep);
+		}
+		payload->path = g_strdup(files[i]);
+		if (!payload->weight) {
+			fprintf(stderr, "Invalid weight for %s\n", payload->path);
+			return FALSE;
+		} else if (!g_file_get_contents(payload->path, &contents, &len,
+			&error)) {
+			fprintf(stderr, "%s\n", error->message);
+			g_error_free(error);
+			return FALSE;
+		}
+		payload->data = g_variant_ref_sink(g_variant_new_fixed_array(
+			G_VARIANT_TYPE_BYTE, contents, len, 1));
+		load->total_weight += payload->weight;
+		g_free(contents);
+	}
+	return TRUE;
+}
+
+static
+void
+load_init_zipf(
+	struct load *load)
+{
+	double sum = 0;
+	gint i;
+
+	/* Zipf with exponent 1, IMSI 0 being the most popular */
+	load->zipf_cdf = g_new(double, load->imsi_count);
+	for (i = 0; i < load->imsi_count; i++) {
+		sum += 1.0 / (i + 1);
+		load->zipf_cdf[i] = sum;
+	}
+	for (i = 0; i < load->imsi_count; i++) {
+		load->zipf_cdf[i] /= sum;
+	}
+}
+
+static
+char *
+load_bus_address(
+	const char *bus,
+	GError **error)
+{
+	if (!bus || !strcmp(bus, "system")) {
+		return g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SYSTEM, NULL,
+			error);
+	} else if (!strcmp(bus, "session")) {
+		return g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SESSION, NULL,
+			error);
+	} else {
+		return g_strdup(bus);
+	}
+}
+
+static
+gboolean
+load_connect(
+	struct load *load,
+	const char *bus)
+{
+	GError *error = NULL;
+	char *address = load_bus_address(bus, &error);
+	gint i;
+
+	load->conns = g_new0(GDBusConnection*, load->conn_count);
+	for (i = 0; address && i < load->conn_count; i++) {
+		load->conns[i] = g_dbus_connection_new_for_address_sync(address,
+			G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+			G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+			NULL, NULL, &error);
+		if (!load->conns[i]) {
+			break;
+		}
+	}
+	g_free(address);
+	if (error) {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+
+	/* Results are sent only to the connection which submitted the call */
+	load->signal_ids = g_new0(guint, load->conn_count);
+	for (i = 0; i < load->conn_count; i++) {
+		load->signal_ids[i] = g_dbus_connection_signal_subscribe(
+			load->conns[i], NULL, PROVISIONING_SERVICE_INTERFACE,
+			"ProvisioningResult", PROVISIONING_SERVICE_PATH, NULL,
+			G_DBUS_SIGNAL_FLAGS_NONE, load_result, load, NULL);
+	}
+	return TRUE;
+}
+
+static
+void
+load_cleanup(
+	struct load *load)
+{
+	guint i;
+
+	if (load->tick_id) {
+		g_source_remove(load->tick_id);
+	}
+	if (load->timeout_id) {
+		g_source_remove(load->timeout_id);
+	}
+	if (load->name_watch_id) {
+		g_bus_unwatch_name(load->name_watch_id);
+	}
+	if (load->conns) {
+		for (i = 0; i < (guint)load->conn_count; i++) {
+			if (load->signal_ids && load->signal_ids[i]) {
+				g_dbus_connection_signal_unsubscribe(load->conns[i],
+					load->signal_ids[i]);
+			}
+			if (load->conns[i]) {
+				g_object_unref(load->conns[i]);
+			}
+		}
+		g_free(load->signal_ids);
+		g_free(load->conns);
+	}
+	for (i = 0; i < load->payload_count; i++) {
+		if (load->payloads[i].data) {
+			g_variant_unref(load->payloads[i].data);
+		}
+		g_free(load->payloads[i].path);
+	}
+	g_free(load->payloads);
+	g_free(load->zipf_cdf);
+	g_hash_table_destroy(load->pending);
+	g_array_free(load->call_latency, TRUE);
+	g_array_free(load->result_latency, TRUE);
+	g_ptr_array_free(load->batch, TRUE);
+	g_main_loop_unref(load->loop);
+	g_rand_free(load->rand);
+}
+
+int main(int argc, char *argv[])
+{
+	struct load load;
+	char *bus = NULL;
+	char *arrival = NULL;
+	char *distribution = NULL;
+	char *mccmnc = NULL;
+	char **files = NULL;
+	gint seed = 0;
+	GError *error = NULL;
+	GOptionContext *options;
+	GOptionEntry entries[] = {
+		{ "bus", 'b', 0, G_OPTION_ARG_STRING, &bus,
+		  "system (default), session or ADDRESS", "BUS" },
+		{ "connections", 'c', 0, G_OPTION_ARG_INT, &load.conn_count,
+		  "Number of bus connections [1]", "N" },
+		{ "count", 'n', 0, G_OPTION_ARG_INT, &load.count,
+		  "Number of messages [1000]", "N" },
+		{ "rate", 'r', 0, G_OPTION_ARG_INT, &load.rate,
+		  "Messages per second, 0 for closed loop [0]", "N" },
+		{ "arrival", 'a', 0, G_OPTION_ARG_STRING, &arrival,
+		  "Arrival process: poisson, uniform or burst [poisson]", "TYPE" },
+		{ "window", 'w', 0, G_OPTION_ARG_INT, &load.window,
+		  "Messages in flight per connection in closed loop [1]", "N" },
+		{ "batch", 'B', 0, G_OPTION_ARG_INT, &load.batch_size,
+		  "Send up to N messages per call [1]", "N" },
+		{ "imsis", 'k', 0, G_OPTION_ARG_INT, &load.imsi_count,
+		  "Number of distinct IMSIs [1]", "N" },
+		{ "distribution", 'd', 0, G_OPTION_ARG_STRING, &distribution,
+		  "IMSI distribution: uniform, zipf or sequential [uniform]",
+		  "TYPE" },
+		{ "mccmnc", 'i', 0, G_OPTION_ARG_STRING, &mccmnc,
+		  "IMSI prefix [24499]", "MCCMNC" },
+		{ "file", 'f', 0, G_OPTION_ARG_FILENAME_ARRAY, &files,
+		  "Payload with optional relative weight", "FILE[:WEIGHT]" },
+		{ "timeout", 't', 0, G_OPTION_ARG_INT, &load.timeout,
+		  "Give up on results after SEC of silence [10]", "SEC" },
+		{ "seed", 's', 0, G_OPTION_ARG_INT, &seed,
+		  "Random seed", "N" },
+		{ "cold", 0, 0, G_OPTION_ARG_NONE, &load.cold,
+		  "Wait for the service to exit before each message", NULL },
+		{ NULL }
+	};
+	gboolean ok;
+	int ret = 1;
+
+	memset(&load, 0, sizeof(load));
+	load.conn_count = 1;
+	load.count = 1000;
+	load.window = 1;
+	load.batch_size = 1;
+	load.imsi_count = 1;
+	load.timeout = 10;
+	options = g_option_context_new("- provisioning service load generator");
+	g_option_context_add_main_entries(options, entries, NULL);
+	ok = g_option_context_parse(options, &argc, &argv, &error);
+	g_option_context_free(options);
+
+	if (arrival && !strcmp(arrival, "uniform")) {
+		load.arrival = LOAD_ARRIVAL_UNIFORM;
+	} else if (arrival && !strcmp(arrival, "burst")) {
+		load.arrival = LOAD_ARRIVAL_BURST;
+	} else if (arrival && strcmp(arrival, "poisson")) {
+		ok = FALSE;
+	}
+	if (distribution && !strcmp(distribution, "zipf")) {
+		load.distribution = LOAD_IMSI_ZIPF;
+	} else if (distribution && !strcmp(distribution, "sequential")) {
+		load.distribution = LOAD_IMSI_SEQUENTIAL;
+	} else if (distribution && strcmp(distribution, "uniform")) {
+		ok = FALSE;
+	}
+	load.mccmnc = mccmnc ? mccmnc : "24499";
+
+	if (error) {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+	} else if (!ok || load.conn_count < 1 || load.count < 1 ||
+		load.rate < 0 || load.window < 1 || load.batch_size < 1 ||
+		load.imsi_count < 1 ||
+		(load.cold && (load.rate > 0 || load.batch_size > 1)) ||
+		load.timeout < 1 || strlen(load.mccmnc) < 5 ||
+		strlen(load.mccmnc) > 6) {
+		fprintf(stderr, "Invalid arguments\n");
+	} else {
+		load.loop = g_main_loop_new(NULL, FALSE);
+		load.rand = seed ? g_rand_new_with_seed(seed) : g_rand_new();
+		load.pending = g_hash_table_new_full(NULL, NULL, NULL,
+			load_request_free);
+		load.call_latency = g_array_new(FALSE, FALSE, sizeof(gint64));
+		load.result_latency = g_array_new(FALSE, FALSE, sizeof(gint64));
+		load.batch = g_ptr_array_new();
+		if (load.distribution == LOAD_IMSI_ZIPF) {
+			load_init_zipf(&load);
+		}
+		if (load_parse_payloads(&load, files) && load_connect(&load, bus)) {
+			load.start = load.next_send = load.last_done =
+				g_get_monotonic_time();
+			if (load.cold) {
+				/* Sends the first message once the service is gone */
+				load.service_up = TRUE;
+				load.name_watch_id = g_bus_watch_name_on_connection(
+					load.conns[0], PROVISIONING_SERVICE,
+					G_BUS_NAME_WATCHER_FLAGS_NONE, load_service_appeared,
+					load_service_vanished, &load, NULL);
+			}
+			load_send_due(&load);
+			if (load.rate > 0) {
+				load.tick_id = g_timeout_add(1, load_tick, &load);
+			}
+			load.timeout_id = g_timeout_add_seconds(1, load_timeout, &load);
+			g_main_loop_run(load.loop);
+			load_report(&load);
+			ret = (load.call_errors || load.in_flight) ? 2 : 0;
+		}
+		load_cleanup(&load);
+	}
+	g_free(bus);
+	g_free(arrival);
+	g_free(distribution);
+	g_free(mccmnc);
+	g_strfreev(files);
+	return ret;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,369 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-common.h"
+#include "test-data.h"
+#include "provisioning-batch.h"
+#include "provisioning-decoder.h"
+
+static TestOpt test_opt;
+
+#define TEST_PREFIX "/batch/"
+#define TEST_SENDER ":1.1"
+
+/* Transactions started by the queue, completed by the test */
+struct test_tx {
+	struct provisioning_batch *batch;
+	guint txid;
+	char *imsi;
+};
+
+struct test_queue {
+	struct provisioning_batch_queue *queue;
+	guint last_txid;
+	GPtrArray *running;         /* test_tx, in the order started */
+	GPtrArray *started;         /* IMSIs, in the order started */
+	guint max_running;
+	guint finished;
+	guint batch_id;
+	guint results[PROV_FAILURE + 1];
+	gboolean sync;              /* Transactions complete right away */
+	enum prov_result sync_result;
+	guint depth;
+	guint max_depth;
+};
+
+static
+guint
+test_txid(
+	void *param)
+{
+	struct test_queue *test = param;
+
+	return ++test->last_txid;
+}
+
+static
+void
+test_start(
+	struct provisioning_batch *batch,
+	guint txid,
+	const char *imsi,
+	void *param)
+{
+	struct test_queue *test = param;
+
+	test->depth++;
+	test->max_depth = MAX(test->max_depth, test->depth);
+	g_ptr_array_add(test->started, g_strdup(imsi));
+	if (test->sync) {
+		provisioning_batch_done(batch, test->sync_result);
+	} else {
+		struct test_tx *tx = g_new(struct test_tx, 1);
+
+		tx->batch = batch;
+		tx->txid = txid;
+		tx->imsi = g_strdup(imsi);
+		g_ptr_array_add(test->running, tx);
+		test->max_running = MAX(test->max_running, test->running->len);
+	}
+	test->depth--;
+}
+
+static
+void
+test_finished(
+	struct provisioning_batch *batch,
+	void *param)
+{
+	struct test_queue *test = param;
+
+	g_assert_cmpuint(batch->finished, == ,batch->count);
+	g_assert_cmpstr(batch->sender, == ,TEST_SENDER);
+	test->finished++;
+	test->batch_id = batch->id;
+	memcpy(test->results, batch->results, sizeof(test->results));
+}
+
+static const struct provisioning_batch_callbacks test_cb = {
+	test_txid,
+	test_start,
+	test_finished
+};
+
+static
+void
+test_queue_init(
+	struct test_queue *test,
+	int max_parallel)
+{
+	memset(test, 0, sizeof(*test));
+	test->queue = provisioning_batch_queue_new(max_parallel, &test_cb, test);
+	test->running = g_ptr_array_new();
+	test->started = g_ptr_array_new_with_free_func(g_free);
+}
+
+static
+void
+test_queue_deinit(
+	struct test_queue *test)
+{
+	g_assert_cmpuint(test->running->len, == ,0);
+	provisioning_batch_queue_free(test->queue);
+	g_ptr_array_free(test->running, TRUE);
+	g_ptr_array_free(test->started, TRUE);
+}
+
+/* Completes the oldest running transaction */
+static
+void
+test_complete(
+	struct test_queue *test,
+	enum prov_result result)
+{
+	struct test_tx *tx;
+
+	g_assert_cmpuint(test->running->len, > ,0);
+	tx = g_ptr_array_remove_index(test->running, 0);
+	provisioning_batch_done(tx->batch, result);
+	g_free(tx->imsi);
+	g_free(tx);
+}
+
+static
+void
+test_idle(void)
+{
+	while (g_main_context_iteration(NULL, FALSE));
+}
+
+static
+void
+test_imsis(void)
+{
+	static const char *const none[] = { NULL };
+	static const char *const empty[] = { "244990000000000", "", NULL };
+	static const char *const dup[] = { "244990000000000", "244990000000001",
+		"244990000000000", NULL };
+	static const char *const ok[] = { "244990000000000", "244990000000001",
+		NULL };
+
+	g_assert_cmpstr(provisioning_batch_check_imsis(NULL), == ,
+		"Missing IMSI");
+	g_assert_cmpstr(provisioning_batch_check_imsis(none), == ,
+		"Missing IMSI");
+	g_assert_cmpstr(provisioning_batch_check_imsis(empty), == ,
+		"Missing IMSI");
+	g_assert_cmpstr(provisioning_batch_check_imsis(dup), == ,
+		"Duplicate IMSI");
+	g_assert(!provisioning_batch_check_imsis(ok));
+}
+
+static
+void
+test_parallel(void)
+{
+	static const char *const imsis[] = { "244990000000000",
+		"244990000000001", "244990000000002", "244990000000003",
+		"244990000000004" };
+	struct provisioning_data *data = test_data_new();
+	struct test_queue test;
+	struct provisioning_batch *batch;
+	guint txids[G_N_ELEMENTS(imsis)];
+	guint i;
+
+	test_queue_init(&test, 2);
+	batch = provisioning_batch_queue_add(test.queue, TEST_SENDER, data,
+		imsis, G_N_ELEMENTS(imsis), txids);
+	provisioning_data_unref(data);
+	g_assert(batch);
+	g_assert_cmpuint(batch->id, == ,1);
+	for (i = 0; i < G_N_ELEMENTS(imsis); i++) {
+		g_assert_cmpuint(txids[i], == ,i + 2);
+	}
+
+	/* Nothing gets started until the caller has returned */
+	g_assert_cmpuint(test.started->len, == ,0);
+	g_assert_cmpuint(provisioning_batch_queue_waiting(test.queue), == ,5);
+	test_idle();
+	g_assert_cmpuint(test.running->len, == ,2);
+	g_assert_cmpuint(provisioning_batch_queue_waiting(test.queue), == ,3);
+
+	/* Finishing one lets the next one go, in order */
+	test_complete(&test, PROV_SUCCESS);
+	g_assert_cmpuint(test.running->len, == ,1);
+	test_idle();
+	g_assert_cmpuint(test.running->len, == ,2);
+	while (test.running->len) {
+		test_complete(&test, PROV_SUCCESS);
+		test_idle();
+	}
+	g_assert_cmpuint(test.max_running, == ,2);
+	g_assert_cmpuint(test.started->len, == ,G_N_ELEMENTS(imsis));
+	for (i = 0; i < G_N_ELEMENTS(imsis); i++) {
+		g_assert_cmpstr(test.started->pdata[i], == ,imsis[i]);
+	}
+	g_assert_cmpuint(test.finished, == ,1);
+	g_assert_cmpuint(provisioning_batch_queue_waiting(test.queue), == ,0);
+	test_queue_deinit(&test);
+}
+
+static
+void
+test_results(void)
+{
+	static const char *const imsis1[] = { "244990000000000",
+		"244990000000001", "244990000000002", "244990000000003" };
+	static const char *const imsis2[] = { "244990000000004" };
+	struct provisioning_data *data = test_data_new();
+	struct test_queue test;
+	struct provisioning_batch *batch1, *batch2;
+	guint txids1[G_N_ELEMENTS(imsis1)];
+	guint txids2[G_N_ELEMENTS(imsis2)];
+
+	/* The limit applies to all batches together */
+	test_queue_init(&test, 0);
+	batch1 = provisioning_batch_queue_add(test.queue, TEST_SENDER, data,
+		imsis1, G_N_ELEMENTS(imsis1), txids1);
+	batch2 = provisioning_batch_queue_add(test.queue, TEST_SENDER, data,
+		imsis2, G_N_ELEMENTS(imsis2), txids2);
+	provisioning_data_unref(data);
+	g_assert(batch1);
+	g_assert(batch2);
+	g_assert_cmpuint(batch2->id, == ,txids1[3] + 1);
+	test_idle();
+	g_assert_cmpuint(test.running->len, == ,5);
+
+	test_complete(&test, PROV_SUCCESS);
+	test_complete(&test, PROV_PARTIAL_SUCCESS);
+	test_complete(&test, PROV_FAILURE);
+	g_assert_cmpuint(test.finished, == ,0);
+	test_complete(&test, PROV_FAILURE);
+	g_assert_cmpuint(test.finished, == ,1);
+	g_assert_cmpuint(test.batch_id, == ,1);
+	g_assert_cmpuint(test.results[PROV_SUCCESS], == ,1);
+	g_assert_cmpuint(test.results[PROV_PARTIAL_SUCCESS], == ,1);
+	g_assert_cmpuint(test.results[PROV_FAILURE], == ,2);
+
+	test_complete(&test, PROV_SUCCESS);
+	g_assert_cmpuint(test.finished, == ,2);
+	g_assert_cmpuint(test.batch_id, == ,txids1[3] + 1);
+	g_assert_cmpuint(test.results[PROV_SUCCESS], == ,1);
+	g_assert_cmpuint(test.results[PROV_PARTIAL_SUCCESS], == ,0);
+	g_assert_cmpuint(test.results[PROV_FAILURE], == ,0);
+	test_queue_deinit(&test);
+}
+
+static
+void
+test_sync(void)
+{
+	const guint n = 1000;
+	char **imsis = g_new0(char*, n + 1);
+	guint *txids = g_new(guint, n);
+	struct provisioning_data *data = test_data_new();
+	struct test_queue test;
+	guint i;
+
+	for (i = 0; i < n; i++) {
+		imsis[i] = g_strdup_printf("24499%010u", i);
+	}
+
+	/* Completing right away doesn't start the next one recursively */
+	test_queue_init(&test, 1);
+	test.sync = TRUE;
+	test.sync_result = PROV_FAILURE;
+	g_assert(provisioning_batch_queue_add(test.queue, TEST_SENDER, data,
+		(const char *const *)imsis, n, txids));
+	provisioning_data_unref(data);
+	test_idle();
+	g_assert_cmpuint(test.started->len, == ,n);
+	g_assert_cmpuint(test.max_depth, == ,1);
+	g_assert_cmpuint(test.finished, == ,1);
+	g_assert_cmpuint(test.results[PROV_FAILURE], == ,n);
+	test_queue_deinit(&test);
+	g_strfreev(imsis);
+	g_free(txids);
+}
+
+static
+void
+test_undecodable(void)
+{
+	static const char *const imsis[] = { "244990000000000" };
+	struct test_queue test;
+	guint txid = 0;
+
+	/* Nothing is started and nothing is reported */
+	test_queue_init(&test, 0);
+	g_assert(!provisioning_batch_queue_add(test.queue, TEST_SENDER, NULL,
+		imsis, G_N_ELEMENTS(imsis), &txid));
+	g_assert_cmpuint(txid, == ,0);
+	g_assert_cmpuint(test.last_txid, == ,0);
+	g_assert_cmpuint(provisioning_batch_queue_waiting(test.queue), == ,0);
+	test_idle();
+	g_assert_cmpuint(test.started->len, == ,0);
+	g_assert_cmpuint(test.finished, == ,0);
+	test_queue_deinit(&test);
+}
+
+static
+void
+test_free(void)
+{
+	static const char *const imsis[] = { "244990000000000",
+		"244990000000001", "244990000000002" };
+	struct provisioning_data *data = test_data_new();
+	struct provisioning_batch_queue *queue;
+	struct test_queue test;
+	guint txids[G_N_ELEMENTS(imsis)];
+
+	/* The running transactions outlive the queue, the rest is dropped */
+	test_queue_init(&test, 2);
+	g_assert(provisioning_batch_queue_add(test.queue, TEST_SENDER, data,
+		imsis, G_N_ELEMENTS(imsis), txids));
+	provisioning_data_unref(data);
+	test_idle();
+	g_assert_cmpuint(test.running->len, == ,2);
+	queue = test.queue;
+	test.queue = NULL;
+	provisioning_batch_queue_free(queue);
+	test_complete(&test, PROV_SUCCESS);
+	test_complete(&test, PROV_SUCCESS);
+	test_idle();
+	g_assert_cmpuint(test.started->len, == ,2);
+	g_assert_cmpuint(test.finished, == ,0);
+	test_queue_deinit(&test);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+	test_init(&test_opt, argc, argv);
+	g_test_add_func(TEST_PREFIX "imsis", test_imsis);
+	g_test_add_func(TEST_PREFIX "parallel", test_parallel);
+	g_test_add_func(TEST_PREFIX "results", test_results);
+	g_test_add_func(TEST_PREFIX "sync", test_sync);
+	g_test_add_func(TEST_PREFIX "undecodable", test_undecodable);
+	g_test_add_func(TEST_PREFIX "free", test_free);
+	return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
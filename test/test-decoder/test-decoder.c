@@ -36,8 +36,18 @@
 static TestOpt test_opt;
 
 #define DATA_DIR "../data"
+#define SLOW_DATA_DIR DATA_DIR G_DIR_SEPARATOR_S "slow"
 #define TEST_PREFIX "/decoder/"
 
+/*
+ * Time budget for decoding each input in SLOW_DATA_DIR. Those are
+ * saved by fuzz-decoder or crafted to hit the paths which used to be
+ * super-linear. Not enforced with -d because debugging is slow.
+ */
+#ifndef TEST_DECODE_BUDGET_MS
+#  define TEST_DECODE_BUDGET_MS (100)
+#endif
+
 struct test_decoder_data {
 	const char *name;
 	const char *file;
@@ -88,7 +98,7 @@ test_decoder(
 		g_assert(!prov->mms);
 	}
 
-	provisioning_data_free(prov);
+	provisioning_data_unref(prov);
 	g_free(wbxml);
 	g_free(path);
 }
@@ -191,6 +201,23 @@ static const struct provisioning_data prov_beeline_2 = {
 	.mms = &prov_beeline_mms
 };
 
+/* ======== Several PXPHYSICAL, PORT and NAPAUTHINFO ======== */
+
+static struct provisioning_mms prov_multi_mms = {
+	.name = "Multi MMS",
+	.apn = "mms.multi",
+	.username = "mmsuser",
+	.password = "mmspass",
+	.messageproxy = "10.0.0.1",
+	.messagecenter = "http://mmsc.multi/",
+	.portnro = "8080",
+	.authtype = AUTH_PAP
+};
+
+static const struct provisioning_data prov_multi = {
+	.mms = &prov_multi_mms
+};
+
 static const struct test_decoder_data tests [] = {
 	{ TEST_PREFIX "sonera", "prov_sonera.wbxml", &prov_sonera },
 	{ TEST_PREFIX "dna_1", "prov_dna_1.wbxml", &prov_dna_1 },
@@ -198,9 +225,43 @@ static const struct test_decoder_data tests [] = {
 	{ TEST_PREFIX "moi_1", "prov_moi_1.wbxml", &prov_moi_1 },
 	{ TEST_PREFIX "moi_2", "prov_moi_2.wbxml", &prov_moi_2 },
 	{ TEST_PREFIX "moi_3", "prov_moi_3.wbxml", &prov_moi_3 },
-	{ TEST_PREFIX "beeline_2", "prov_beeline_2.wbxml", &prov_beeline_2 }
+	{ TEST_PREFIX "beeline_2", "prov_beeline_2.wbxml", &prov_beeline_2 },
+	{ TEST_PREFIX "multi", "prov_multi.wbxml", &prov_multi }
 };
 
+static
+void
+test_slow(
+	void)
+{
+	GDir *dir = g_dir_open(SLOW_DATA_DIR, 0, NULL);
+	const char *name;
+
+	g_assert(dir);
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		char *path = g_build_filename(SLOW_DATA_DIR, name, NULL);
+		struct provisioning_data *prov;
+		gchar *wbxml;
+		gsize length;
+		gint64 start, ms;
+
+		g_assert(g_file_get_contents(path, &wbxml, &length, NULL));
+		start = g_get_monotonic_time();
+		prov = decode_provisioning_wbxml((void*)wbxml, length);
+		ms = (g_get_monotonic_time() - start) / 1000;
+		LOG("%s: %u bytes, %d ms", path, (guint)length, (int)ms);
+		if (!(test_opt.flags & TEST_FLAG_DEBUG)) {
+			g_assert_cmpint(ms, <= ,TEST_DECODE_BUDGET_MS);
+		}
+		if (prov) {
+			provisioning_data_unref(prov);
+		}
+		g_free(wbxml);
+		g_free(path);
+	}
+	g_dir_close(dir);
+}
+
 int main(int argc, char *argv[])
 {
 	guint i;
@@ -210,6 +271,7 @@ int main(int argc, char *argv[])
 		const struct test_decoder_data *test = tests + i;
 		g_test_add_data_func(test->name, test, test_decoder);
 	}
+	g_test_add_func(TEST_PREFIX "slow", test_slow);
 	return g_test_run();
 }
 
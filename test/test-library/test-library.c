@@ -0,0 +1,239 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-common.h"
+#include "provisioning-prescan.h"
+
+#include <prov_decoder.h>
+
+static TestOpt test_opt;
+
+#define DATA_DIR "../data"
+#define TEST_PREFIX "/library/"
+
+static
+GBytes *
+test_load(
+	const char *file)
+{
+	char *path = g_build_filename(DATA_DIR, file, NULL);
+	gchar *data;
+	gsize length;
+
+	LOG("Loading %s", path);
+	g_assert(g_file_get_contents(path, &data, &length, NULL));
+	g_free(path);
+	return g_bytes_new_take(data, length);
+}
+
+static
+ProvSettings *
+test_decode(
+	ProvDecoder *decoder,
+	GBytes *bytes,
+	GError **error)
+{
+	gsize len;
+	const void *data = g_bytes_get_data(bytes, &len);
+	return prov_decoder_decode(decoder, data, len, error);
+}
+
+static
+void
+test_version(
+	void)
+{
+	g_assert_cmpuint(prov_decoder_version(), == ,PROV_DECODER_VERSION);
+	g_assert_cmpuint(PROV_DECODER_VERSION, == ,PROV_DECODER_VERSION_(1,0,0));
+}
+
+static
+void
+test_null(
+	void)
+{
+	GError *error = NULL;
+
+	g_assert(!prov_decoder_ref(NULL));
+	prov_decoder_unref(NULL);
+	g_assert(!prov_decoder_set_limit(NULL, PROV_DECODER_LIMIT_BYTES, 1));
+	g_assert(!prov_decoder_get_limit(NULL, PROV_DECODER_LIMIT_BYTES));
+	g_assert(!prov_settings_ref(NULL));
+	prov_settings_unref(NULL);
+	g_assert(!prov_settings_has_context(NULL, PROV_SETTINGS_INTERNET));
+	g_assert(!prov_settings_get_string(NULL, PROV_SETTINGS_INTERNET,
+		PROV_SETTINGS_APN));
+	g_assert_cmpint(prov_settings_get_auth(NULL, PROV_SETTINGS_MMS), == ,
+		PROV_SETTINGS_AUTH_UNKNOWN);
+	g_assert(!prov_settings_to_variant(NULL));
+
+	/* NULL decoder means no limits */
+	g_assert(!prov_decoder_decode(NULL, NULL, 0, &error));
+	g_assert_error(error, PROV_DECODER_ERROR, PROV_DECODER_ERROR_REJECTED);
+	g_error_free(error);
+}
+
+static
+void
+test_limits(
+	void)
+{
+	ProvDecoder *decoder = prov_decoder_new();
+
+	/* Same defaults as the service */
+	g_assert_cmpuint(prov_decoder_get_limit(decoder,
+		PROV_DECODER_LIMIT_BYTES), == ,PROV_PRESCAN_MAX_BYTES);
+	g_assert_cmpuint(prov_decoder_get_limit(decoder,
+		PROV_DECODER_LIMIT_DEPTH), == ,PROV_PRESCAN_MAX_DEPTH);
+	g_assert_cmpuint(prov_decoder_get_limit(decoder,
+		PROV_DECODER_LIMIT_STRTBL), == ,PROV_PRESCAN_MAX_STRTBL);
+	g_assert_cmpuint(prov_decoder_get_limit(decoder,
+		PROV_DECODER_LIMIT_CHARACTERISTICS), == ,
+		PROV_PRESCAN_MAX_CHARACTERISTICS);
+	g_assert_cmpuint(prov_decoder_get_limit(decoder,
+		PROV_DECODER_LIMIT_PARMS), == ,PROV_PRESCAN_MAX_PARMS);
+
+	g_assert(prov_decoder_set_limit(decoder, PROV_DECODER_LIMIT_DEPTH, 3));
+	g_assert_cmpuint(prov_decoder_get_limit(decoder,
+		PROV_DECODER_LIMIT_DEPTH), == ,3);
+	g_assert(prov_decoder_set_limit(decoder, PROV_DECODER_LIMIT_BYTES, 0));
+	g_assert_cmpuint(prov_decoder_get_limit(decoder,
+		PROV_DECODER_LIMIT_BYTES), == ,0);
+	g_assert(!prov_decoder_set_limit(decoder, (ProvDecoderLimit)-1, 0));
+	g_assert(!prov_decoder_get_limit(decoder, (ProvDecoderLimit)-1));
+
+	g_assert(prov_decoder_ref(decoder) == decoder);
+	prov_decoder_unref(decoder);
+	prov_decoder_unref(decoder);
+}
+
+static
+void
+test_rejected(
+	void)
+{
+	static const guint8 garbage[] = { 0x03, 0x0b, 0x6a, 0x00, 0x01 };
+	ProvDecoder *decoder = prov_decoder_new();
+	GBytes *bytes = test_load("prov_sonera.wbxml");
+	GError *error = NULL;
+
+	g_assert(!prov_decoder_decode(decoder, garbage, sizeof(garbage),
+		&error));
+	g_assert_error(error, PROV_DECODER_ERROR, PROV_DECODER_ERROR_REJECTED);
+	g_clear_error(&error);
+
+	/* Fine until it's over the limit */
+	prov_decoder_set_limit(decoder, PROV_DECODER_LIMIT_BYTES,
+		g_bytes_get_size(bytes) - 1);
+	g_assert(!test_decode(decoder, bytes, &error));
+	g_assert_error(error, PROV_DECODER_ERROR, PROV_DECODER_ERROR_REJECTED);
+	g_clear_error(&error);
+
+	/* Error is optional */
+	g_assert(!test_decode(decoder, bytes, NULL));
+	g_bytes_unref(bytes);
+	prov_decoder_unref(decoder);
+}
+
+static
+void
+test_settings(
+	void)
+{
+	ProvDecoder *decoder = prov_decoder_new();
+	GBytes *bytes = test_load("prov_sonera.wbxml");
+	ProvSettings *settings = test_decode(decoder, bytes, NULL);
+	GVariant *var;
+
+	g_assert(settings);
+	g_assert(prov_settings_ref(settings) == settings);
+	prov_settings_unref(settings);
+
+	g_assert(prov_settings_has_context(settings, PROV_SETTINGS_INTERNET));
+	g_assert_cmpstr(prov_settings_get_string(settings,
+		PROV_SETTINGS_INTERNET, PROV_SETTINGS_NAME), == ,"Sonera Internet");
+	g_assert_cmpstr(prov_settings_get_string(settings,
+		PROV_SETTINGS_INTERNET, PROV_SETTINGS_APN), == ,"internet");
+	g_assert(!prov_settings_get_string(settings,
+		PROV_SETTINGS_INTERNET, PROV_SETTINGS_MESSAGE_CENTER));
+	g_assert_cmpint(prov_settings_get_auth(settings,
+		PROV_SETTINGS_INTERNET), == ,PROV_SETTINGS_AUTH_PAP);
+
+	g_assert(prov_settings_has_context(settings, PROV_SETTINGS_MMS));
+	g_assert_cmpstr(prov_settings_get_string(settings,
+		PROV_SETTINGS_MMS, PROV_SETTINGS_APN), == ,"wap.sonera.net");
+	g_assert_cmpstr(prov_settings_get_string(settings,
+		PROV_SETTINGS_MMS, PROV_SETTINGS_MESSAGE_PROXY), == ,
+		"195.156.25.33");
+	g_assert_cmpstr(prov_settings_get_string(settings,
+		PROV_SETTINGS_MMS, PROV_SETTINGS_MESSAGE_CENTER), == ,
+		"http://mms.sonera.fi:8002/");
+	g_assert_cmpstr(prov_settings_get_string(settings,
+		PROV_SETTINGS_MMS, PROV_SETTINGS_PORT), == ,"80");
+
+	var = g_variant_ref_sink(prov_settings_to_variant(settings));
+	g_assert(g_variant_is_of_type(var, G_VARIANT_TYPE_VARDICT));
+	g_assert(g_variant_lookup(var, "internet", "@a{sv}", NULL));
+	g_assert(g_variant_lookup(var, "mms", "@a{sv}", NULL));
+	g_variant_unref(var);
+
+	prov_settings_unref(settings);
+	g_bytes_unref(bytes);
+	prov_decoder_unref(decoder);
+}
+
+static
+void
+test_partial(
+	void)
+{
+	ProvDecoder *decoder = prov_decoder_new();
+	GBytes *bytes = test_load("prov_dna_1.wbxml");
+	ProvSettings *settings = test_decode(decoder, bytes, NULL);
+
+	/* Internet only */
+	g_assert(settings);
+	g_assert(prov_settings_has_context(settings, PROV_SETTINGS_INTERNET));
+	g_assert(!prov_settings_has_context(settings, PROV_SETTINGS_MMS));
+	g_assert(!prov_settings_get_string(settings, PROV_SETTINGS_MMS,
+		PROV_SETTINGS_APN));
+	g_assert_cmpint(prov_settings_get_auth(settings,
+		PROV_SETTINGS_INTERNET), == ,PROV_SETTINGS_AUTH_UNKNOWN);
+	g_assert_cmpint(prov_settings_get_auth(settings,
+		PROV_SETTINGS_MMS), == ,PROV_SETTINGS_AUTH_UNKNOWN);
+	prov_settings_unref(settings);
+	g_bytes_unref(bytes);
+	prov_decoder_unref(decoder);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+	test_init(&test_opt, argc, argv);
+	g_test_add_func(TEST_PREFIX "version", test_version);
+	g_test_add_func(TEST_PREFIX "null", test_null);
+	g_test_add_func(TEST_PREFIX "limits", test_limits);
+	g_test_add_func(TEST_PREFIX "rejected", test_rejected);
+	g_test_add_func(TEST_PREFIX "settings", test_settings);
+	g_test_add_func(TEST_PREFIX "partial", test_partial);
+	return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,654 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-common.h"
+#include "test-data.h"
+#include "test-malloc.h"
+#include "fake-ofono.h"
+#include "provisioning-ofono.h"
+#include "provisioning-decoder.h"
+
+#include <gofono_connmgr.h>
+#include <gofono_names.h>
+
+static TestOpt test_opt;
+
+#define TEST_PREFIX "/ofono/"
+#define TEST_IMSI "244051234567890"
+#define TEST_MODEM "/ril_0"
+#define TEST_TIMEOUT 20 /* sec */
+
+/*
+ * Heap allocations allowed per warm transaction, not counting ofono's.
+ * Two are the transaction timeout, one is test_done() and the rest is
+ * the main loop taking the finished calls of the fake off its list.
+ * Anything done per property write would blow it.
+ */
+#define TEST_MAX_ALLOCS 7
+
+#define INTERNET OFONO_CONNCTX_TYPE_INTERNET
+#define MMS OFONO_CONNCTX_TYPE_MMS
+
+struct test_result {
+	GMainLoop *loop;
+	char *path;
+	struct provisioning_ofono_report report;
+};
+
+static
+gboolean
+test_timeout(
+	gpointer data)
+{
+	g_assert(!"Test timed out");
+	return G_SOURCE_REMOVE;
+}
+
+static
+void
+test_done(
+	const char *imsi,
+	const char *path,
+	const struct provisioning_ofono_report *report,
+	void *param)
+{
+	struct test_result *result = param;
+	g_assert_cmpstr(imsi, == ,TEST_IMSI);
+	g_assert(!result->path);
+	result->path = g_strdup(path ? path : "");
+	result->report = *report;
+	g_main_loop_quit(result->loop);
+}
+
+/* Runs provisioning to completion, the caller frees result->path */
+static
+void
+test_run_full(
+	guint internet_props,
+	guint mms_props,
+	gboolean update,
+	struct test_result *result)
+{
+	struct provisioning_data *data = test_data_new();
+	guint timeout_id = g_timeout_add_seconds(TEST_TIMEOUT, test_timeout, NULL);
+
+	memset(result, 0, sizeof(*result));
+	result->loop = g_main_loop_new(NULL, FALSE);
+	if (update) {
+		provisioning_ofono_update(TEST_IMSI, data, test_done, result);
+	} else {
+		provisioning_ofono_props(TEST_IMSI, data, internet_props, mms_props,
+			test_done, result);
+	}
+	provisioning_data_unref(data);
+	if (!result->path) {
+		/* Nothing to wait for if it's already done */
+		g_main_loop_run(result->loop);
+	}
+	g_main_loop_unref(result->loop);
+	g_source_remove(timeout_id);
+
+	/* Let the cancelled calls complete and check for leaks */
+	while (g_main_context_iteration(NULL, FALSE));
+	g_assert_cmpuint(fake_ofono_objects(), == ,0);
+}
+
+static
+void
+test_run(
+	guint internet_props,
+	guint mms_props,
+	struct test_result *result)
+{
+	test_run_full(internet_props, mms_props, FALSE, result);
+}
+
+static
+void
+test_basic(void)
+{
+	struct test_result result;
+	FakeOfonoModem *modem;
+
+	fake_ofono_init();
+	modem = fake_ofono_add_modem(TEST_MODEM, TEST_IMSI);
+	test_run(PROV_PROPERTIES_INTERNET, PROV_PROPERTIES_MMS, &result);
+
+	g_assert_cmpint(result.report.result, == ,PROV_SUCCESS);
+	g_assert_cmpstr(result.path, == ,TEST_MODEM);
+	g_assert_cmpuint(result.report.internet_failed, == ,0);
+	g_assert_cmpuint(result.report.mms_failed, == ,0);
+	g_assert_cmpuint(result.report.retries, == ,0);
+	g_assert_cmpuint(fake_ofono_calls(), == ,12);
+	g_assert_cmpstr(fake_ofono_modem_property(modem, INTERNET,
+		OFONO_CONNCTX_PROPERTY_APN), == ,"internet");
+	g_assert_cmpstr(fake_ofono_modem_property(modem, INTERNET,
+		OFONO_CONNCTX_PROPERTY_AUTH), == ,"pap");
+	g_assert_cmpstr(fake_ofono_modem_property(modem, MMS,
+		OFONO_CONNCTX_PROPERTY_AUTH), == ,"none");
+	g_assert_cmpstr(fake_ofono_modem_property(modem, MMS,
+		OFONO_CONNCTX_PROPERTY_MMS_PROXY), == ,"10.0.0.1:8080");
+	g_assert_cmpstr(fake_ofono_modem_property(modem, MMS,
+		OFONO_CONNCTX_PROPERTY_MMS_CENTER), == ,"http://mms/");
+	g_free(result.path);
+	fake_ofono_deinit();
+}
+
+static
+void
+test_second_modem(void)
+{
+	struct test_result result;
+	FakeOfonoModem *modem;
+
+	fake_ofono_init();
+	fake_ofono_add_modem("/ril_0", "244050000000000");
+	fake_ofono_add_modem("/ril_1", NULL);
+	modem = fake_ofono_add_modem("/ril_2", TEST_IMSI);
+	test_run(PROV_PROPERTIES_INTERNET, PROV_PROPERTIES_MMS, &result);
+
+	g_assert_cmpint(result.report.result, == ,PROV_SUCCESS);
+	g_assert_cmpstr(result.path, == ,"/ril_2");
+	g_assert_cmpstr(fake_ofono_modem_property(modem, INTERNET,
+		OFONO_CONNCTX_PROPERTY_APN), == ,"internet");
+	g_free(result.path);
+	fake_ofono_deinit();
+}
+
+static
+void
+test_delays(void)
+{
+	struct test_result result;
+	FakeOfonoModem *modem;
+
+	fake_ofono_init();
+	fake_ofono_set_manager_delay(5);
+	modem = fake_ofono_add_modem(TEST_MODEM, TEST_IMSI);
+	fake_ofono_modem_set_delays(modem, 5, 5, 5);
+	fake_ofono_modem_set_latency(modem, 2, 3);
+	test_run(PROV_PROPERTIES_INTERNET, PROV_PROPERTIES_MMS, &result);
+
+	g_assert_cmpint(result.report.result, == ,PROV_SUCCESS);
+	g_assert_cmpstr(result.path, == ,TEST_MODEM);
+	g_free(result.path);
+	fake_ofono_deinit();
+}
+
+static
+void
+test_active(void)
+{
+	struct test_result result;
+	FakeOfonoModem *modem;
+
+	fake_ofono_init();
+	modem = fake_ofono_add_modem(TEST_MODEM, TEST_IMSI);
+	fake_ofono_modem_set_active(modem, INTERNET, TRUE);
+	test_run(PROV_PROPERTIES_INTERNET, PROV_PROPERTIES_MMS, &result);
+
+	/* The context stays down */
+	g_assert_cmpint(result.report.result, == ,PROV_SUCCESS);
+	g_assert(!fake_ofono_modem_active(modem, INTERNET));
+	g_assert_cmpstr(fake_ofono_modem_property(modem, INTERNET,
+		OFONO_CONNCTX_PROPERTY_APN), == ,"internet");
+	g_free(result.path);
+	fake_ofono_deinit();
+}
+
+static
+void
+test_reactivate(void)
+{
+	struct test_result result;
+	FakeOfonoModem *modem;
+
+	fake_ofono_init();
+	modem = fake_ofono_add_modem(TEST_MODEM, TEST_IMSI);
+	fake_ofono_modem_set_latency(modem, 1, 1);
+	fake_ofono_modem_set_active(modem, INTERNET, TRUE);
+	provisioning_ofono_set_reactivate(TRUE);
+	test_run(PROV_PROPERTIES_INTERNET, PROV_PROPERTIES_MMS, &result);
+	provisioning_ofono_set_reactivate(FALSE);
+
+	/* The context is back up, the inactive one stays down */
+	g_assert_cmpint(result.report.result, == ,PROV_SUCCESS);
+	g_assert(fake_ofono_modem_active(modem, INTERNET));
+	g_assert(!fake_ofono_modem_active(modem, MMS));
+	g_free(result.path);
+	fake_ofono_deinit();
+}
+
+static
+void
+test_reactivate_failed(void)
+{
+	struct test_result result;
+	FakeOfonoModem *modem;
+	gint64 start;
+
+	fake_ofono_init();
+	modem = fake_ofono_add_modem(TEST_MODEM, TEST_IMSI);
+	fake_ofono_modem_set_latency(modem, 1, 1);
+	fake_ofono_modem_set_active(modem, INTERNET, TRUE);
+	fake_ofono_modem_fail(modem, INTERNET, OFONO_CONNCTX_PROPERTY_ACTIVE,
+		OFONO_ERROR_FAILED, 1);
+	provisioning_ofono_set_reactivate(TRUE);
+	start = g_get_monotonic_time();
+	test_run(PROV_PROPERTIES_INTERNET, PROV_PROPERTIES_MMS, &result);
+	provisioning_ofono_set_reactivate(FALSE);
+
+	/* Reported right away rather than after the re-activation timeout */
+	g_assert_cmpint(result.report.result, == ,PROV_SUCCESS);
+	g_assert(!fake_ofono_modem_active(modem, INTERNET));
+	g_assert_cmpint(g_get_monotonic_time() - start, < ,5 * G_USEC_PER_SEC);
+	g_free(result.path);
+	fake_ofono_deinit();
+}
+
+static
+void
+test_reactivate_error(void)
+{
+	struct test_result result;
+	FakeOfonoModem *modem;
+
+	fake_ofono_init();
+	modem = fake_ofono_add_modem(TEST_MODEM, TEST_IMSI);
+	fake_ofono_modem_set_active(modem, INTERNET, TRUE);
+	fake_ofono_modem_fail(modem, INTERNET, OFONO_CONNCTX_PROPERTY_APN,
+		OFONO_ERROR_INVALID_ARGS, 1);
+	provisioning_ofono_set_reactivate(TRUE);
+	test_run(PROV_PROPERTIES_INTERNET, 0, &result);
+	provisioning_ofono_set_reactivate(FALSE);
+
+	/* Half-provisioned context is not brought back up */
+	g_assert_cmpint(result.report.result, == ,PROV_FAILURE);
+	g_assert_cmpuint(result.report.internet_failed, == ,
+		PROV_PROPERTY_BIT(PROV_PROPERTY_APN));
+	g_assert(!fake_ofono_modem_active(modem, INTERNET));
+	g_free(result.path);
+	fake_ofono_deinit();
+}
+
+static
+void
+test_retry(void)
+{
+	struct test_result result;
+	FakeOfonoModem *modem;
+
+	fake_ofono_init();
+	modem = fake_ofono_add_modem(TEST_MODEM, TEST_IMSI);
+	fake_ofono_modem_fail(modem, INTERNET, OFONO_CONNCTX_PROPERTY_APN,
+		OFONO_ERROR_IN_PROGRESS, 2);
+	test_run(PROV_PROPERTIES_INTERNET, PROV_PROPERTIES_MMS, &result);
+
+	g_assert_cmpint(result.report.result, == ,PROV_SUCCESS);
+	g_assert_cmpuint(result.report.retries, == ,2);
+	g_assert_cmpuint(fake_ofono_calls(), == ,14);
+	g_assert_cmpstr(fake_ofono_modem_property(modem, INTERNET,
+		OFONO_CONNCTX_PROPERTY_APN), == ,"internet");
+	g_free(result.path);
+	fake_ofono_deinit();
+}
+
+static
+void
+test_retry_active(void)
+{
+	struct test_result result;
+	struct provisioning_data *data = test_data_new();
+	FakeOfonoModem *modem;
+
+	fake_ofono_init();
+	modem = fake_ofono_add_modem(TEST_MODEM, TEST_IMSI);
+	fake_ofono_modem_set_latency(modem, 1, 1);
+	fake_ofono_modem_fail(modem, INTERNET, OFONO_CONNCTX_PROPERTY_APN,
+		OFONO_ERROR_IN_PROGRESS, 1);
+	memset(&result, 0, sizeof(result));
+	result.loop = g_main_loop_new(NULL, FALSE);
+	provisioning_ofono_props(TEST_IMSI, data, PROV_PROPERTIES_INTERNET, 0,
+		test_done, &result);
+
+	/* Something brings the context up while the APN waits for a retry */
+	g_assert_cmpuint(fake_ofono_calls(), == ,5);
+	fake_ofono_modem_set_active(modem, INTERNET, TRUE);
+	g_main_loop_run(result.loop);
+
+	/* The retry has waited for it to go down again */
+	g_assert_cmpint(result.report.result, == ,PROV_SUCCESS);
+	g_assert_cmpuint(result.report.retries, == ,1);
+	g_assert_cmpuint(fake_ofono_calls(), == ,6);
+	g_assert(!fake_ofono_modem_active(modem, INTERNET));
+	g_assert_cmpstr(fake_ofono_modem_property(modem, INTERNET,
+		OFONO_CONNCTX_PROPERTY_APN), == ,"internet");
+	while (g_main_context_iteration(NULL, FALSE));
+	g_assert_cmpuint(fake_ofono_objects(), == ,0);
+	provisioning_data_unref(data);
+	g_main_loop_unref(result.loop);
+	g_free(result.path);
+	fake_ofono_deinit();
+}
+
+static
+void
+test_error(void)
+{
+	struct test_result result;
+	FakeOfonoModem *modem;
+
+	fake_ofono_init();
+	modem = fake_ofono_add_modem(TEST_MODEM, TEST_IMSI);
+	fake_ofono_modem_fail(modem, MMS, OFONO_CONNCTX_PROPERTY_APN,
+		OFONO_ERROR_INVALID_ARGS, 1);
+	test_run(PROV_PROPERTIES_INTERNET, PROV_PROPERTIES_MMS, &result);
+
+	/* Permanent errors are not retried */
+	g_assert_cmpint(result.report.result, == ,PROV_PARTIAL_SUCCESS);
+	g_assert_cmpuint(result.report.retries, == ,0);
+	g_assert_cmpuint(result.report.internet_failed, == ,0);
+	g_assert_cmpuint(result.report.mms_failed, == ,
+		PROV_PROPERTY_BIT(PROV_PROPERTY_APN));
+	g_assert(!fake_ofono_modem_property(modem, MMS,
+		OFONO_CONNCTX_PROPERTY_APN));
+	g_free(result.path);
+	fake_ofono_deinit();
+}
+
+static
+void
+test_subset(void)
+{
+	struct test_result result;
+	FakeOfonoModem *modem;
+
+	fake_ofono_init();
+	modem = fake_ofono_add_modem(TEST_MODEM, TEST_IMSI);
+	test_run(PROV_PROPERTY_BIT(PROV_PROPERTY_APN), 0, &result);
+
+	g_assert_cmpint(result.report.result, == ,PROV_SUCCESS);
+	g_assert_cmpuint(fake_ofono_calls(), == ,1);
+	g_assert_cmpstr(fake_ofono_modem_property(modem, INTERNET,
+		OFONO_CONNCTX_PROPERTY_APN), == ,"internet");
+	g_assert(!fake_ofono_modem_property(modem, INTERNET,
+		OFONO_CONNCTX_PROPERTY_NAME));
+	g_assert(!fake_ofono_modem_property(modem, MMS,
+		OFONO_CONNCTX_PROPERTY_APN));
+	g_free(result.path);
+	fake_ofono_deinit();
+}
+
+static
+void
+test_update(void)
+{
+	struct test_result result;
+	FakeOfonoModem *modem;
+
+	fake_ofono_init();
+	modem = fake_ofono_add_modem(TEST_MODEM, TEST_IMSI);
+	test_run(PROV_PROPERTIES_INTERNET, PROV_PROPERTIES_MMS, &result);
+	g_assert_cmpint(result.report.result, == ,PROV_SUCCESS);
+	g_assert_cmpuint(fake_ofono_calls(), == ,12);
+	g_free(result.path);
+
+	/* Everything is up to date, the active context is left alone */
+	fake_ofono_modem_set_active(modem, INTERNET, TRUE);
+	test_run_full(0, 0, TRUE, &result);
+	g_assert_cmpint(result.report.result, == ,PROV_SUCCESS);
+	g_assert_cmpstr(result.path, == ,TEST_MODEM);
+	g_assert_cmpuint(fake_ofono_calls(), == ,12);
+	g_assert(fake_ofono_modem_active(modem, INTERNET));
+	g_free(result.path);
+
+	/* Only what differs gets written */
+	fake_ofono_modem_set_property(modem, MMS,
+		OFONO_CONNCTX_PROPERTY_MMS_CENTER, "http://other/");
+	fake_ofono_modem_set_property(modem, MMS,
+		OFONO_CONNCTX_PROPERTY_AUTH, "chap");
+	test_run_full(0, 0, TRUE, &result);
+	g_assert_cmpint(result.report.result, == ,PROV_SUCCESS);
+	g_assert_cmpuint(result.report.mms_failed, == ,0);
+	g_assert_cmpuint(fake_ofono_calls(), == ,14);
+	g_assert(fake_ofono_modem_active(modem, INTERNET));
+	g_assert_cmpstr(fake_ofono_modem_property(modem, MMS,
+		OFONO_CONNCTX_PROPERTY_MMS_CENTER), == ,"http://mms/");
+	g_assert_cmpstr(fake_ofono_modem_property(modem, MMS,
+		OFONO_CONNCTX_PROPERTY_AUTH), == ,"none");
+	g_free(result.path);
+	fake_ofono_deinit();
+}
+
+static
+void
+test_watch_cb(
+	const char *imsi,
+	void *param)
+{
+	g_ptr_array_add(param, g_strdup(imsi));
+}
+
+static
+void
+test_watch(void)
+{
+	GPtrArray *seen = g_ptr_array_new_with_free_func(g_free);
+	struct provisioning_ofono_watch *watch;
+	FakeOfonoModem *modem0;
+	FakeOfonoModem *modem1;
+
+	fake_ofono_init();
+	fake_ofono_set_manager_delay(1);
+	modem0 = fake_ofono_add_modem("/ril_0", "244050000000000");
+	modem1 = fake_ofono_add_modem("/ril_1", NULL);
+	watch = provisioning_ofono_watch_new(test_watch_cb, seen);
+	g_assert_cmpuint(seen->len, == ,0);
+	while (!seen->len) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+	g_assert_cmpuint(seen->len, == ,1);
+	g_assert_cmpstr(seen->pdata[0], == ,"244050000000000");
+
+	/* SIM insertion */
+	fake_ofono_modem_set_imsi(modem1, "244050000000001");
+	g_assert_cmpuint(seen->len, == ,2);
+	g_assert_cmpstr(seen->pdata[1], == ,"244050000000001");
+
+	/* The same SIM is reported again after it has been removed */
+	fake_ofono_modem_set_imsi(modem0, NULL);
+	fake_ofono_modem_set_imsi(modem0, "244050000000000");
+	g_assert_cmpuint(seen->len, == ,3);
+	g_assert_cmpstr(seen->pdata[2], == ,"244050000000000");
+
+	/* New modem */
+	fake_ofono_add_modem("/ril_2", "244050000000002");
+	g_assert_cmpuint(seen->len, == ,4);
+	g_assert_cmpstr(seen->pdata[3], == ,"244050000000002");
+
+	provisioning_ofono_watch_free(watch);
+	g_assert_cmpuint(fake_ofono_objects(), == ,0);
+	g_ptr_array_free(seen, TRUE);
+	fake_ofono_deinit();
+}
+
+static
+gboolean
+test_quit(
+	gpointer loop)
+{
+	g_main_loop_quit(loop);
+	return G_SOURCE_REMOVE;
+}
+
+static
+void
+test_prewarm(void)
+{
+	struct test_result result;
+	struct provisioning_data *data = test_data_new();
+	struct provisioning_ofono_watch *watch;
+	OfonoConnMgr *connmgr;
+	FakeOfonoModem *modem;
+	guint timeout_id;
+
+	fake_ofono_init();
+	fake_ofono_set_manager_delay(5);
+	modem = fake_ofono_add_modem(TEST_MODEM, TEST_IMSI);
+	fake_ofono_modem_set_delays(modem, 5, 5, 5);
+
+	/* Let the watch get everything ready */
+	memset(&result, 0, sizeof(result));
+	result.loop = g_main_loop_new(NULL, FALSE);
+	timeout_id = g_timeout_add_seconds(TEST_TIMEOUT, test_timeout, NULL);
+	watch = provisioning_ofono_watch_new(NULL, NULL);
+	while (fake_ofono_pending_objects()) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+	connmgr = ofono_connmgr_new(TEST_MODEM);
+	g_assert(ofono_connmgr_valid(connmgr));
+
+	/*
+	 * Anything created from now on would take longer than the test is
+	 * allowed to run. Nothing is, there's nothing to wait for but the
+	 * calls.
+	 */
+	fake_ofono_set_manager_delay(TEST_TIMEOUT * 1000);
+	fake_ofono_modem_set_delays(modem, TEST_TIMEOUT * 1000,
+		TEST_TIMEOUT * 1000, TEST_TIMEOUT * 1000);
+	provisioning_ofono(TEST_IMSI, data, test_done, &result);
+	g_assert_cmpuint(fake_ofono_pending_objects(), == ,0);
+	if (!result.path) {
+		g_main_loop_run(result.loop);
+	}
+	g_assert_cmpuint(fake_ofono_pending_objects(), == ,0);
+	g_assert_cmpint(result.report.result, == ,PROV_SUCCESS);
+	g_assert_cmpstr(result.path, == ,TEST_MODEM);
+	g_assert_cmpstr(fake_ofono_modem_property(modem, MMS,
+		OFONO_CONNCTX_PROPERTY_APN), == ,"mms");
+
+	g_source_remove(timeout_id);
+	ofono_connmgr_unref(connmgr);
+	provisioning_ofono_watch_free(watch);
+	while (g_main_context_iteration(NULL, FALSE));
+	g_assert_cmpuint(fake_ofono_objects(), == ,0);
+	provisioning_data_unref(data);
+	g_main_loop_unref(result.loop);
+	g_free(result.path);
+	fake_ofono_deinit();
+}
+
+static
+guint64
+test_allocs_count(void)
+{
+	TestMallocStats stats;
+
+	test_malloc_get_stats(&stats);
+	return stats.allocs;
+}
+
+/*
+ * Warm transactions share the ofono objects with the watch. Returns
+ * the number of allocations made by the service.
+ */
+static
+guint64
+test_allocs_run(
+	struct provisioning_data *data,
+	struct test_result *result)
+{
+	const guint64 fake_before = fake_ofono_allocs();
+	TestMallocStats before, after;
+
+	memset(result, 0, sizeof(*result));
+	result->loop = g_main_loop_new(NULL, FALSE);
+	test_malloc_get_stats(&before);
+	provisioning_ofono(TEST_IMSI, data, test_done, result);
+	if (!result->path) {
+		g_main_loop_run(result->loop);
+	}
+	while (g_main_context_iteration(NULL, FALSE));
+	test_malloc_get_stats(&after);
+	g_main_loop_unref(result->loop);
+	g_assert_cmpint(result->report.result, == ,PROV_SUCCESS);
+	g_free(result->path);
+	return (after.allocs - before.allocs) -
+		(fake_ofono_allocs() - fake_before);
+}
+
+static
+void
+test_allocs(void)
+{
+	struct test_result result;
+	struct provisioning_data *data = test_data_new();
+	struct provisioning_ofono_watch *watch;
+	GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+	guint64 allocs;
+	guint calls;
+
+	fake_ofono_init();
+	fake_ofono_set_alloc_counter(test_allocs_count);
+	fake_ofono_add_modem(TEST_MODEM, TEST_IMSI);
+	watch = provisioning_ofono_watch_new(NULL, NULL);
+	g_timeout_add(10, test_quit, loop);
+	g_main_loop_run(loop);
+	g_main_loop_unref(loop);
+
+	/* The first one fills the pools */
+	test_allocs_run(data, &result);
+	calls = fake_ofono_calls();
+	allocs = test_allocs_run(data, &result);
+	calls = fake_ofono_calls() - calls;
+	GDEBUG("%u allocations, %u calls", (guint)allocs, calls);
+	g_assert_cmpuint(calls, == ,12);
+	g_assert_cmpuint(allocs, <= ,TEST_MAX_ALLOCS);
+
+	provisioning_ofono_watch_free(watch);
+	while (g_main_context_iteration(NULL, FALSE));
+	g_assert_cmpuint(fake_ofono_objects(), == ,0);
+	provisioning_data_unref(data);
+	fake_ofono_deinit();
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+	test_init(&test_opt, argc, argv);
+	g_test_add_func(TEST_PREFIX "basic", test_basic);
+	g_test_add_func(TEST_PREFIX "second_modem", test_second_modem);
+	g_test_add_func(TEST_PREFIX "delays", test_delays);
+	g_test_add_func(TEST_PREFIX "active", test_active);
+	g_test_add_func(TEST_PREFIX "reactivate", test_reactivate);
+	g_test_add_func(TEST_PREFIX "reactivate_failed", test_reactivate_failed);
+	g_test_add_func(TEST_PREFIX "reactivate_error", test_reactivate_error);
+	g_test_add_func(TEST_PREFIX "retry", test_retry);
+	g_test_add_func(TEST_PREFIX "retry_active", test_retry_active);
+	g_test_add_func(TEST_PREFIX "error", test_error);
+	g_test_add_func(TEST_PREFIX "subset", test_subset);
+	g_test_add_func(TEST_PREFIX "update", test_update);
+	g_test_add_func(TEST_PREFIX "watch", test_watch);
+	g_test_add_func(TEST_PREFIX "prewarm", test_prewarm);
+	g_test_add_func(TEST_PREFIX "allocs", test_allocs);
+	return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,314 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-common.h"
+#include "provisioning-prescan.h"
+
+static TestOpt test_opt;
+
+#define DATA_DIR "../data"
+#define TEST_PREFIX "/prescan/"
+
+/* WBXML 1.3, PROV 1.0, UTF-8, empty string table */
+#define TEST_HEADER 0x03, 0x0b, 0x6a, 0x00
+#define TEST_ARRAY_AND_SIZE(a) a, sizeof(a)
+
+static const char *const test_files[] = {
+	"prov_beeline_2.wbxml",
+	"prov_dna_1.wbxml",
+	"prov_dna_2.wbxml",
+	"prov_moi_1.wbxml",
+	"prov_moi_2.wbxml",
+	"prov_moi_3.wbxml",
+	"prov_sonera.wbxml"
+};
+
+static
+GBytes *
+test_load(
+	const char *file)
+{
+	char *path = g_build_filename(DATA_DIR, file, NULL);
+	gchar *data;
+	gsize length;
+
+	LOG("Loading %s", path);
+	g_assert(g_file_get_contents(path, &data, &length, NULL));
+	g_free(path);
+	return g_bytes_new_take(data, length);
+}
+
+static
+const char *
+test_scan(
+	GBytes *bytes,
+	const struct provisioning_prescan_limits *limits,
+	struct provisioning_prescan_info *info)
+{
+	gsize len;
+	const guint8 *data = g_bytes_get_data(bytes, &len);
+	return provisioning_prescan(data, len, limits, info);
+}
+
+static
+void
+test_data(
+	void)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(test_files); i++) {
+		GBytes *bytes = test_load(test_files[i]);
+		struct provisioning_prescan_info info;
+
+		g_assert(!test_scan(bytes, NULL, &info));
+		g_assert(info.characteristics > 0);
+		g_assert(info.parms > 0);
+		g_assert(info.depth >= 2);
+		g_assert(!info.strtbl);
+		g_bytes_unref(bytes);
+	}
+}
+
+static
+void
+test_truncated(
+	void)
+{
+	GBytes *bytes = test_load("prov_sonera.wbxml");
+	gsize len, i;
+	const guint8 *data = g_bytes_get_data(bytes, &len);
+
+	/* None of the prefixes is a complete document */
+	g_assert(!provisioning_prescan(data, len, NULL, NULL));
+	for (i = 0; i < len; i++) {
+		g_assert(provisioning_prescan(data, i, NULL, NULL));
+	}
+	g_bytes_unref(bytes);
+}
+
+static
+void
+test_limits(
+	void)
+{
+	GBytes *bytes = test_load("prov_sonera.wbxml");
+	struct provisioning_prescan_limits limits;
+	struct provisioning_prescan_info info;
+
+	g_assert(!test_scan(bytes, NULL, &info));
+
+	/* Exactly at the limit is fine */
+	memset(&limits, 0, sizeof(limits));
+	limits.max_bytes = g_bytes_get_size(bytes);
+	limits.max_depth = info.depth;
+	limits.max_characteristics = info.characteristics;
+	limits.max_parms = info.parms;
+	g_assert(!test_scan(bytes, &limits, NULL));
+
+	/* One less isn't */
+	limits.max_bytes--;
+	g_assert(test_scan(bytes, &limits, NULL));
+	limits.max_bytes++;
+	limits.max_depth--;
+	g_assert(test_scan(bytes, &limits, NULL));
+	limits.max_depth++;
+	limits.max_characteristics--;
+	g_assert(test_scan(bytes, &limits, NULL));
+	limits.max_characteristics++;
+	limits.max_parms--;
+	g_assert(test_scan(bytes, &limits, NULL));
+
+	/* Zeros mean no limits */
+	memset(&limits, 0, sizeof(limits));
+	g_assert(!test_scan(bytes, &limits, NULL));
+	g_bytes_unref(bytes);
+}
+
+static
+void
+test_deep(
+	void)
+{
+	static const guint8 head[] = { TEST_HEADER };
+	const guint n = PROV_PRESCAN_MAX_DEPTH + 1;
+	GByteArray *doc = g_byte_array_new();
+	struct provisioning_prescan_limits limits;
+	struct provisioning_prescan_info info;
+	guint i;
+
+	/* Root element and nested characteristics without attributes */
+	g_byte_array_append(doc, head, sizeof(head));
+	for (i = 0; i < n; i++) {
+		const guint8 tag = i ? 0x46 : 0x45;
+		g_byte_array_append(doc, &tag, 1);
+	}
+	for (i = 0; i < n; i++) {
+		const guint8 end = 0x01;
+		g_byte_array_append(doc, &end, 1);
+	}
+	g_assert(provisioning_prescan(doc->data, doc->len, NULL, &info));
+	g_assert_cmpuint(info.depth, == ,PROV_PRESCAN_MAX_DEPTH);
+
+	memset(&limits, 0, sizeof(limits));
+	g_assert(!provisioning_prescan(doc->data, doc->len, &limits, &info));
+	g_assert_cmpuint(info.depth, == ,n);
+	g_assert_cmpuint(info.characteristics, == ,n - 1);
+	g_byte_array_free(doc, TRUE);
+}
+
+static
+void
+test_strtbl(
+	void)
+{
+	/* Public ID in the string table, characteristic type as STR_T */
+	static const guint8 ok[] = {
+		0x03, 0x00, 0x00, 0x6a, 0x25,
+		'-', '/', '/', 'W', 'A', 'P', 'F', 'O', 'R', 'U', 'M', '/', '/',
+		'D', 'T', 'D', ' ', 'P', 'R', 'O', 'V', ' ', '1', '.', '0',
+		'/', '/', 'E', 'N', 0x00, 'N', 'A', 'P', 'D', 'E', 'F', 0x00,
+		0x45, 0x86, 0x05, 0x83, 0x1e, 0x01, 0x01
+	};
+	static const guint8 wrong_id[] = {
+		0x03, 0x00, 0x00, 0x6a, 0x04, 'S', 'I', '?', 0x00, 0x05
+	};
+	static const guint8 bad_id_index[] = {
+		0x03, 0x00, 0x04, 0x6a, 0x04, 'S', 'I', '?', 0x00, 0x05
+	};
+	static const guint8 bad_index[] = {
+		0x03, 0x0b, 0x6a, 0x02, 'A', 0x00, 0x45, 0x83, 0x02, 0x01
+	};
+	static const guint8 bad_literal[] = {
+		0x03, 0x0b, 0x6a, 0x02, 'A', 0x00, 0x44, 0x05, 0x01
+	};
+	static const guint8 too_long[] = {
+		0x03, 0x0b, 0x6a, 0x10, 'A', 0x00, 0x05
+	};
+	struct provisioning_prescan_limits limits;
+	struct provisioning_prescan_info info;
+
+	g_assert(!provisioning_prescan(TEST_ARRAY_AND_SIZE(ok), NULL, &info));
+	g_assert_cmpuint(info.strtbl, == ,0x25);
+	g_assert_cmpuint(info.characteristics, == ,1);
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(wrong_id), NULL, NULL));
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(bad_id_index),
+		NULL, NULL));
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(bad_index), NULL, NULL));
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(bad_literal),
+		NULL, NULL));
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(too_long), NULL, NULL));
+
+	memset(&limits, 0, sizeof(limits));
+	limits.max_strtbl = 0x24;
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(ok), &limits, NULL));
+}
+
+static
+void
+test_header(
+	void)
+{
+	static const guint8 empty_root[] = { TEST_HEADER, 0x05 };
+	static const guint8 wbxml_1_0[] = { 0x00, 0x0b, 0x00, 0x05 };
+	static const guint8 unknown_id[] = { 0x03, 0x01, 0x6a, 0x00, 0x05 };
+	static const guint8 bad_version[] = { 0x04, 0x0b, 0x6a, 0x00, 0x05 };
+	static const guint8 bad_id[] = { 0x03, 0x05, 0x6a, 0x00, 0x05 };
+	static const guint8 bad_mb[] = {
+		0x03, 0x0b, 0x6a, 0xff, 0xff, 0xff, 0xff, 0x7f, 0x05
+	};
+	static const guint8 no_body[] = { TEST_HEADER };
+
+	g_assert(!provisioning_prescan(TEST_ARRAY_AND_SIZE(empty_root),
+		NULL, NULL));
+	g_assert(!provisioning_prescan(TEST_ARRAY_AND_SIZE(wbxml_1_0),
+		NULL, NULL));
+	g_assert(!provisioning_prescan(TEST_ARRAY_AND_SIZE(unknown_id),
+		NULL, NULL));
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(bad_version),
+		NULL, NULL));
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(bad_id), NULL, NULL));
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(bad_mb), NULL, NULL));
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(no_body), NULL, NULL));
+	g_assert(provisioning_prescan(NULL, 0, NULL, NULL));
+}
+
+static
+void
+test_body(
+	void)
+{
+	static const guint8 unterminated[] = {
+		TEST_HEADER, 0x45, 0x03, 'A', 'B'
+	};
+	static const guint8 opaque[] = {
+		TEST_HEADER, 0x45, 0xc3, 0x02, 'A', 'B', 0x01
+	};
+	static const guint8 opaque_overflow[] = {
+		TEST_HEADER, 0x45, 0xc3, 0x10, 'A', 0x01
+	};
+	static const guint8 unbalanced[] = { TEST_HEADER, 0x01 };
+	static const guint8 text_before_root[] = {
+		TEST_HEADER, 0x03, 'A', 0x00, 0x05
+	};
+	static const guint8 page_and_pi[] = {
+		TEST_HEADER, 0x43, 0x05, 0x03, 'x', 0x00, 0x01, 0x00, 0x01, 0x05
+	};
+	static const guint8 pi_in_attrs[] = {
+		TEST_HEADER, 0x85, 0x43, 0x01
+	};
+	static const guint8 attrs[] = {
+		TEST_HEADER, 0xc5, 0x05, 0x03, '1', '.', '0', 0x00, 0x01,
+		0x87, 0x05, 0xc0, 0x80, 0x00, 0x41, 'x', 0x00, 0x01, 0x01
+	};
+	static const guint8 trailing[] = { TEST_HEADER, 0x05, 0xff };
+
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(unterminated),
+		NULL, NULL));
+	g_assert(!provisioning_prescan(TEST_ARRAY_AND_SIZE(opaque), NULL, NULL));
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(opaque_overflow),
+		NULL, NULL));
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(unbalanced),
+		NULL, NULL));
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(text_before_root),
+		NULL, NULL));
+	g_assert(!provisioning_prescan(TEST_ARRAY_AND_SIZE(page_and_pi),
+		NULL, NULL));
+	g_assert(provisioning_prescan(TEST_ARRAY_AND_SIZE(pi_in_attrs),
+		NULL, NULL));
+	g_assert(!provisioning_prescan(TEST_ARRAY_AND_SIZE(attrs), NULL, NULL));
+	g_assert(!provisioning_prescan(TEST_ARRAY_AND_SIZE(trailing), NULL, NULL));
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+	test_init(&test_opt, argc, argv);
+	g_test_add_func(TEST_PREFIX "data", test_data);
+	g_test_add_func(TEST_PREFIX "truncated", test_truncated);
+	g_test_add_func(TEST_PREFIX "limits", test_limits);
+	g_test_add_func(TEST_PREFIX "deep", test_deep);
+	g_test_add_func(TEST_PREFIX "strtbl", test_strtbl);
+	g_test_add_func(TEST_PREFIX "header", test_header);
+	g_test_add_func(TEST_PREFIX "body", test_body);
+	return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
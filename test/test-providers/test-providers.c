@@ -0,0 +1,328 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-common.h"
+#include "test-dir.h"
+#include "provisioning-providers.h"
+
+static TestOpt test_opt;
+
+#define TEST_PREFIX "/providers/"
+#define TEST_IMSI "244990000000001"
+#define TEST_IMSI_3 "310999000000001"
+
+static const char test_xml[] =
+	"<?xml version=\"1.0\"?>\n"
+	"<serviceproviders format=\"2.0\">\n"
+	"<country code=\"fi\">\n"
+	" <provider>\n"
+	"  <name>Operator</name>\n"
+	"  <name xml:lang=\"fi\">Operaattori</name>\n"
+	"  <gsm>\n"
+	"   <network-id mcc=\"244\" mnc=\"99\"/>\n"
+	"   <network-id mcc=\"244\" mnc=\"x\"/>\n"
+	"   <apn value=\"internet\">\n"
+	"    <usage type=\"internet\"/>\n"
+	"    <name>Operator Internet</name>\n"
+	"    <username> user </username>\n"
+	"    <password>secret</password>\n"
+	"    <authentication method=\"chap\"/>\n"
+	"   </apn>\n"
+	"   <apn value=\"mms\">\n"
+	"    <usage type=\"mms\"/>\n"
+	"    <mmsc>http://mms.example.com</mmsc>\n"
+	"    <mmsproxy>10.0.0.1:8080</mmsproxy>\n"
+	"   </apn>\n"
+	"   <apn value=\"\"/>\n"
+	"  </gsm>\n"
+	"  <cdma>\n"
+	"   <sid value=\"1\"/>\n"
+	"  </cdma>\n"
+	" </provider>\n"
+	"</country>\n"
+	"<country code=\"us\">\n"
+	" <provider>\n"
+	"  <name>Carrier</name>\n"
+	"  <gsm>\n"
+	"   <network-id mcc=\"310\" mnc=\"999\"/>\n"
+	"   <apn value=\"wap\">\n"
+	"    <usage type=\"wap\"/>\n"
+	"    <usage type=\"mms\"/>\n"
+	"    <mmsc>http://mmsc</mmsc>\n"
+	"    <mmsproxy>proxy</mmsproxy>\n"
+	"   </apn>\n"
+	"   <apn value=\"broadband\"/>\n"
+	"  </gsm>\n"
+	" </provider>\n"
+	"</country>\n"
+	"</serviceproviders>\n";
+
+static
+struct provisioning_providers *
+test_providers_new(
+	TestDir *test)
+{
+	struct provisioning_providers *providers;
+	char *xml;
+
+	test_dir_init(test, "providers");
+	xml = test_dir_write(test, "serviceproviders.xml", test_xml);
+	g_assert(provisioning_providers_compile_file(xml, test->file, NULL));
+	providers = provisioning_providers_new(test->file);
+	g_assert(providers);
+	g_free(xml);
+	return providers;
+}
+
+static
+void
+test_missing(void)
+{
+	TestDir test;
+	struct provisioning_data *data = provisioning_data_new();
+
+	test_dir_init(&test, "providers");
+	g_assert(!provisioning_providers_new(test.file));
+	g_assert(!provisioning_providers_lookup(NULL, TEST_IMSI));
+	g_assert(provisioning_providers_complete(NULL, TEST_IMSI, data) == data);
+	g_assert(!provisioning_providers_complete(NULL, TEST_IMSI, NULL));
+	provisioning_providers_free(NULL);
+	provisioning_data_unref(data);
+	provisioning_data_unref(data);
+	test_dir_deinit(&test);
+}
+
+static
+void
+test_lookup(void)
+{
+	TestDir test;
+	struct provisioning_providers *providers = test_providers_new(&test);
+	const char *apn, *name, *user, *pass, *mmsc, *proxy;
+	guint8 usage, auth;
+	GVariant *apns;
+
+	/* 2-digit MNC */
+	apns = provisioning_providers_lookup(providers, TEST_IMSI);
+	g_assert(apns);
+	g_assert_cmpuint(g_variant_n_children(apns), == ,2);
+	g_variant_get_child(apns, 0, "(&s&s&s&s&s&syy)", &apn, &name, &user,
+		&pass, &mmsc, &proxy, &usage, &auth);
+	g_assert_cmpstr(apn, == ,"internet");
+	g_assert_cmpstr(name, == ,"Operator Internet");
+	g_assert_cmpstr(user, == ,"user");
+	g_assert_cmpstr(pass, == ,"secret");
+	g_assert_cmpuint(usage, == ,PROV_PROVIDERS_USAGE_INTERNET);
+	g_assert_cmpuint(auth, == ,AUTH_CHAP);
+	g_variant_get_child(apns, 1, "(&s&s&s&s&s&syy)", &apn, &name, &user,
+		&pass, &mmsc, &proxy, &usage, &auth);
+	g_assert_cmpstr(apn, == ,"mms");
+	g_assert_cmpstr(name, == ,"Operator");
+	g_assert_cmpstr(mmsc, == ,"http://mms.example.com");
+	g_assert_cmpstr(proxy, == ,"10.0.0.1:8080");
+	g_assert_cmpuint(usage, == ,PROV_PROVIDERS_USAGE_MMS);
+	g_assert_cmpuint(auth, == ,AUTH_UNKNOWN);
+	g_variant_unref(apns);
+
+	/* 3-digit MNC, no usage means internet */
+	apns = provisioning_providers_lookup(providers, TEST_IMSI_3);
+	g_assert(apns);
+	g_assert_cmpuint(g_variant_n_children(apns), == ,2);
+	g_variant_get_child(apns, 1, "(&s&s&s&s&s&syy)", &apn, &name, &user,
+		&pass, &mmsc, &proxy, &usage, &auth);
+	g_assert_cmpstr(apn, == ,"broadband");
+	g_assert_cmpstr(name, == ,"Carrier");
+	g_assert_cmpuint(usage, == ,PROV_PROVIDERS_USAGE_INTERNET);
+	g_variant_unref(apns);
+
+	/* Unknown or invalid */
+	g_assert(!provisioning_providers_lookup(providers, "244980000000001"));
+	g_assert(!provisioning_providers_lookup(providers, "31099"));
+	g_assert(!provisioning_providers_lookup(providers, "24499x"));
+	g_assert(!provisioning_providers_lookup(providers, NULL));
+	provisioning_providers_free(providers);
+	test_dir_deinit(&test);
+}
+
+static
+void
+test_internet(void)
+{
+	TestDir test;
+	struct provisioning_providers *providers = test_providers_new(&test);
+	struct provisioning_data *data = provisioning_data_new();
+	struct provisioning_data *out;
+
+	data->internet = g_new0(struct provisioning_internet, 1);
+	data->internet->apn = g_strdup("INTERNET");
+
+	/* Everything missing gets filled in, the original stays intact */
+	out = provisioning_providers_complete(providers, TEST_IMSI, data);
+	g_assert(out != data);
+	g_assert(!data->internet->name);
+	g_assert(!out->mms);
+	g_assert_cmpstr(out->internet->apn, == ,"INTERNET");
+	g_assert_cmpstr(out->internet->name, == ,"Operator Internet");
+	g_assert_cmpstr(out->internet->username, == ,"user");
+	g_assert_cmpstr(out->internet->password, == ,"secret");
+	g_assert_cmpint(out->internet->authtype, == ,AUTH_CHAP);
+
+	/* Nothing left to add */
+	g_assert(provisioning_providers_complete(providers, TEST_IMSI, out) ==
+		out);
+	provisioning_data_unref(out);
+	provisioning_data_unref(out);
+
+	/* Credentials aren't mixed, what's there isn't overwritten */
+	data->internet->name = g_strdup("Name");
+	data->internet->username = g_strdup("other");
+	g_assert(provisioning_providers_complete(providers, TEST_IMSI, data) ==
+		data);
+	g_assert_cmpint(data->internet->authtype, == ,AUTH_UNKNOWN);
+	provisioning_data_unref(data);
+	data->internet->authtype = AUTH_PAP;
+	g_assert(provisioning_providers_complete(providers, TEST_IMSI, data) ==
+		data);
+	provisioning_data_unref(data);
+
+	/* Unknown APN or network */
+	g_free(data->internet->apn);
+	data->internet->apn = g_strdup("mms");
+	g_free(data->internet->name);
+	data->internet->name = NULL;
+	out = provisioning_providers_complete(providers, TEST_IMSI, data);
+	g_assert(out != data);
+	g_assert_cmpstr(out->internet->name, == ,"Operator");
+	provisioning_data_unref(out);
+	g_free(data->internet->apn);
+	data->internet->apn = g_strdup("other");
+	g_assert(provisioning_providers_complete(providers, TEST_IMSI, data) ==
+		data);
+	provisioning_data_unref(data);
+	g_assert(provisioning_providers_complete(providers, "244980000000001",
+		data) == data);
+	provisioning_data_unref(data);
+
+	provisioning_data_unref(data);
+	provisioning_providers_free(providers);
+	test_dir_deinit(&test);
+}
+
+static
+void
+test_mms(void)
+{
+	TestDir test;
+	struct provisioning_providers *providers = test_providers_new(&test);
+	struct provisioning_data *data = provisioning_data_new();
+	struct provisioning_data *out;
+
+	data->mms = g_new0(struct provisioning_mms, 1);
+	data->mms->apn = g_strdup("mms");
+	data->mms->name = g_strdup("MMS");
+
+	/* The proxy address and the port get split */
+	out = provisioning_providers_complete(providers, TEST_IMSI, data);
+	g_assert(out != data);
+	g_assert(!out->internet);
+	g_assert_cmpstr(out->mms->name, == ,"MMS");
+	g_assert_cmpstr(out->mms->messagecenter, == ,"http://mms.example.com");
+	g_assert_cmpstr(out->mms->messageproxy, == ,"10.0.0.1");
+	g_assert_cmpstr(out->mms->portnro, == ,"8080");
+	g_assert(!out->mms->username);
+	g_assert(!out->mms->password);
+	g_assert_cmpint(out->mms->authtype, == ,AUTH_UNKNOWN);
+	provisioning_data_unref(out);
+
+	/* Only the port for the same proxy */
+	data->mms->messagecenter = g_strdup("http://mmsc");
+	data->mms->messageproxy = g_strdup("10.0.0.1");
+	out = provisioning_providers_complete(providers, TEST_IMSI, data);
+	g_assert(out != data);
+	g_assert_cmpstr(out->mms->messagecenter, == ,"http://mmsc");
+	g_assert_cmpstr(out->mms->messageproxy, == ,"10.0.0.1");
+	g_assert_cmpstr(out->mms->portnro, == ,"8080");
+	provisioning_data_unref(out);
+
+	/* Nothing for a different proxy */
+	g_free(data->mms->messageproxy);
+	data->mms->messageproxy = g_strdup("10.0.0.2");
+	g_assert(provisioning_providers_complete(providers, TEST_IMSI, data) ==
+		data);
+	provisioning_data_unref(data);
+
+	/* Proxy without port */
+	g_free(data->mms->apn);
+	g_free(data->mms->messageproxy);
+	data->mms->apn = g_strdup("wap");
+	data->mms->messageproxy = NULL;
+	out = provisioning_providers_complete(providers, TEST_IMSI_3, data);
+	g_assert(out != data);
+	g_assert_cmpstr(out->mms->messageproxy, == ,"proxy");
+	g_assert(!out->mms->portnro);
+	provisioning_data_unref(out);
+
+	provisioning_data_unref(data);
+	provisioning_providers_free(providers);
+	test_dir_deinit(&test);
+}
+
+static
+void
+test_bad_xml(void)
+{
+	static const char garbage[] = "This is not a provider index";
+	TestDir test;
+	GError *error = NULL;
+	char *xml;
+
+	test_dir_init(&test, "providers");
+	xml = test_dir_write(&test, "serviceproviders.xml",
+		"<serviceproviders><country>");
+	g_assert(!provisioning_providers_compile_file(xml, test.file, &error));
+	g_assert(error);
+	g_error_free(error);
+	g_assert(!g_file_test(test.file, G_FILE_TEST_EXISTS));
+	g_assert(!provisioning_providers_compile("<a></b>", 7, NULL));
+	g_assert(!provisioning_providers_compile_file(test.file, test.file,
+		NULL));
+
+	/* Not an index */
+	g_assert(g_file_set_contents(test.file, garbage, sizeof(garbage), NULL));
+	g_assert(!provisioning_providers_new(test.file));
+	g_assert(g_file_set_contents(test.file, "", 0, NULL));
+	g_assert(!provisioning_providers_new(test.file));
+	g_free(xml);
+	test_dir_deinit(&test);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+	test_init(&test_opt, argc, argv);
+	g_test_add_func(TEST_PREFIX "missing", test_missing);
+	g_test_add_func(TEST_PREFIX "lookup", test_lookup);
+	g_test_add_func(TEST_PREFIX "internet", test_internet);
+	g_test_add_func(TEST_PREFIX "mms", test_mms);
+	g_test_add_func(TEST_PREFIX "bad_xml", test_bad_xml);
+	return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,158 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-common.h"
+#include "provisioning-ratelimit.h"
+
+static TestOpt test_opt;
+
+#define TEST_PREFIX "/ratelimit/"
+#define TEST_SEC(s) ((gint64)(s) * G_USEC_PER_SEC)
+
+/* Arbitrary monotonic time */
+#define TEST_NOW TEST_SEC(1000)
+
+static
+gboolean
+test_try(
+	struct provisioning_ratelimit *limit,
+	const char *key,
+	gint64 now)
+{
+	if (!provisioning_ratelimit_delay(limit, key, now)) {
+		provisioning_ratelimit_take(limit, key, now);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+static
+void
+test_null(
+	void)
+{
+	struct provisioning_ratelimit *limit = provisioning_ratelimit_new(1, 0);
+	int i;
+
+	/* Disabled limit never says no */
+	for (i = 0; i < 100; i++) {
+		g_assert(test_try(limit, "x", TEST_NOW));
+	}
+	g_assert_cmpuint(provisioning_ratelimit_size(limit), == ,0);
+	provisioning_ratelimit_free(limit);
+
+	g_assert(!provisioning_ratelimit_delay(NULL, "x", TEST_NOW));
+	provisioning_ratelimit_take(NULL, "x", TEST_NOW);
+	g_assert(!provisioning_ratelimit_size(NULL));
+	provisioning_ratelimit_free(NULL);
+}
+
+static
+void
+test_burst(
+	void)
+{
+	/* 3 at once, then one every 10 seconds */
+	struct provisioning_ratelimit *limit = provisioning_ratelimit_new(3, 6);
+
+	g_assert(test_try(limit, "a", TEST_NOW));
+	g_assert(test_try(limit, "a", TEST_NOW));
+	g_assert(test_try(limit, "a", TEST_NOW));
+	g_assert_cmpuint(provisioning_ratelimit_delay(limit, "a", TEST_NOW),
+		== ,10000);
+	g_assert_cmpuint(provisioning_ratelimit_delay(limit, "a",
+		TEST_NOW + TEST_SEC(4)), == ,6000);
+
+	/* Other keys are not affected */
+	g_assert(test_try(limit, "b", TEST_NOW));
+	g_assert_cmpuint(provisioning_ratelimit_size(limit), == ,2);
+
+	/* One token comes back in 10 seconds */
+	g_assert(test_try(limit, "a", TEST_NOW + TEST_SEC(10)));
+	g_assert(!test_try(limit, "a", TEST_NOW + TEST_SEC(10)));
+
+	/* Full again in 30 seconds after the last one */
+	g_assert(test_try(limit, "a", TEST_NOW + TEST_SEC(50)));
+	g_assert(test_try(limit, "a", TEST_NOW + TEST_SEC(50)));
+	g_assert(test_try(limit, "a", TEST_NOW + TEST_SEC(50)));
+	g_assert(!test_try(limit, "a", TEST_NOW + TEST_SEC(50)));
+	provisioning_ratelimit_free(limit);
+}
+
+static
+void
+test_rounding(
+	void)
+{
+	/* 7 per minute isn't a whole number of milliseconds */
+	struct provisioning_ratelimit *limit = provisioning_ratelimit_new(1, 7);
+	guint delay;
+
+	g_assert(test_try(limit, "a", TEST_NOW));
+	delay = provisioning_ratelimit_delay(limit, "a", TEST_NOW);
+	g_assert_cmpuint(delay, == ,8572);
+
+	/* Retrying after the suggested delay works */
+	g_assert(!test_try(limit, "a", TEST_NOW + (delay - 1) * 1000));
+	g_assert(test_try(limit, "a", TEST_NOW + delay * 1000));
+	provisioning_ratelimit_free(limit);
+}
+
+static
+void
+test_keys(
+	void)
+{
+	struct provisioning_ratelimit *limit = provisioning_ratelimit_new(1, 60);
+	char key[16];
+	guint i;
+
+	for (i = 0; i < PROV_RATELIMIT_MAX_KEYS; i++) {
+		g_snprintf(key, sizeof(key), "%u", i);
+		g_assert(test_try(limit, key, TEST_NOW));
+	}
+	g_assert_cmpuint(provisioning_ratelimit_size(limit), == ,
+		PROV_RATELIMIT_MAX_KEYS);
+
+	/* No room for newcomers until someone's bucket is full again */
+	g_assert_cmpuint(provisioning_ratelimit_delay(limit, "new", TEST_NOW),
+		== ,1000);
+	provisioning_ratelimit_take(limit, "new", TEST_NOW);
+	g_assert_cmpuint(provisioning_ratelimit_size(limit), == ,
+		PROV_RATELIMIT_MAX_KEYS);
+
+	/* Second later all buckets are full and get forgotten */
+	g_assert(test_try(limit, "new", TEST_NOW + TEST_SEC(1)));
+	g_assert_cmpuint(provisioning_ratelimit_size(limit), == ,1);
+	provisioning_ratelimit_free(limit);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+	test_init(&test_opt, argc, argv);
+	g_test_add_func(TEST_PREFIX "null", test_null);
+	g_test_add_func(TEST_PREFIX "burst", test_burst);
+	g_test_add_func(TEST_PREFIX "rounding", test_rounding);
+	g_test_add_func(TEST_PREFIX "keys", test_keys);
+	return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,155 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-common.h"
+#include "provisioning-recorder.h"
+
+static TestOpt test_opt;
+
+#define TEST_PREFIX "/recorder/"
+
+static
+void
+test_collect(
+	const char *line,
+	void *user_data)
+{
+	/* Strip the timestamp */
+	const char *msg = strchr(line, ' ');
+	g_assert(msg);
+	g_ptr_array_add(user_data, g_strdup(msg + 1));
+}
+
+static
+GPtrArray *
+test_dump(
+	gboolean all)
+{
+	GPtrArray *lines = g_ptr_array_new_with_free_func(g_free);
+	const guint n = provisioning_recorder_dump(all, test_collect, lines);
+	g_assert_cmpuint(n, == ,lines->len);
+	return lines;
+}
+
+static
+void
+test_format(void)
+{
+	GPtrArray *lines;
+	char *big = g_strnfill(300, 'x');
+	char *small = g_strdup("internet");
+
+	provisioning_recorder_clear();
+	provisioning_recorder_add("plain %% text");
+	provisioning_recorder_add("%s (%d) %s = \"%s\"", "/ril_0/context1", 3,
+		"AccessPointName", small);
+	provisioning_recorder_add("%u %lu %lld %zu %hhu %x %c", 42u,
+		123456789UL, -5LL, (gsize)7, 300, 255, 'Z');
+	provisioning_recorder_add("%5.2f|%-6s|%*d|%.*s", 3.14159, "ab", 4, 7,
+		3, "abcdef");
+	provisioning_recorder_add("%s", big);
+	provisioning_recorder_add("%d %d %d %d %d %d %d %d %d %d",
+		1, 2, 3, 4, 5, 6, 7, 8, 9, 10);
+
+	/* Strings are copied */
+	small[0] = 'X';
+	g_free(big);
+	g_free(small);
+
+	lines = test_dump(FALSE);
+	g_assert_cmpuint(lines->len, == ,6);
+	g_assert_cmpstr(lines->pdata[0], == ,"plain % text");
+	g_assert_cmpstr(lines->pdata[1], == ,
+		"/ril_0/context1 (3) AccessPointName = \"internet\"");
+	g_assert_cmpstr(lines->pdata[2], == ,"42 123456789 -5 7 44 ff Z");
+	g_assert_cmpstr(lines->pdata[3], == ," 3.14|ab    |   7|abc");
+	/* Long strings are truncated */
+	g_assert(g_str_has_prefix(lines->pdata[4], "xxxx"));
+	g_assert_cmpuint(strlen(lines->pdata[4]), < ,300);
+	/* So are messages with too many arguments */
+	g_assert_cmpstr(lines->pdata[5], == ,"1 2 3 4 5 6 7 8 ...");
+	g_ptr_array_free(lines, TRUE);
+}
+
+static
+void
+test_dump_since(void)
+{
+	GPtrArray *lines;
+
+	provisioning_recorder_clear();
+	provisioning_recorder_add("one");
+	lines = test_dump(FALSE);
+	g_assert_cmpuint(lines->len, == ,1);
+	g_ptr_array_free(lines, TRUE);
+
+	provisioning_recorder_add("two");
+	lines = test_dump(FALSE);
+	g_assert_cmpuint(lines->len, == ,1);
+	g_assert_cmpstr(lines->pdata[0], == ,"two");
+	g_ptr_array_free(lines, TRUE);
+
+	lines = test_dump(TRUE);
+	g_assert_cmpuint(lines->len, == ,2);
+	g_assert_cmpstr(lines->pdata[0], == ,"one");
+	g_ptr_array_free(lines, TRUE);
+
+	provisioning_recorder_clear();
+	lines = test_dump(TRUE);
+	g_assert_cmpuint(lines->len, == ,0);
+	g_ptr_array_free(lines, TRUE);
+}
+
+static
+void
+test_wrap(void)
+{
+	GPtrArray *lines;
+	guint i, first;
+
+	provisioning_recorder_clear();
+	for (i = 0; i < 10000; i++) {
+		provisioning_recorder_add("%u", i);
+	}
+	lines = test_dump(TRUE);
+	g_assert_cmpuint(lines->len, > ,0);
+	g_assert_cmpuint(lines->len, < ,10000);
+
+	/* Only the most recent ones are kept, in order */
+	first = 10000 - lines->len;
+	for (i = 0; i < lines->len; i++) {
+		char *expected = g_strdup_printf("%u", first + i);
+		g_assert_cmpstr(lines->pdata[i], == ,expected);
+		g_free(expected);
+	}
+	g_ptr_array_free(lines, TRUE);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+	test_init(&test_opt, argc, argv);
+	g_test_add_func(TEST_PREFIX "format", test_format);
+	g_test_add_func(TEST_PREFIX "dump_since", test_dump_since);
+	g_test_add_func(TEST_PREFIX "wrap", test_wrap);
+	return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,751 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-common.h"
+#include "fake-ofono.h"
+#include "provisioning-router.h"
+#include "provisioning-ofono.h"
+#include "provisioning-variant.h"
+
+#include <sys/socket.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static TestOpt test_opt;
+static const char *test_exe;
+
+#define TEST_PREFIX "/router/"
+#define TEST_TIMEOUT 20 /* sec */
+#define TEST_WORKERS 2
+#define TEST_XML "../../org.nemomobile.provisioning.xml"
+#define TEST_PATH "/"
+#define TEST_IFACE "org.nemomobile.provisioning.interface"
+#define TEST_ERROR_BUSY "org.nemomobile.provisioning.Error.Busy"
+
+/* The test executable runs the workers too, see test_worker_main() */
+#define TEST_WORKER_ARG "--test-worker"
+
+/* Connection context of this APN never becomes valid */
+#define TEST_APN_HANG "hang"
+#define TEST_HANG_MS 60000
+
+/* log.c is left out, the router only needs this from it */
+gboolean
+prov_log_set_level(
+	const char *module,
+	int level)
+{
+	return TRUE;
+}
+
+static
+GVariant *
+test_histogram(
+	guint64 count,
+	guint64 sum,
+	guint64 min,
+	guint64 max,
+	const guint64 *buckets,
+	gsize n)
+{
+	return g_variant_new("(tttt@at)", count, sum, min, max,
+		g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64, buckets, n,
+		sizeof(guint64)));
+}
+
+static
+void
+test_shard(void)
+{
+	/* Must not change between releases, stored settings depend on it */
+	g_assert_cmpuint(provisioning_router_shard("244990000000000", 4), == ,3);
+	g_assert_cmpuint(provisioning_router_shard("244990000000001", 4), == ,0);
+	g_assert_cmpuint(provisioning_router_shard("244990000000001", 3), == ,2);
+	g_assert_cmpuint(provisioning_router_shard("310260000000000", 2), == ,1);
+
+	/* Degenerate cases */
+	g_assert_cmpuint(provisioning_router_shard(NULL, 4), == ,
+		provisioning_router_shard("", 4));
+	g_assert_cmpuint(provisioning_router_shard("244990000000000", 1), == ,0);
+	g_assert_cmpuint(provisioning_router_shard("244990000000000", 0), == ,0);
+}
+
+static
+void
+test_spread(void)
+{
+	guint count[4] = { 0, 0, 0, 0 };
+	guint i;
+
+	/* Consecutive IMSIs of one operator get spread evenly enough */
+	for (i = 0; i < 1000; i++) {
+		char *imsi = g_strdup_printf("24499%010u", i);
+		const guint shard = provisioning_router_shard(imsi, 4);
+
+		g_assert_cmpuint(shard, < ,4);
+		count[shard]++;
+		g_free(imsi);
+	}
+	for (i = 0; i < 4; i++) {
+		g_assert_cmpuint(count[i], > ,200);
+		g_assert_cmpuint(count[i], < ,300);
+	}
+}
+
+static
+void
+test_merge(void)
+{
+	static const guint64 b1[] = { 1, 0, 2 };
+	static const guint64 b2[] = { 0, 3 };
+	GVariantBuilder builder;
+	GVariant *s1, *s2, *totals, *v, *b;
+	guint64 count, sum, min, max;
+	const guint64 *buckets;
+	guint32 in_flight;
+	gsize n;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&builder, "{sv}", "retries",
+		g_variant_new_uint64(2));
+	g_variant_builder_add(&builder, "{sv}", "in_flight",
+		g_variant_new_uint32(1));
+	g_variant_builder_add(&builder, "{sv}", "decode",
+		test_histogram(3, 30, 5, 20, b1, G_N_ELEMENTS(b1)));
+	g_variant_builder_add(&builder, "{sv}", "downtime",
+		test_histogram(0, 0, 0, 0, NULL, 0));
+	s1 = g_variant_ref_sink(g_variant_builder_end(&builder));
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&builder, "{sv}", "retries",
+		g_variant_new_uint64(5));
+	g_variant_builder_add(&builder, "{sv}", "in_flight",
+		g_variant_new_uint32(2));
+	g_variant_builder_add(&builder, "{sv}", "decode",
+		test_histogram(3, 9, 2, 4, b2, G_N_ELEMENTS(b2)));
+	g_variant_builder_add(&builder, "{sv}", "downtime",
+		test_histogram(1, 7, 7, 7, b2, 1));
+	g_variant_builder_add(&builder, "{sv}", "timeouts",
+		g_variant_new_uint64(1));
+	s2 = g_variant_ref_sink(g_variant_builder_end(&builder));
+
+	/* The first one is taken as is */
+	totals = g_variant_ref_sink(provisioning_router_merge_stats(NULL, s1));
+	g_assert(g_variant_equal(totals, s1));
+	v = g_variant_ref_sink(provisioning_router_merge_stats(totals, s2));
+	g_variant_unref(totals);
+	totals = v;
+
+	g_assert(g_variant_lookup(totals, "retries", "t", &count));
+	g_assert_cmpuint(count, == ,7);
+	g_assert(g_variant_lookup(totals, "timeouts", "t", &count));
+	g_assert_cmpuint(count, == ,1);
+	g_assert(g_variant_lookup(totals, "in_flight", "u", &in_flight));
+	g_assert_cmpuint(in_flight, == ,3);
+
+	v = g_variant_lookup_value(totals, "decode", G_VARIANT_TYPE("(ttttat)"));
+	g_assert(v);
+	g_variant_get(v, "(tttt@at)", &count, &sum, &min, &max, &b);
+	g_assert_cmpuint(count, == ,6);
+	g_assert_cmpuint(sum, == ,39);
+	g_assert_cmpuint(min, == ,2);
+	g_assert_cmpuint(max, == ,20);
+	buckets = g_variant_get_fixed_array(b, &n, sizeof(guint64));
+	g_assert_cmpuint(n, == ,3);
+	g_assert_cmpuint(buckets[0], == ,1);
+	g_assert_cmpuint(buckets[1], == ,3);
+	g_assert_cmpuint(buckets[2], == ,2);
+	g_variant_unref(b);
+	g_variant_unref(v);
+
+	/* Minimum of an empty histogram doesn't count */
+	v = g_variant_lookup_value(totals, "downtime", NULL);
+	g_assert(v);
+	g_variant_get(v, "(tttt@at)", &count, &sum, &min, &max, NULL);
+	g_assert_cmpuint(count, == ,1);
+	g_assert_cmpuint(min, == ,7);
+	g_assert_cmpuint(max, == ,7);
+	g_variant_unref(v);
+
+	g_variant_unref(totals);
+	g_variant_unref(s1);
+	g_variant_unref(s2);
+}
+
+static
+GDBusNodeInfo *
+test_node_info_new(void)
+{
+	GDBusNodeInfo *info;
+	char *xml = NULL;
+
+	g_assert(g_file_get_contents(TEST_XML, &xml, NULL, NULL));
+	info = g_dbus_node_info_new_for_xml(xml, NULL);
+	g_assert(info);
+	g_free(xml);
+	return info;
+}
+
+/* ==========================================================================*
+ * Worker process, the service side is provisioning-ofono.c running on
+ * top of the fake ofono. Only what the tests need is implemented.
+ * ==========================================================================*/
+
+typedef struct test_worker {
+	GMainLoop *loop;
+	GDBusConnection *conn;
+	GHashTable *modems;
+	guint shard;
+	guint last_txid;
+} TestWorker;
+
+typedef struct test_worker_tx {
+	TestWorker *worker;
+	guint txid;
+} TestWorkerTx;
+
+static
+void
+test_worker_done(
+	const char *imsi,
+	const char *path,
+	const struct provisioning_ofono_report *report,
+	void *param)
+{
+	TestWorkerTx *tx = param;
+	GDBusConnection *conn = tx->worker->conn;
+
+	if (!path) path = "";
+	g_dbus_connection_emit_signal(conn, NULL, TEST_PATH, TEST_IFACE,
+		"apnProvisioningResult", g_variant_new("(ssuuuu)", imsi, path,
+		report->result, report->internet_failed, report->mms_failed,
+		report->retries), NULL);
+	g_dbus_connection_emit_signal(conn, NULL, TEST_PATH, TEST_IFACE,
+		"ProvisioningResult", g_variant_new("(ussuuuu)", tx->txid, imsi,
+		path, report->result, report->internet_failed, report->mms_failed,
+		report->retries), NULL);
+	g_free(tx);
+}
+
+static
+void
+test_worker_provision(
+	TestWorker *worker,
+	GDBusMethodInvocation *call,
+	GVariant *args)
+{
+	const char *imsi = NULL, *error = NULL;
+	GVariant *internet = NULL, *mms = NULL;
+	struct provisioning_data *data;
+
+	g_variant_get(args, "(&s@a{sv}@a{sv})", &imsi, &internet, &mms);
+	data = provisioning_data_from_variant(internet, mms, &error);
+	if (data) {
+		TestWorkerTx *tx = g_new(TestWorkerTx, 1);
+		FakeOfonoModem *modem = g_hash_table_lookup(worker->modems, imsi);
+
+		if (!modem) {
+			char *path = g_strdup_printf("/ril_%u",
+				g_hash_table_size(worker->modems));
+
+			modem = fake_ofono_add_modem(path, imsi);
+			g_hash_table_insert(worker->modems, g_strdup(imsi), modem);
+			g_free(path);
+		}
+		if (data->internet &&
+			!g_strcmp0(data->internet->apn, TEST_APN_HANG)) {
+			fake_ofono_modem_set_delays(modem, 0, 0, TEST_HANG_MS);
+		}
+
+		/* Same IDs and the same order as the service */
+		tx->worker = worker;
+		tx->txid = (worker->last_txid++) * (TEST_WORKERS + 1) +
+			worker->shard + 2;
+		g_dbus_method_invocation_return_value(call,
+			g_variant_new("(u)", tx->txid));
+		provisioning_ofono(imsi, data, test_worker_done, tx);
+		provisioning_data_unref(data);
+	} else {
+		g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+			G_DBUS_ERROR_INVALID_ARGS, "%s", error);
+	}
+	g_variant_unref(internet);
+	g_variant_unref(mms);
+}
+
+static
+void
+test_worker_method_call(
+	GDBusConnection *conn,
+	const char *sender,
+	const char *path,
+	const char *iface,
+	const char *method,
+	GVariant *args,
+	GDBusMethodInvocation *call,
+	gpointer user_data)
+{
+	TestWorker *worker = user_data;
+
+	if (!strcmp(method, "ProvisionSettings")) {
+		test_worker_provision(worker, call, args);
+	} else if (!strcmp(method, "GetStatistics")) {
+		/* Tells the test which process is serving the shard */
+		GVariantBuilder builder;
+		char *key = g_strdup_printf("pid%u", worker->shard);
+
+		g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+		g_variant_builder_add(&builder, "{sv}", key,
+			g_variant_new_uint32(getpid()));
+		g_dbus_method_invocation_return_value(call,
+			g_variant_new("(@a{sv})", g_variant_builder_end(&builder)));
+		g_free(key);
+	} else {
+		g_dbus_method_invocation_return_error(call, G_DBUS_ERROR,
+			G_DBUS_ERROR_UNKNOWN_METHOD, "Unknown method %s", method);
+	}
+}
+
+static const GDBusInterfaceVTable test_worker_vtable = {
+	test_worker_method_call
+};
+
+static
+void
+test_worker_closed(
+	GDBusConnection *conn,
+	gboolean remote_peer_vanished,
+	GError *error,
+	gpointer loop)
+{
+	g_main_loop_quit(loop);
+}
+
+static
+int
+test_worker_main(
+	int argc,
+	char *argv[])
+{
+	TestWorker worker;
+	GDBusNodeInfo *info;
+	const char *address = NULL;
+	int i;
+
+	memset(&worker, 0, sizeof(worker));
+	for (i = 1; i + 1 < argc; i++) {
+		if (!strcmp(argv[i], "--worker")) {
+			address = argv[++i];
+		} else if (!strcmp(argv[i], "--shard")) {
+			worker.shard = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--first-tx")) {
+			worker.last_txid = atoi(argv[++i]);
+		}
+	}
+
+	worker.conn = address ? g_dbus_connection_new_for_address_sync(address,
+		G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT, NULL, NULL, NULL) :
+		NULL;
+	if (!worker.conn) {
+		return 1;
+	}
+
+	fake_ofono_init();
+	info = test_node_info_new();
+	worker.loop = g_main_loop_new(NULL, FALSE);
+	worker.modems = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		NULL);
+	g_assert(g_dbus_connection_register_object(worker.conn, TEST_PATH,
+		g_dbus_node_info_lookup_interface(info, TEST_IFACE),
+		&test_worker_vtable, &worker, NULL, NULL));
+
+	/* The front end closes the connection when it's done with us */
+	g_signal_connect(worker.conn, "closed",
+		G_CALLBACK(test_worker_closed), worker.loop);
+	g_main_loop_run(worker.loop);
+
+	g_hash_table_destroy(worker.modems);
+	g_main_loop_unref(worker.loop);
+	g_object_unref(worker.conn);
+	g_dbus_node_info_unref(info);
+	return 0;
+}
+
+/* ==========================================================================*
+ * Front end with the workers
+ * ==========================================================================*/
+
+typedef struct test_router {
+	GDBusConnection *client;
+	GHashTable *results;        /* imsi => result + 1 */
+	gboolean busy;
+} TestRouter;
+
+typedef struct test_call {
+	GVariant *reply;
+	GError *error;
+	gboolean done;
+} TestCall;
+
+static
+gboolean
+test_timeout(
+	gpointer data)
+{
+	g_assert(!"Test timed out");
+	return G_SOURCE_REMOVE;
+}
+
+static
+gboolean
+test_sleep_done(
+	gpointer data)
+{
+	*(gboolean*)data = TRUE;
+	return G_SOURCE_REMOVE;
+}
+
+static
+void
+test_sleep(
+	guint ms)
+{
+	gboolean done = FALSE;
+
+	g_timeout_add(ms, test_sleep_done, &done);
+	while (!done) g_main_context_iteration(NULL, TRUE);
+}
+
+static
+void
+test_router_busy(
+	void *param)
+{
+	((TestRouter*)param)->busy = TRUE;
+}
+
+static
+void
+test_router_idle(
+	void *param)
+{
+	((TestRouter*)param)->busy = FALSE;
+}
+
+static const struct provisioning_router_callbacks test_router_cb = {
+	NULL,
+	test_router_busy,
+	test_router_idle
+};
+
+static
+void
+test_router_signal(
+	GDBusConnection *conn,
+	const char *sender,
+	const char *path,
+	const char *iface,
+	const char *name,
+	GVariant *args,
+	gpointer user_data)
+{
+	TestRouter *test = user_data;
+	const char *imsi = NULL;
+	guint result = PROV_FAILURE;
+
+	g_variant_get(args, "(&s&suuuu)", &imsi, NULL, &result, NULL, NULL,
+		NULL);
+	g_hash_table_replace(test->results, g_strdup(imsi),
+		GUINT_TO_POINTER(result + 1));
+}
+
+/* The front end and the test are two ends of a socket pair */
+static
+void
+test_bus_new_done(
+	GObject *object,
+	GAsyncResult *result,
+	gpointer user_data)
+{
+	GDBusConnection **conn = user_data;
+
+	*conn = g_dbus_connection_new_finish(result, NULL);
+	g_assert(*conn);
+}
+
+static
+void
+test_bus_new(
+	GDBusConnection **server,
+	GDBusConnection **client)
+{
+	char *guid = g_dbus_generate_guid();
+	GSocket *s0, *s1;
+	GSocketConnection *c0, *c1;
+	int fd[2];
+
+	g_assert(!socketpair(AF_UNIX, SOCK_STREAM, 0, fd));
+	s0 = g_socket_new_from_fd(fd[0], NULL);
+	s1 = g_socket_new_from_fd(fd[1], NULL);
+	g_assert(s0);
+	g_assert(s1);
+	c0 = g_socket_connection_factory_create_connection(s0);
+	c1 = g_socket_connection_factory_create_connection(s1);
+	*server = *client = NULL;
+	g_dbus_connection_new(G_IO_STREAM(c0), guid,
+		G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_SERVER |
+		G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_ALLOW_ANONYMOUS, NULL, NULL,
+		test_bus_new_done, server);
+	g_dbus_connection_new(G_IO_STREAM(c1), NULL,
+		G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT, NULL, NULL,
+		test_bus_new_done, client);
+	while (!*server || !*client) g_main_context_iteration(NULL, TRUE);
+	g_object_unref(c0);
+	g_object_unref(c1);
+	g_object_unref(s0);
+	g_object_unref(s1);
+	g_free(guid);
+}
+
+static
+void
+test_call_done(
+	GObject *object,
+	GAsyncResult *result,
+	gpointer user_data)
+{
+	TestCall *call = user_data;
+
+	call->reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object),
+		result, &call->error);
+	call->done = TRUE;
+}
+
+/* The front end runs on the same thread, hence no sync calls */
+static
+GVariant *
+test_call(
+	TestRouter *test,
+	const char *method,
+	GVariant *args,
+	GError **error)
+{
+	TestCall call;
+
+	memset(&call, 0, sizeof(call));
+	g_dbus_connection_call(test->client, NULL, TEST_PATH, TEST_IFACE,
+		method, args, NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+		test_call_done, &call);
+	while (!call.done) g_main_context_iteration(NULL, TRUE);
+	if (call.error) {
+		if (error) {
+			*error = call.error;
+		} else {
+			g_error_free(call.error);
+		}
+	}
+	return call.reply;
+}
+
+static
+guint
+test_provision(
+	TestRouter *test,
+	const char *imsi,
+	const char *apn,
+	GError **error)
+{
+	GVariantBuilder internet;
+	GVariant *reply;
+	guint txid = 0;
+
+	g_variant_builder_init(&internet, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&internet, "{sv}", "apn", g_variant_new_string(apn));
+	reply = test_call(test, "ProvisionSettings", g_variant_new("(s@a{sv}@a{sv})",
+		imsi, g_variant_builder_end(&internet), g_variant_new_array(
+		G_VARIANT_TYPE("{sv}"), NULL, 0)), error);
+	if (reply) {
+		g_variant_get(reply, "(u)", &txid);
+		g_variant_unref(reply);
+	}
+	return txid;
+}
+
+/* Result of the next apnProvisioningResult for this IMSI */
+static
+guint
+test_wait_result(
+	TestRouter *test,
+	const char *imsi)
+{
+	guint result;
+
+	while (!g_hash_table_contains(test->results, imsi)) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+	result = GPOINTER_TO_UINT(g_hash_table_lookup(test->results, imsi)) - 1;
+	g_hash_table_remove(test->results, imsi);
+	return result;
+}
+
+/* Zero if the worker isn't there */
+static
+guint
+test_worker_pid(
+	TestRouter *test,
+	guint shard)
+{
+	GVariant *reply = test_call(test, "GetStatistics", NULL, NULL);
+	guint32 pid = 0;
+
+	if (reply) {
+		GVariant *stats = g_variant_get_child_value(reply, 0);
+		char *key = g_strdup_printf("pid%u", shard);
+
+		g_variant_lookup(stats, key, "u", &pid);
+		g_variant_unref(stats);
+		g_variant_unref(reply);
+		g_free(key);
+	}
+	return pid;
+}
+
+static
+guint
+test_wait_worker(
+	TestRouter *test,
+	guint shard,
+	guint old_pid)
+{
+	guint pid;
+
+	while (!(pid = test_worker_pid(test, shard)) || pid == old_pid) {
+		test_sleep(20);
+	}
+	return pid;
+}
+
+static
+void
+test_workers(void)
+{
+	const char *argv[] = { test_exe, TEST_WORKER_ARG, NULL };
+	GDBusConnection *server, *client;
+	GDBusNodeInfo *info = test_node_info_new();
+	struct provisioning_router *router;
+	guint timeout_id = g_timeout_add_seconds(TEST_TIMEOUT, test_timeout, NULL);
+	guint signal_id, pid0, pid1, txid, txid2, i;
+	char *imsi[TEST_WORKERS];
+	GError *error = NULL;
+	char *name;
+	TestRouter test;
+
+	/* One IMSI for each worker */
+	memset(imsi, 0, sizeof(imsi));
+	for (i = 0; !imsi[0] || !imsi[1]; i++) {
+		char *s = g_strdup_printf("24499%010u", i);
+		const guint shard = provisioning_router_shard(s, TEST_WORKERS);
+
+		if (!imsi[shard]) {
+			imsi[shard] = s;
+		} else {
+			g_free(s);
+		}
+	}
+
+	memset(&test, 0, sizeof(test));
+	test.results = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		NULL);
+	test_bus_new(&server, &client);
+	test.client = client;
+	signal_id = g_dbus_connection_signal_subscribe(client, NULL, TEST_IFACE,
+		"apnProvisioningResult", TEST_PATH, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+		test_router_signal, &test, NULL);
+
+	router = provisioning_router_new(argv, TEST_WORKERS, TEST_ERROR_BUSY,
+		&test_router_cb, &test, NULL);
+	g_assert(router);
+	g_assert(provisioning_router_export(router, server, TEST_PATH,
+		g_dbus_node_info_lookup_interface(info, TEST_IFACE), NULL));
+	pid0 = test_wait_worker(&test, 0, 0);
+	pid1 = test_wait_worker(&test, 1, 0);
+
+	/* Both shards work */
+	for (i = 0; i < TEST_WORKERS; i++) {
+		g_assert(test_provision(&test, imsi[i], "internet", NULL));
+		g_assert_cmpuint(test_wait_result(&test, imsi[i]), == ,PROV_SUCCESS);
+	}
+
+	/* The worker dies in the middle of a transaction, which fails */
+	txid = test_provision(&test, imsi[0], TEST_APN_HANG, NULL);
+	g_assert(txid);
+	g_assert(provisioning_router_busy(router));
+	g_assert(!kill(pid0, SIGKILL));
+	g_assert_cmpuint(test_wait_result(&test, imsi[0]), == ,PROV_FAILURE);
+
+	/* The other one keeps working, the IMSIs of the dead one are busy */
+	g_assert(test_provision(&test, imsi[1], "internet2", NULL));
+	g_assert_cmpuint(test_wait_result(&test, imsi[1]), == ,PROV_SUCCESS);
+	g_assert(!test_provision(&test, imsi[0], "internet", &error));
+	name = g_dbus_error_get_remote_error(error);
+	g_assert_cmpstr(name, == ,TEST_ERROR_BUSY);
+	g_clear_error(&error);
+	g_free(name);
+
+	/* And then it's back, without reusing the transaction IDs */
+	g_assert_cmpuint(test_wait_worker(&test, 0, pid0), != ,pid0);
+	g_assert_cmpuint(test_worker_pid(&test, 1), == ,pid1);
+	txid2 = test_provision(&test, imsi[0], "internet2", NULL);
+	g_assert_cmpuint(txid2, > ,txid);
+	g_assert_cmpuint(test_wait_result(&test, imsi[0]), == ,PROV_SUCCESS);
+
+	/* Nothing is left hanging */
+	while (test.busy) g_main_context_iteration(NULL, TRUE);
+	g_assert(!provisioning_router_busy(router));
+
+	provisioning_router_free(router);
+	g_dbus_connection_signal_unsubscribe(client, signal_id);
+	g_object_unref(server);
+	g_object_unref(client);
+	g_dbus_node_info_unref(info);
+	g_hash_table_destroy(test.results);
+	g_source_remove(timeout_id);
+	for (i = 0; i < TEST_WORKERS; i++) {
+		g_free(imsi[i]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], TEST_WORKER_ARG)) {
+		return test_worker_main(argc, argv);
+	}
+	test_exe = argv[0];
+	g_test_init(&argc, &argv, NULL);
+	test_init(&test_opt, argc, argv);
+	g_test_add_func(TEST_PREFIX "shard", test_shard);
+	g_test_add_func(TEST_PREFIX "spread", test_spread);
+	g_test_add_func(TEST_PREFIX "merge", test_merge);
+	g_test_add_func(TEST_PREFIX "workers", test_workers);
+	return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
@@ -0,0 +1,113 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-common.h"
+#include "provisioning-stats.h"
+
+static TestOpt test_opt;
+
+#define TEST_PREFIX "/stats/"
+
+static
+void
+test_bucket(void)
+{
+	g_assert_cmpuint(provisioning_stats_bucket(0), == ,0);
+	g_assert_cmpuint(provisioning_stats_bucket(1), == ,0);
+	g_assert_cmpuint(provisioning_stats_bucket(2), == ,1);
+	g_assert_cmpuint(provisioning_stats_bucket(3), == ,1);
+	g_assert_cmpuint(provisioning_stats_bucket(4), == ,2);
+	g_assert_cmpuint(provisioning_stats_bucket(1023), == ,9);
+	g_assert_cmpuint(provisioning_stats_bucket(1024), == ,10);
+	g_assert_cmpuint(provisioning_stats_bucket(G_MAXUINT64), == ,31);
+}
+
+static
+void
+test_variant(void)
+{
+	GVariant *stats;
+	GVariant *v;
+	GVariant *b;
+	guint64 count, sum, min, max;
+	const guint64 *buckets;
+	guint32 in_flight;
+	gsize n;
+
+	provisioning_stats_reset();
+	provisioning_stats_count(PROV_STATS_RETRIES, 2);
+	provisioning_stats_count(PROV_STATS_RETRIES, 1);
+	provisioning_stats_count(PROV_STATS_COUNTER_COUNT, 1);
+	provisioning_stats_set_in_flight(5);
+	provisioning_stats_record(PROV_STATS_DECODE, 3);
+	provisioning_stats_record(PROV_STATS_DECODE, 1000);
+	provisioning_stats_record(PROV_STATS_DECODE, -1);
+	provisioning_stats_record(PROV_STATS_HISTOGRAM_COUNT, 1);
+
+	stats = g_variant_ref_sink(provisioning_stats_variant());
+	g_assert(g_variant_lookup(stats, "retries", "t", &count));
+	g_assert_cmpuint(count, == ,3);
+	g_assert(g_variant_lookup(stats, "timeouts", "t", &count));
+	g_assert_cmpuint(count, == ,0);
+	g_assert(g_variant_lookup(stats, "in_flight", "u", &in_flight));
+	g_assert_cmpuint(in_flight, == ,5);
+
+	v = g_variant_lookup_value(stats, "decode", G_VARIANT_TYPE("(ttttat)"));
+	g_assert(v);
+	g_variant_get(v, "(tttt@at)", &count, &sum, &min, &max, NULL);
+	g_assert_cmpuint(count, == ,2);
+	g_assert_cmpuint(sum, == ,1003);
+	g_assert_cmpuint(min, == ,3);
+	g_assert_cmpuint(max, == ,1000);
+
+	/* Trailing empty buckets are trimmed */
+	b = g_variant_get_child_value(v, 4);
+	buckets = g_variant_get_fixed_array(b, &n, sizeof(guint64));
+	g_assert_cmpuint(n, == ,10);
+	g_assert_cmpuint(buckets[1], == ,1);
+	g_assert_cmpuint(buckets[9], == ,1);
+	g_variant_unref(b);
+	g_variant_unref(v);
+
+	/* Empty histograms have no buckets */
+	v = g_variant_lookup_value(stats, "downtime", NULL);
+	g_assert(v);
+	g_variant_get(v, "(tttt@at)", &count, &sum, &min, &max, NULL);
+	g_assert_cmpuint(count, == ,0);
+	g_variant_unref(v);
+	g_variant_unref(stats);
+
+	provisioning_stats_reset();
+	stats = g_variant_ref_sink(provisioning_stats_variant());
+	g_assert(g_variant_lookup(stats, "retries", "t", &count));
+	g_assert_cmpuint(count, == ,0);
+	g_variant_unref(stats);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+	test_init(&test_opt, argc, argv);
+	g_test_add_func(TEST_PREFIX "bucket", test_bucket);
+	g_test_add_func(TEST_PREFIX "variant", test_variant);
+	return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
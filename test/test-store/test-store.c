@@ -0,0 +1,361 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-common.h"
+#include "test-dir.h"
+#include "provisioning-store.h"
+
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+
+static TestOpt test_opt;
+
+#define TEST_PREFIX "/store/"
+#define TEST_IMSI "244990000000001"
+
+static
+void
+test_init_data(
+	struct provisioning_data *data,
+	struct provisioning_internet *internet,
+	struct provisioning_mms *mms)
+{
+	memset(internet, 0, sizeof(*internet));
+	internet->name = "Internet";
+	internet->apn = "internet.example.com";
+	internet->authtype = AUTH_CHAP;
+	memset(mms, 0, sizeof(*mms));
+	mms->apn = "mms.example.com";
+	mms->messagecenter = "http://mms.example.com";
+	mms->authtype = AUTH_UNKNOWN;
+	memset(data, 0, sizeof(*data));
+	data->internet = internet;
+	data->mms = mms;
+}
+
+static
+void
+test_missing(void)
+{
+	TestDir test;
+	struct provisioning_store *store;
+
+	test_dir_init(&test, "state/settings");
+	store = provisioning_store_new(test.file);
+	g_assert(!provisioning_store_lookup(store, TEST_IMSI));
+	g_assert(!provisioning_store_get(store, TEST_IMSI));
+	g_assert(!provisioning_store_lookup(store, NULL));
+	g_assert(!provisioning_store_get_failed(store, TEST_IMSI, NULL, NULL));
+	g_assert(provisioning_store_remove_failed(store, TEST_IMSI));
+	g_assert(!g_file_test(test.file, G_FILE_TEST_EXISTS));
+	provisioning_store_free(store);
+	provisioning_store_free(NULL);
+	test_dir_deinit(&test);
+}
+
+static
+void
+test_basic(void)
+{
+	TestDir test;
+	struct provisioning_store *store;
+	struct provisioning_internet internet;
+	struct provisioning_mms mms;
+	struct provisioning_data data;
+	struct provisioning_data *stored;
+	GStatBuf st;
+	GVariant *v;
+	char *state;
+
+	test_dir_init(&test, "state/settings");
+	test_init_data(&data, &internet, &mms);
+	store = provisioning_store_new(test.file);
+	g_assert(provisioning_store_put(store, TEST_IMSI, &data));
+	g_assert(g_file_test(test.file, G_FILE_TEST_IS_REGULAR));
+	provisioning_store_free(store);
+
+	/* Only for the owner's eyes */
+	g_assert(!g_stat(test.file, &st));
+	g_assert_cmpint(st.st_mode & 0777, == ,0600);
+	state = g_path_get_dirname(test.file);
+	g_assert(!g_stat(state, &st));
+	g_assert_cmpint(st.st_mode & 0777, == ,0700);
+	g_free(state);
+
+	/* Read it back */
+	store = provisioning_store_new(test.file);
+	stored = provisioning_store_get(store, TEST_IMSI);
+	g_assert(stored);
+	g_assert(stored->internet);
+	g_assert(stored->mms);
+	g_assert_cmpstr(stored->internet->name, == ,"Internet");
+	g_assert_cmpstr(stored->internet->apn, == ,"internet.example.com");
+	g_assert_cmpint(stored->internet->authtype, == ,AUTH_CHAP);
+	g_assert_cmpstr(stored->mms->apn, == ,"mms.example.com");
+	g_assert_cmpstr(stored->mms->messagecenter, == ,"http://mms.example.com");
+	g_assert(!stored->mms->messageproxy);
+	provisioning_data_unref(stored);
+
+	v = provisioning_store_lookup(store, TEST_IMSI);
+	g_assert(v);
+	g_assert(g_variant_is_of_type(v, G_VARIANT_TYPE_VARDICT));
+	g_variant_unref(v);
+	g_assert(!provisioning_store_lookup(store, "244990000000002"));
+
+	/* Internet only */
+	data.mms = NULL;
+	g_assert(provisioning_store_put(store, TEST_IMSI, &data));
+	stored = provisioning_store_get(store, TEST_IMSI);
+	g_assert(stored);
+	g_assert(stored->internet);
+	g_assert(!stored->mms);
+	provisioning_data_unref(stored);
+	provisioning_store_free(store);
+	test_dir_deinit(&test);
+}
+
+static
+void
+test_unchanged(void)
+{
+	TestDir test;
+	struct provisioning_store *store;
+	struct provisioning_internet internet;
+	struct provisioning_mms mms;
+	struct provisioning_data data;
+
+	test_dir_init(&test, "state/settings");
+	test_init_data(&data, &internet, &mms);
+	store = provisioning_store_new(test.file);
+	g_assert(provisioning_store_put(store, TEST_IMSI, &data));
+
+	/* Same thing again doesn't rewrite the file */
+	g_assert(!g_unlink(test.file));
+	g_assert(provisioning_store_put(store, TEST_IMSI, &data));
+	g_assert(!g_file_test(test.file, G_FILE_TEST_EXISTS));
+
+	/* But a change does */
+	internet.username = "user";
+	g_assert(provisioning_store_put(store, TEST_IMSI, &data));
+	g_assert(g_file_test(test.file, G_FILE_TEST_IS_REGULAR));
+	provisioning_store_free(store);
+	test_dir_deinit(&test);
+}
+
+static
+void
+test_corrupt(void)
+{
+	static const char garbage[] = "This is not a settings file";
+	TestDir test;
+	struct provisioning_store *store;
+	struct provisioning_internet internet;
+	struct provisioning_mms mms;
+	struct provisioning_data data;
+	char *state;
+
+	test_dir_init(&test, "state/settings");
+	state = g_path_get_dirname(test.file);
+	g_assert(!g_mkdir_with_parents(state, 0755));
+	g_assert(g_file_set_contents(test.file, garbage, sizeof(garbage), NULL));
+	store = provisioning_store_new(test.file);
+	g_assert(!provisioning_store_lookup(store, TEST_IMSI));
+
+	/* Gets overwritten */
+	test_init_data(&data, &internet, &mms);
+	g_assert(provisioning_store_put(store, TEST_IMSI, &data));
+	provisioning_store_free(store);
+	store = provisioning_store_new(test.file);
+	provisioning_data_unref(provisioning_store_get(store, TEST_IMSI));
+	g_assert(provisioning_store_lookup(store, TEST_IMSI));
+	g_variant_unref(provisioning_store_lookup(store, TEST_IMSI));
+	provisioning_store_free(store);
+
+	/* Empty file */
+	g_assert(g_file_set_contents(test.file, "", 0, NULL));
+	store = provisioning_store_new(test.file);
+	g_assert(!provisioning_store_lookup(store, TEST_IMSI));
+	provisioning_store_free(store);
+	g_free(state);
+	test_dir_deinit(&test);
+}
+
+static
+void
+test_limit(void)
+{
+	TestDir test;
+	struct provisioning_store *store;
+	struct provisioning_internet internet;
+	struct provisioning_mms mms;
+	struct provisioning_data data;
+	GVariant *v;
+	char imsi[16];
+	int i;
+
+	test_dir_init(&test, "state/settings");
+	test_init_data(&data, &internet, &mms);
+	store = provisioning_store_new(test.file);
+	for (i = 0; i < 40; i++) {
+		g_snprintf(imsi, sizeof(imsi), "2449900000000%02d", i);
+		g_assert(provisioning_store_put(store, imsi, &data));
+		/* Keep the first one fresh */
+		if (i > 0) {
+			internet.apn = (i & 1) ? "a" : "b";
+			g_assert(provisioning_store_put(store, "244990000000000",
+				&data));
+		}
+	}
+	provisioning_store_free(store);
+
+	/* The oldest ones are gone */
+	store = provisioning_store_new(test.file);
+	v = provisioning_store_lookup(store, "244990000000000");
+	g_assert(v);
+	g_variant_unref(v);
+	for (i = 1; i < 9; i++) {
+		g_snprintf(imsi, sizeof(imsi), "2449900000000%02d", i);
+		g_assert(!provisioning_store_lookup(store, imsi));
+	}
+	for (; i < 40; i++) {
+		g_snprintf(imsi, sizeof(imsi), "2449900000000%02d", i);
+		v = provisioning_store_lookup(store, imsi);
+		g_assert(v);
+		g_variant_unref(v);
+	}
+	provisioning_store_free(store);
+	test_dir_deinit(&test);
+}
+
+static
+void
+test_failed(void)
+{
+	TestDir test;
+	struct provisioning_store *store;
+	struct provisioning_internet internet;
+	struct provisioning_mms mms;
+	struct provisioning_data data;
+	struct provisioning_data *failed;
+	guint internet_failed = 0, mms_failed = 0;
+
+	test_dir_init(&test, "state/settings");
+	test_init_data(&data, &internet, &mms);
+	store = provisioning_store_new(test.file);
+	g_assert(provisioning_store_put(store, TEST_IMSI, &data));
+	internet.apn = "other.example.com";
+	g_assert(provisioning_store_put_failed(store, TEST_IMSI, &data, 0x02,
+		0x40));
+	provisioning_store_free(store);
+
+	/* Survives a restart, next to the applied settings */
+	store = provisioning_store_new(test.file);
+	failed = provisioning_store_get_failed(store, TEST_IMSI,
+		&internet_failed, &mms_failed);
+	g_assert(failed);
+	g_assert_cmpstr(failed->internet->apn, == ,"other.example.com");
+	g_assert_cmpstr(failed->mms->apn, == ,"mms.example.com");
+	g_assert_cmpuint(internet_failed, == ,0x02);
+	g_assert_cmpuint(mms_failed, == ,0x40);
+	provisioning_data_unref(failed);
+	failed = provisioning_store_get(store, TEST_IMSI);
+	g_assert_cmpstr(failed->internet->apn, == ,"internet.example.com");
+	provisioning_data_unref(failed);
+
+	/* Same thing again doesn't rewrite the file */
+	g_assert(!g_unlink(test.file));
+	g_assert(provisioning_store_put_failed(store, TEST_IMSI, &data, 0x02,
+		0x40));
+	g_assert(!g_file_test(test.file, G_FILE_TEST_EXISTS));
+
+	/* Removing it does, the applied settings stay */
+	g_assert(provisioning_store_remove_failed(store, TEST_IMSI));
+	g_assert(g_file_test(test.file, G_FILE_TEST_IS_REGULAR));
+	provisioning_store_free(store);
+	store = provisioning_store_new(test.file);
+	g_assert(!provisioning_store_get_failed(store, TEST_IMSI, NULL, NULL));
+	failed = provisioning_store_get(store, TEST_IMSI);
+	g_assert(failed);
+	provisioning_data_unref(failed);
+	provisioning_store_free(store);
+	test_dir_deinit(&test);
+}
+
+static
+void
+test_v1(void)
+{
+	TestDir test;
+	struct provisioning_store *store;
+	struct provisioning_data *stored;
+	GVariantBuilder settings, entries;
+	GVariant *internet, *root;
+	char *state;
+
+	/* A file written before failed settings were kept */
+	test_dir_init(&test, "state/settings");
+	state = g_path_get_dirname(test.file);
+	g_assert(!g_mkdir_with_parents(state, 0700));
+	g_variant_builder_init(&settings, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&settings, "{sv}", "apn",
+		g_variant_new_string("internet.example.com"));
+	internet = g_variant_builder_end(&settings);
+	g_variant_builder_init(&settings, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&settings, "{sv}", "internet", internet);
+	g_variant_builder_init(&entries, G_VARIANT_TYPE("a{sa{sv}}"));
+	g_variant_builder_add(&entries, "{s@a{sv}}", TEST_IMSI,
+		g_variant_builder_end(&settings));
+	root = g_variant_ref_sink(g_variant_new("(u@a{sa{sv}})", 0x50525631,
+		g_variant_builder_end(&entries)));
+	if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+		GVariant *swapped = g_variant_ref_sink(g_variant_byteswap(root));
+		g_variant_unref(root);
+		root = swapped;
+	}
+	g_assert(g_file_set_contents(test.file, g_variant_get_data(root),
+		g_variant_get_size(root), NULL));
+	g_variant_unref(root);
+
+	store = provisioning_store_new(test.file);
+	stored = provisioning_store_get(store, TEST_IMSI);
+	g_assert(stored);
+	g_assert_cmpstr(stored->internet->apn, == ,"internet.example.com");
+	provisioning_data_unref(stored);
+	g_assert(!provisioning_store_get_failed(store, TEST_IMSI, NULL, NULL));
+	provisioning_store_free(store);
+	g_free(state);
+	test_dir_deinit(&test);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+	test_init(&test_opt, argc, argv);
+	g_test_add_func(TEST_PREFIX "missing", test_missing);
+	g_test_add_func(TEST_PREFIX "basic", test_basic);
+	g_test_add_func(TEST_PREFIX "unchanged", test_unchanged);
+	g_test_add_func(TEST_PREFIX "corrupt", test_corrupt);
+	g_test_add_func(TEST_PREFIX "limit", test_limit);
+	g_test_add_func(TEST_PREFIX "failed", test_failed);
+	g_test_add_func(TEST_PREFIX "v1", test_v1);
+	return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
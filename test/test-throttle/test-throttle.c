@@ -0,0 +1,158 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-common.h"
+#include "provisioning-throttle.h"
+
+static TestOpt test_opt;
+
+#define TEST_PREFIX "/throttle/"
+#define TEST_NOW ((gint64)1000 * G_USEC_PER_SEC)
+
+/* The service defaults */
+#define TEST_BURST 5
+#define TEST_SENDER_RATE 20
+#define TEST_IMSI_RATE 10
+#define TEST_MAX_IN_FLIGHT 32
+
+static
+struct provisioning_throttle *
+test_throttle_new(void)
+{
+	return provisioning_throttle_new(TEST_BURST, TEST_SENDER_RATE,
+		TEST_IMSI_RATE, TEST_MAX_IN_FLIGHT);
+}
+
+static
+void
+test_null(
+	void)
+{
+	struct provisioning_throttle *throttle =
+		provisioning_throttle_new(1, 0, 0, 0);
+	int i;
+
+	/* No limits at all */
+	for (i = 0; i < 100; i++) {
+		g_assert(!provisioning_throttle_push(throttle, "x", "y", 1000,
+			TEST_NOW));
+	}
+	g_assert(!provisioning_throttle_call(throttle, 1000));
+	provisioning_throttle_free(throttle);
+
+	g_assert(!provisioning_throttle_call(NULL, 1000));
+	g_assert(!provisioning_throttle_push(NULL, "x", "y", 1000, TEST_NOW));
+	provisioning_throttle_free(NULL);
+}
+
+static
+void
+test_push(
+	void)
+{
+	struct provisioning_throttle *throttle = test_throttle_new();
+	char imsi[16];
+	int i;
+
+	/* The burst per originator, with a different IMSI each time */
+	for (i = 0; i < TEST_BURST; i++) {
+		g_snprintf(imsi, sizeof(imsi), "24499000000000%d", i);
+		g_assert(!provisioning_throttle_push(throttle, "a", imsi, 0,
+			TEST_NOW));
+	}
+	g_assert_cmpuint(provisioning_throttle_push(throttle, "a", "other", 0,
+		TEST_NOW), == ,60000 / TEST_SENDER_RATE);
+
+	/* The last IMSI has a token less, whoever sent the message */
+	g_assert(!provisioning_throttle_push(throttle, "b", imsi, 0, TEST_NOW));
+	for (i = 2; i < TEST_BURST; i++) {
+		g_assert(!provisioning_throttle_push(throttle, "c", imsi, 0,
+			TEST_NOW));
+	}
+	g_assert_cmpuint(provisioning_throttle_push(throttle, "d", imsi, 0,
+		TEST_NOW), == ,60000 / TEST_IMSI_RATE);
+	provisioning_throttle_free(throttle);
+}
+
+static
+void
+test_empty(
+	void)
+{
+	struct provisioning_throttle *throttle = test_throttle_new();
+	char imsi[16];
+	int i;
+
+	/* Messages without an originator don't share a bucket */
+	for (i = 0; i < 10 * TEST_BURST; i++) {
+		g_snprintf(imsi, sizeof(imsi), "2449900000000%02d", i);
+		g_assert(!provisioning_throttle_push(throttle, "", imsi, 0,
+			TEST_NOW));
+		g_assert(!provisioning_throttle_push(throttle, NULL, imsi, 0,
+			TEST_NOW));
+	}
+
+	/* Nor do the ones without an IMSI */
+	for (i = 0; i < 10 * TEST_BURST; i++) {
+		g_assert(!provisioning_throttle_push(throttle, NULL, "", 0,
+			TEST_NOW));
+	}
+	provisioning_throttle_free(throttle);
+}
+
+static
+void
+test_batch(
+	void)
+{
+	struct provisioning_throttle *throttle = test_throttle_new();
+	const guint count = 1000;
+	int i;
+
+	/* A batch much larger than the burst goes in as a whole */
+	g_assert(!provisioning_throttle_call(throttle, 0));
+
+	/* Until it's done, it keeps everything else out */
+	g_assert_cmpuint(provisioning_throttle_call(throttle, count), == ,
+		PROV_BUSY_RETRY_MS);
+	g_assert_cmpuint(provisioning_throttle_push(throttle, "a", "b", count,
+		TEST_NOW), == ,PROV_BUSY_RETRY_MS);
+	g_assert(!provisioning_throttle_call(throttle, TEST_MAX_IN_FLIGHT - 1));
+
+	/* It hasn't used up anyone's budget */
+	for (i = 0; i < TEST_BURST; i++) {
+		g_assert(!provisioning_throttle_push(throttle, "a", "b", 0,
+			TEST_NOW));
+	}
+	provisioning_throttle_free(throttle);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+	test_init(&test_opt, argc, argv);
+	g_test_add_func(TEST_PREFIX "null", test_null);
+	g_test_add_func(TEST_PREFIX "push", test_push);
+	g_test_add_func(TEST_PREFIX "empty", test_empty);
+	g_test_add_func(TEST_PREFIX "batch", test_batch);
+	return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */
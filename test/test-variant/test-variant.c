@@ -0,0 +1,277 @@
+/*
+ *  Copyright (C) 2026 Jolla Ltd.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+#include "test-common.h"
+#include "provisioning-variant.h"
+
+static TestOpt test_opt;
+
+#define TEST_PREFIX "/variant/"
+
+static
+void
+test_assert_string(
+	GVariant *dict,
+	const char *key,
+	const char *expected)
+{
+	const char *value = NULL;
+	if (expected) {
+		g_assert(g_variant_lookup(dict, key, "&s", &value));
+		g_assert_cmpstr(value, == ,expected);
+	} else {
+		g_assert(!g_variant_lookup(dict, key, "&s", &value));
+	}
+}
+
+static
+void
+test_assert_linked(
+	GVariant *dict,
+	const char *expected)
+{
+	const char **linked = NULL;
+	char *str;
+	g_assert(g_variant_lookup(dict, "linked", "^a&s", &linked));
+	str = g_strjoinv(",", (char**)linked);
+	g_assert_cmpstr(str, == ,expected);
+	g_free(str);
+	g_free(linked);
+}
+
+static
+void
+test_empty(void)
+{
+	struct provisioning_data data;
+	GVariant *v;
+
+	memset(&data, 0, sizeof(data));
+	v = g_variant_ref_sink(provisioning_data_variant(&data));
+	g_assert(g_variant_is_of_type(v, G_VARIANT_TYPE_VARDICT));
+	g_assert_cmpuint(g_variant_n_children(v), == ,0);
+	g_variant_unref(v);
+}
+
+static
+void
+test_internet(void)
+{
+	struct provisioning_internet internet;
+	struct provisioning_data data;
+	GVariant *v;
+	GVariant *dict;
+
+	memset(&internet, 0, sizeof(internet));
+	internet.name = "Internet";
+	internet.apn = "internet.example.com";
+	internet.username = "user";
+	internet.authtype = AUTH_CHAP;
+	internet.linked = PROV_LINKED_APPLICATION | PROV_LINKED_NAPDEF;
+	memset(&data, 0, sizeof(data));
+	data.internet = &internet;
+
+	v = g_variant_ref_sink(provisioning_data_variant(&data));
+	g_assert_cmpuint(g_variant_n_children(v), == ,1);
+	g_assert(!g_variant_lookup_value(v, "mms", NULL));
+	dict = g_variant_lookup_value(v, "internet", G_VARIANT_TYPE_VARDICT);
+	g_assert(dict);
+	test_assert_string(dict, "name", "Internet");
+	test_assert_string(dict, "apn", "internet.example.com");
+	test_assert_string(dict, "username", "user");
+	test_assert_string(dict, "password", NULL);
+	test_assert_string(dict, "auth", "chap");
+	test_assert_string(dict, "messageproxy", NULL);
+	test_assert_linked(dict, "application,napdef");
+	g_variant_unref(dict);
+	g_variant_unref(v);
+}
+
+static
+void
+test_mms(void)
+{
+	struct provisioning_mms mms;
+	struct provisioning_data data;
+	GVariant *v;
+	GVariant *dict;
+
+	memset(&mms, 0, sizeof(mms));
+	mms.apn = "mms.example.com";
+	mms.password = "secret";
+	mms.messageproxy = "10.0.0.1";
+	mms.messagecenter = "http://mms.example.com";
+	mms.portnro = "8080";
+	mms.authtype = AUTH_PAP;
+	mms.linked = PROV_LINKED_APPLICATION | PROV_LINKED_PXLOGICAL |
+		PROV_LINKED_NAPDEF;
+	memset(&data, 0, sizeof(data));
+	data.mms = &mms;
+
+	v = g_variant_ref_sink(provisioning_data_variant(&data));
+	g_assert_cmpuint(g_variant_n_children(v), == ,1);
+	dict = g_variant_lookup_value(v, "mms", G_VARIANT_TYPE_VARDICT);
+	g_assert(dict);
+	test_assert_string(dict, "name", NULL);
+	test_assert_string(dict, "apn", "mms.example.com");
+	test_assert_string(dict, "password", "secret");
+	test_assert_string(dict, "auth", "pap");
+	test_assert_string(dict, "messageproxy", "10.0.0.1");
+	test_assert_string(dict, "messagecenter", "http://mms.example.com");
+	test_assert_string(dict, "port", "8080");
+	test_assert_linked(dict, "application,pxlogical,napdef");
+	g_variant_unref(dict);
+
+	/* Unknown auth type */
+	mms.authtype = AUTH_UNKNOWN;
+	mms.linked = 0;
+	g_variant_unref(v);
+	v = g_variant_ref_sink(provisioning_data_variant(&data));
+	dict = g_variant_lookup_value(v, "mms", G_VARIANT_TYPE_VARDICT);
+	test_assert_string(dict, "auth", "");
+	test_assert_linked(dict, "");
+	g_variant_unref(dict);
+	g_variant_unref(v);
+}
+
+static
+void
+test_parse(void)
+{
+	struct provisioning_data *data;
+	GVariantBuilder b;
+	GVariant *internet;
+	GVariant *mms;
+	GVariant *v;
+	GVariant *dict;
+	const char *error = NULL;
+
+	g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&b, "{sv}", "apn", g_variant_new_string("inet"));
+	g_variant_builder_add(&b, "{sv}", "name", g_variant_new_string("x"));
+	g_variant_builder_add(&b, "{sv}", "name", g_variant_new_string("Inet"));
+	g_variant_builder_add(&b, "{sv}", "auth", g_variant_new_string("CHAP"));
+	g_variant_builder_add(&b, "{sv}", "unknown", g_variant_new_int32(1));
+	internet = g_variant_ref_sink(g_variant_builder_end(&b));
+	g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&b, "{sv}", "apn", g_variant_new_string("mms"));
+	g_variant_builder_add(&b, "{sv}", "port", g_variant_new_string("80"));
+	mms = g_variant_ref_sink(g_variant_builder_end(&b));
+
+	data = provisioning_data_from_variant(internet, mms, &error);
+	g_assert(data);
+	g_assert(data->internet);
+	g_assert(data->mms);
+	g_assert_cmpstr(data->internet->apn, == ,"inet");
+	g_assert_cmpstr(data->internet->name, == ,"Inet");
+	g_assert(!data->internet->username);
+	g_assert_cmpint(data->internet->authtype, == ,AUTH_CHAP);
+	g_assert_cmpstr(data->mms->apn, == ,"mms");
+	g_assert_cmpstr(data->mms->portnro, == ,"80");
+	g_assert_cmpint(data->mms->authtype, == ,AUTH_UNKNOWN);
+
+	/* And back */
+	v = g_variant_ref_sink(provisioning_data_variant(data));
+	dict = g_variant_lookup_value(v, "internet", G_VARIANT_TYPE_VARDICT);
+	test_assert_string(dict, "apn", "inet");
+	test_assert_string(dict, "auth", "chap");
+	g_variant_unref(dict);
+	g_variant_unref(v);
+	provisioning_data_unref(data);
+
+	/* Empty dictionary leaves the context out */
+	v = g_variant_ref_sink(g_variant_new_array(G_VARIANT_TYPE("{sv}"),
+		NULL, 0));
+	data = provisioning_data_from_variant(v, mms, NULL);
+	g_assert(data);
+	g_assert(!data->internet);
+	g_assert(data->mms);
+	provisioning_data_unref(data);
+
+	/* Both can't be empty */
+	g_assert(!provisioning_data_from_variant(v, v, &error));
+	g_assert_cmpstr(error, == ,"No settings");
+	g_variant_unref(v);
+	g_variant_unref(internet);
+	g_variant_unref(mms);
+}
+
+static
+void
+test_parse_error(void)
+{
+	static const struct test_parse_error_data {
+		const char *key;
+		const char *value;
+		const char *error;
+	} tests[] = {
+		{ "auth", "none", "Invalid authentication method" },
+		{ "apn", "", "Missing internet APN" },
+		{ "name", "x", "Missing internet APN" }
+	};
+	GVariant *empty = g_variant_ref_sink(g_variant_new_array(
+		G_VARIANT_TYPE("{sv}"), NULL, 0));
+	GVariantBuilder b;
+	GVariant *v;
+	const char *error;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(tests); i++) {
+		g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+		g_variant_builder_add(&b, "{sv}", tests[i].key,
+			g_variant_new_string(tests[i].value));
+		v = g_variant_ref_sink(g_variant_builder_end(&b));
+		error = NULL;
+		g_assert(!provisioning_data_from_variant(v, empty, &error));
+		g_assert_cmpstr(error, == ,tests[i].error);
+		g_variant_unref(v);
+	}
+
+	/* Non-string values */
+	g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&b, "{sv}", "apn", g_variant_new_string("mms"));
+	g_variant_builder_add(&b, "{sv}", "port", g_variant_new_uint16(80));
+	v = g_variant_ref_sink(g_variant_builder_end(&b));
+	g_assert(!provisioning_data_from_variant(empty, v, &error));
+	g_assert_cmpstr(error, == ,"Settings must be strings");
+	g_variant_unref(v);
+
+	g_variant_builder_init(&b, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&b, "{sv}", "auth", g_variant_new_int32(1));
+	v = g_variant_ref_sink(g_variant_builder_end(&b));
+	g_assert(!provisioning_data_from_variant(empty, v, &error));
+	g_assert_cmpstr(error, == ,"Invalid authentication method");
+	g_variant_unref(v);
+	g_variant_unref(empty);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+	test_init(&test_opt, argc, argv);
+	g_test_add_func(TEST_PREFIX "empty", test_empty);
+	g_test_add_func(TEST_PREFIX "internet", test_internet);
+	g_test_add_func(TEST_PREFIX "mms", test_mms);
+	g_test_add_func(TEST_PREFIX "parse", test_parse);
+	g_test_add_func(TEST_PREFIX "parse_error", test_parse_error);
+	return g_test_run();
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 4
+ * c-basic-offset: 4
+ * indent-tabs-mode: t
+ * End:
+ */